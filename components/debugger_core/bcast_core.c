@@ -0,0 +1,189 @@
+#include "bcast_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void bcast_init(bcast_t *b, uint32_t evict_strikes, uint32_t max_lag_us, uint32_t byte_budget) {
+    memset(b, 0, sizeof(*b));
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) b->clients[i].fd = -1;
+    b->evict_strikes = evict_strikes;
+    b->max_lag_us = max_lag_us;
+    b->byte_budget = byte_budget;
+}
+
+int bcast_find_client(const bcast_t *b, int fd) {
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        if (b->clients[i].fd == fd) return i;
+    }
+    return -1;
+}
+
+int bcast_add_client(bcast_t *b, int fd) {
+    int slot = bcast_find_client(b, fd);
+    if (slot >= 0) return slot;
+    slot = bcast_find_client(b, -1);
+    if (slot < 0) return -1;
+
+    bcast_client_t *c = &b->clients[slot];
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    return slot;
+}
+
+void bcast_remove_client(bcast_t *b, int slot) {
+    if (slot < 0 || slot >= BCAST_MAX_CLIENTS) return;
+    bcast_client_t *c = &b->clients[slot];
+    uint32_t t;
+    bcast_msg_t *msg;
+    while ((msg = bcast_pop(c, &t)) != NULL) bcast_msg_unref(msg);
+    if (c->evict) b->evictions++;
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+bcast_msg_t *bcast_msg_new(bcast_t *b, const void *data, size_t len, bool binary, uint8_t key) {
+    uint32_t live = atomic_fetch_add(&b->live_bytes, len) + len;
+    bcast_msg_t *msg = live <= b->byte_budget ? malloc(sizeof(*msg) + len) : NULL;
+    if (!msg) {
+        atomic_fetch_sub(&b->live_bytes, len);
+        b->alloc_failures++;
+        return NULL;
+    }
+    atomic_init(&msg->refs, 1);
+    msg->owner = b;
+    msg->binary = binary;
+    msg->key = key;
+    msg->stamp_at = 0;
+    msg->len = len;
+    memcpy(msg->data, data, len);
+    return msg;
+}
+
+void bcast_msg_ref(bcast_msg_t *msg) {
+    atomic_fetch_add(&msg->refs, 1);
+}
+
+void bcast_msg_unref(bcast_msg_t *msg) {
+    if (atomic_fetch_sub(&msg->refs, 1) != 1) return;
+    atomic_fetch_sub(&msg->owner->live_bytes, msg->len);
+    free(msg);
+}
+
+static bool enqueue(bcast_t *b, bcast_client_t *c, bcast_msg_t *msg, uint32_t now_us) {
+    if (msg->key != BCAST_KEY_NONE) {
+        for (int i = 0; i < c->count; i++) {
+            bcast_entry_t *e = &c->q[(c->head + i) % BCAST_QUEUE_LEN];
+            if (e->msg->key != msg->key) continue;
+            // Keep the slot (and its enqueue time) but carry the newer content
+            bcast_msg_ref(msg);
+            bcast_msg_unref(e->msg);
+            e->msg = msg;
+            c->coalesced++;
+            c->strikes = 0;
+            return true;
+        }
+    }
+
+    if (c->count == BCAST_QUEUE_LEN) {
+        c->dropped++;
+        if (++c->strikes >= b->evict_strikes) c->evict = true;
+        return false;
+    }
+
+    bcast_msg_ref(msg);
+    c->q[(c->head + c->count) % BCAST_QUEUE_LEN] = (bcast_entry_t){ .msg = msg, .t_us = now_us };
+    c->count++;
+    c->strikes = 0;
+    if (c->count > c->max_depth) c->max_depth = c->count;
+    return true;
+}
+
+int bcast_publish(bcast_t *b, bcast_msg_t *msg, uint32_t targets, uint32_t now_us) {
+    int queued = 0;
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        bcast_client_t *c = &b->clients[i];
+        if (c->fd < 0 || c->evict || !(targets & (1u << i))) continue;
+        if (enqueue(b, c, msg, now_us)) queued++;
+    }
+    return queued;
+}
+
+void bcast_defer(bcast_t *b, uint32_t targets, uint32_t bits, uint32_t now_us) {
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        bcast_client_t *c = &b->clients[i];
+        if (c->fd < 0 || !(targets & (1u << i))) continue;
+        if (!c->deferred) c->deferred_t_us = now_us;
+        c->deferred |= bits;
+    }
+}
+
+bool bcast_has_work(const bcast_client_t *c) {
+    return c->fd >= 0 && (c->count || c->deferred || c->evict);
+}
+
+bcast_msg_t *bcast_pop(bcast_client_t *c, uint32_t *enqueued_us) {
+    if (!c->count) return NULL;
+    bcast_entry_t *e = &c->q[c->head];
+    c->head = (c->head + 1) % BCAST_QUEUE_LEN;
+    c->count--;
+    *enqueued_us = e->t_us;
+    return e->msg;
+}
+
+uint32_t bcast_take_deferred(bcast_client_t *c, uint32_t *since_us) {
+    uint32_t bits = c->deferred;
+    c->deferred = 0;
+    *since_us = c->deferred_t_us;
+    return bits;
+}
+
+void bcast_record_sent(bcast_client_t *c, uint32_t latency_us) {
+    c->sent++;
+    c->lat_last_us = latency_us;
+    c->lat_sum_us += latency_us;
+    if (latency_us > c->lat_max_us) c->lat_max_us = latency_us;
+}
+
+uint32_t bcast_check_lag(bcast_t *b, uint32_t now_us) {
+    uint32_t mask = 0;
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        bcast_client_t *c = &b->clients[i];
+        if (c->fd < 0) continue;
+        if (!c->evict && c->count && now_us - c->q[c->head].t_us > b->max_lag_us) {
+            c->evict = true;
+        }
+        if (c->evict) mask |= 1u << i;
+    }
+    return mask;
+}
+
+size_t bcast_stats_json(const bcast_t *b, char *out, size_t out_len) {
+    size_t pos = 0;
+    int n = snprintf(out, out_len, "{\"clients\":[");
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    pos = n;
+
+    bool first = true;
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        const bcast_client_t *c = &b->clients[i];
+        if (c->fd < 0) continue;
+        n = snprintf(out + pos, out_len - pos,
+            "%s{\"fd\":%d,\"depth\":%u,\"max_depth\":%lu,\"sent\":%lu,\"coalesced\":%lu,"
+            "\"dropped\":%lu,\"lat_us\":%lu,\"lat_avg_us\":%lu,\"lat_max_us\":%lu}",
+            first ? "" : ",", c->fd, c->count, (unsigned long)c->max_depth,
+            (unsigned long)c->sent, (unsigned long)c->coalesced, (unsigned long)c->dropped,
+            (unsigned long)c->lat_last_us,
+            (unsigned long)(c->sent ? c->lat_sum_us / c->sent : 0),
+            (unsigned long)c->lat_max_us);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+        first = false;
+    }
+
+    n = snprintf(out + pos, out_len - pos, "],\"live_bytes\":%lu,\"alloc_failures\":%lu,\"evictions\":%lu}",
+                 (unsigned long)atomic_load(&b->live_bytes), (unsigned long)b->alloc_failures,
+                 (unsigned long)b->evictions);
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
@@ -0,0 +1,166 @@
+#include "capture_core.h"
+#include "dbg_wire.h"
+
+#include <string.h>
+#include <strings.h>
+
+#define RING_MASK (CAP_RING_LEN - 1)
+
+#define PRIMED_LOW  0x01   // signal was below level - hysteresis
+#define PRIMED_HIGH 0x02   // signal was above level + hysteresis
+
+static const char *const trig_names[] = {
+    [CAP_TRIG_NONE] = "NONE",
+    [CAP_TRIG_RISING] = "RISING",
+    [CAP_TRIG_FALLING] = "FALLING",
+    [CAP_TRIG_EDGE] = "EDGE",
+    [CAP_TRIG_ABOVE] = "ABOVE",
+    [CAP_TRIG_BELOW] = "BELOW",
+};
+
+void cap_config_sanitize(cap_config_t *cfg) {
+    if (cfg->block_len < CAP_MIN_BLOCK) cfg->block_len = CAP_MIN_BLOCK;
+    if (cfg->block_len > CAP_MAX_BLOCK) cfg->block_len = CAP_MAX_BLOCK;
+    if (cfg->pre_trigger >= cfg->block_len) cfg->pre_trigger = cfg->block_len - 1;
+    if (cfg->trig_mode > CAP_TRIG_BELOW) cfg->trig_mode = CAP_TRIG_NONE;
+}
+
+void cap_engine_init(cap_engine_t *eng, const cap_config_t *cfg) {
+    memset(eng, 0, sizeof(*eng));
+    cap_engine_configure(eng, cfg);
+}
+
+void cap_engine_configure(cap_engine_t *eng, const cap_config_t *cfg) {
+    eng->cfg = *cfg;
+    cap_config_sanitize(&eng->cfg);
+    eng->state = CAP_ARMED;
+    eng->count = 0;
+    eng->primed = 0;
+}
+
+void cap_engine_reset(cap_engine_t *eng) {
+    eng->head = 0;
+    eng->block_start = 0;
+    eng->count = 0;
+    eng->primed = 0;
+    if (eng->state != CAP_STOPPED) eng->state = CAP_ARMED;
+}
+
+void cap_engine_rearm(cap_engine_t *eng) {
+    if (eng->state == CAP_STOPPED) {
+        eng->state = CAP_ARMED;
+        eng->primed = 0;
+    }
+}
+
+static bool trigger_hit(cap_engine_t *eng, uint16_t s) {
+    const cap_config_t *cfg = &eng->cfg;
+    int level = cfg->trig_level;
+    int lo = level - cfg->hysteresis;
+    int hi = level + cfg->hysteresis;
+
+    switch (cfg->trig_mode) {
+    case CAP_TRIG_NONE:
+        return true;
+    case CAP_TRIG_ABOVE:
+        return s >= level;
+    case CAP_TRIG_BELOW:
+        return s <= level;
+    default:
+        break;
+    }
+
+    bool rising = (eng->primed & PRIMED_LOW) && s >= level;
+    bool falling = (eng->primed & PRIMED_HIGH) && s <= level;
+    if (s <= lo) eng->primed |= PRIMED_LOW;
+    if (s >= hi) eng->primed |= PRIMED_HIGH;
+
+    switch (cfg->trig_mode) {
+    case CAP_TRIG_RISING:  return rising;
+    case CAP_TRIG_FALLING: return falling;
+    default:               return rising || falling;
+    }
+}
+
+static size_t frame_block(cap_engine_t *eng) {
+    const cap_config_t *cfg = &eng->cfg;
+    uint8_t *f = eng->frame;
+    bool triggered = cfg->trig_mode != CAP_TRIG_NONE;
+
+    f[0] = WIRE_ADC_BLOCK;
+    f[1] = cfg->channel;
+    f[2] = (triggered ? CAP_FLAG_TRIGGERED : 0) | (cfg->single ? CAP_FLAG_SINGLE : 0);
+    f[3] = (uint8_t)cfg->trig_mode;
+    wire_put_u32(f + 4, eng->seq++);
+    wire_put_u32(f + 8, cfg->sample_rate);
+    wire_put_u32(f + 12, eng->block_start);
+    wire_put_u16(f + 16, cfg->block_len);
+    wire_put_u16(f + 18, triggered ? cfg->pre_trigger : CAP_NO_TRIGGER);
+
+    uint8_t *p = f + CAP_HDR_LEN;
+    for (uint32_t i = 0; i < cfg->block_len; i++, p += 2) {
+        wire_put_u16(p, eng->ring[(eng->block_start + i) & RING_MASK]);
+    }
+    return CAP_HDR_LEN + (size_t)cfg->block_len * 2;
+}
+
+size_t cap_engine_push(cap_engine_t *eng, const uint16_t *samples, size_t n,
+                       cap_block_cb_t cb, void *ctx) {
+    const cap_config_t *cfg = &eng->cfg;
+    size_t blocks = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint16_t s = samples[i];
+        eng->ring[eng->head & RING_MASK] = s;
+        eng->head++;
+
+        switch (eng->state) {
+        case CAP_STOPPED:
+            continue;
+        case CAP_HOLDOFF:
+            if (++eng->count >= cfg->holdoff) {
+                eng->state = CAP_ARMED;
+                eng->primed = 0;
+            }
+            continue;
+        case CAP_ARMED:
+            // The pre-trigger window has to exist before a trigger can count
+            if (eng->head <= cfg->pre_trigger || !trigger_hit(eng, s)) continue;
+            eng->block_start = eng->head - 1 - cfg->pre_trigger;
+            eng->state = CAP_POST;
+            eng->triggers++;
+            break;
+        case CAP_POST:
+            break;
+        }
+
+        if (eng->head - eng->block_start < cfg->block_len) continue;
+
+        size_t len = frame_block(eng);
+        if (cb) cb(eng->frame, len, ctx);
+        blocks++;
+
+        eng->count = 0;
+        eng->primed = 0;
+        if (cfg->single) {
+            eng->state = CAP_STOPPED;
+        } else {
+            eng->state = cfg->holdoff ? CAP_HOLDOFF : CAP_ARMED;
+        }
+    }
+    return blocks;
+}
+
+bool cap_trig_mode_parse(const char *name, cap_trig_mode_t *mode) {
+    for (size_t i = 0; i < sizeof(trig_names) / sizeof(trig_names[0]); i++) {
+        if (strcasecmp(name, trig_names[i]) == 0) {
+            *mode = (cap_trig_mode_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *cap_trig_mode_name(cap_trig_mode_t mode) {
+    return mode <= CAP_TRIG_BELOW ? trig_names[mode] : "?";
+}
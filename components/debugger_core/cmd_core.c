@@ -0,0 +1,199 @@
+#include "cmd_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool cmd_table_init(cmd_table_t *table, const cmd_def_t *defs, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        if (strcmp(defs[i - 1].name, defs[i].name) >= 0) return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        for (int a = 0; a + 1 < defs[i].n_args; a++) {
+            if (defs[i].args[a].type == CMD_ARG_REST) return false;
+        }
+        if (defs[i].n_required > defs[i].n_args || defs[i].n_args > CMD_MAX_ARGS) return false;
+    }
+    table->defs = defs;
+    table->n = n;
+    return true;
+}
+
+const cmd_def_t *cmd_lookup(const cmd_table_t *table, const char *name, size_t len) {
+    size_t lo = 0, hi = table->n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const char *m = table->defs[mid].name;
+        int c = strncmp(name, m, len);
+        if (c == 0 && m[len] != '\0') c = -1;   // name is a prefix of m
+        if (c == 0) return &table->defs[mid];
+        if (c < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+static bool parse_int(const char *s, int32_t min, int32_t max, int32_t *out, const char **err) {
+    char *end;
+    if (*s == '\0') {
+        *err = "missing number";
+        return false;
+    }
+    // Decimal, so a leading zero is not octal; hex only with an explicit 0x
+    const char *digits = s + (*s == '-' || *s == '+');
+    int base = digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X') ? 16 : 10;
+    long long v = strtoll(s, &end, base);
+    if (*end != '\0') {
+        *err = "bad number";
+        return false;
+    }
+    if (v < min || v > max) {
+        *err = "out of range";
+        return false;
+    }
+    *out = (int32_t)v;
+    return true;
+}
+
+// Parse one NUL-terminated line into cmd
+static bool parse_line(const cmd_table_t *table, char *line, cmd_t *cmd, const char **err) {
+    char *colon = strchr(line, ':');
+    size_t name_len = colon ? (size_t)(colon - line) : strlen(line);
+    const cmd_def_t *def = cmd_lookup(table, line, name_len);
+    if (!def) {
+        *err = "unknown command";
+        return false;
+    }
+
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->def = def;
+    char *p = colon && colon[1] ? colon + 1 : NULL;
+
+    for (int i = 0; i < def->n_args && p; i++) {
+        const cmd_arg_spec_t *spec = &def->args[i];
+        char *arg = p;
+        if (spec->type == CMD_ARG_REST) {
+            p = NULL;
+        } else {
+            char *comma = strchr(p, ',');
+            if (comma) *comma = '\0';
+            p = comma ? comma + 1 : NULL;
+        }
+        if (spec->type == CMD_ARG_INT && !parse_int(arg, spec->min, spec->max, &cmd->ival[i], err)) return false;
+        cmd->sval[i] = arg;
+        cmd->argc++;
+    }
+    if (p) {
+        *err = "too many arguments";
+        return false;
+    }
+    if (cmd->argc < def->n_required) {
+        *err = "missing argument";
+        return false;
+    }
+    return true;
+}
+
+bool cmd_parse_batch(const cmd_table_t *table, char *buf, size_t len, void *ctx, cmd_batch_t *batch) {
+    batch->n = 0;
+    batch->error_line = 0;
+    batch->error = NULL;
+
+    char *p = buf, *end = buf + len;
+    int line_no = 0;
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        char *line = p;
+        char *line_end = nl ? nl : end;
+        p = line_end + 1;
+        line_no++;
+
+        if (line_end > line && line_end[-1] == '\r') line_end--;
+        *line_end = '\0';
+        if (line_end == line) continue;
+
+        const char *err = NULL;
+        if (strlen(line) != (size_t)(line_end - line)) {
+            err = "embedded NUL";
+        } else if (batch->n == CMD_MAX_BATCH) {
+            err = "too many commands";
+        } else {
+            cmd_t *cmd = &batch->cmds[batch->n];
+            if (parse_line(table, line, cmd, &err) &&
+                (!cmd->def->check || cmd->def->check(cmd, ctx, &err) == 0)) {
+                batch->n++;
+                continue;
+            }
+            if (!err) err = "rejected";
+        }
+        batch->error = err;
+        batch->error_line = line_no;
+        return false;
+    }
+    return true;
+}
+
+int cmd_run_batch(const cmd_batch_t *batch, void *ctx, const char **err) {
+    int failed = 0;
+    for (size_t i = 0; i < batch->n; i++) {
+        const char *e = NULL;
+        if (batch->cmds[i].def->run(&batch->cmds[i], ctx, &e) != 0) {
+            failed++;
+            if (err && e) *err = e;
+        }
+    }
+    return failed;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+size_t cmd_unescape(char *s) {
+    char *out = s;
+    for (const char *in = s; *in; in++) {
+        if (*in != '\\' || !in[1]) {
+            *out++ = *in;
+            continue;
+        }
+        switch (*++in) {
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'x': {
+            int hi = hex_digit(in[1]);
+            int lo = hi >= 0 ? hex_digit(in[2]) : -1;
+            if (lo >= 0) {
+                *out++ = (char)(hi << 4 | lo);
+                in += 2;
+            } else {
+                *out++ = 'x';
+            }
+            break;
+        }
+        default: *out++ = *in; break;
+        }
+    }
+    *out = '\0';
+    return out - s;
+}
+
+char *cmd_pool_claim(cmd_pool_t *pool) {
+    uint32_t busy = atomic_load(&pool->busy);
+    for (int i = 0; i < CMD_POOL_BUFS; i++) {
+        uint32_t bit = 1u << i;
+        while (!(busy & bit)) {
+            if (atomic_compare_exchange_weak(&pool->busy, &busy, busy | bit)) return pool->bufs[i];
+        }
+    }
+    pool->exhausted++;
+    return NULL;
+}
+
+void cmd_pool_release(cmd_pool_t *pool, char *buf) {
+    if (!buf) return;
+    int i = (buf - pool->bufs[0]) / CMD_BUF_LEN;
+    if (i >= 0 && i < CMD_POOL_BUFS) atomic_fetch_and(&pool->busy, ~(1u << i));
+}
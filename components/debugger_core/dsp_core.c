@@ -0,0 +1,200 @@
+#include "dsp_core.h"
+#include "scan_core.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#if DSP_USE_ESP_DSP
+#include <esp_err.h>
+#include "dsps_fft2r.h"
+#endif
+
+#define DSP_PI              3.14159265358979f
+#define DSP_FLAT_MV         2.0f        // peak amplitude below which there is no frequency
+#define DSP_DUTY_MIN_VPP    50.0f       // mV swing needed before duty is measured
+
+uint16_t dsp_fft_len(uint32_t samples) {
+    if (samples < DSP_MIN_N) return 0;
+    uint16_t n = DSP_MAX_N;
+    while (n > samples) n >>= 1;
+    return n;
+}
+
+bool dsp_fft_init(dsp_fft_t *f, uint16_t n) {
+    if (n < DSP_MIN_N || n > DSP_MAX_N || (n & (n - 1))) return false;
+#if DSP_USE_ESP_DSP
+    // One shared table sized for the largest FFT, kept for good
+    static bool tables;
+    if (!tables) tables = dsps_fft2r_init_fc32(NULL, DSP_MAX_N) == ESP_OK;
+    if (!tables) return false;
+#endif
+    f->n = n;
+    for (uint16_t i = 0; i < n; i++) f->window[i] = 0.5f - 0.5f * cosf(2 * DSP_PI * i / n);
+    for (uint16_t k = 0; k < n / 2; k++) {
+        f->twiddle[2 * k] = cosf(2 * DSP_PI * k / n);
+        f->twiddle[2 * k + 1] = -sinf(2 * DSP_PI * k / n);
+    }
+    return true;
+}
+
+#if !DSP_USE_ESP_DSP
+static void bit_reverse(float *x, uint16_t n) {
+    for (uint16_t i = 1, j = 0; i < n; i++) {
+        uint16_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            float re = x[2 * i], im = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = re;
+            x[2 * j + 1] = im;
+        }
+    }
+}
+#endif
+
+void dsp_fft_run(dsp_fft_t *f) {
+#if DSP_USE_ESP_DSP
+    dsps_fft2r_fc32(f->buf, f->n);
+    dsps_bit_rev_fc32(f->buf, f->n);
+#else
+    float *x = f->buf;
+    uint16_t n = f->n;
+    bit_reverse(x, n);
+    for (uint16_t len = 2, stride = n / 2; len <= n; len <<= 1, stride >>= 1) {
+        for (uint16_t i = 0; i < n; i += len) {
+            for (uint16_t k = 0; k < len / 2; k++) {
+                float wr = f->twiddle[2 * k * stride], wi = f->twiddle[2 * k * stride + 1];
+                float *a = &x[2 * (i + k)], *b = &x[2 * (i + k + len / 2)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+#endif
+}
+
+// High time over the span between the first and last rising edge, with
+// hysteresis at a tenth of the swing either side of the midpoint
+static float measure_duty(const float *mv, uint16_t n, float lo_mv, float hi_mv) {
+    float mid = (lo_mv + hi_mv) / 2, hyst = (hi_mv - lo_mv) / 10;
+    bool high = mv[0] > mid;
+    int32_t first = -1, last = -1;
+    uint32_t high_count = 0, high_at_first = 0, high_at_last = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        if (!high && mv[i] > mid + hyst) {
+            high = true;
+            if (first < 0) {
+                first = i;
+                high_at_first = high_count;
+            }
+            last = i;
+            high_at_last = high_count;
+        } else if (high && mv[i] < mid - hyst) {
+            high = false;
+        }
+        if (high) high_count++;
+    }
+    if (first < 0 || last == first) return -1;
+    return (float)(high_at_last - high_at_first) / (float)(last - first);
+}
+
+void dsp_analyze(dsp_fft_t *f, const uint16_t *raw, const uint16_t *lut, uint32_t rate, dsp_result_t *r) {
+    uint16_t n = f->n;
+    float sum = 0, sum_sq = 0, lo = 65535, hi = 0;
+
+    // mV values wait in the upper half of buf; interleaving them in place
+    // below only ever overwrites entries already read
+    float *mv = f->buf + n;
+    for (uint16_t i = 0; i < n; i++) {
+        float v = lut[raw[i] & (SCAN_LUT_LEN - 1)];
+        mv[i] = v;
+        sum += v;
+        sum_sq += v * v;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    r->n = n;
+    r->rate = rate;
+    r->mean_mv = sum / n;
+    r->rms_mv = sqrtf(sum_sq / n);
+    r->min_mv = lo;
+    r->max_mv = hi;
+    r->duty = hi - lo >= DSP_DUTY_MIN_VPP ? measure_duty(mv, n, lo, hi) : -1;
+
+    // Remove DC before windowing so its leakage does not mask low bins
+    for (uint16_t i = 0; i < n; i++) {
+        float v = mv[i] - r->mean_mv;
+        f->buf[2 * i] = v * f->window[i];
+        f->buf[2 * i + 1] = 0;
+    }
+    dsp_fft_run(f);
+
+    // Hann coherent gain is 1/2: a bin of a sine of amplitude A reads A * n / 4
+    uint16_t half = n / 2, group = half > DSP_SPECTRUM_BINS ? half / DSP_SPECTRUM_BINS : 1;
+    float scale = 4.0f / n, peak = 0;
+    uint16_t peak_k = 0;
+    for (uint16_t k = 0; k < half; k++) {
+        float re = f->buf[2 * k], im = f->buf[2 * k + 1];
+        float amp = sqrtf(re * re + im * im) * scale;
+        f->buf[k] = amp;                // complex bin k is in buf[2k], already read
+        if (k >= 1 && amp > peak) {
+            peak = amp;
+            peak_k = k;
+        }
+    }
+
+    r->freq_hz = 0;
+    if (peak >= DSP_FLAT_MV && peak_k + 1 < half) {
+        // Parabola through the log magnitudes around the peak
+        float a = logf(f->buf[peak_k - 1] + 1e-6f), b = logf(peak), c = logf(f->buf[peak_k + 1] + 1e-6f);
+        float den = a - 2 * b + c;
+        float delta = den != 0 ? 0.5f * (a - c) / den : 0;
+        r->freq_hz = (peak_k + delta) * rate / n;
+    } else if (peak >= DSP_FLAT_MV) {
+        r->freq_hz = (float)peak_k * rate / n;
+    }
+
+    r->bins = half / group;
+    r->bin_hz = (float)rate * group / n;
+    for (uint16_t b = 0; b < r->bins; b++) {
+        float amp = 0;
+        for (uint16_t k = b * group; k < (b + 1) * group; k++) {
+            if (k && f->buf[k] > amp) amp = f->buf[k];
+        }
+        float db = amp > 0 ? 20 * log10f(amp) : DSP_DB_FLOOR;
+        r->db[b] = (int8_t)(db < DSP_DB_FLOOR ? DSP_DB_FLOOR : db > 127 ? 127 : lrintf(db));
+    }
+}
+
+size_t dsp_result_to_json(const dsp_result_t *r, int pin, char *out, size_t out_len) {
+    int n = snprintf(out, out_len,
+                     "{\"analysis\":{\"pin\":%d,\"n\":%u,\"rate\":%lu,\"mean\":%.3f,\"rms\":%.3f,\"vpp\":%.3f,"
+                     "\"freq\":%.1f,\"duty\":",
+                     pin, r->n, (unsigned long)r->rate, r->mean_mv / 1000, r->rms_mv / 1000,
+                     (r->max_mv - r->min_mv) / 1000, r->freq_hz);
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    size_t pos = n;
+
+    n = r->duty < 0 ? snprintf(out + pos, out_len - pos, "null") : snprintf(out + pos, out_len - pos, "%.3f", r->duty);
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    pos += n;
+
+    n = snprintf(out + pos, out_len - pos, ",\"bin_hz\":%.2f,\"db\":[", r->bin_hz);
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    pos += n;
+
+    for (uint16_t i = 0; i < r->bins; i++) {
+        n = snprintf(out + pos, out_len - pos, "%s%d", i ? "," : "", r->db[i]);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+    }
+    n = snprintf(out + pos, out_len - pos, "],\"cycles\":%lu}}", (unsigned long)r->cycles);
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
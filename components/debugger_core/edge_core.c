@@ -0,0 +1,123 @@
+#include "edge_core.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void edge_ring_init(edge_ring_t *ring) {
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->overruns, 0);
+}
+
+static void window_clear(edge_pin_stats_t *p) {
+    p->win_edges = 0;
+    p->min_high_us = p->min_low_us = UINT32_MAX;
+    p->max_high_us = p->max_low_us = 0;
+}
+
+void edge_stats_init(edge_stats_t *st, size_t num_pins, uint32_t bounce_us, uint32_t now_us) {
+    memset(st, 0, sizeof(*st));
+    st->num_pins = num_pins > EDGE_MAX_PINS ? EDGE_MAX_PINS : num_pins;
+    st->bounce_us = bounce_us;
+    edge_stats_window_reset(st, now_us);
+}
+
+void edge_stats_seed(edge_stats_t *st, uint8_t pin, uint8_t level, uint32_t now_us) {
+    if (pin >= st->num_pins) return;
+    st->pins[pin].level = level;
+    st->pins[pin].last_t_us = now_us;
+}
+
+static void record_pulse(edge_pin_stats_t *p, bool high, uint32_t width) {
+    if (high) {
+        p->last_high_us = width;
+        if (width < p->min_high_us) p->min_high_us = width;
+        if (width > p->max_high_us) p->max_high_us = width;
+    } else {
+        p->last_low_us = width;
+        if (width < p->min_low_us) p->min_low_us = width;
+        if (width > p->max_low_us) p->max_low_us = width;
+    }
+}
+
+void edge_stats_apply(edge_stats_t *st, const edge_event_t *ev) {
+    if (ev->pin >= st->num_pins) return;
+    edge_pin_stats_t *p = &st->pins[ev->pin];
+    uint32_t dt = ev->t_us - p->last_t_us;
+    uint32_t bit = 1u << ev->pin;
+
+    if (ev->level == p->level) {
+        // The opposite edge came and went before the ISR sampled the level:
+        // a pulse narrower than the interrupt latency, always a bounce.
+        p->edges += 2;
+        p->win_edges += 2;
+        p->bounces++;
+        record_pulse(p, !ev->level, 0);
+    } else {
+        p->edges++;
+        p->win_edges++;
+        if (dt < st->bounce_us) p->bounces++;
+        record_pulse(p, p->level, dt);
+        p->level = ev->level;
+        st->level_changed ^= bit;   // an even number of changes cancels out
+    }
+    p->last_t_us = ev->t_us;
+    st->active |= bit;
+}
+
+size_t edge_stats_drain(edge_stats_t *st, edge_ring_t *ring, size_t max) {
+    edge_event_t ev;
+    size_t n = 0;
+    while (n < max && edge_ring_pop(ring, &ev)) {
+        edge_stats_apply(st, &ev);
+        n++;
+    }
+    return n;
+}
+
+uint32_t edge_stats_rate(const edge_stats_t *st, uint8_t pin, uint32_t now_us) {
+    uint32_t span = now_us - st->window_start_us;
+    if (pin >= st->num_pins || span == 0) return 0;
+    return (uint32_t)((uint64_t)st->pins[pin].win_edges * 1000000u / span);
+}
+
+void edge_stats_window_reset(edge_stats_t *st, uint32_t now_us) {
+    st->window_start_us = now_us;
+    st->active = 0;
+    st->level_changed = 0;
+    for (size_t i = 0; i < st->num_pins; i++) window_clear(&st->pins[i]);
+}
+
+static uint32_t min_or_zero(uint32_t v) {
+    return v == UINT32_MAX ? 0 : v;
+}
+
+size_t edge_stats_to_json(const edge_stats_t *st, const int *gpio_nums, uint32_t overruns,
+                          uint32_t now_us, char *out, size_t out_len) {
+    size_t pos = 0;
+    int n = snprintf(out, out_len, "{\"edges\":{\"overruns\":%lu,\"window_ms\":%lu,\"pins\":[",
+                     (unsigned long)overruns, (unsigned long)((now_us - st->window_start_us) / 1000));
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    pos = n;
+
+    bool first = true;
+    for (size_t i = 0; i < st->num_pins; i++) {
+        if (!(st->active & (1u << i))) continue;
+        const edge_pin_stats_t *p = &st->pins[i];
+        n = snprintf(out + pos, out_len - pos,
+            "%s{\"pin\":%d,\"level\":%d,\"edges\":%lu,\"bounce\":%lu,\"rate\":%lu,"
+            "\"high_us\":[%lu,%lu],\"low_us\":[%lu,%lu]}",
+            first ? "" : ",", gpio_nums[i], p->level,
+            (unsigned long)p->edges, (unsigned long)p->bounces,
+            (unsigned long)edge_stats_rate(st, i, now_us),
+            (unsigned long)min_or_zero(p->min_high_us), (unsigned long)p->max_high_us,
+            (unsigned long)min_or_zero(p->min_low_us), (unsigned long)p->max_low_us);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+        first = false;
+    }
+
+    n = snprintf(out + pos, out_len - pos, "]}}");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
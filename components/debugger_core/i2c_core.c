@@ -0,0 +1,97 @@
+#include "i2c_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parse one number and step over it; rejects trailing garbage up to the next separator
+static bool parse_num(const char **s, unsigned long max, unsigned long *out) {
+    char *end;
+    unsigned long v = strtoul(*s, &end, 0);
+    if (end == *s || v > max) return false;
+    *s = end;
+    *out = v;
+    return true;
+}
+
+static bool parse_op(const char *s, i2c_op_t *op) {
+    unsigned long v;
+    memset(op, 0, sizeof(*op));
+    if ((s[0] != 'R' && s[0] != 'W' && s[0] != 'D') || s[1] != ':') return false;
+    op->type = (i2c_op_type_t)s[0];
+    s += 2;
+    if (!parse_num(&s, 0xFF, &v)) return false;
+    op->reg = v;
+
+    if (op->type == I2C_OP_WRITE) {
+        while (*s == ',') {
+            s++;
+            if (op->len == I2C_MAX_WRITE || !parse_num(&s, 0xFF, &v)) return false;
+            op->data[op->len++] = v;
+        }
+    } else {
+        if (*s++ != ',' || !parse_num(&s, I2C_MAX_READ, &v) || v == 0) return false;
+        op->len = v;
+    }
+    return *s == '\0' || *s == ';';
+}
+
+bool i2c_txn_parse(const char *s, i2c_txn_t *txn) {
+    unsigned long addr;
+    memset(txn, 0, sizeof(*txn));
+    if (!parse_num(&s, 0x7F, &addr) || addr < 0x08 || addr > 0x77) return false;
+    txn->addr = addr;
+
+    while (*s == ';') {
+        s++;
+        if (txn->n_ops == I2C_MAX_OPS || !parse_op(s, &txn->ops[txn->n_ops])) return false;
+        txn->n_ops++;
+        s += strcspn(s, ";");
+    }
+    return *s == '\0' && txn->n_ops > 0;
+}
+
+static size_t put_bytes(char *out, size_t out_len, const uint8_t *data, size_t n) {
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++) {
+        int w = snprintf(out + pos, out_len - pos, "%s%u", i ? "," : "", data[i]);
+        if (w < 0 || (size_t)w >= out_len - pos) return out_len;
+        pos += w;
+    }
+    return pos;
+}
+
+size_t i2c_op_to_json(uint32_t job, int index, uint8_t addr, const i2c_op_t *op,
+                      const uint8_t *data, size_t n, uint32_t us, const char *err,
+                      char *out, size_t out_len) {
+    int w = snprintf(out, out_len,
+        "{\"i2c_op\":{\"job\":%lu,\"i\":%d,\"addr\":%u,\"op\":\"%c\",\"reg\":%u,\"n\":%u,\"us\":%lu,\"err\":\"%s\",\"data\":[",
+        (unsigned long)job, index, addr, (char)op->type, op->reg, (unsigned)n, (unsigned long)us, err);
+    if (w < 0 || (size_t)w >= out_len) return 0;
+    size_t pos = w;
+
+    if (op->type != I2C_OP_WRITE) pos += put_bytes(out + pos, out_len - pos, data, n);
+    if (pos >= out_len) return 0;
+
+    w = snprintf(out + pos, out_len - pos, "]}}");
+    if (w < 0 || (size_t)w >= out_len - pos) return 0;
+    return pos + w;
+}
+
+size_t i2c_scan_to_json(uint32_t job, const uint8_t *found, size_t n_found, uint8_t next_addr,
+                        bool done, uint32_t us, const char *err, char *out, size_t out_len) {
+    int w = done ? snprintf(out, out_len, "{\"i2c\":[")
+                 : snprintf(out, out_len, "{\"i2c_scan\":{\"job\":%lu,\"next\":%u,\"found\":[",
+                            (unsigned long)job, next_addr);
+    if (w < 0 || (size_t)w >= out_len) return 0;
+    size_t pos = w;
+
+    pos += put_bytes(out + pos, out_len - pos, found, n_found);
+    if (pos >= out_len) return 0;
+
+    w = done ? snprintf(out + pos, out_len - pos, "],\"job\":%lu,\"us\":%lu,\"err\":\"%s\"}",
+                        (unsigned long)job, (unsigned long)us, err)
+             : snprintf(out + pos, out_len - pos, "]}}");
+    if (w < 0 || (size_t)w >= out_len - pos) return 0;
+    return pos + w;
+}
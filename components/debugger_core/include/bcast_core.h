@@ -0,0 +1,97 @@
+// Broadcast fan-out: refcounted messages encoded once and shared by
+// bounded per-client queues, with coalescing of superseded state messages
+// and eviction of clients that fall too far behind.
+//
+// Not thread safe: the caller serialises every call except bcast_msg_unref(),
+// which may run anywhere (the sender drops its reference after the send).
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BCAST_MAX_CLIENTS   8
+#define BCAST_QUEUE_LEN     16
+#define BCAST_ALL           0xFFFFFFFFu
+
+#define BCAST_KEY_NONE      0   // never coalesced
+
+struct bcast;
+
+typedef struct bcast_msg {
+    _Atomic uint32_t refs;
+    struct bcast *owner;
+    uint8_t binary;
+    uint8_t key;            // a newer message with the same key replaces a queued one
+    uint16_t stamp_at;      // offset of a send-time field the sender fills in, 0 = none
+    uint32_t len;
+    uint8_t data[];
+} bcast_msg_t;
+
+typedef struct {
+    bcast_msg_t *msg;
+    uint32_t t_us;          // enqueue time
+} bcast_entry_t;
+
+typedef struct {
+    int fd;                 // -1 = free slot
+    bcast_entry_t q[BCAST_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    uint32_t deferred;      // per-client messages the sender encodes itself when due
+    uint32_t deferred_t_us;
+    bool evict;
+    uint32_t strikes;       // consecutive drops
+    // Statistics
+    uint32_t max_depth;
+    uint32_t sent;
+    uint32_t coalesced;
+    uint32_t dropped;
+    uint32_t lat_last_us;
+    uint32_t lat_max_us;
+    uint64_t lat_sum_us;
+} bcast_client_t;
+
+typedef struct bcast {
+    bcast_client_t clients[BCAST_MAX_CLIENTS];
+    uint32_t evict_strikes;     // consecutive drops before a client is evicted
+    uint32_t max_lag_us;        // oldest queued message age before a client is evicted
+    uint32_t byte_budget;       // total payload bytes alive across all messages
+    _Atomic uint32_t live_bytes;
+    uint32_t alloc_failures;
+    uint32_t evictions;
+} bcast_t;
+
+void bcast_init(bcast_t *b, uint32_t evict_strikes, uint32_t max_lag_us, uint32_t byte_budget);
+
+// Slot management, returns the slot index or -1
+int bcast_add_client(bcast_t *b, int fd);
+void bcast_remove_client(bcast_t *b, int slot);
+int bcast_find_client(const bcast_t *b, int fd);
+
+// Message with one reference owned by the caller; NULL when out of budget/memory
+bcast_msg_t *bcast_msg_new(bcast_t *b, const void *data, size_t len, bool binary, uint8_t key);
+void bcast_msg_ref(bcast_msg_t *msg);
+void bcast_msg_unref(bcast_msg_t *msg);
+
+// Queue msg for every client in the targets slot mask; the caller keeps its
+// own reference. Returns the number of queues the message entered.
+int bcast_publish(bcast_t *b, bcast_msg_t *msg, uint32_t targets, uint32_t now_us);
+
+// Flag per-client deferred work (bit meaning is up to the caller)
+void bcast_defer(bcast_t *b, uint32_t targets, uint32_t bits, uint32_t now_us);
+
+bool bcast_has_work(const bcast_client_t *c);
+
+// Pop the next queued message; the caller inherits the queue's reference
+bcast_msg_t *bcast_pop(bcast_client_t *c, uint32_t *enqueued_us);
+uint32_t bcast_take_deferred(bcast_client_t *c, uint32_t *since_us);
+
+void bcast_record_sent(bcast_client_t *c, uint32_t latency_us);
+
+// Flag clients whose oldest message exceeds max_lag_us; returns the evict mask
+uint32_t bcast_check_lag(bcast_t *b, uint32_t now_us);
+
+// {"clients":[{"fd":..,"depth":..,...}],...}; returns the length or 0
+size_t bcast_stats_json(const bcast_t *b, char *out, size_t out_len);
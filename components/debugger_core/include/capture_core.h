@@ -0,0 +1,87 @@
+// Triggered sample capture: ring buffer, trigger detection and block framing.
+// Hardware independent so it can be fed from the ADC DMA driver on target
+// or from a synthetic source on the host.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAP_RING_LEN   4096            // must be a power of two
+#define CAP_MIN_BLOCK  16
+#define CAP_MAX_BLOCK  1024
+#define CAP_HDR_LEN    20
+#define CAP_FRAME_MAX  (CAP_HDR_LEN + CAP_MAX_BLOCK * 2)
+
+// Block header flags
+#define CAP_FLAG_TRIGGERED 0x01
+#define CAP_FLAG_SINGLE    0x02
+
+#define CAP_NO_TRIGGER     0xFFFF
+
+typedef enum {
+    CAP_TRIG_NONE = 0,  // free running, a block every block_len + holdoff samples
+    CAP_TRIG_RISING,
+    CAP_TRIG_FALLING,
+    CAP_TRIG_EDGE,      // either edge
+    CAP_TRIG_ABOVE,     // level: sample >= trig_level
+    CAP_TRIG_BELOW,     // level: sample <= trig_level
+} cap_trig_mode_t;
+
+typedef struct {
+    uint32_t sample_rate;       // Hz, carried in the block header only
+    uint16_t block_len;         // samples per block
+    uint16_t pre_trigger;       // samples of the block that precede the trigger
+    cap_trig_mode_t trig_mode;
+    uint16_t trig_level;        // raw code
+    uint16_t hysteresis;        // raw codes the signal must cross back before an edge re-arms
+    uint32_t holdoff;           // samples ignored after a block before re-arming
+    bool single;                // stop after one block until cap_engine_rearm()
+    uint8_t channel;            // carried in the block header only
+} cap_config_t;
+
+typedef enum {
+    CAP_STOPPED = 0,
+    CAP_HOLDOFF,
+    CAP_ARMED,
+    CAP_POST,
+} cap_state_t;
+
+typedef struct {
+    cap_config_t cfg;
+    cap_state_t state;
+    uint32_t head;              // total samples written, ring index is head & (CAP_RING_LEN - 1)
+    uint32_t count;             // samples spent in the current state
+    uint32_t block_start;       // absolute index of the first sample of the pending block
+    uint8_t primed;             // hysteresis flags for edge triggers
+    uint32_t seq;
+    uint32_t triggers;
+    uint16_t ring[CAP_RING_LEN];
+    uint8_t frame[CAP_FRAME_MAX];
+} cap_engine_t;
+
+// Called with a complete framed block; the buffer is reused after return.
+typedef void (*cap_block_cb_t)(const uint8_t *frame, size_t len, void *ctx);
+
+// Clamp a configuration into the range the engine supports.
+void cap_config_sanitize(cap_config_t *cfg);
+
+void cap_engine_init(cap_engine_t *eng, const cap_config_t *cfg);
+
+// Apply a new configuration. Samples already in the ring are kept so the
+// pre-trigger window is available immediately.
+void cap_engine_configure(cap_engine_t *eng, const cap_config_t *cfg);
+
+// Forget the samples in the ring, e.g. after switching pin or rate: the
+// next trigger waits for a fresh pre-trigger window. seq keeps counting.
+void cap_engine_reset(cap_engine_t *eng);
+
+// Re-arm after a single-shot block (no-op while running).
+void cap_engine_rearm(cap_engine_t *eng);
+
+// Feed samples; returns the number of blocks delivered to cb.
+size_t cap_engine_push(cap_engine_t *eng, const uint16_t *samples, size_t n,
+                       cap_block_cb_t cb, void *ctx);
+
+bool cap_trig_mode_parse(const char *name, cap_trig_mode_t *mode);
+const char *cap_trig_mode_name(cap_trig_mode_t mode);
@@ -0,0 +1,87 @@
+// Text command dispatch: a static, name-sorted command table, argument
+// validation against per-command specs, and newline-separated batches that
+// are parsed in place and either validated as a whole or rejected as a whole.
+//
+// Frames come from a small preallocated receive pool so dispatching a
+// command never touches the heap.
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CMD_MAX_ARGS    5
+#define CMD_MAX_BATCH   32      // commands per frame
+#define CMD_POOL_BUFS   2
+#define CMD_BUF_LEN     2048
+
+typedef enum {
+    CMD_ARG_INT,        // decimal or 0x hex, checked against [min, max]
+    CMD_ARG_WORD,       // text up to the next comma
+    CMD_ARG_REST,       // rest of the line, commas included; must be last
+} cmd_arg_type_t;
+
+typedef struct {
+    cmd_arg_type_t type;
+    int32_t min;
+    int32_t max;
+} cmd_arg_spec_t;
+
+struct cmd_def;
+
+typedef struct {
+    const struct cmd_def *def;
+    uint8_t argc;
+    int32_t ival[CMD_MAX_ARGS];         // CMD_ARG_INT values
+    const char *sval[CMD_MAX_ARGS];     // every argument as text, NUL-terminated
+} cmd_t;
+
+// Return 0 on success, or a short static reason string through *err
+typedef int (*cmd_fn_t)(const cmd_t *cmd, void *ctx, const char **err);
+
+typedef struct cmd_def {
+    const char *name;                   // matched exactly against the text before ':'
+    uint8_t n_args;
+    uint8_t n_required;
+    cmd_arg_spec_t args[CMD_MAX_ARGS];
+    cmd_fn_t check;                     // optional semantic check, runs before anything is applied
+    cmd_fn_t run;
+} cmd_def_t;
+
+typedef struct {
+    const cmd_def_t *defs;              // sorted by name (strcmp order)
+    size_t n;
+} cmd_table_t;
+
+typedef struct {
+    size_t n;
+    int error_line;                     // 1-based, 0 when the batch is valid
+    const char *error;
+    cmd_t cmds[CMD_MAX_BATCH];
+} cmd_batch_t;
+
+// Fails if the table is not sorted or has duplicate names
+bool cmd_table_init(cmd_table_t *table, const cmd_def_t *defs, size_t n);
+const cmd_def_t *cmd_lookup(const cmd_table_t *table, const char *name, size_t len);
+
+// Split buf (modified in place, buf[len] must be writable) into lines and validate every command,
+// including its check hook. Blank lines are skipped and a trailing '\r' is
+// dropped. Returns false with error/error_line set if any line is invalid.
+bool cmd_parse_batch(const cmd_table_t *table, char *buf, size_t len, void *ctx, cmd_batch_t *batch);
+
+// Run a parsed batch in order; returns the number of commands that failed
+int cmd_run_batch(const cmd_batch_t *batch, void *ctx, const char **err);
+
+// Decode \n \r \t \\ and \xNN in place; returns the new length
+size_t cmd_unescape(char *s);
+
+// Receive buffers, claimed and released from any task without locking
+typedef struct {
+    _Atomic uint32_t busy;
+    uint32_t exhausted;
+    char bufs[CMD_POOL_BUFS][CMD_BUF_LEN];
+} cmd_pool_t;
+
+char *cmd_pool_claim(cmd_pool_t *pool);     // NULL when all buffers are in use
+void cmd_pool_release(cmd_pool_t *pool, char *buf);
@@ -0,0 +1,34 @@
+// Binary WebSocket framing shared by the firmware and the web UI.
+// Every binary frame starts with a one-byte message type; all multi-byte
+// fields are little-endian.
+#pragma once
+
+#include <stdint.h>
+
+enum {
+    WIRE_ADC_BLOCK = 0x01,
+    WIRE_PIN_STATE = 0x02,
+    WIRE_UART_RX = 0x03,
+    WIRE_LOGIC = 0x04,
+    WIRE_ADC_SCAN = 0x05,
+};
+
+static inline void wire_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void wire_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t wire_get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t wire_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
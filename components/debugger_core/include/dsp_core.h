@@ -0,0 +1,52 @@
+// Waveform measurements on one captured ADC block: Hann-windowed FFT
+// magnitude spectrum, mean, RMS, peak-to-peak, dominant frequency and duty
+// cycle. Uses the esp-dsp FFT kernels when the firmware links them, else a
+// portable radix-2 FFT, which is also what the host tools check.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DSP_MIN_N           64
+#define DSP_MAX_N           1024        // must match CAP_MAX_BLOCK or less
+#define DSP_SPECTRUM_BINS   128         // bins sent; wider spectra keep the max of each group
+#define DSP_DB_FLOOR        (-40)       // dB re 1 mV, well under one LSB
+
+typedef struct {
+    uint16_t n;                         // FFT length, a power of two
+    float window[DSP_MAX_N];            // Hann
+    float twiddle[DSP_MAX_N];           // cos, -sin pairs for k < n / 2
+    float buf[2 * DSP_MAX_N] __attribute__((aligned(16)));     // interleaved re, im; esp-dsp wants 16-byte alignment
+} dsp_fft_t;
+
+typedef struct {
+    uint16_t n;                         // samples analyzed
+    uint32_t rate;                      // Hz
+    float mean_mv;
+    float rms_mv;                       // of the whole signal, DC included
+    float min_mv;
+    float max_mv;
+    float freq_hz;                      // spectral peak, interpolated; 0 for a flat signal
+    float duty;                         // high time over whole periods; -1 without two rising edges
+    uint16_t bins;                      // entries used in db
+    float bin_hz;                       // width of one entry in db
+    int8_t db[DSP_SPECTRUM_BINS];       // peak amplitude per group, dB re 1 mV, DC excluded
+    uint32_t cycles;                    // CPU cycles spent, filled in by the caller
+} dsp_result_t;
+
+// Largest supported FFT length that fits in samples; 0 if too short
+uint16_t dsp_fft_len(uint32_t samples);
+
+// Precompute window and twiddles; false unless n is a supported power of two
+bool dsp_fft_init(dsp_fft_t *f, uint16_t n);
+
+// Complex FFT of f->buf in place, natural order out
+void dsp_fft_run(dsp_fft_t *f);
+
+// Measure f->n raw codes, converted to mV through lut (SCAN_LUT_LEN entries)
+void dsp_analyze(dsp_fft_t *f, const uint16_t *raw, const uint16_t *lut, uint32_t rate, dsp_result_t *r);
+
+// {"analysis":{"pin":..,"n":..,"rate":..,"mean":..,"rms":..,"vpp":..,"freq":..,
+//  "duty":..|null,"bin_hz":..,"db":[...],"cycles":..}}, volts and Hz
+size_t dsp_result_to_json(const dsp_result_t *r, int pin, char *out, size_t out_len);
@@ -0,0 +1,93 @@
+// GPIO edge capture: a lock-free single-producer ring filled from the GPIO
+// ISR and per-pin bounce / pulse-width / edge-rate statistics computed by
+// the consumer task.
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EDGE_RING_LEN  1024    // must be a power of two
+#define EDGE_MAX_PINS  32
+
+typedef struct {
+    uint32_t t_us;      // timestamp, low 32 bits of esp_timer time
+    uint8_t pin;        // index into the caller's pin table
+    uint8_t level;      // level read right after the edge
+} edge_event_t;
+
+typedef struct {
+    _Atomic uint32_t head;      // written by the producer only
+    _Atomic uint32_t tail;      // written by the consumer only
+    _Atomic uint32_t overruns;  // events dropped because the ring was full
+    edge_event_t buf[EDGE_RING_LEN];
+} edge_ring_t;
+
+// Producer side, safe to call from an ISR. Never blocks; a full ring drops
+// the new event and counts an overrun.
+static inline bool edge_ring_push(edge_ring_t *ring, const edge_event_t *ev) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= EDGE_RING_LEN) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        return false;
+    }
+    ring->buf[head & (EDGE_RING_LEN - 1)] = *ev;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side
+static inline bool edge_ring_pop(edge_ring_t *ring, edge_event_t *ev) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail == head) return false;
+    *ev = ring->buf[tail & (EDGE_RING_LEN - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void edge_ring_init(edge_ring_t *ring);
+
+typedef struct {
+    uint32_t edges;             // total edges since start
+    uint32_t bounces;           // edges closer than bounce_us to the previous one
+    uint32_t last_t_us;
+    uint8_t level;
+    uint32_t last_high_us;      // width of the most recent completed pulses
+    uint32_t last_low_us;
+    // Current publish window
+    uint32_t win_edges;
+    uint32_t min_high_us, max_high_us;
+    uint32_t min_low_us, max_low_us;
+} edge_pin_stats_t;
+
+typedef struct {
+    uint32_t bounce_us;
+    uint32_t window_start_us;
+    uint32_t active;            // bitmask of pins with edges in the current window
+    uint32_t level_changed;     // bitmask of pins whose settled level changed in the window
+    size_t num_pins;
+    edge_pin_stats_t pins[EDGE_MAX_PINS];
+} edge_stats_t;
+
+void edge_stats_init(edge_stats_t *st, size_t num_pins, uint32_t bounce_us, uint32_t now_us);
+
+// Record the current level without counting an edge (initial state, mode changes)
+void edge_stats_seed(edge_stats_t *st, uint8_t pin, uint8_t level, uint32_t now_us);
+
+void edge_stats_apply(edge_stats_t *st, const edge_event_t *ev);
+
+// Pop up to max events from the ring into the statistics; returns the count.
+size_t edge_stats_drain(edge_stats_t *st, edge_ring_t *ring, size_t max);
+
+// Edges per second on a pin over the current window
+uint32_t edge_stats_rate(const edge_stats_t *st, uint8_t pin, uint32_t now_us);
+
+void edge_stats_window_reset(edge_stats_t *st, uint32_t now_us);
+
+// Encode the pins in the active mask as {"edges":{...}}; gpio_nums maps pin
+// indices to GPIO numbers. Returns the length, or 0 if out did not fit.
+size_t edge_stats_to_json(const edge_stats_t *st, const int *gpio_nums, uint32_t overruns,
+                          uint32_t now_us, char *out, size_t out_len);
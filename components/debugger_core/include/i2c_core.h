@@ -0,0 +1,44 @@
+// I2C transaction batches: parser for the I2C_TXN command and the JSON
+// result encoders shared by the bus worker. No driver calls here.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define I2C_MAX_OPS         8
+#define I2C_MAX_WRITE       16      // data bytes per write op, register excluded
+#define I2C_MAX_READ        256
+#define I2C_DUMP_CHUNK      16      // bytes per bus transaction in a dump
+
+typedef enum {
+    I2C_OP_READ = 'R',      // write reg, repeated start, read len bytes
+    I2C_OP_WRITE = 'W',     // write reg followed by data
+    I2C_OP_DUMP = 'D',      // read len bytes from reg in I2C_DUMP_CHUNK transactions
+} i2c_op_type_t;
+
+typedef struct {
+    i2c_op_type_t type;
+    uint8_t reg;
+    uint16_t len;           // bytes to read, or bytes in data for a write
+    uint8_t data[I2C_MAX_WRITE];
+} i2c_op_t;
+
+typedef struct {
+    uint8_t addr;           // 7-bit
+    uint8_t n_ops;
+    i2c_op_t ops[I2C_MAX_OPS];
+} i2c_txn_t;
+
+// "<addr>;<op>;<op>..." where op is R:<reg>,<n> | W:<reg>,<b>[,<b>...] | D:<reg>,<n>.
+// Numbers may be decimal or 0x-prefixed hex, e.g. "0x68;W:0x6B,0;R:0x3B,14".
+bool i2c_txn_parse(const char *s, i2c_txn_t *txn);
+
+// {"i2c_op":{"job","i","addr","op","reg","n","us","err","data":[...]}}; data only for reads
+size_t i2c_op_to_json(uint32_t job, int index, uint8_t addr, const i2c_op_t *op,
+                      const uint8_t *data, size_t n, uint32_t us, const char *err,
+                      char *out, size_t out_len);
+
+// Addresses found so far; done selects the final {"i2c":[...]} form over {"i2c_scan":...}
+size_t i2c_scan_to_json(uint32_t job, const uint8_t *found, size_t n_found, uint8_t next_addr,
+                        bool done, uint32_t us, const char *err, char *out, size_t out_len);
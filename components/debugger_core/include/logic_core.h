@@ -0,0 +1,135 @@
+// Logic analyzer core: run-length coding of multi-channel samples, pattern
+// and edge trigger search, pre-trigger windowing, and binary block framing.
+// Fed from RMT receive symbols on target or from recorded bitstreams on the
+// host.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LA_MAX_CHANNELS     8           // one bit per channel in a run word
+#define LA_HDR_LEN          14
+#define LA_BLOCK_MAX        1024        // framed block size, header included
+#define LA_NONE             SIZE_MAX
+
+// Block header flags
+#define LA_FLAG_FIRST       0x01
+#define LA_FLAG_LAST        0x02
+#define LA_FLAG_TRIGGERED   0x04        // the capture is windowed around a trigger match
+#define LA_FLAG_TRUNCATED   0x08        // a buffer filled before the capture ended
+
+// All channels hold `word` for `ticks` sample periods
+typedef struct {
+    uint32_t ticks;
+    uint8_t word;                       // bit n = channel n
+} la_run_t;
+
+typedef struct {
+    la_run_t *runs;
+    size_t cap;
+    size_t count;
+    uint64_t ticks;                     // total length of the runs so far
+    bool full;                          // a push was refused
+} la_rle_t;
+
+void la_rle_init(la_rle_t *r, la_run_t *buf, size_t cap);
+
+// Append ticks of word, extending the last run when the word is unchanged.
+// Returns false (and sets full) when a new run does not fit.
+bool la_rle_push(la_rle_t *r, uint8_t word, uint32_t ticks);
+
+// Encode one word per sample period; returns the samples consumed.
+size_t la_rle_from_samples(la_rle_t *r, const uint8_t *samples, size_t n);
+
+// Expand runs back into samples (for checking recorded captures); returns
+// the samples written, stopping at out_len.
+size_t la_rle_to_samples(const la_run_t *runs, size_t count, uint8_t *out, size_t out_len);
+
+// Start tick of runs[index]
+uint64_t la_rle_tick(const la_run_t *runs, size_t index);
+
+// Keep the ticks [from, to) of the runs: clip the runs at both ends and move
+// them to the front, so tick from becomes tick 0. Returns the new count.
+size_t la_rle_window(la_run_t *runs, size_t count, uint64_t from, uint64_t to);
+
+// One contiguous RMT receive on a channel. RMT stops at the idle threshold,
+// so a capture is a list of segments re-armed after each idle period.
+typedef struct {
+    uint64_t start;                     // ticks from the capture origin to the first edge
+    uint32_t first;                     // index of the first symbol in la_rmt_chan_t.symbols
+    uint32_t count;
+} la_segment_t;
+
+// Symbols use the RMT word layout (duration0:15, level0:1, duration1:15,
+// level1:1). A zero duration ends a segment and carries the idle level.
+typedef struct {
+    const uint32_t *symbols;
+    const la_segment_t *segs;
+    size_t num_segs;
+    uint8_t level;                      // line level before the first segment
+} la_rmt_chan_t;
+
+// Merge per-channel RMT segments (channel n = bit n) into runs on a common
+// time base. Returns false when the runs did not fit.
+bool la_merge_rmt(la_rle_t *r, const la_rmt_chan_t *chans, size_t num_chans);
+
+// Drop one channel's segments that end before tick `before` and move the
+// rest to the front of symbols and segs; *level becomes the line level they
+// left behind. Returns the symbols dropped. An armed capture keeps only its
+// pre-trigger history this way.
+size_t la_rmt_drop(uint32_t *symbols, la_segment_t *segs, size_t *num_segs, uint8_t *level, uint64_t before);
+
+// Trigger: every channel in mask must equal its bit in value, and every
+// channel in edge must have just changed into it (rising or falling).
+typedef struct {
+    uint8_t mask;
+    uint8_t value;
+    uint8_t edge;                       // subset of mask
+} la_trigger_t;
+
+// One character per channel, channel 0 first: 0, 1, X (don't care),
+// R (rising), F (falling). E.g. "F1XX" = ch0 falls while ch1 is high.
+bool la_trigger_parse(const char *s, la_trigger_t *t);
+
+// Index of the first run at which the trigger matches, at or after from;
+// LA_NONE if none. An empty trigger matches run 0.
+size_t la_trigger_find(const la_trigger_t *t, const la_run_t *runs, size_t count, size_t from);
+
+// Splits a finished capture into wire blocks:
+//   [0] WIRE_LOGIC  [1] channels  [2] flags  [3] reserved
+//   [4] capture id u32  [8] tick of the first run u32  [12] run count u16
+// then per run: word u8, ticks as LEB128 (1-5 bytes).
+typedef struct {
+    const la_run_t *runs;
+    size_t count;
+    size_t next;                        // first run not yet framed
+    uint32_t tick;                      // start tick of runs[next]
+    uint32_t id;
+    uint8_t channels;
+    uint8_t flags;                      // TRIGGERED / TRUNCATED, copied to every block
+} la_framer_t;
+
+void la_framer_init(la_framer_t *f, const la_run_t *runs, size_t count, uint8_t channels,
+                    uint32_t id, uint8_t flags);
+
+// Frame the next block into out (at least LA_HDR_LEN + 6 bytes); 0 when done.
+size_t la_framer_next(la_framer_t *f, uint8_t *out, size_t out_len);
+
+// Decode the runs of one framed block; returns the runs written, 0 on a
+// malformed block. *tick receives the block's start tick when non-NULL.
+size_t la_block_decode(const uint8_t *block, size_t len, la_run_t *runs, size_t max_runs, uint32_t *tick);
+
+// Capture summary sent ahead of the blocks
+typedef struct {
+    uint32_t id;
+    const int *gpios;                   // GPIO number per channel
+    uint8_t channels;
+    uint32_t tick_hz;
+    size_t runs;
+    uint64_t ticks;
+    size_t trigger;                     // run index, LA_NONE if none
+    bool truncated;
+} la_summary_t;
+
+size_t la_summary_to_json(const la_summary_t *s, const la_run_t *runs, char *out, size_t out_len);
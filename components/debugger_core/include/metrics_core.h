@@ -0,0 +1,55 @@
+// Lightweight telemetry: fixed-bucket latency histograms that any task can
+// record into without locks, and a Prometheus text-format writer that
+// streams through a small buffer instead of building the whole page.
+#pragma once
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAT_BUCKETS 14      // 13 upper bounds plus +Inf
+
+// Bucket upper bounds in microseconds, shared by every histogram
+extern const uint32_t lat_bucket_us[LAT_BUCKETS - 1];
+
+typedef struct {
+    const char *name;       // Prometheus metric name, e.g. "dbg_cmd_latency_seconds"
+    const char *help;
+    const char *key;        // short name for the JSON stream
+    _Atomic uint32_t buckets[LAT_BUCKETS];
+    _Atomic uint32_t count;
+    _Atomic uint64_t sum_us;
+    _Atomic uint32_t max_us;
+} lat_hist_t;
+
+void lat_hist_init(lat_hist_t *h, const char *name, const char *key, const char *help);
+void lat_hist_record(lat_hist_t *h, uint32_t us);
+
+// Upper bound (us) of the bucket holding quantile q (0..1); 0 when empty,
+// max_us when the quantile falls in the +Inf bucket
+uint32_t lat_hist_quantile(const lat_hist_t *h, float q);
+
+// "<key>":{"count":..,"p50":..,"p90":..,"p99":..,"max":..}; returns length or 0
+size_t lat_hist_to_json(const lat_hist_t *h, char *out, size_t out_len);
+
+// Called with each filled chunk; return false to stop writing
+typedef bool (*prom_flush_t)(const char *buf, size_t len, void *ctx);
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t pos;
+    prom_flush_t flush;
+    void *ctx;
+    bool failed;            // a flush failed or a single line did not fit
+} prom_writer_t;
+
+void prom_init(prom_writer_t *w, char *buf, size_t cap, prom_flush_t flush, void *ctx);
+void prom_printf(prom_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// # HELP / # TYPE lines
+void prom_header(prom_writer_t *w, const char *name, const char *type, const char *help);
+void prom_hist(prom_writer_t *w, const lat_hist_t *h);
+// Flush what is left; returns false if anything was lost
+bool prom_finish(prom_writer_t *w);
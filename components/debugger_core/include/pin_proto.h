@@ -0,0 +1,53 @@
+// Versioned pin-state model and its compact binary encoding.
+//
+// Every change bumps a global version and stamps the pin with it, so a
+// client that acknowledged version V only needs the pins stamped after V.
+//
+// Binary frame (WIRE_PIN_STATE), little-endian:
+//   0  u8  type            16 u32 levels mask
+//   1  u8  proto version   20 u32 output mask
+//   2  u8  flags           24 u32 pwm mask
+//   3  u8  pin count       28 u8  counter count n
+//   4  u32 version         29 n * { u8 pin index, u32 bounce counter }
+//   8  u32 base version    then, for full snapshots only:
+//   12 u32 changed mask        pin count * u8 GPIO number
+// Mask bits are pin indices; only bits set in the changed mask are meaningful.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pin_store.h"
+
+#define PIN_PROTO_VERSION    1
+#define PIN_PROTO_MAX_PINS   32
+#define PIN_PROTO_HDR_LEN    29
+#define PIN_PROTO_MAX_FRAME  (PIN_PROTO_HDR_LEN + PIN_PROTO_MAX_PINS * 6)
+
+#define PIN_PROTO_FLAG_FULL  0x01
+
+typedef struct {
+    uint8_t num_pins;
+    const int *gpio_nums;
+    uint32_t version;
+    uint32_t levels;
+    uint32_t outputs;
+    uint32_t pwm;
+    uint32_t counters[PIN_PROTO_MAX_PINS];
+    uint32_t pin_version[PIN_PROTO_MAX_PINS];
+} pin_proto_state_t;
+
+void pin_proto_init(pin_proto_state_t *st, const int *gpio_nums, size_t num_pins);
+
+// Take every pin and its version from a pin_store snapshot, keeping the
+// pin table set by pin_proto_init()
+void pin_proto_load(pin_proto_state_t *st, const pin_snapshot_t *snap);
+
+// Encode the pins changed after since_version (0 = full snapshot).
+// Returns the frame length, or 0 if nothing changed.
+size_t pin_proto_encode(const pin_proto_state_t *st, uint32_t since_version, uint8_t *out, size_t out_len);
+
+// Full state as the legacy JSON array [{"pin","mode","state","bounce"},...]
+// for clients that have not negotiated the binary protocol. Returns the
+// length, or 0 if out did not fit.
+size_t pin_proto_to_json(const pin_proto_state_t *st, char *out, size_t out_len);
@@ -0,0 +1,67 @@
+// Pin state shared between cores: a seqlock over per-pin records.
+//
+// Readers never block: they copy the store and retry if a writer was in
+// the middle of an update. Writers must be serialized by the caller (one
+// mutex), and keep their update bracket short: no I/O between begin and end.
+// Every change stamps the pin with a new store version, so versions only
+// ever grow, per pin and overall.
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PIN_STORE_MAX_PINS  32
+
+typedef struct {
+    bool level;
+    bool output;
+    uint32_t pwm_hz;            // 0 when not driving PWM
+    uint32_t bounces;
+    uint32_t last_change_ms;    // of the last input edge, esp_timer ms
+    uint32_t version;           // store version of the last change
+} pin_state_t;
+
+typedef struct {
+    uint32_t version;           // highest pin version
+    uint8_t num_pins;
+    pin_state_t pins[PIN_STORE_MAX_PINS];
+} pin_snapshot_t;
+
+// Per pin: flags (level, output), pwm_hz, bounces, last_change_ms, version
+#define PIN_STORE_WORDS     5
+
+typedef struct {
+    _Atomic uint32_t seq;       // odd while a writer is inside its bracket
+    _Atomic uint32_t version;
+    uint8_t num_pins;
+    _Atomic uint32_t words[PIN_STORE_MAX_PINS][PIN_STORE_WORDS];
+    _Atomic uint32_t retries;   // reader passes thrown away, for metrics
+} pin_store_t;
+
+// All pins inputs, low, version 1 (0 means "nothing seen" to clients)
+void pin_store_init(pin_store_t *st, size_t num_pins);
+
+// Consistent copy of every pin; false if a writer kept it busy for
+// max_tries passes, so the caller can fall back to the writers' lock
+bool pin_store_read(pin_store_t *st, pin_snapshot_t *snap, unsigned max_tries);
+
+// Consistent copy of one pin, same rules
+bool pin_store_read_pin(pin_store_t *st, size_t idx, pin_state_t *pin, unsigned max_tries);
+
+// Latest version, e.g. to bound a client's ACK
+static inline uint32_t pin_store_version(pin_store_t *st) {
+    return atomic_load_explicit(&st->version, memory_order_relaxed);
+}
+
+// Writer side, with the caller's writer lock held
+void pin_store_write_begin(pin_store_t *st);
+void pin_store_write_end(pin_store_t *st);
+
+// Current value inside a write bracket (no retry: writers are serialized)
+void pin_store_peek(const pin_store_t *st, size_t idx, pin_state_t *pin);
+
+// Store a pin inside a write bracket; bumps its version only if something
+// other than the version differs. Returns true on a change.
+bool pin_store_set(pin_store_t *st, size_t idx, const pin_state_t *pin);
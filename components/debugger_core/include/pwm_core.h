@@ -0,0 +1,83 @@
+// PWM allocator: hands out LEDC timers and channels per pin, sharing a
+// timer between pins with the same frequency, and picks the finest duty
+// resolution each frequency allows. Mirrors the ESP32 LEDC divider maths
+// so the achieved frequency can be reported; no driver calls here.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PWM_MODES           2           // LEDC high- and low-speed groups
+#define PWM_TIMERS          4           // per group
+#define PWM_CHANNELS        8           // per group
+#define PWM_MAX_BITS        20
+#define PWM_DIV_FRAC_BITS   8           // the divider is 10.8 fixed point
+#define PWM_DIV_MIN         (1u << PWM_DIV_FRAC_BITS)
+#define PWM_DIV_MAX         0x3FFFF
+#define PWM_DUTY_SCALE      10000       // duty is given in 0.01 % steps
+#define PWM_MAX_ERROR_PPM   1000        // frequency error traded for resolution
+
+typedef struct {
+    uint32_t freq_hz;                   // requested
+    uint32_t div;                       // 10.8 fixed point
+    uint8_t bits;                       // duty resolution
+    uint8_t users;                      // channels bound to it, 0 = free
+} pwm_timer_t;
+
+typedef struct {
+    int gpio;                           // -1 = free
+    uint8_t timer;
+    uint16_t duty;                      // 0..PWM_DUTY_SCALE
+} pwm_channel_t;
+
+typedef struct {
+    uint32_t clk_hz;
+    pwm_timer_t timers[PWM_MODES][PWM_TIMERS];
+    pwm_channel_t channels[PWM_MODES][PWM_CHANNELS];
+} pwm_alloc_t;
+
+// What the driver has to do to put a pin on a new frequency
+typedef struct {
+    uint8_t mode;
+    uint8_t channel;
+    uint8_t timer;
+    bool timer_config;                  // timer is new or changes resolution: full configuration
+    bool timer_freq;                    // timer keeps its resolution, only the divider changes
+    bool channel_config;                // channel is new to this pin
+    bool rebind;                        // the pin's channel moves to another timer
+    int8_t freed_mode;                  // channel the pin gave up (-1 none), to be stopped
+    int8_t freed_channel;
+} pwm_plan_t;
+
+void pwm_alloc_init(pwm_alloc_t *a, uint32_t clk_hz);
+
+// Finest resolution (up to PWM_MAX_BITS) whose divider hits freq_hz within
+// PWM_MAX_ERROR_PPM, else the most accurate one; false when no resolution
+// gives a valid divider
+bool pwm_timing(uint32_t clk_hz, uint32_t freq_hz, uint8_t *bits, uint32_t *div);
+
+// Divider for freq_hz at a fixed resolution; false when out of range
+bool pwm_timing_at(uint32_t clk_hz, uint32_t freq_hz, uint8_t bits, uint32_t *div);
+
+// Frequency the hardware produces for a divider and resolution
+double pwm_actual_hz(uint32_t clk_hz, uint32_t div, uint8_t bits);
+
+// Duty in timer ticks; full scale is 1 << bits (always high)
+uint32_t pwm_duty_ticks(uint16_t duty, uint8_t bits);
+
+// Channel of a pin; false when it has none
+bool pwm_find(const pwm_alloc_t *a, int gpio, uint8_t *mode, uint8_t *channel);
+
+// Put gpio on freq_hz and fill in the plan; the allocation is updated
+// before returning. A timer used only by this pin is retuned in place,
+// keeping its resolution when the divider still fits, so the output never
+// restarts. False (nothing changed) when no timer or channel is free or
+// the frequency is out of range.
+bool pwm_assign(pwm_alloc_t *a, int gpio, uint32_t freq_hz, pwm_plan_t *plan);
+
+// Free the pin's channel, and its timer with the last user; false if it had none
+bool pwm_release(pwm_alloc_t *a, int gpio, uint8_t *mode, uint8_t *channel);
+
+// {"pwm":[{"pin","hz","actual_hz","bits","duty","group","timer","channel"},...]}
+size_t pwm_to_json(const pwm_alloc_t *a, char *out, size_t out_len);
@@ -0,0 +1,114 @@
+// Recording file format: a self-describing header, then variable-length
+// chunks of timestamped records, then a sparse chunk index. Chunks carry a
+// CRC and are walkable without the index, so a recording cut short by a
+// reset is still readable up to its last complete chunk.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "edge_core.h"
+
+#define REC_MAGIC           "DBGREC01"
+#define REC_VERSION         1
+#define REC_FILE_HDR_LEN    256         // one SPIFFS page
+#define REC_DESC_MAX        (REC_FILE_HDR_LEN - 32)
+#define REC_CHUNK_HDR_LEN   24
+#define REC_CHUNK_MAX       8192        // header included
+#define REC_REC_HDR_LEN     8
+#define REC_INDEX_MAX       256         // entries; neighbours merge when it fills
+#define REC_INDEX_ENTRY_LEN 24
+#define REC_FOOTER_LEN      16
+
+// Record types. ADC, scan and UART records carry their wire frame verbatim,
+// so the type is the frame's WIRE_* byte.
+#define REC_ADC_BLOCK       0x01
+#define REC_UART_RX         0x03
+#define REC_ADC_SCAN        0x05
+#define REC_EDGES           0x08        // per edge: t_us u32 (esp_timer low bits), gpio u8, level u8
+#define REC_DROPPED         0x09        // records u32 lost while both buffers were in flight
+
+// Record flags
+#define REC_FRAG_MORE       0x01        // payload continues in the next chunk
+#define REC_FRAG_CONT       0x02        // payload continues the previous record
+
+// Sources selected for a recording, as REC_START names them
+#define REC_SRC_ADC         0x01        // oscilloscope blocks and scan frames
+#define REC_SRC_EDGES       0x02
+#define REC_SRC_UART        0x04
+
+// "ADC+EDGES+UART", any subset in any order
+bool rec_sources_parse(const char *s, uint8_t *mask);
+
+uint32_t rec_crc32(uint32_t crc, const void *data, size_t len);
+
+// File header:
+//   [0] REC_MAGIC  [8] version u16  [10] header length u16
+//   [12] max chunk length u32  [16] start time u64 (esp_timer us)
+//   [24] sources u8  [25] reserved  [26] description length u16
+//   [28] reserved u32  [32] description, JSON, NUL padded
+size_t rec_file_header(uint8_t *out, uint64_t start_us, uint8_t sources, const char *desc);
+
+// Chunk:
+//   [0] "RCHK"  [4] seq u32  [8] base time u64 (esp_timer us)
+//   [16] payload length u16  [18] records u16  [20] CRC-32 of the payload
+//   [24] records, then zero padding to a multiple of 4
+// Record:
+//   [0] type u8  [1] flags u8  [2] length u16  [4] time after the chunk base u32 (us)
+//   [8] payload
+typedef struct {
+    uint8_t *buf;                       // REC_CHUNK_MAX bytes
+    size_t len;                         // header included
+    uint32_t seq;
+    uint64_t base_us;
+    uint64_t last_us;
+    uint16_t records;
+    uint16_t types;                     // bit n set for each record type n present
+} rec_chunk_t;
+
+void rec_chunk_init(rec_chunk_t *c, uint8_t *buf, uint32_t seq, uint64_t base_us);
+
+static inline bool rec_chunk_empty(const rec_chunk_t *c) {
+    return c->records == 0;
+}
+
+// Append as much of a record as fits; returns the bytes of data taken. A
+// short count means the chunk is full and the rest belongs in a record with
+// REC_FRAG_CONT in the next chunk. 0 when nothing fits, or t_us is too far
+// from the chunk base.
+size_t rec_chunk_put(rec_chunk_t *c, uint8_t type, uint64_t t_us, const void *data, size_t len, bool cont);
+
+// Write the chunk header and padding; returns the bytes to store
+size_t rec_chunk_seal(rec_chunk_t *c);
+
+// Check a stored chunk; returns its stored length, 0 if it is not valid
+size_t rec_chunk_check(const uint8_t *p, size_t avail);
+
+// One index entry covers one or more consecutive chunks
+typedef struct {
+    uint32_t offset;                    // file offset of the first chunk
+    uint16_t chunks;
+    uint16_t types;
+    uint32_t records;
+    uint64_t base_us;
+    uint32_t span_us;                   // first chunk base to the last record
+} rec_index_entry_t;
+
+typedef struct {
+    rec_index_entry_t entries[REC_INDEX_MAX];
+    size_t count;
+    uint16_t per_entry;                 // chunks an entry may cover, doubles on merge
+    uint32_t chunks;
+    uint32_t records;
+} rec_index_t;
+
+void rec_index_init(rec_index_t *ix);
+void rec_index_add(rec_index_t *ix, const rec_chunk_t *c, uint32_t offset);
+
+// Trailer: "RIDX", entry count u32, entries
+//   (offset u32, chunks u16, types u16, records u32, base u64, span u32),
+// then the footer: "REND", index offset u32, chunks u32, records u32.
+size_t rec_index_encode(const rec_index_t *ix, uint32_t index_offset, uint8_t *out, size_t out_len);
+
+// REC_EDGES payload for n events; gpio_nums maps edge_core's pin index
+size_t rec_edges_encode(const edge_event_t *ev, size_t n, const int *gpio_nums, uint8_t *out, size_t out_len);
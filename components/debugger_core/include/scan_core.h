@@ -0,0 +1,76 @@
+// ADC scan: interleaved samples from several channels reduced to
+// per-channel min/mean/max envelopes with a fixed number of points per
+// frame, so spikes shorter than a point survive decimation. Raw codes go
+// through a calibration lookup table first. Hardware independent.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCAN_MAX_CHANNELS   8
+#define SCAN_MAX_POINTS     1024
+#define SCAN_MAX_BINS       2048        // points x channels per frame
+#define SCAN_ADC_CHANNELS   10          // channel numbers tagged in the DMA results
+#define SCAN_LUT_LEN        4096        // one entry per 12-bit code
+#define SCAN_HDR_LEN        20
+#define SCAN_FRAME_MAX      (SCAN_HDR_LEN + SCAN_MAX_CHANNELS + SCAN_MAX_BINS * 6)
+
+// Frame header flags
+#define SCAN_FLAG_CALIBRATED 0x01       // values are eFuse-calibrated mV, else a nominal line
+
+typedef struct {
+    uint8_t channels;
+    uint8_t adc_channel[SCAN_MAX_CHANNELS];     // as tagged in the DMA results
+    uint8_t gpio[SCAN_MAX_CHANNELS];            // carried in the frame only
+    uint32_t rate;                              // Hz per channel, carried in the frame only
+    uint16_t points;                            // per channel per frame
+    uint32_t per_point;                         // samples reduced into one point
+    uint32_t holdoff;                           // samples per channel skipped between frames
+    bool calibrated;
+} scan_config_t;
+
+// Channel count, points and bins within limits, no channel twice
+bool scan_config_valid(const scan_config_t *cfg);
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint64_t sum;                       // a point may span minutes at MHz rates
+    uint32_t n;
+    uint16_t point;                     // next point to fill
+    uint32_t skip;                      // holdoff samples still to drop
+} scan_acc_t;
+
+typedef struct {
+    scan_config_t cfg;
+    const uint16_t *lut;                // raw code -> mV; NULL passes codes through
+    int8_t slot[SCAN_ADC_CHANNELS];     // ADC channel -> index in cfg, -1 if not scanned
+    scan_acc_t acc[SCAN_MAX_CHANNELS];
+    uint8_t complete;                   // channels whose points are all filled
+    uint32_t seq;
+    uint8_t frame[SCAN_FRAME_MAX];
+} scan_engine_t;
+
+// Called with a complete frame; the buffer is reused after return.
+typedef void (*scan_frame_cb_t)(const uint8_t *frame, size_t len, void *ctx);
+
+// The config must be valid; lut must outlive the engine
+void scan_engine_init(scan_engine_t *eng, const scan_config_t *cfg, const uint16_t *lut);
+
+// Feed n samples with the ADC channel each came from; returns the frames
+// delivered to cb. Frame layout:
+//   [0] WIRE_ADC_SCAN  [1] channels  [2] flags  [3] reserved
+//   [4] seq u32  [8] rate per channel u32  [12] samples per point u32
+//   [16] points u16  [18] reserved u16
+//   [20] gpio per channel (u8 each, padded to an even length)
+// then per channel, per point: min u16, mean u16, max u16.
+size_t scan_engine_push(scan_engine_t *eng, const uint8_t *chan, const uint16_t *raw, size_t n,
+                        scan_frame_cb_t cb, void *ctx);
+
+// Nominal straight line from code 0 to full_scale_mv, for uncalibrated chips
+void scan_lut_linear(uint16_t *lut, uint16_t full_scale_mv);
+
+// {"adc_cal":{"calibrated":true,"mv":[...]}}: the table every 128 codes
+// (33 points, the last at code 4095) so a client can convert raw blocks
+size_t scan_lut_to_json(const uint16_t *lut, bool calibrated, char *out, size_t out_len);
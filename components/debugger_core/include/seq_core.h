@@ -0,0 +1,84 @@
+// Waveform sequencer core: parser for timed output vectors, the playback
+// cursor stepped from the timer ISR and achieved-vs-requested timing
+// statistics. No driver calls here.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEQ_MAX_CHANNELS    8           // one bit per channel in a step word
+#define SEQ_MAX_STEPS       256
+#define SEQ_MIN_STEP_US     5           // below this the alarm ISR cannot keep up
+#define SEQ_MAX_STEP_US     60000000
+
+// All channels are driven to `word` and held for `us`
+typedef struct {
+    uint32_t us;
+    uint8_t word;                       // bit n = channel n
+} seq_step_t;
+
+// "<vector>@<us>[;<vector>@<us>...]" with one 0/1 per channel, channel 0
+// first, e.g. "10@100;01@100" for two pins in antiphase at 5 kHz.
+// Returns the number of steps, 0 on a malformed sequence.
+size_t seq_parse(const char *s, size_t channels, seq_step_t *steps, size_t max);
+
+// Ideal length of one pass, in microseconds
+uint64_t seq_length_us(const seq_step_t *steps, size_t count);
+
+// Timer ticks are absolute, so a late alarm never shifts the steps after it
+typedef struct {
+    const seq_step_t *steps;
+    size_t count;
+    uint32_t loops;                     // passes to play, 0 = until stopped
+    uint32_t ticks_per_us;
+    size_t index;                       // next step to apply
+    uint32_t loop;                      // passes completed
+    uint64_t due;                       // tick at which steps[index] is due, or the end once done
+    bool done;                          // the last step is applied and only has to be held
+} seq_player_t;
+
+void seq_player_init(seq_player_t *p, const seq_step_t *steps, size_t count, uint32_t loops,
+                     uint32_t ticks_per_us, uint64_t start);
+
+// Step past steps[index] once it is on the pins. Safe to call from an ISR.
+static inline void seq_player_advance(seq_player_t *p) {
+    p->due += (uint64_t)p->steps[p->index].us * p->ticks_per_us;
+    if (++p->index < p->count) return;
+    p->index = 0;
+    p->loop++;
+    p->done = p->loops && p->loop == p->loops;
+}
+
+// Error of each applied step against its due tick
+typedef struct {
+    uint32_t steps;
+    uint32_t late;                      // steps applied more than late_ticks after due
+    uint32_t late_ticks;
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+} seq_stats_t;
+
+void seq_stats_init(seq_stats_t *s, uint32_t late_ticks);
+
+static inline void seq_stats_record(seq_stats_t *s, int32_t err) {
+    if (!s->steps || err < s->min) s->min = err;
+    if (!s->steps || err > s->max) s->max = err;
+    s->sum += err;
+    s->steps++;
+    if (err > (int32_t)s->late_ticks) s->late++;
+}
+
+typedef struct {
+    uint32_t id;
+    const char *state;                  // "running", "done" or "stopped"
+    uint32_t loops;                     // passes completed
+    uint64_t requested_us;              // ideal length of what was played
+    uint64_t actual_us;                 // measured from the first step to the end
+    uint32_t tick_hz;
+    const seq_stats_t *stats;
+} seq_report_t;
+
+// {"seq":{"id","state","steps","loops","requested_us","actual_us","err_ns":{"min","mean","max"},"late"}}
+size_t seq_report_to_json(const seq_report_t *r, char *out, size_t out_len);
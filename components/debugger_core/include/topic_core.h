@@ -0,0 +1,75 @@
+// Per-client WebSocket topic subscriptions with rate limits.
+//
+// Publishers ask which subscribers are due before they encode anything, so
+// a topic nobody listens to costs nothing and every update is encoded once
+// for all the clients it goes to. A subscription may cap its rate and
+// filter on GPIOs; clients held back by their rate are remembered, so a
+// state topic can still hand them the latest state once they are due.
+//
+// Not thread safe: the caller serialises every call.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bcast_core.h"
+
+typedef enum {
+    TOPIC_PINS,         // pin states and edge statistics
+    TOPIC_ADC,          // oscilloscope blocks, scan frames, summary and analysis
+    TOPIC_UART,         // UART RX frames
+    TOPIC_I2C,          // every client's I2C results, not only one's own
+    TOPIC_WIFI,
+    TOPIC_METRICS,
+    TOPIC_COUNT
+} topic_id_t;
+
+#define TOPIC_MAX_HZ    1000
+
+typedef struct {
+    uint32_t interval_us;   // 0 = every update
+    uint32_t last_us;       // of the last delivery
+    uint64_t gpios;         // GPIO filter, 0 = all
+    bool sent;              // last_us is valid
+    bool pending;           // held back by the rate since the last delivery
+} topic_sub_t;
+
+typedef struct {
+    uint32_t subscribed[TOPIC_COUNT];   // slot mask per topic
+    topic_sub_t subs[TOPIC_COUNT][BCAST_MAX_CLIENTS];
+    // Statistics
+    uint32_t published[TOPIC_COUNT];    // updates that went to at least one client
+    uint32_t held[TOPIC_COUNT];         // deliveries skipped by a rate limit
+} topic_table_t;
+
+void topic_init(topic_table_t *t);
+
+// "PINS", "ADC", "UART", "I2C", "WIFI" or "METRICS"
+bool topic_parse(const char *name, topic_id_t *id);
+const char *topic_name(topic_id_t id);      // lower case, as in JSON
+
+// GPIO numbers joined with '+', e.g. "34+35"
+bool topic_parse_gpios(const char *s, uint64_t *gpios);
+
+// (Re)subscribe slot; a new subscription is due at the next update
+void topic_subscribe(topic_table_t *t, int slot, topic_id_t id, uint32_t interval_us, uint64_t gpios);
+void topic_unsubscribe(topic_table_t *t, int slot, topic_id_t id);
+void topic_drop_client(topic_table_t *t, int slot);
+
+// Subscribers whose filter matches gpios (0 = not about particular pins),
+// rates ignored: for low-rate messages that must not be skipped
+uint32_t topic_subscribers(const topic_table_t *t, topic_id_t id, uint64_t gpios);
+
+// Subscribers due an update about gpios at now_us, stamped as delivered;
+// those held back by their rate are marked pending instead
+uint32_t topic_due(topic_table_t *t, topic_id_t id, uint64_t gpios, uint32_t now_us);
+
+// Pending subscribers whose interval has now passed, stamped as delivered
+uint32_t topic_due_pending(topic_table_t *t, topic_id_t id, uint32_t now_us);
+
+// Shortest interval among rate-limited subscribers, 0 if there are none
+uint32_t topic_min_interval(const topic_table_t *t, topic_id_t id);
+
+// {"subs":[{"topic":"pins","max_hz":10,"gpios":[34,35]},...]} for one slot
+size_t topic_to_json(const topic_table_t *t, int slot, char *out, size_t out_len);
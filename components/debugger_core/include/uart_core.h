@@ -0,0 +1,63 @@
+// UART bridge framing: line settings parser and the RX batch framer.
+// The framer collects received bytes in place behind a reserved header so
+// a finished batch goes out as one binary frame without another copy.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define UART_HDR_LEN        18
+#define UART_MAX_BATCH      1024
+#define UART_FRAME_MAX      (UART_HDR_LEN + UART_MAX_BATCH)
+
+// RX frame flags, describing what happened since the previous frame
+#define UART_FLAG_OVERFLOW  0x01    // bytes were lost before this batch
+#define UART_FLAG_FRAME_ERR 0x02
+#define UART_FLAG_PARITY    0x04
+#define UART_FLAG_BREAK     0x08
+
+typedef struct {
+    uint32_t baud;
+    uint8_t data_bits;          // 5..8
+    char parity;                // 'N', 'E' or 'O'
+    uint8_t stop_bits;          // 1 or 2
+} uart_line_t;
+
+typedef struct {
+    uint8_t port;
+    uint8_t flags;              // pending for the next frame
+    uint16_t len;               // payload bytes collected
+    uint32_t seq;
+    uint32_t offset;            // total bytes received before this batch
+    uint8_t frame[UART_FRAME_MAX];
+} uart_framer_t;
+
+// "115200" or "115200,8N1" (also 7E1, 8O2, ...); fields left out keep their value in line
+bool uart_line_parse(const char *s, uart_line_t *line);
+size_t uart_line_format(const uart_line_t *line, char *out, size_t out_len);
+
+void uart_framer_init(uart_framer_t *f, uint8_t port);
+
+// Where the next received bytes go and how many still fit
+static inline uint8_t *uart_framer_tail(uart_framer_t *f, size_t *space) {
+    *space = UART_MAX_BATCH - f->len;
+    return f->frame + UART_HDR_LEN + f->len;
+}
+
+static inline void uart_framer_commit(uart_framer_t *f, size_t n) {
+    f->len += n;
+}
+
+static inline void uart_framer_flag(uart_framer_t *f, uint8_t flags) {
+    f->flags |= flags;
+}
+
+// True when there is something worth a frame: data, or a flag on its own
+static inline bool uart_framer_pending(const uart_framer_t *f) {
+    return f->len || f->flags;
+}
+
+// Write the header for the collected batch and return the frame length.
+// The frame stays valid until the next uart_framer_tail().
+size_t uart_framer_finish(uart_framer_t *f, uint32_t t_ms);
@@ -0,0 +1,311 @@
+#include "logic_core.h"
+#include "dbg_wire.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define RMT_DURATION(sym, half)  (((sym) >> ((half) ? 16 : 0)) & 0x7FFF)
+#define RMT_LEVEL(sym, half)     (((sym) >> ((half) ? 31 : 15)) & 1)
+
+void la_rle_init(la_rle_t *r, la_run_t *buf, size_t cap) {
+    r->runs = buf;
+    r->cap = cap;
+    r->count = 0;
+    r->ticks = 0;
+    r->full = false;
+}
+
+bool la_rle_push(la_rle_t *r, uint8_t word, uint32_t ticks) {
+    if (!ticks) return true;
+    if (r->count) {
+        la_run_t *last = &r->runs[r->count - 1];
+        if (last->word == word && last->ticks <= UINT32_MAX - ticks) {
+            last->ticks += ticks;
+            r->ticks += ticks;
+            return true;
+        }
+    }
+    if (r->count == r->cap) {
+        r->full = true;
+        return false;
+    }
+    r->runs[r->count++] = (la_run_t){ .ticks = ticks, .word = word };
+    r->ticks += ticks;
+    return true;
+}
+
+size_t la_rle_from_samples(la_rle_t *r, const uint8_t *samples, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        size_t j = i + 1;
+        while (j < n && samples[j] == samples[i]) j++;
+        if (!la_rle_push(r, samples[i], (uint32_t)(j - i))) break;
+        i = j;
+    }
+    return i;
+}
+
+size_t la_rle_to_samples(const la_run_t *runs, size_t count, uint8_t *out, size_t out_len) {
+    size_t pos = 0;
+    for (size_t i = 0; i < count && pos < out_len; i++) {
+        size_t n = runs[i].ticks < out_len - pos ? runs[i].ticks : out_len - pos;
+        memset(out + pos, runs[i].word, n);
+        pos += n;
+    }
+    return pos;
+}
+
+uint64_t la_rle_tick(const la_run_t *runs, size_t index) {
+    uint64_t tick = 0;
+    for (size_t i = 0; i < index; i++) tick += runs[i].ticks;
+    return tick;
+}
+
+size_t la_rle_window(la_run_t *runs, size_t count, uint64_t from, uint64_t to) {
+    size_t n = 0;
+    uint64_t t = 0;
+    for (size_t i = 0; i < count && t < to; i++) {
+        uint64_t start = t, end = t + runs[i].ticks;
+        t = end;
+        if (end <= from) continue;
+        if (start < from) start = from;
+        if (end > to) end = to;
+        runs[n++] = (la_run_t){ .ticks = (uint32_t)(end - start), .word = runs[i].word };
+    }
+    return n;
+}
+
+// Merge cursor over one channel's segments
+typedef struct {
+    const la_rmt_chan_t *ch;
+    size_t seg;
+    size_t half;                        // half-symbol whose level takes effect at next
+    uint64_t next;                      // UINT64_MAX once every segment is consumed
+    uint8_t level;
+} la_cursor_t;
+
+static uint32_t half_word(const la_cursor_t *c) {
+    const la_segment_t *s = &c->ch->segs[c->seg];
+    return c->ch->symbols[s->first + c->half / 2];
+}
+
+// Point the cursor at the first segment that starts at or after end
+static void cursor_seek(la_cursor_t *c, uint64_t end) {
+    while (c->seg < c->ch->num_segs && !c->ch->segs[c->seg].count) c->seg++;
+    if (c->seg == c->ch->num_segs) {
+        c->next = UINT64_MAX;
+        return;
+    }
+    // Channels are aligned from edge timestamps, which can jitter back over the previous segment
+    uint64_t start = c->ch->segs[c->seg].start;
+    c->next = start > end ? start : end;
+    c->half = 0;
+}
+
+// Apply the pending level change and load the following one
+static void cursor_step(la_cursor_t *c) {
+    uint32_t sym = half_word(c);
+    c->level = RMT_LEVEL(sym, c->half & 1);
+    uint32_t dur = RMT_DURATION(sym, c->half & 1);
+    size_t halves = (size_t)c->ch->segs[c->seg].count * 2;
+
+    if (dur && c->half + 1 < halves) {
+        c->half++;
+        c->next += dur;
+        return;
+    }
+    // A zero duration is RMT's end marker and its level is the idle level;
+    // a segment cut short by a full buffer just holds its last level
+    c->seg++;
+    cursor_seek(c, c->next + dur);
+}
+
+bool la_merge_rmt(la_rle_t *r, const la_rmt_chan_t *chans, size_t num_chans) {
+    la_cursor_t cur[LA_MAX_CHANNELS];
+    if (num_chans > LA_MAX_CHANNELS) num_chans = LA_MAX_CHANNELS;
+
+    uint8_t word = 0;
+    for (size_t i = 0; i < num_chans; i++) {
+        cur[i] = (la_cursor_t){ .ch = &chans[i], .level = chans[i].level & 1 };
+        cursor_seek(&cur[i], 0);
+        word |= cur[i].level << i;
+    }
+
+    uint64_t t = 0;
+    while (1) {
+        uint64_t t_next = UINT64_MAX;
+        for (size_t i = 0; i < num_chans; i++) {
+            if (cur[i].next < t_next) t_next = cur[i].next;
+        }
+        if (t_next == UINT64_MAX) break;
+
+        for (uint64_t gap = t_next - t; gap; ) {
+            uint32_t n = gap > UINT32_MAX ? UINT32_MAX : (uint32_t)gap;
+            if (!la_rle_push(r, word, n)) return false;
+            gap -= n;
+        }
+        t = t_next;
+
+        word = 0;
+        for (size_t i = 0; i < num_chans; i++) {
+            while (cur[i].next == t) cursor_step(&cur[i]);
+            word |= cur[i].level << i;
+        }
+    }
+    // One tick of the final state so trailing levels are visible
+    return la_rle_push(r, word, 1);
+}
+
+size_t la_rmt_drop(uint32_t *symbols, la_segment_t *segs, size_t *num_segs, uint8_t *level, uint64_t before) {
+    size_t k = 0;
+    for (; k < *num_segs; k++) {
+        const la_segment_t *seg = &segs[k];
+        uint64_t end = seg->start;
+        uint8_t last = *level;
+        for (size_t h = 0; h < (size_t)seg->count * 2; h++) {
+            uint32_t sym = symbols[seg->first + h / 2];
+            last = RMT_LEVEL(sym, h & 1);
+            uint32_t dur = RMT_DURATION(sym, h & 1);
+            if (!dur) break;
+            end += dur;
+        }
+        if (end >= before) break;
+        *level = last;
+    }
+    if (!k) return 0;
+
+    size_t base = segs[0].first;
+    size_t end = segs[*num_segs - 1].first + segs[*num_segs - 1].count;
+    size_t keep = k < *num_segs ? segs[k].first : end;
+    memmove(symbols + base, symbols + keep, (end - keep) * sizeof(uint32_t));
+    for (size_t i = k; i < *num_segs; i++) {
+        segs[i - k] = segs[i];
+        segs[i - k].first -= (uint32_t)(keep - base);
+    }
+    *num_segs -= k;
+    return keep - base;
+}
+
+bool la_trigger_parse(const char *s, la_trigger_t *t) {
+    *t = (la_trigger_t){ 0 };
+    size_t len = strlen(s);
+    if (len > LA_MAX_CHANNELS) return false;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t bit = 1u << i;
+        switch (s[i]) {
+        case '0':           t->mask |= bit; break;
+        case '1':           t->mask |= bit; t->value |= bit; break;
+        case 'x': case 'X': break;
+        case 'r': case 'R': t->mask |= bit; t->value |= bit; t->edge |= bit; break;
+        case 'f': case 'F': t->mask |= bit; t->edge |= bit; break;
+        default:            return false;
+        }
+    }
+    return true;
+}
+
+size_t la_trigger_find(const la_trigger_t *t, const la_run_t *runs, size_t count, size_t from) {
+    for (size_t i = from; i < count; i++) {
+        if ((runs[i].word ^ t->value) & t->mask) continue;
+        if (t->edge) {
+            if (i == 0 || ((runs[i - 1].word ^ runs[i].word) & t->edge) != t->edge) continue;
+        }
+        return i;
+    }
+    return LA_NONE;
+}
+
+void la_framer_init(la_framer_t *f, const la_run_t *runs, size_t count, uint8_t channels,
+                    uint32_t id, uint8_t flags) {
+    f->runs = runs;
+    f->count = count;
+    f->next = 0;
+    f->tick = 0;
+    f->id = id;
+    f->channels = channels;
+    f->flags = flags & (LA_FLAG_TRIGGERED | LA_FLAG_TRUNCATED);
+}
+
+static size_t put_leb128(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        p[n++] = b | (v ? 0x80 : 0);
+    } while (v);
+    return n;
+}
+
+size_t la_framer_next(la_framer_t *f, uint8_t *out, size_t out_len) {
+    if (f->next >= f->count && f->next) return 0;
+    if (out_len > LA_BLOCK_MAX) out_len = LA_BLOCK_MAX;
+    if (out_len < LA_HDR_LEN + 6) return 0;
+
+    uint8_t flags = f->flags | (f->next == 0 ? LA_FLAG_FIRST : 0);
+    uint32_t first_tick = f->tick;
+    size_t pos = LA_HDR_LEN, n = 0;
+    while (f->next < f->count && pos + 6 <= out_len && n < UINT16_MAX) {
+        const la_run_t *run = &f->runs[f->next++];
+        out[pos++] = run->word;
+        pos += put_leb128(out + pos, run->ticks);
+        f->tick += run->ticks;
+        n++;
+    }
+    if (f->next >= f->count) {
+        flags |= LA_FLAG_LAST;
+        f->next = f->count ? f->count : 1;   // an empty capture still gets one block
+    }
+
+    out[0] = WIRE_LOGIC;
+    out[1] = f->channels;
+    out[2] = flags;
+    out[3] = 0;
+    wire_put_u32(out + 4, f->id);
+    wire_put_u32(out + 8, first_tick);
+    wire_put_u16(out + 12, (uint16_t)n);
+    return pos;
+}
+
+size_t la_block_decode(const uint8_t *block, size_t len, la_run_t *runs, size_t max_runs, uint32_t *tick) {
+    if (len < LA_HDR_LEN || block[0] != WIRE_LOGIC) return 0;
+    size_t n = wire_get_u16(block + 12);
+    if (n > max_runs) return 0;
+    if (tick) *tick = wire_get_u32(block + 8);
+
+    size_t pos = LA_HDR_LEN;
+    for (size_t i = 0; i < n; i++) {
+        if (pos >= len) return 0;
+        runs[i].word = block[pos++];
+        uint32_t v = 0;
+        for (int shift = 0; ; shift += 7) {
+            if (pos >= len || shift > 28) return 0;
+            uint8_t b = block[pos++];
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        runs[i].ticks = v;
+    }
+    return pos == len ? n : 0;
+}
+
+size_t la_summary_to_json(const la_summary_t *s, const la_run_t *runs, char *out, size_t out_len) {
+    size_t pos = 0;
+    int n = snprintf(out, out_len, "{\"logic\":{\"id\":%lu,\"tick_hz\":%lu,\"pins\":[",
+                     (unsigned long)s->id, (unsigned long)s->tick_hz);
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    pos = n;
+
+    for (size_t i = 0; i < s->channels; i++) {
+        n = snprintf(out + pos, out_len - pos, "%s%d", i ? "," : "", s->gpios[i]);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+    }
+
+    // The trigger is reported as a tick so the UI can centre on it
+    long long trigger_tick = -1;
+    if (s->trigger != LA_NONE && s->trigger <= s->runs) trigger_tick = (long long)la_rle_tick(runs, s->trigger);
+    n = snprintf(out + pos, out_len - pos, "],\"runs\":%lu,\"ticks\":%llu,\"trigger\":%lld,\"truncated\":%s}}",
+                 (unsigned long)s->runs, (unsigned long long)s->ticks, trigger_tick, s->truncated ? "true" : "false");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
@@ -0,0 +1,105 @@
+#include "metrics_core.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t lat_bucket_us[LAT_BUCKETS - 1] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000,
+};
+
+void lat_hist_init(lat_hist_t *h, const char *name, const char *key, const char *help) {
+    memset(h, 0, sizeof(*h));
+    h->name = name;
+    h->key = key;
+    h->help = help;
+}
+
+void lat_hist_record(lat_hist_t *h, uint32_t us) {
+    int b = 0;
+    while (b < LAT_BUCKETS - 1 && us > lat_bucket_us[b]) b++;
+    atomic_fetch_add_explicit(&h->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+
+    uint32_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak(&h->max_us, &max, us)) {
+    }
+}
+
+uint32_t lat_hist_quantile(const lat_hist_t *h, float q) {
+    uint32_t count = atomic_load(&h->count);
+    if (!count) return 0;
+    uint32_t rank = (uint32_t)(q * count + 0.5f);
+    if (rank < 1) rank = 1;
+
+    uint32_t seen = 0;
+    for (int b = 0; b < LAT_BUCKETS - 1; b++) {
+        seen += atomic_load(&h->buckets[b]);
+        if (seen >= rank) return lat_bucket_us[b];
+    }
+    return atomic_load(&h->max_us);
+}
+
+size_t lat_hist_to_json(const lat_hist_t *h, char *out, size_t out_len) {
+    int n = snprintf(out, out_len, "\"%s\":{\"count\":%lu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}",
+                     h->key, (unsigned long)atomic_load(&h->count),
+                     (unsigned long)lat_hist_quantile(h, 0.5f), (unsigned long)lat_hist_quantile(h, 0.9f),
+                     (unsigned long)lat_hist_quantile(h, 0.99f), (unsigned long)atomic_load(&h->max_us));
+    return (n < 0 || (size_t)n >= out_len) ? 0 : n;
+}
+
+void prom_init(prom_writer_t *w, char *buf, size_t cap, prom_flush_t flush, void *ctx) {
+    w->buf = buf;
+    w->cap = cap;
+    w->pos = 0;
+    w->flush = flush;
+    w->ctx = ctx;
+    w->failed = false;
+}
+
+static void prom_flush(prom_writer_t *w) {
+    if (w->pos && !w->failed && !w->flush(w->buf, w->pos, w->ctx)) w->failed = true;
+    w->pos = 0;
+}
+
+void prom_printf(prom_writer_t *w, const char *fmt, ...) {
+    if (w->failed) return;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(w->buf + w->pos, w->cap - w->pos, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t)n < w->cap - w->pos) {
+            w->pos += n;
+            return;
+        }
+        // Drop the partial line, ship what came before and retry on an empty buffer
+        w->buf[w->pos] = '\0';
+        if (attempt == 0) prom_flush(w);
+    }
+    w->failed = true;
+}
+
+void prom_header(prom_writer_t *w, const char *name, const char *type, const char *help) {
+    prom_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void prom_hist(prom_writer_t *w, const lat_hist_t *h) {
+    prom_header(w, h->name, "histogram", h->help);
+    uint32_t cumulative = 0;
+    for (int b = 0; b < LAT_BUCKETS - 1; b++) {
+        cumulative += atomic_load(&h->buckets[b]);
+        prom_printf(w, "%s_bucket{le=\"%lu.%06lu\"} %lu\n", h->name, (unsigned long)(lat_bucket_us[b] / 1000000),
+                    (unsigned long)(lat_bucket_us[b] % 1000000), (unsigned long)cumulative);
+    }
+    cumulative += atomic_load(&h->buckets[LAT_BUCKETS - 1]);
+    prom_printf(w, "%s_bucket{le=\"+Inf\"} %lu\n", h->name, (unsigned long)cumulative);
+    uint64_t sum = atomic_load(&h->sum_us);
+    prom_printf(w, "%s_sum %lu.%06lu\n", h->name, (unsigned long)(sum / 1000000), (unsigned long)(sum % 1000000));
+    prom_printf(w, "%s_count %lu\n", h->name, (unsigned long)cumulative);
+}
+
+bool prom_finish(prom_writer_t *w) {
+    prom_flush(w);
+    return !w->failed;
+}
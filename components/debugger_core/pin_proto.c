@@ -0,0 +1,94 @@
+#include "pin_proto.h"
+#include "dbg_wire.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void pin_proto_init(pin_proto_state_t *st, const int *gpio_nums, size_t num_pins) {
+    memset(st, 0, sizeof(*st));
+    st->num_pins = num_pins > PIN_PROTO_MAX_PINS ? PIN_PROTO_MAX_PINS : num_pins;
+    st->gpio_nums = gpio_nums;
+    // Version 0 means "nothing acknowledged", so the first state is version 1
+    st->version = 1;
+    for (size_t i = 0; i < st->num_pins; i++) st->pin_version[i] = 1;
+}
+
+static void set_bit(uint32_t *mask, uint32_t bit, bool on) {
+    if (on) *mask |= bit;
+    else *mask &= ~bit;
+}
+
+void pin_proto_load(pin_proto_state_t *st, const pin_snapshot_t *snap) {
+    st->version = snap->version;
+    st->levels = st->outputs = st->pwm = 0;
+    for (size_t i = 0; i < st->num_pins && i < snap->num_pins; i++) {
+        const pin_state_t *p = &snap->pins[i];
+        uint32_t bit = 1u << i;
+        set_bit(&st->levels, bit, p->level);
+        set_bit(&st->outputs, bit, p->output);
+        set_bit(&st->pwm, bit, p->pwm_hz > 0);
+        st->counters[i] = p->bounces;
+        st->pin_version[i] = p->version;
+    }
+}
+
+size_t pin_proto_encode(const pin_proto_state_t *st, uint32_t since_version, uint8_t *out, size_t out_len) {
+    bool full = since_version == 0;
+    uint32_t changed = 0;
+    uint8_t n = 0;
+    for (size_t i = 0; i < st->num_pins; i++) {
+        if (st->pin_version[i] > since_version) {
+            changed |= 1u << i;
+            n++;
+        }
+    }
+    if (!changed) return 0;
+
+    size_t len = PIN_PROTO_HDR_LEN + (size_t)n * 5 + (full ? st->num_pins : 0);
+    if (len > out_len) return 0;
+
+    out[0] = WIRE_PIN_STATE;
+    out[1] = PIN_PROTO_VERSION;
+    out[2] = full ? PIN_PROTO_FLAG_FULL : 0;
+    out[3] = st->num_pins;
+    wire_put_u32(out + 4, st->version);
+    wire_put_u32(out + 8, since_version);
+    wire_put_u32(out + 12, changed);
+    wire_put_u32(out + 16, st->levels & changed);
+    wire_put_u32(out + 20, st->outputs & changed);
+    wire_put_u32(out + 24, st->pwm & changed);
+    out[28] = n;
+
+    uint8_t *p = out + PIN_PROTO_HDR_LEN;
+    for (size_t i = 0; i < st->num_pins; i++) {
+        if (!(changed & (1u << i))) continue;
+        p[0] = (uint8_t)i;
+        wire_put_u32(p + 1, st->counters[i]);
+        p += 5;
+    }
+    if (full) {
+        for (size_t i = 0; i < st->num_pins; i++) *p++ = (uint8_t)st->gpio_nums[i];
+    }
+    return len;
+}
+
+size_t pin_proto_to_json(const pin_proto_state_t *st, char *out, size_t out_len) {
+    size_t pos = 0;
+    if (out_len < 2) return 0;
+    out[pos++] = '[';
+
+    for (size_t i = 0; i < st->num_pins; i++) {
+        uint32_t bit = 1u << i;
+        const char *mode = (st->outputs & bit) ? ((st->pwm & bit) ? "PWM" : "OUTPUT") : "INPUT";
+        int n = snprintf(out + pos, out_len - pos, "%s{\"pin\":%d,\"mode\":\"%s\",\"state\":%d,\"bounce\":%lu}",
+                         i ? "," : "", st->gpio_nums[i], mode, !!(st->levels & bit),
+                         (unsigned long)st->counters[i]);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+    }
+
+    if (pos + 2 > out_len) return 0;
+    out[pos++] = ']';
+    out[pos] = '\0';
+    return pos;
+}
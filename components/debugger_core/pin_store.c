@@ -0,0 +1,105 @@
+#include "pin_store.h"
+
+#include <string.h>
+
+#define FLAG_LEVEL  0x01
+#define FLAG_OUTPUT 0x02
+
+void pin_store_init(pin_store_t *st, size_t num_pins) {
+    st->num_pins = num_pins > PIN_STORE_MAX_PINS ? PIN_STORE_MAX_PINS : num_pins;
+    atomic_store(&st->seq, 0);
+    atomic_store(&st->version, 1);
+    atomic_store(&st->retries, 0);
+    for (size_t i = 0; i < PIN_STORE_MAX_PINS; i++) {
+        for (size_t w = 0; w < PIN_STORE_WORDS; w++) atomic_store(&st->words[i][w], 0);
+        atomic_store(&st->words[i][4], 1);
+    }
+}
+
+// Data words are relaxed atomics: a torn copy is possible and harmless,
+// because the sequence check throws it away
+static void load_pin(const pin_store_t *st, size_t idx, pin_state_t *pin) {
+    _Atomic uint32_t *w = (_Atomic uint32_t *)st->words[idx];
+    uint32_t flags = atomic_load_explicit(&w[0], memory_order_relaxed);
+    pin->level = flags & FLAG_LEVEL;
+    pin->output = flags & FLAG_OUTPUT;
+    pin->pwm_hz = atomic_load_explicit(&w[1], memory_order_relaxed);
+    pin->bounces = atomic_load_explicit(&w[2], memory_order_relaxed);
+    pin->last_change_ms = atomic_load_explicit(&w[3], memory_order_relaxed);
+    pin->version = atomic_load_explicit(&w[4], memory_order_relaxed);
+}
+
+static bool read_begin(pin_store_t *st, uint32_t *seq) {
+    *seq = atomic_load_explicit(&st->seq, memory_order_acquire);
+    if (!(*seq & 1)) return true;
+    atomic_fetch_add_explicit(&st->retries, 1, memory_order_relaxed);
+    return false;
+}
+
+static bool read_end(pin_store_t *st, uint32_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&st->seq, memory_order_relaxed) == seq) return true;
+    atomic_fetch_add_explicit(&st->retries, 1, memory_order_relaxed);
+    return false;
+}
+
+bool pin_store_read(pin_store_t *st, pin_snapshot_t *snap, unsigned max_tries) {
+    for (unsigned t = 0; t < max_tries; t++) {
+        uint32_t seq;
+        if (!read_begin(st, &seq)) continue;
+        snap->num_pins = st->num_pins;
+        snap->version = atomic_load_explicit(&st->version, memory_order_relaxed);
+        for (size_t i = 0; i < st->num_pins; i++) load_pin(st, i, &snap->pins[i]);
+        if (read_end(st, seq)) return true;
+    }
+    return false;
+}
+
+bool pin_store_read_pin(pin_store_t *st, size_t idx, pin_state_t *pin, unsigned max_tries) {
+    if (idx >= st->num_pins) return false;
+    for (unsigned t = 0; t < max_tries; t++) {
+        uint32_t seq;
+        if (!read_begin(st, &seq)) continue;
+        load_pin(st, idx, pin);
+        if (read_end(st, seq)) return true;
+    }
+    return false;
+}
+
+void pin_store_write_begin(pin_store_t *st) {
+    uint32_t seq = atomic_load_explicit(&st->seq, memory_order_relaxed);
+    atomic_store_explicit(&st->seq, seq + 1, memory_order_relaxed);
+    // The odd sequence is visible before any data store
+    atomic_thread_fence(memory_order_release);
+}
+
+void pin_store_write_end(pin_store_t *st) {
+    uint32_t seq = atomic_load_explicit(&st->seq, memory_order_relaxed);
+    atomic_store_explicit(&st->seq, seq + 1, memory_order_release);
+}
+
+void pin_store_peek(const pin_store_t *st, size_t idx, pin_state_t *pin) {
+    if (idx < st->num_pins) load_pin(st, idx, pin);
+    else memset(pin, 0, sizeof(*pin));
+}
+
+bool pin_store_set(pin_store_t *st, size_t idx, const pin_state_t *pin) {
+    if (idx >= st->num_pins) return false;
+    pin_state_t cur;
+    load_pin(st, idx, &cur);
+    if (cur.level == pin->level && cur.output == pin->output && cur.pwm_hz == pin->pwm_hz &&
+        cur.bounces == pin->bounces && cur.last_change_ms == pin->last_change_ms) {
+        return false;
+    }
+
+    _Atomic uint32_t *w = st->words[idx];
+    uint32_t version = atomic_load_explicit(&st->version, memory_order_relaxed) + 1;
+    atomic_store_explicit(&w[0], (pin->level ? FLAG_LEVEL : 0) | (pin->output ? FLAG_OUTPUT : 0),
+                          memory_order_relaxed);
+    atomic_store_explicit(&w[1], pin->pwm_hz, memory_order_relaxed);
+    atomic_store_explicit(&w[2], pin->bounces, memory_order_relaxed);
+    atomic_store_explicit(&w[3], pin->last_change_ms, memory_order_relaxed);
+    atomic_store_explicit(&w[4], version, memory_order_relaxed);
+    atomic_store_explicit(&st->version, version, memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,221 @@
+#include "pwm_core.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void pwm_alloc_init(pwm_alloc_t *a, uint32_t clk_hz) {
+    memset(a, 0, sizeof(*a));
+    a->clk_hz = clk_hz;
+    for (int m = 0; m < PWM_MODES; m++) {
+        for (int c = 0; c < PWM_CHANNELS; c++) a->channels[m][c].gpio = -1;
+    }
+}
+
+bool pwm_timing_at(uint32_t clk_hz, uint32_t freq_hz, uint8_t bits, uint32_t *div) {
+    if (!freq_hz || !bits || bits > PWM_MAX_BITS) return false;
+    // Same rounding as the LEDC driver, so the reported frequency is the real one
+    uint64_t ticks = (uint64_t)freq_hz << bits;
+    uint64_t d = (((uint64_t)clk_hz << PWM_DIV_FRAC_BITS) + ticks / 2) / ticks;
+    if (d < PWM_DIV_MIN || d > PWM_DIV_MAX) return false;
+    *div = (uint32_t)d;
+    return true;
+}
+
+double pwm_actual_hz(uint32_t clk_hz, uint32_t div, uint8_t bits) {
+    if (!div) return 0;
+    return (double)clk_hz * PWM_DIV_MIN / ((double)div * (1u << bits));
+}
+
+static double ppm_off(uint32_t clk_hz, uint32_t freq_hz, uint32_t div, uint8_t bits) {
+    double err = pwm_actual_hz(clk_hz, div, bits) / freq_hz - 1;
+    return (err < 0 ? -err : err) * 1e6;
+}
+
+bool pwm_timing(uint32_t clk_hz, uint32_t freq_hz, uint8_t *bits, uint32_t *div) {
+    // Near the top resolution the divider is close to 1 and its 1/256 steps
+    // move the frequency by up to 0.4 %; step down until it is accurate
+    double best = -1;
+    for (int b = PWM_MAX_BITS; b >= 1; b--) {
+        uint32_t d;
+        if (!pwm_timing_at(clk_hz, freq_hz, b, &d)) continue;
+        double ppm = ppm_off(clk_hz, freq_hz, d, b);
+        if (best < 0 || ppm < best) {
+            best = ppm;
+            *bits = b;
+            *div = d;
+        }
+        if (ppm <= PWM_MAX_ERROR_PPM) break;
+    }
+    return best >= 0;
+}
+
+uint32_t pwm_duty_ticks(uint16_t duty, uint8_t bits) {
+    if (duty > PWM_DUTY_SCALE) duty = PWM_DUTY_SCALE;
+    return (uint32_t)((((uint64_t)duty << bits) + PWM_DUTY_SCALE / 2) / PWM_DUTY_SCALE);
+}
+
+bool pwm_find(const pwm_alloc_t *a, int gpio, uint8_t *mode, uint8_t *channel) {
+    for (int m = 0; m < PWM_MODES; m++) {
+        for (int c = 0; c < PWM_CHANNELS; c++) {
+            if (a->channels[m][c].gpio == gpio) {
+                *mode = m;
+                *channel = c;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int timer_on(const pwm_alloc_t *a, int mode, uint32_t freq_hz) {
+    for (int t = 0; t < PWM_TIMERS; t++) {
+        if (a->timers[mode][t].users && a->timers[mode][t].freq_hz == freq_hz) return t;
+    }
+    return -1;
+}
+
+static int free_timer(const pwm_alloc_t *a, int mode) {
+    for (int t = 0; t < PWM_TIMERS; t++) {
+        if (!a->timers[mode][t].users) return t;
+    }
+    return -1;
+}
+
+static int free_channel(const pwm_alloc_t *a, int mode) {
+    for (int c = 0; c < PWM_CHANNELS; c++) {
+        if (a->channels[mode][c].gpio < 0) return c;
+    }
+    return -1;
+}
+
+static void timer_unref(pwm_alloc_t *a, int mode, int timer) {
+    pwm_timer_t *t = &a->timers[mode][timer];
+    if (t->users && --t->users == 0) *t = (pwm_timer_t){ 0 };
+}
+
+static void timer_setup(pwm_alloc_t *a, int mode, int timer, uint32_t freq_hz, uint8_t bits, uint32_t div) {
+    a->timers[mode][timer] = (pwm_timer_t){ .freq_hz = freq_hz, .div = div, .bits = bits };
+}
+
+bool pwm_assign(pwm_alloc_t *a, int gpio, uint32_t freq_hz, pwm_plan_t *plan) {
+    uint8_t bits, mode = 0, ch = 0;
+    uint32_t div;
+    if (!pwm_timing(a->clk_hz, freq_hz, &bits, &div)) return false;
+
+    *plan = (pwm_plan_t){ .freed_mode = -1, .freed_channel = -1 };
+    bool have = pwm_find(a, gpio, &mode, &ch);
+    uint16_t duty = PWM_DUTY_SCALE / 2;
+    if (have) {
+        pwm_channel_t *c = &a->channels[mode][ch];
+        pwm_timer_t *cur = &a->timers[mode][c->timer];
+        duty = c->duty;
+        plan->mode = mode;
+        plan->channel = ch;
+        plan->timer = c->timer;
+        if (cur->freq_hz == freq_hz) return true;
+
+        // Join a timer of the same group that already runs at this frequency
+        int t = timer_on(a, mode, freq_hz);
+        if (t >= 0) {
+            timer_unref(a, mode, c->timer);
+            c->timer = t;
+            a->timers[mode][t].users++;
+            plan->timer = t;
+            plan->rebind = true;
+            return true;
+        }
+        // Sole user: retune in place, without a timer reset if the resolution holds
+        if (cur->users == 1) {
+            uint32_t same_bits_div;
+            if (pwm_timing_at(a->clk_hz, freq_hz, cur->bits, &same_bits_div) &&
+                ppm_off(a->clk_hz, freq_hz, same_bits_div, cur->bits) <= PWM_MAX_ERROR_PPM) {
+                cur->freq_hz = freq_hz;
+                cur->div = same_bits_div;
+                plan->timer_freq = true;
+            } else {
+                timer_setup(a, mode, c->timer, freq_hz, bits, div);
+                cur->users = 1;
+                plan->timer_config = true;
+            }
+            return true;
+        }
+        // Shared with other pins: take a free timer of the same group
+        t = free_timer(a, mode);
+        if (t >= 0) {
+            timer_unref(a, mode, c->timer);
+            timer_setup(a, mode, t, freq_hz, bits, div);
+            a->timers[mode][t].users = 1;
+            c->timer = t;
+            plan->timer = t;
+            plan->timer_config = true;
+            plan->rebind = true;
+            return true;
+        }
+        // Otherwise a new channel in the other group, below
+    }
+
+    // Prefer a group with a timer already on this frequency, then one with a free timer
+    for (int pass = 0; pass < 2; pass++) {
+        for (int m = 0; m < PWM_MODES; m++) {
+            if (have && m == mode) continue;
+            int c = free_channel(a, m);
+            int t = pass == 0 ? timer_on(a, m, freq_hz) : free_timer(a, m);
+            if (c < 0 || t < 0) continue;
+
+            if (have) {
+                timer_unref(a, mode, a->channels[mode][ch].timer);
+                a->channels[mode][ch] = (pwm_channel_t){ .gpio = -1 };
+                plan->freed_mode = mode;
+                plan->freed_channel = ch;
+            }
+            if (pass == 1) {
+                timer_setup(a, m, t, freq_hz, bits, div);
+                plan->timer_config = true;
+            }
+            a->timers[m][t].users++;
+            a->channels[m][c] = (pwm_channel_t){ .gpio = gpio, .timer = t, .duty = duty };
+            plan->mode = m;
+            plan->channel = c;
+            plan->timer = t;
+            plan->channel_config = true;
+            plan->rebind = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool pwm_release(pwm_alloc_t *a, int gpio, uint8_t *mode, uint8_t *channel) {
+    if (!pwm_find(a, gpio, mode, channel)) return false;
+    timer_unref(a, *mode, a->channels[*mode][*channel].timer);
+    a->channels[*mode][*channel] = (pwm_channel_t){ .gpio = -1 };
+    return true;
+}
+
+size_t pwm_to_json(const pwm_alloc_t *a, char *out, size_t out_len) {
+    size_t pos = 0;
+    int n = snprintf(out, out_len, "{\"pwm\":[");
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    pos = n;
+
+    bool first = true;
+    for (int m = 0; m < PWM_MODES; m++) {
+        for (int c = 0; c < PWM_CHANNELS; c++) {
+            const pwm_channel_t *ch = &a->channels[m][c];
+            if (ch->gpio < 0) continue;
+            const pwm_timer_t *t = &a->timers[m][ch->timer];
+            n = snprintf(out + pos, out_len - pos,
+                         "%s{\"pin\":%d,\"hz\":%lu,\"actual_hz\":%.3f,\"bits\":%u,\"duty\":%u,"
+                         "\"group\":\"%s\",\"timer\":%u,\"channel\":%d}",
+                         first ? "" : ",", ch->gpio, (unsigned long)t->freq_hz,
+                         pwm_actual_hz(a->clk_hz, t->div, t->bits), t->bits, ch->duty,
+                         m == 0 ? "hs" : "ls", ch->timer, c);
+            if (n < 0 || (size_t)n >= out_len - pos) return 0;
+            pos += n;
+            first = false;
+        }
+    }
+    n = snprintf(out + pos, out_len - pos, "]}");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
@@ -0,0 +1,189 @@
+#include "rec_core.h"
+#include "dbg_wire.h"
+
+#include <string.h>
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    wire_put_u32(p, (uint32_t)v);
+    wire_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+bool rec_sources_parse(const char *s, uint8_t *mask) {
+    static const struct { const char *name; uint8_t bit; } names[] = {
+        { "ADC", REC_SRC_ADC }, { "EDGES", REC_SRC_EDGES }, { "UART", REC_SRC_UART },
+    };
+    *mask = 0;
+    while (*s) {
+        size_t len = strcspn(s, "+");
+        size_t i;
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (strlen(names[i].name) == len && strncmp(s, names[i].name, len) == 0) break;
+        }
+        if (i == sizeof(names) / sizeof(names[0])) return false;
+        *mask |= names[i].bit;
+        s += len;
+        if (*s == '+') s++;
+    }
+    return *mask != 0;
+}
+
+// Reflected CRC-32 (zlib's), a nibble at a time to keep the table small
+uint32_t rec_crc32(uint32_t crc, const void *data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t *p = data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+size_t rec_file_header(uint8_t *out, uint64_t start_us, uint8_t sources, const char *desc) {
+    size_t desc_len = strlen(desc);
+    if (desc_len > REC_DESC_MAX) desc_len = REC_DESC_MAX;
+    memset(out, 0, REC_FILE_HDR_LEN);
+    memcpy(out, REC_MAGIC, 8);
+    wire_put_u16(out + 8, REC_VERSION);
+    wire_put_u16(out + 10, REC_FILE_HDR_LEN);
+    wire_put_u32(out + 12, REC_CHUNK_MAX);
+    put_u64(out + 16, start_us);
+    out[24] = sources;
+    wire_put_u16(out + 26, (uint16_t)desc_len);
+    memcpy(out + 32, desc, desc_len);
+    return REC_FILE_HDR_LEN;
+}
+
+void rec_chunk_init(rec_chunk_t *c, uint8_t *buf, uint32_t seq, uint64_t base_us) {
+    c->buf = buf;
+    c->len = REC_CHUNK_HDR_LEN;
+    c->seq = seq;
+    c->base_us = base_us;
+    c->last_us = base_us;
+    c->records = 0;
+    c->types = 0;
+}
+
+size_t rec_chunk_put(rec_chunk_t *c, uint8_t type, uint64_t t_us, const void *data, size_t len, bool cont) {
+    // Leave room for the seal's padding so a full chunk still fits the buffer
+    size_t room = REC_CHUNK_MAX - 3 - c->len;
+    if (room <= REC_REC_HDR_LEN || c->records == UINT16_MAX) return 0;
+    if (t_us < c->base_us) t_us = c->base_us;
+    if (t_us - c->base_us > UINT32_MAX) return 0;
+    if (len == 0 && cont) return 0;
+
+    size_t n = len < room - REC_REC_HDR_LEN ? len : room - REC_REC_HDR_LEN;
+    uint8_t *p = c->buf + c->len;
+    p[0] = type;
+    p[1] = (n < len ? REC_FRAG_MORE : 0) | (cont ? REC_FRAG_CONT : 0);
+    wire_put_u16(p + 2, (uint16_t)n);
+    wire_put_u32(p + 4, (uint32_t)(t_us - c->base_us));
+    memcpy(p + REC_REC_HDR_LEN, data, n);
+    c->len += REC_REC_HDR_LEN + n;
+    c->records++;
+    if (type < 16) c->types |= 1u << type;
+    c->last_us = t_us;
+    return n;
+}
+
+size_t rec_chunk_seal(rec_chunk_t *c) {
+    uint8_t *p = c->buf;
+    size_t payload = c->len - REC_CHUNK_HDR_LEN;
+    memcpy(p, "RCHK", 4);
+    wire_put_u32(p + 4, c->seq);
+    put_u64(p + 8, c->base_us);
+    wire_put_u16(p + 16, (uint16_t)payload);
+    wire_put_u16(p + 18, c->records);
+    wire_put_u32(p + 20, rec_crc32(0, p + REC_CHUNK_HDR_LEN, payload));
+    size_t stored = (c->len + 3) & ~(size_t)3;
+    memset(p + c->len, 0, stored - c->len);
+    return stored;
+}
+
+size_t rec_chunk_check(const uint8_t *p, size_t avail) {
+    if (avail < REC_CHUNK_HDR_LEN || memcmp(p, "RCHK", 4) != 0) return 0;
+    size_t payload = wire_get_u16(p + 16);
+    size_t stored = (REC_CHUNK_HDR_LEN + payload + 3) & ~(size_t)3;
+    if (stored > avail || stored > REC_CHUNK_MAX) return 0;
+    return rec_crc32(0, p + REC_CHUNK_HDR_LEN, payload) == wire_get_u32(p + 20) ? stored : 0;
+}
+
+void rec_index_init(rec_index_t *ix) {
+    memset(ix, 0, sizeof(*ix));
+    ix->per_entry = 1;
+}
+
+static void merge_pairs(rec_index_t *ix) {
+    size_t out = 0;
+    for (size_t i = 0; i < ix->count; i += 2, out++) {
+        rec_index_entry_t e = ix->entries[i];
+        if (i + 1 < ix->count) {
+            const rec_index_entry_t *b = &ix->entries[i + 1];
+            e.chunks += b->chunks;
+            e.types |= b->types;
+            e.records += b->records;
+            e.span_us = (uint32_t)(b->base_us + b->span_us - e.base_us);
+        }
+        ix->entries[out] = e;
+    }
+    ix->count = out;
+    ix->per_entry *= 2;
+}
+
+void rec_index_add(rec_index_t *ix, const rec_chunk_t *c, uint32_t offset) {
+    ix->chunks++;
+    ix->records += c->records;
+    uint64_t span = c->last_us - c->base_us;
+    if (ix->count) {
+        rec_index_entry_t *e = &ix->entries[ix->count - 1];
+        uint64_t joined = c->last_us - e->base_us;
+        if (e->chunks < ix->per_entry && joined <= UINT32_MAX) {
+            e->chunks++;
+            e->types |= c->types;
+            e->records += c->records;
+            e->span_us = (uint32_t)joined;
+            return;
+        }
+    }
+    if (ix->count == REC_INDEX_MAX) merge_pairs(ix);
+    ix->entries[ix->count++] = (rec_index_entry_t){
+        .offset = offset, .chunks = 1, .types = c->types, .records = c->records,
+        .base_us = c->base_us, .span_us = span > UINT32_MAX ? UINT32_MAX : (uint32_t)span,
+    };
+}
+
+size_t rec_index_encode(const rec_index_t *ix, uint32_t index_offset, uint8_t *out, size_t out_len) {
+    size_t need = 8 + ix->count * REC_INDEX_ENTRY_LEN + REC_FOOTER_LEN;
+    if (need > out_len) return 0;
+    memcpy(out, "RIDX", 4);
+    wire_put_u32(out + 4, (uint32_t)ix->count);
+    uint8_t *p = out + 8;
+    for (size_t i = 0; i < ix->count; i++, p += REC_INDEX_ENTRY_LEN) {
+        const rec_index_entry_t *e = &ix->entries[i];
+        wire_put_u32(p, e->offset);
+        wire_put_u16(p + 4, e->chunks);
+        wire_put_u16(p + 6, e->types);
+        wire_put_u32(p + 8, e->records);
+        put_u64(p + 12, e->base_us);
+        wire_put_u32(p + 20, e->span_us);
+    }
+    memcpy(p, "REND", 4);
+    wire_put_u32(p + 4, index_offset);
+    wire_put_u32(p + 8, ix->chunks);
+    wire_put_u32(p + 12, ix->records);
+    return need;
+}
+
+size_t rec_edges_encode(const edge_event_t *ev, size_t n, const int *gpio_nums, uint8_t *out, size_t out_len) {
+    size_t pos = 0;
+    for (size_t i = 0; i < n && pos + 6 <= out_len; i++, pos += 6) {
+        wire_put_u32(out + pos, ev[i].t_us);
+        out[pos + 4] = (uint8_t)gpio_nums[ev[i].pin];
+        out[pos + 5] = ev[i].level;
+    }
+    return pos;
+}
@@ -0,0 +1,117 @@
+#include "scan_core.h"
+#include "dbg_wire.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define LUT_JSON_STEP 128
+
+bool scan_config_valid(const scan_config_t *cfg) {
+    if (!cfg->channels || cfg->channels > SCAN_MAX_CHANNELS) return false;
+    if (!cfg->points || cfg->points > SCAN_MAX_POINTS || !cfg->per_point) return false;
+    if ((size_t)cfg->points * cfg->channels > SCAN_MAX_BINS) return false;
+    for (size_t i = 0; i < cfg->channels; i++) {
+        if (cfg->adc_channel[i] >= SCAN_ADC_CHANNELS) return false;
+        for (size_t j = 0; j < i; j++) {
+            if (cfg->adc_channel[j] == cfg->adc_channel[i]) return false;
+        }
+    }
+    return true;
+}
+
+static size_t data_offset(const scan_config_t *cfg) {
+    return SCAN_HDR_LEN + ((cfg->channels + 1u) & ~1u);
+}
+
+static void reset_acc(scan_acc_t *a, uint32_t skip) {
+    *a = (scan_acc_t){ .min = UINT16_MAX, .skip = skip };
+}
+
+void scan_engine_init(scan_engine_t *eng, const scan_config_t *cfg, const uint16_t *lut) {
+    memset(eng, 0, sizeof(*eng));
+    eng->cfg = *cfg;
+    eng->lut = lut;
+    memset(eng->slot, -1, sizeof(eng->slot));
+    for (size_t i = 0; i < cfg->channels; i++) {
+        eng->slot[cfg->adc_channel[i]] = (int8_t)i;
+        reset_acc(&eng->acc[i], 0);
+    }
+}
+
+static size_t finish_frame(scan_engine_t *eng) {
+    const scan_config_t *cfg = &eng->cfg;
+    uint8_t *f = eng->frame;
+    f[0] = WIRE_ADC_SCAN;
+    f[1] = cfg->channels;
+    f[2] = cfg->calibrated && eng->lut ? SCAN_FLAG_CALIBRATED : 0;
+    f[3] = 0;
+    wire_put_u32(f + 4, eng->seq++);
+    wire_put_u32(f + 8, cfg->rate);
+    wire_put_u32(f + 12, cfg->per_point);
+    wire_put_u16(f + 16, cfg->points);
+    wire_put_u16(f + 18, 0);
+    memset(f + SCAN_HDR_LEN, 0, data_offset(cfg) - SCAN_HDR_LEN);
+    memcpy(f + SCAN_HDR_LEN, cfg->gpio, cfg->channels);
+    return data_offset(cfg) + (size_t)cfg->channels * cfg->points * 6;
+}
+
+size_t scan_engine_push(scan_engine_t *eng, const uint8_t *chan, const uint16_t *raw, size_t n,
+                        scan_frame_cb_t cb, void *ctx) {
+    const scan_config_t *cfg = &eng->cfg;
+    size_t frames = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (chan[i] >= SCAN_ADC_CHANNELS || eng->slot[chan[i]] < 0) continue;
+        int c = eng->slot[chan[i]];
+        scan_acc_t *a = &eng->acc[c];
+        // A channel that is a sample or two ahead waits here for the others
+        if (a->point == cfg->points) continue;
+        if (a->skip) {
+            a->skip--;
+            continue;
+        }
+
+        uint16_t v = eng->lut ? eng->lut[raw[i] & (SCAN_LUT_LEN - 1)] : raw[i];
+        if (v < a->min) a->min = v;
+        if (v > a->max) a->max = v;
+        a->sum += v;
+        if (++a->n < cfg->per_point) continue;
+
+        uint8_t *p = eng->frame + data_offset(cfg) + ((size_t)c * cfg->points + a->point) * 6;
+        wire_put_u16(p, a->min);
+        wire_put_u16(p + 2, (uint16_t)((a->sum + a->n / 2) / a->n));
+        wire_put_u16(p + 4, a->max);
+        uint16_t point = a->point + 1;
+        reset_acc(a, 0);
+        a->point = point;
+        if (point < cfg->points || ++eng->complete < cfg->channels) continue;
+
+        size_t len = finish_frame(eng);
+        if (cb) cb(eng->frame, len, ctx);
+        frames++;
+        eng->complete = 0;
+        for (size_t k = 0; k < cfg->channels; k++) reset_acc(&eng->acc[k], cfg->holdoff);
+    }
+    return frames;
+}
+
+void scan_lut_linear(uint16_t *lut, uint16_t full_scale_mv) {
+    for (uint32_t i = 0; i < SCAN_LUT_LEN; i++) {
+        lut[i] = (uint16_t)((i * full_scale_mv + (SCAN_LUT_LEN - 1) / 2) / (SCAN_LUT_LEN - 1));
+    }
+}
+
+size_t scan_lut_to_json(const uint16_t *lut, bool calibrated, char *out, size_t out_len) {
+    int n = snprintf(out, out_len, "{\"adc_cal\":{\"calibrated\":%s,\"mv\":[", calibrated ? "true" : "false");
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    size_t pos = n;
+    for (uint32_t code = 0; code <= SCAN_LUT_LEN; code += LUT_JSON_STEP) {
+        uint32_t i = code < SCAN_LUT_LEN ? code : SCAN_LUT_LEN - 1;
+        n = snprintf(out + pos, out_len - pos, "%s%u", code ? "," : "", lut[i]);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+    }
+    n = snprintf(out + pos, out_len - pos, "]}}");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
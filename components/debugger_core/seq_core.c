@@ -0,0 +1,72 @@
+#include "seq_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+size_t seq_parse(const char *s, size_t channels, seq_step_t *steps, size_t max) {
+    size_t n = 0;
+    if (!channels || channels > SEQ_MAX_CHANNELS) return 0;
+
+    while (*s) {
+        if (n == max) return 0;
+        uint8_t word = 0;
+        for (size_t ch = 0; ch < channels; ch++, s++) {
+            if (*s != '0' && *s != '1') return 0;
+            word |= (uint8_t)(*s - '0') << ch;
+        }
+        if (*s++ != '@') return 0;
+
+        char *end;
+        unsigned long us = strtoul(s, &end, 10);
+        if (end == s || us < SEQ_MIN_STEP_US || us > SEQ_MAX_STEP_US) return 0;
+        s = end;
+        steps[n++] = (seq_step_t){ .us = (uint32_t)us, .word = word };
+
+        if (*s == ';') s++;
+        else if (*s) return 0;
+    }
+    return n;
+}
+
+uint64_t seq_length_us(const seq_step_t *steps, size_t count) {
+    uint64_t us = 0;
+    for (size_t i = 0; i < count; i++) us += steps[i].us;
+    return us;
+}
+
+void seq_player_init(seq_player_t *p, const seq_step_t *steps, size_t count, uint32_t loops,
+                     uint32_t ticks_per_us, uint64_t start) {
+    *p = (seq_player_t){
+        .steps = steps,
+        .count = count,
+        .loops = loops,
+        .ticks_per_us = ticks_per_us,
+        .due = start,
+        .done = count == 0,
+    };
+}
+
+void seq_stats_init(seq_stats_t *s, uint32_t late_ticks) {
+    *s = (seq_stats_t){ .late_ticks = late_ticks };
+}
+
+size_t seq_report_to_json(const seq_report_t *r, char *out, size_t out_len) {
+    const seq_stats_t *st = r->stats;
+    // Errors go out in nanoseconds so the tick rate stays a firmware detail
+    double ns = r->tick_hz ? 1e9 / r->tick_hz : 0;
+    long min = 0, mean = 0, max = 0;
+    if (st->steps) {
+        min = (long)(st->min * ns);
+        max = (long)(st->max * ns);
+        mean = (long)((double)st->sum / st->steps * ns);
+    }
+    int n = snprintf(out, out_len,
+                     "{\"seq\":{\"id\":%lu,\"state\":\"%s\",\"steps\":%lu,\"loops\":%lu,"
+                     "\"requested_us\":%llu,\"actual_us\":%llu,"
+                     "\"err_ns\":{\"min\":%ld,\"mean\":%ld,\"max\":%ld},\"late\":%lu}}",
+                     (unsigned long)r->id, r->state, (unsigned long)st->steps, (unsigned long)r->loops,
+                     (unsigned long long)r->requested_us, (unsigned long long)r->actual_us,
+                     min, mean, max, (unsigned long)st->late);
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    return n;
+}
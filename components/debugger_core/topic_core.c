@@ -0,0 +1,164 @@
+#include "topic_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const names[TOPIC_COUNT] = {
+    [TOPIC_PINS] = "PINS", [TOPIC_ADC] = "ADC", [TOPIC_UART] = "UART",
+    [TOPIC_I2C] = "I2C", [TOPIC_WIFI] = "WIFI", [TOPIC_METRICS] = "METRICS",
+};
+
+static const char *const json_names[TOPIC_COUNT] = {
+    [TOPIC_PINS] = "pins", [TOPIC_ADC] = "adc", [TOPIC_UART] = "uart",
+    [TOPIC_I2C] = "i2c", [TOPIC_WIFI] = "wifi", [TOPIC_METRICS] = "metrics",
+};
+
+void topic_init(topic_table_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+bool topic_parse(const char *name, topic_id_t *id) {
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *id = (topic_id_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *topic_name(topic_id_t id) {
+    return (unsigned)id < TOPIC_COUNT ? json_names[id] : "?";
+}
+
+bool topic_parse_gpios(const char *s, uint64_t *gpios) {
+    *gpios = 0;
+    while (*s) {
+        char *end;
+        long pin = strtol(s, &end, 10);
+        if (end == s || pin < 0 || pin > 63 || (*end && *end != '+')) return false;
+        *gpios |= 1ull << pin;
+        s = *end ? end + 1 : end;
+    }
+    return *gpios != 0;
+}
+
+static bool valid(int slot, topic_id_t id) {
+    return slot >= 0 && slot < BCAST_MAX_CLIENTS && (unsigned)id < TOPIC_COUNT;
+}
+
+void topic_subscribe(topic_table_t *t, int slot, topic_id_t id, uint32_t interval_us, uint64_t gpios) {
+    if (!valid(slot, id)) return;
+    t->subs[id][slot] = (topic_sub_t){ .interval_us = interval_us, .gpios = gpios };
+    t->subscribed[id] |= 1u << slot;
+}
+
+void topic_unsubscribe(topic_table_t *t, int slot, topic_id_t id) {
+    if (!valid(slot, id)) return;
+    t->subscribed[id] &= ~(1u << slot);
+    t->subs[id][slot] = (topic_sub_t){ 0 };
+}
+
+void topic_drop_client(topic_table_t *t, int slot) {
+    for (int i = 0; i < TOPIC_COUNT; i++) topic_unsubscribe(t, slot, (topic_id_t)i);
+}
+
+uint32_t topic_subscribers(const topic_table_t *t, topic_id_t id, uint64_t gpios) {
+    if ((unsigned)id >= TOPIC_COUNT) return 0;
+    uint32_t mask = 0;
+    for (uint32_t m = t->subscribed[id]; m; m &= m - 1) {
+        int slot = __builtin_ctz(m);
+        const topic_sub_t *s = &t->subs[id][slot];
+        if (!s->gpios || !gpios || (s->gpios & gpios)) mask |= 1u << slot;
+    }
+    return mask;
+}
+
+// Publishers run on timers of their own, so an update may come a little
+// early; an eighth of the interval is let through. Deliveries are then
+// booked on the subscriber's own schedule, which keeps the average at or
+// under its rate.
+static bool elapsed(const topic_sub_t *s, uint32_t now_us) {
+    return !s->sent || now_us - s->last_us >= s->interval_us - s->interval_us / 8;
+}
+
+static void stamp(topic_sub_t *s, uint32_t now_us) {
+    bool on_schedule = s->sent && now_us - s->last_us < 2 * s->interval_us;
+    s->last_us = on_schedule ? s->last_us + s->interval_us : now_us;
+    s->sent = true;
+    s->pending = false;
+}
+
+uint32_t topic_due(topic_table_t *t, topic_id_t id, uint64_t gpios, uint32_t now_us) {
+    uint32_t mask = 0;
+    for (uint32_t m = topic_subscribers(t, id, gpios); m; m &= m - 1) {
+        int slot = __builtin_ctz(m);
+        topic_sub_t *s = &t->subs[id][slot];
+        if (elapsed(s, now_us)) {
+            stamp(s, now_us);
+            mask |= 1u << slot;
+        } else {
+            s->pending = true;
+            t->held[id]++;
+        }
+    }
+    if (mask) t->published[id]++;
+    return mask;
+}
+
+uint32_t topic_due_pending(topic_table_t *t, topic_id_t id, uint32_t now_us) {
+    if ((unsigned)id >= TOPIC_COUNT) return 0;
+    uint32_t mask = 0;
+    for (uint32_t m = t->subscribed[id]; m; m &= m - 1) {
+        int slot = __builtin_ctz(m);
+        topic_sub_t *s = &t->subs[id][slot];
+        if (s->pending && elapsed(s, now_us)) {
+            stamp(s, now_us);
+            mask |= 1u << slot;
+        }
+    }
+    return mask;
+}
+
+uint32_t topic_min_interval(const topic_table_t *t, topic_id_t id) {
+    if ((unsigned)id >= TOPIC_COUNT) return 0;
+    uint32_t min = 0;
+    for (uint32_t m = t->subscribed[id]; m; m &= m - 1) {
+        uint32_t iv = t->subs[id][__builtin_ctz(m)].interval_us;
+        if (iv && (!min || iv < min)) min = iv;
+    }
+    return min;
+}
+
+size_t topic_to_json(const topic_table_t *t, int slot, char *out, size_t out_len) {
+    if (slot < 0 || slot >= BCAST_MAX_CLIENTS) return 0;
+    int n = snprintf(out, out_len, "{\"subs\":[");
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    size_t pos = n;
+
+    bool first = true;
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        if (!(t->subscribed[i] & (1u << slot))) continue;
+        const topic_sub_t *s = &t->subs[i][slot];
+        unsigned hz = s->interval_us ? (1000000u + s->interval_us / 2) / s->interval_us : 0;
+        n = snprintf(out + pos, out_len - pos, "%s{\"topic\":\"%s\",\"max_hz\":%u,\"gpios\":[",
+                     first ? "" : ",", json_names[i], hz);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+        bool first_gpio = true;
+        for (uint64_t g = s->gpios; g; g &= g - 1) {
+            n = snprintf(out + pos, out_len - pos, "%s%d", first_gpio ? "" : ",", __builtin_ctzll(g));
+            if (n < 0 || (size_t)n >= out_len - pos) return 0;
+            pos += n;
+            first_gpio = false;
+        }
+        n = snprintf(out + pos, out_len - pos, "]}");
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+        first = false;
+    }
+    n = snprintf(out + pos, out_len - pos, "]}");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
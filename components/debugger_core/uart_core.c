@@ -0,0 +1,60 @@
+#include "uart_core.h"
+#include "dbg_wire.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool uart_line_parse(const char *s, uart_line_t *line) {
+    char *end;
+    unsigned long baud = strtoul(s, &end, 10);
+    if (end == s || baud < 300 || baud > 5000000) return false;
+
+    uart_line_t out = *line;
+    out.baud = baud;
+    if (*end == ',') {
+        const char *f = end + 1;
+        if (f[0] < '5' || f[0] > '8') return false;
+        if (f[1] != 'N' && f[1] != 'E' && f[1] != 'O') return false;
+        if (f[2] != '1' && f[2] != '2') return false;
+        if (f[3] != '\0') return false;
+        out.data_bits = f[0] - '0';
+        out.parity = f[1];
+        out.stop_bits = f[2] - '0';
+    } else if (*end != '\0') {
+        return false;
+    }
+    *line = out;
+    return true;
+}
+
+size_t uart_line_format(const uart_line_t *line, char *out, size_t out_len) {
+    int n = snprintf(out, out_len, "%lu,%u%c%u", (unsigned long)line->baud,
+                     line->data_bits, line->parity, line->stop_bits);
+    return (n < 0 || (size_t)n >= out_len) ? 0 : n;
+}
+
+void uart_framer_init(uart_framer_t *f, uint8_t port) {
+    memset(f, 0, sizeof(*f));
+    f->port = port;
+}
+
+// 0 type, 1 port, 2 flags, 3 reserved, 4 seq u32, 8 offset u32 (byte count
+// before this batch, so gaps are visible), 12 time ms u32, 16 len u16, 18 data
+size_t uart_framer_finish(uart_framer_t *f, uint32_t t_ms) {
+    uint8_t *h = f->frame;
+    h[0] = WIRE_UART_RX;
+    h[1] = f->port;
+    h[2] = f->flags;
+    h[3] = 0;
+    wire_put_u32(h + 4, f->seq++);
+    wire_put_u32(h + 8, f->offset);
+    wire_put_u32(h + 12, t_ms);
+    wire_put_u16(h + 16, f->len);
+
+    size_t len = UART_HDR_LEN + f->len;
+    f->offset += f->len;
+    f->len = 0;
+    f->flags = 0;
+    return len;
+}
@@ -0,0 +1,266 @@
+// Correctness checks for capture_core.
+//
+// capture_check
+// Feeds synthetic steps, ramps and jittery levels through the capture
+// engine in chunks of several sizes and checks every block it frames: the
+// trigger index, the pre-trigger depth, block boundaries across ring wrap,
+// seq numbers, holdoff, single-shot re-arming, the hysteresis that keeps
+// noise on the level from re-triggering, and the reset after a pin switch.
+// Exits non-zero if any check fails.
+#include "capture_core.h"
+#include "dbg_wire.h"
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BLOCKS  64
+#define LOW         100
+#define HIGH        3000
+#define LEVEL       2000
+
+typedef uint16_t (*gen_fn)(uint32_t i);
+
+typedef struct {
+    uint32_t seq, start;
+    uint16_t len, pre;
+    uint8_t flags, mode;
+} block_t;
+
+typedef struct {
+    gen_fn gen;
+    block_t blocks[MAX_BLOCKS];
+    size_t n;
+    int bad_samples;
+} run_t;
+
+static cap_engine_t eng;
+
+// Parses the header and compares every sample with the generator at its
+// absolute index, which is what catches ring wrap and framing mistakes
+static void on_block(const uint8_t *f, size_t len, void *ctx) {
+    run_t *r = ctx;
+    block_t b = {
+        .seq = wire_get_u32(f + 4), .start = wire_get_u32(f + 12),
+        .len = wire_get_u16(f + 16), .pre = wire_get_u16(f + 18),
+        .flags = f[2], .mode = f[3],
+    };
+    if (f[0] != WIRE_ADC_BLOCK || len != CAP_HDR_LEN + (size_t)b.len * 2) r->bad_samples++;
+    for (uint16_t j = 0; j < b.len && len >= CAP_HDR_LEN + (size_t)b.len * 2; j++) {
+        if (wire_get_u16(f + CAP_HDR_LEN + 2 * j) != r->gen(b.start + j)) r->bad_samples++;
+    }
+    if (r->n < MAX_BLOCKS) r->blocks[r->n++] = b;
+}
+
+static void run(const cap_config_t *cfg, gen_fn gen, uint32_t total, uint32_t chunk, run_t *r) {
+    static uint16_t buf[CAP_RING_LEN];
+    memset(r, 0, sizeof(*r));
+    r->gen = gen;
+    cap_engine_init(&eng, cfg);
+    for (uint32_t i = 0; i < total; i += chunk) {
+        uint32_t n = total - i < chunk ? total - i : chunk;
+        for (uint32_t k = 0; k < n; k++) buf[k] = gen(i + k);
+        cap_engine_push(&eng, buf, n, on_block, r);
+    }
+}
+
+// Low, with a short rising edge at 50 that comes before a full pre-trigger
+// window exists, then high from 4146 on so the block wraps the ring. Each
+// sample carries its index mod 50, so misplaced samples show.
+static uint16_t gen_step(uint32_t i) {
+    bool high = (i >= 50 && i < 60) || i >= 4146;
+    return (uint16_t)((high ? HIGH : LOW) + i % 50);
+}
+
+// Sawtooth 0..4092 in steps of 4, period 1024
+static uint16_t gen_ramp(uint32_t i) {
+    return (uint16_t)((i % 1024) * 4);
+}
+
+// Below the level until 200, then +-10 codes around it until 3000, a dip
+// well below at 3000..3099 and high after: one rising edge at 200 and one
+// at 3100, whatever the jitter does in between
+static uint16_t gen_jitter(uint32_t i) {
+    if (i < 200) return LEVEL - 100;
+    if (i < 3000) return (uint16_t)(i % 2 ? LEVEL - 10 : LEVEL + 10);
+    if (i < 3100) return LEVEL - 100;
+    return LEVEL + 100;
+}
+
+static uint16_t gen_index(uint32_t i) {
+    return (uint16_t)(i & 0xFFF);
+}
+
+// What another pin reads: nowhere near gen_index at the same index
+static uint16_t gen_other(uint32_t i) {
+    return (uint16_t)(HIGH + i % 50);
+}
+
+static void check_common(const run_t *r, const char *name) {
+    char what[64];
+    snprintf(what, sizeof(what), "%s: samples match source", name);
+    eq(r->bad_samples, 0, what);
+    bool seq_ok = true;
+    for (size_t b = 0; b < r->n; b++) seq_ok &= r->blocks[b].seq == b;
+    snprintf(what, sizeof(what), "%s: seq 0..n-1", name);
+    check(seq_ok, what, (long)r->n, (long)r->n);
+}
+
+static void check_step(uint32_t chunk) {
+    cap_config_t cfg = {
+        .block_len = 256, .pre_trigger = 100, .trig_mode = CAP_TRIG_RISING,
+        .trig_level = LEVEL, .hysteresis = 50, .channel = 6,
+    };
+    run_t r;
+    run(&cfg, gen_step, 6000, chunk, &r);
+    printf("step, rising, chunks of %u\n", chunk);
+    check_common(&r, "step");
+    eq((long)r.n, 1, "blocks");
+    if (r.n < 1) return;
+    const block_t *b = &r.blocks[0];
+    // The edge at 50 has no 100 samples before it and is skipped
+    eq(b->start + b->pre, 4146, "trigger index");
+    eq(b->pre, 100, "pre-trigger depth");
+    eq(b->start, 4046, "block start (wraps the ring)");
+    eq(b->len, 256, "block length");
+    eq(b->flags, CAP_FLAG_TRIGGERED, "flags");
+    eq(b->mode, CAP_TRIG_RISING, "mode");
+    eq(eng.triggers, 1, "trigger count");
+}
+
+static void check_ramp(void) {
+    cap_config_t cfg = {
+        .block_len = 128, .pre_trigger = 32, .trig_mode = CAP_TRIG_RISING,
+        .trig_level = LEVEL, .hysteresis = 100, .holdoff = 200,
+    };
+    run_t r;
+    run(&cfg, gen_ramp, 4096, 333, &r);
+    printf("ramp, rising at %d, holdoff 200\n", LEVEL);
+    check_common(&r, "ramp");
+    // Primed low by each wrap to 0, the ramp reaches 2000 at 500 in every period
+    eq((long)r.n, 4, "blocks");
+    for (size_t k = 0; k < r.n; k++) {
+        char what[48];
+        snprintf(what, sizeof(what), "block %zu trigger index", k);
+        eq(r.blocks[k].start + r.blocks[k].pre, (long)(k * 1024 + 500), what);
+    }
+
+    // Falling: the sawtooth drops through the level once per period, from
+    // 4092 to 0, at 1024 * k
+    cfg.trig_mode = CAP_TRIG_FALLING;
+    cfg.holdoff = 0;
+    run(&cfg, gen_ramp, 4096, 64, &r);
+    printf("ramp, falling\n");
+    check_common(&r, "falling");
+    eq((long)r.n, 3, "blocks");
+    if (r.n) eq(r.blocks[0].start + r.blocks[0].pre, 1024, "first trigger index");
+
+    // Level: ABOVE fires on the first sample at or over the level once armed
+    cfg.trig_mode = CAP_TRIG_ABOVE;
+    run(&cfg, gen_ramp, 1024, 1024, &r);
+    printf("ramp, above\n");
+    if (r.n) eq(r.blocks[0].start + r.blocks[0].pre, 500, "trigger index");
+    else eq(0, 1, "blocks");
+}
+
+static void check_hysteresis(void) {
+    cap_config_t cfg = {
+        .block_len = 64, .pre_trigger = 16, .trig_mode = CAP_TRIG_RISING,
+        .trig_level = LEVEL, .hysteresis = 50,
+    };
+    run_t r;
+    run(&cfg, gen_jitter, 4000, 100, &r);
+    printf("+-10 codes of jitter on the level, hysteresis 50\n");
+    check_common(&r, "jitter");
+    eq((long)r.n, 2, "blocks");
+    if (r.n == 2) {
+        eq(r.blocks[0].start + r.blocks[0].pre, 200, "first trigger index");
+        eq(r.blocks[1].start + r.blocks[1].pre, 3100, "second trigger index");
+    }
+
+    // Without hysteresis the jitter crosses back every other sample
+    cfg.hysteresis = 0;
+    run(&cfg, gen_jitter, 4000, 100, &r);
+    printf("same, hysteresis 0\n");
+    check(r.n > 10, "blocks (retriggers on jitter)", (long)r.n, 11);
+}
+
+static void check_free_run(uint32_t chunk) {
+    cap_config_t cfg = { .block_len = 100, .trig_mode = CAP_TRIG_NONE, .holdoff = 50 };
+    run_t r;
+    run(&cfg, gen_index, 5000, chunk, &r);
+    printf("free running, block 100, holdoff 50, chunks of %u\n", chunk);
+    check_common(&r, "free run");
+    eq((long)r.n, 33, "blocks");
+    bool starts_ok = true;
+    for (size_t k = 0; k < r.n; k++) {
+        starts_ok &= r.blocks[k].start == k * 150 && r.blocks[k].len == 100 &&
+                     r.blocks[k].pre == CAP_NO_TRIGGER && r.blocks[k].flags == 0;
+    }
+    check(starts_ok, "blocks every 150 samples, untriggered", (long)starts_ok, 1);
+}
+
+// A pin or rate switch re-configures the engine mid-stream; the first block
+// after it must not carry samples of the previous source
+static void check_restart(bool reset) {
+    cap_config_t cfg = { .block_len = 256, .pre_trigger = 128, .trig_mode = CAP_TRIG_NONE, .channel = 6 };
+    run_t r;
+    run(&cfg, gen_index, 1000, 1000, &r);
+    uint32_t base = eng.head;
+    memset(&r, 0, sizeof(r));
+    r.gen = gen_other;
+    cfg.channel = 7;
+    cap_engine_configure(&eng, &cfg);
+    if (reset) {
+        cap_engine_reset(&eng);
+        base = 0;
+    }
+    uint16_t buf[600];
+    for (uint32_t k = 0; k < 600; k++) buf[k] = gen_other(base + k);
+    cap_engine_push(&eng, buf, 600, on_block, &r);
+    if (reset) {
+        printf("pin switch, engine reset\n");
+        eq(r.bad_samples, 0, "samples all from the new pin");
+        check(r.n > 0, "blocks", (long)r.n, 1);
+        if (r.n) eq(r.blocks[0].start, 0, "first block start");
+    } else {
+        printf("pin switch, ring kept\n");
+        check(r.bad_samples > 0, "stale samples in the first block", r.bad_samples, 1);
+    }
+}
+
+static void check_single(void) {
+    cap_config_t cfg = {
+        .block_len = 64, .pre_trigger = 8, .trig_mode = CAP_TRIG_RISING,
+        .trig_level = LEVEL, .hysteresis = 100, .single = true,
+    };
+    run_t r;
+    run(&cfg, gen_ramp, 4096, 4096, &r);
+    printf("single shot\n");
+    eq((long)r.n, 1, "blocks before re-arm");
+    if (r.n) eq(r.blocks[0].flags, CAP_FLAG_TRIGGERED | CAP_FLAG_SINGLE, "flags");
+
+    uint16_t buf[1024];
+    for (uint32_t k = 0; k < 1024; k++) buf[k] = gen_ramp(4096 + k);
+    cap_engine_rearm(&eng);
+    cap_engine_push(&eng, buf, 1024, on_block, &r);
+    eq((long)r.n, 2, "blocks after re-arm");
+    if (r.n == 2) eq(r.blocks[1].start + r.blocks[1].pre, 4096 + 500, "trigger index after re-arm");
+    eq(r.bad_samples, 0, "samples match source");
+}
+
+int main(void) {
+    check_step(1);
+    check_step(7);
+    check_step(4096);
+    check_ramp();
+    check_hysteresis();
+    check_free_run(1);
+    check_free_run(97);
+    check_single();
+    check_restart(false);
+    check_restart(true);
+
+    return check_exit("capture_check");
+}
@@ -0,0 +1,33 @@
+// Pass/fail reporting shared by the host check tools: one line per check
+// with the value seen and the value wanted, and a failure count that
+// check_exit() turns into the exit status.
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+static int check_failures;
+
+static inline void check(bool ok, const char *what, double got, double want) {
+    printf("  %-36s %12.6g  (want %.6g)  %s\n", what, got, want, ok ? "ok" : "FAIL");
+    if (!ok) check_failures++;
+}
+
+static inline void eq(double got, double want, const char *what) {
+    check(got == want, what, got, want);
+}
+
+static inline void near(double got, double want, double tol, const char *what) {
+    check(fabs(got - want) <= tol, what, got, want);
+}
+
+// What main returns: 1 after any failed check, with a summary on stderr
+static inline int check_exit(const char *tool) {
+    if (check_failures) {
+        fprintf(stderr, "%s: %d checks failed\n", tool, check_failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
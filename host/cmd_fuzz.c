@@ -0,0 +1,204 @@
+// Fuzz and benchmark harness for cmd_core.
+//
+// Standalone: cmd_fuzz [iterations] [seed] mutates a corpus of valid
+// batches, checks parser invariants and how numbers are read, then times
+// parsing of a 16-pin batch.
+// With -DDEBUGGER_LIBFUZZER=ON (clang) it is a libFuzzer target instead.
+#include "cmd_core.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int run_nop(const cmd_t *cmd, void *ctx, const char **err) {
+    return 0;
+}
+
+static int check_word(const cmd_t *cmd, void *ctx, const char **err) {
+    if (strcmp(cmd->sval[1], "INPUT") == 0 || strcmp(cmd->sval[1], "OUTPUT") == 0) return 0;
+    *err = "bad mode";
+    return -1;
+}
+
+#define ARG_INT(lo, hi) { CMD_ARG_INT, (lo), (hi) }
+#define ARG_WORD        { CMD_ARG_WORD, 0, 0 }
+#define ARG_REST        { CMD_ARG_REST, 0, 0 }
+
+// Same shapes as the firmware table in main.c
+static const cmd_def_t defs[] = {
+    { "ACK",        1, 1, { ARG_INT(0, INT32_MAX) },                        NULL,       run_nop },
+    { "ADC_ARM",    0, 0, { { 0 } },                                        NULL,       run_nop },
+    { "ADC_RATE",   2, 1, { ARG_INT(1, 2000000), ARG_INT(0, 1024) },        NULL,       run_nop },
+    { "ADC_TRIG",   4, 3, { ARG_WORD, ARG_INT(0, 4095), ARG_INT(0, 1024), ARG_WORD }, NULL, run_nop },
+    { "I2C_TXN",    1, 1, { ARG_REST },                                     NULL,       run_nop },
+    { "MODE",       2, 2, { ARG_INT(0, 39), ARG_WORD },                     check_word, run_nop },
+    { "PWM",        2, 2, { ARG_INT(0, 39), ARG_INT(1, 40000000) },         NULL,       run_nop },
+    { "UART_SEND",  1, 1, { ARG_REST },                                     NULL,       run_nop },
+    { "WRITE",      2, 2, { ARG_INT(0, 39), ARG_INT(0, 1) },                NULL,       run_nop },
+};
+
+static cmd_table_t table;
+static cmd_batch_t batch;
+static char buf[CMD_BUF_LEN];
+
+static void check_invariants(bool ok) {
+    if (ok != (batch.error_line == 0) || (!ok && !batch.error) || batch.n > CMD_MAX_BATCH) abort();
+    for (size_t i = 0; i < batch.n; i++) {
+        const cmd_t *c = &batch.cmds[i];
+        if (c->argc < c->def->n_required || c->argc > c->def->n_args) abort();
+        for (int a = 0; a < c->argc; a++) {
+            const cmd_arg_spec_t *spec = &c->def->args[a];
+            if (!c->sval[a] || c->sval[a] < buf || c->sval[a] >= buf + sizeof(buf)) abort();
+            if (spec->type == CMD_ARG_INT && (c->ival[a] < spec->min || c->ival[a] > spec->max)) abort();
+            if (spec->type != CMD_ARG_REST && strchr(c->sval[a], ',')) abort();
+        }
+    }
+}
+
+static void fuzz_one(const uint8_t *data, size_t len) {
+    if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+    memcpy(buf, data, len);
+    bool ok = cmd_parse_batch(&table, buf, len, NULL, &batch);
+    check_invariants(ok);
+    if (ok) cmd_run_batch(&batch, NULL, NULL);
+
+    // The unescaper must never grow its input
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+    size_t before = strlen(buf);
+    if (cmd_unescape(buf) > before) abort();
+}
+
+#ifdef CMD_FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len) {
+    if (!table.defs && !cmd_table_init(&table, defs, sizeof(defs) / sizeof(defs[0]))) abort();
+    fuzz_one(data, len);
+    return 0;
+}
+
+#else
+
+static const char *const corpus[] = {
+    "WRITE:2,1",
+    "MODE:4,OUTPUT\nWRITE:4,1\nPWM:5,1000",
+    "ADC_RATE:20000,512\nADC_TRIG:RISING,2048,128,SINGLE",
+    "ACK:42\r\nADC_ARM\r\n",
+    "UART_SEND:AT\\r\\n,with,commas",
+    "I2C_TXN:0x68;W:0x6B,0;R:0x3B,14",
+    "MODE:99,OUTPUT",
+    "WRITE:2",
+    "\n\n\nADC_ARM:\n",
+};
+
+static const char tokens[] = ",:\n\r;\\x0-9AZ";
+
+static uint32_t rng_state;
+
+static uint32_t rnd(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static size_t mutate(uint8_t *out, size_t cap) {
+    const char *seed = corpus[rnd() % (sizeof(corpus) / sizeof(corpus[0]))];
+    size_t len = strlen(seed);
+    memcpy(out, seed, len);
+
+    int edits = 1 + rnd() % 8;
+    for (int e = 0; e < edits; e++) {
+        size_t pos = len ? rnd() % len : 0;
+        switch (rnd() % 5) {
+        case 0: if (len) out[pos] = (uint8_t)rnd(); break;                       // random byte
+        case 1: if (len) out[pos] = tokens[rnd() % (sizeof(tokens) - 1)]; break; // separator
+        case 2: if (len) len = pos; break;                                       // truncate
+        case 3:                                                                  // append another seed
+            for (const char *s = corpus[rnd() % (sizeof(corpus) / sizeof(corpus[0]))]; *s && len + 1 < cap; s++) {
+                out[len++] = *s;
+            }
+            if (len < cap) out[len++] = '\n';
+            break;
+        case 4:                                                                  // long digit run
+            while (len < cap && rnd() % 16) out[len++] = '0' + rnd() % 10;
+            break;
+        }
+    }
+    return len;
+}
+
+// Numbers are decimal whatever their leading zeros, hex only with 0x
+static void check_numbers(void) {
+    static const struct {
+        const char *line;
+        int arg;
+        int32_t value;
+    } cases[] = {
+        { "PWM:4,010", 1, 10 }, { "WRITE:09,1", 0, 9 }, { "PWM:4,0x10", 1, 16 }, { "PWM:4,0X1f", 1, 31 },
+        { "ACK:007", 0, 7 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t len = strlen(cases[i].line);
+        memcpy(buf, cases[i].line, len);
+        bool ok = cmd_parse_batch(&table, buf, len, NULL, &batch) && batch.n == 1;
+        int32_t got = ok ? batch.cmds[0].ival[cases[i].arg] : -1;
+        if (got != cases[i].value) {
+            fprintf(stderr, "cmd_fuzz: '%s' read as %d, want %d\n", cases[i].line, (int)got, (int)cases[i].value);
+            abort();
+        }
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(void) {
+    // The scripted test bench case: 16 pins set in one frame
+    char frame[CMD_BUF_LEN];
+    size_t len = 0;
+    for (int i = 0; i < 16; i++) len += snprintf(frame + len, sizeof(frame) - len, "WRITE:%d,%d\n", i + 12, i & 1);
+
+    const int rounds = 200000;
+    double t0 = now_s();
+    for (int r = 0; r < rounds; r++) {
+        memcpy(buf, frame, len);
+        if (!cmd_parse_batch(&table, buf, len, NULL, &batch) || batch.n != 16) abort();
+        cmd_run_batch(&batch, NULL, NULL);
+    }
+    double dt = now_s() - t0;
+    printf("bench: %d frames x 16 commands in %.3f s, %.0f ns/frame, %.2f M commands/s\n",
+           rounds, dt, dt * 1e9 / rounds, rounds * 16 / dt / 1e6);
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+    rng_state = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0x9E3779B9u;
+    if (!rng_state) rng_state = 1;
+
+    if (!cmd_table_init(&table, defs, sizeof(defs) / sizeof(defs[0]))) {
+        fprintf(stderr, "table not sorted\n");
+        return 1;
+    }
+
+    check_numbers();
+
+    static uint8_t input[CMD_BUF_LEN];
+    long accepted = 0;
+    for (long i = 0; i < iterations; i++) {
+        size_t len = mutate(input, sizeof(input) - 1);
+        fuzz_one(input, len);
+        accepted += batch.error_line == 0;
+    }
+    printf("fuzz: %ld inputs, %ld accepted, no invariant violations\n", iterations, accepted);
+
+    bench();
+    return 0;
+}
+
+#endif
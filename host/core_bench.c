@@ -0,0 +1,483 @@
+// Benchmarks for the debugger_core hot paths on the host.
+//
+//   core_bench [--json] [--filter <substring>] [--time <ms per case>]
+//
+// Each case reports ns/op, ops/s and heap calls/bytes per op. Allocations
+// are counted by wrapping malloc/free at link time, so only calls made from
+// core_bench and debugger_core are seen. --json prints one object per line
+// for CI to diff against a stored baseline.
+#include "bcast_core.h"
+#include "capture_core.h"
+#include "cmd_core.h"
+#include "dsp_core.h"
+#include "edge_core.h"
+#include "i2c_core.h"
+#include "logic_core.h"
+#include "metrics_core.h"
+#include "pin_proto.h"
+#include "pin_store.h"
+#include "pwm_core.h"
+#include "rec_core.h"
+#include "scan_core.h"
+#include "seq_core.h"
+#include "topic_core.h"
+#include "uart_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// --- allocation counting ---
+
+static size_t allocs, alloc_bytes;
+
+#ifdef CORE_BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+void *__wrap_malloc(size_t size) {
+    allocs++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    alloc_bytes += n * size;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    allocs++;
+    alloc_bytes += size;
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void *p) {
+    __real_free(p);
+}
+#endif
+
+// --- fixtures, the same shapes as the firmware ---
+
+static const int gpio_nums[] = {
+    0, 2, 4, 5, 12, 13, 14, 15, 16, 17, 18, 19,
+    21, 22, 23, 25, 26, 27, 32, 33, 34, 35, 36, 39
+};
+#define NUM_PINS (sizeof(gpio_nums) / sizeof(gpio_nums[0]))
+
+static pin_proto_state_t pins;
+static pin_store_t store;
+static pin_snapshot_t snapshot;
+static pin_proto_state_t store_model;
+static edge_stats_t edges;
+static edge_ring_t ring;
+static bcast_t bc;
+static cap_engine_t cap;
+static uart_framer_t framer;
+static lat_hist_t hist;
+static cmd_table_t table;
+static cmd_batch_t batch;
+static topic_table_t topics;
+
+static uint8_t out_bin[4096];
+static char out_text[4096];
+static char cmd_buf[CMD_BUF_LEN];
+static char cmd_frame[CMD_BUF_LEN];
+static size_t cmd_frame_len;
+static uint16_t adc_samples[1024];
+static uint8_t la_samples[4096];
+static la_run_t la_runs[4096];
+static uint32_t la_syms[4][64];
+static la_segment_t la_segs[4];
+static la_rmt_chan_t la_chans[4];
+static char seq_text[1024];
+static seq_step_t seq_steps[SEQ_MAX_STEPS];
+static scan_engine_t scan;
+static dsp_fft_t fft;
+static dsp_result_t analysis;
+static float fft_input[2 * 1024];
+static uint16_t scan_lut[SCAN_LUT_LEN];
+static uint8_t scan_chans[4096];
+static uint16_t scan_raw[4096];
+static uint8_t rec_buf[REC_CHUNK_MAX];
+static uint32_t fake_us;
+static volatile size_t sink;    // keeps results alive
+
+static int run_nop(const cmd_t *cmd, void *ctx, const char **err) {
+    return 0;
+}
+
+#define ARG_INT(lo, hi) { CMD_ARG_INT, (lo), (hi) }
+#define ARG_WORD        { CMD_ARG_WORD, 0, 0 }
+
+static const cmd_def_t defs[] = {
+    { "MODE",  2, 2, { ARG_INT(0, 39), ARG_WORD },           NULL, run_nop },
+    { "PWM",   2, 2, { ARG_INT(0, 39), ARG_INT(1, 40000000) }, NULL, run_nop },
+    { "WRITE", 2, 2, { ARG_INT(0, 39), ARG_INT(0, 1) },      NULL, run_nop },
+};
+
+static void setup(void) {
+    pin_proto_init(&pins, gpio_nums, NUM_PINS);
+    pin_store_init(&store, NUM_PINS);
+    pin_proto_init(&store_model, gpio_nums, NUM_PINS);
+    pin_store_write_begin(&store);
+    for (size_t i = 0; i < NUM_PINS; i++) {
+        pin_state_t p = { .level = i & 1, .output = i & 2, .pwm_hz = i & 4 ? 1000 : 0, .bounces = (uint32_t)i * 7 };
+        pin_store_set(&store, i, &p);
+    }
+    pin_store_write_end(&store);
+    pin_store_read(&store, &snapshot, 1);
+    pin_proto_load(&pins, &snapshot);
+
+    edge_ring_init(&ring);
+    edge_stats_init(&edges, NUM_PINS, 5000, 0);
+    for (size_t i = 0; i < NUM_PINS; i++) {
+        edge_event_t ev = { .t_us = 1000 * (uint32_t)i, .pin = (uint8_t)i, .level = 1 };
+        edge_stats_apply(&edges, &ev);
+    }
+
+    bcast_init(&bc, 32, 3000000, 1 << 20);
+
+    // A full house on the ADC topic: half rate limited, half filtered on one pin
+    topic_init(&topics);
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        topic_subscribe(&topics, i, TOPIC_ADC, (i & 1) * 100000, (i & 2) ? 1ull << 34 : 0);
+    }
+
+    cap_config_t cfg = {
+        .sample_rate = 20000, .block_len = 512, .pre_trigger = 128,
+        .trig_mode = CAP_TRIG_RISING, .trig_level = 2048, .hysteresis = 40,
+    };
+    cap_engine_init(&cap, &cfg);
+    // Triangle wave, period 200 samples, crossing the trigger level twice per period
+    for (size_t i = 0; i < 1024; i++) {
+        int phase = i % 200;
+        adc_samples[i] = (uint16_t)(248 + 36 * (phase < 100 ? phase : 200 - phase));
+    }
+
+    // Four interleaved channels, 1024 samples each fill one frame of 128 points
+    scan_lut_linear(scan_lut, 3300);
+    scan_config_t scfg = { .channels = 4, .adc_channel = { 6, 7, 0, 3 }, .gpio = { 34, 35, 36, 39 },
+                           .rate = 500000, .points = 128, .per_point = 8 };
+    if (!scan_config_valid(&scfg)) abort();
+    scan_engine_init(&scan, &scfg, scan_lut);
+    for (size_t i = 0; i < 4096; i++) {
+        scan_chans[i] = scfg.adc_channel[i & 3];
+        scan_raw[i] = adc_samples[i / 4];
+    }
+
+    if (!dsp_fft_init(&fft, 1024)) abort();
+    for (size_t i = 0; i < 1024; i++) fft_input[2 * i] = adc_samples[i] - 2048.0f;
+
+    // SPI-like pattern: ch0 clock every 4 samples, ch1 data, ch2 select
+    for (size_t i = 0; i < 4096; i++) {
+        la_samples[i] = (uint8_t)(((i >> 2) & 1) | (((i * 7) >> 5) & 2) | (i >= 2048 ? 4 : 0));
+    }
+    // Four channels, one segment of 128 alternating half-symbols each
+    for (int ch = 0; ch < 4; ch++) {
+        for (int k = 0; k < 64; k++) {
+            uint32_t d = 3 + ch + (k & 3);
+            la_syms[ch][k] = d | 1u << 15 | d << 16;
+        }
+        la_syms[ch][63] &= 0x0000FFFF;  // end marker in the last half
+        la_segs[ch] = (la_segment_t){ .start = (uint64_t)ch, .first = 0, .count = 64 };
+        la_chans[ch] = (la_rmt_chan_t){ .symbols = la_syms[ch], .segs = &la_segs[ch], .num_segs = 1 };
+    }
+
+    // 64 steps of a 4-pin counter, 10 us each
+    size_t pos = 0;
+    for (int i = 0; i < 64; i++) {
+        pos += snprintf(seq_text + pos, sizeof(seq_text) - pos, "%s%d%d%d%d@10", i ? ";" : "",
+                        i & 1, i >> 1 & 1, i >> 2 & 1, i >> 3 & 1);
+    }
+    if (seq_parse(seq_text, 4, seq_steps, SEQ_MAX_STEPS) != 64) abort();
+
+    uart_framer_init(&framer, 1);
+    lat_hist_init(&hist, "bench_seconds", "bench", "Bench histogram");
+
+    if (!cmd_table_init(&table, defs, sizeof(defs) / sizeof(defs[0]))) abort();
+    for (int i = 0; i < 16; i++) {
+        cmd_frame_len += snprintf(cmd_frame + cmd_frame_len, sizeof(cmd_frame) - cmd_frame_len,
+                                  "WRITE:%d,%d\n", gpio_nums[i], i & 1);
+    }
+}
+
+// --- cases: each runs one operation ---
+
+static void bench_pin_snapshot_bin(void) {
+    sink = pin_proto_encode(&pins, 0, out_bin, sizeof(out_bin));
+}
+
+// One pin toggles in the store; the sender reads the store back, as the
+// firmware does, and a client one version behind gets the delta
+static void bench_pin_delta_bin(void) {
+    pin_state_t p;
+    pin_store_write_begin(&store);
+    pin_store_peek(&store, 0, &p);
+    p.level = !p.level;
+    pin_store_set(&store, 0, &p);
+    pin_store_write_end(&store);
+    pin_store_read(&store, &snapshot, 1);
+    pin_proto_load(&pins, &snapshot);
+    sink = pin_proto_encode(&pins, pins.version - 1, out_bin, sizeof(out_bin));
+}
+
+// Uncontended seqlock read of every pin, then the model the encoders use
+static void bench_pin_store_read(void) {
+    pin_store_read(&store, &snapshot, 1);
+    pin_proto_load(&store_model, &snapshot);
+    sink = store_model.version;
+}
+
+// One edge batch touching every pin
+static void bench_pin_store_write(void) {
+    pin_store_write_begin(&store);
+    for (size_t i = 0; i < NUM_PINS; i++) {
+        pin_state_t p;
+        pin_store_peek(&store, i, &p);
+        p.bounces++;
+        p.level = !p.level;
+        pin_store_set(&store, i, &p);
+    }
+    pin_store_write_end(&store);
+}
+
+static void bench_pin_snapshot_json(void) {
+    sink = pin_proto_to_json(&pins, out_text, sizeof(out_text));
+}
+
+static void bench_edge_stats_json(void) {
+    edges.active = (1u << NUM_PINS) - 1;
+    sink = edge_stats_to_json(&edges, gpio_nums, 0, 100000, out_text, sizeof(out_text));
+}
+
+static void bench_edge_drain_256(void) {
+    for (int i = 0; i < 256; i++) {
+        edge_event_t ev = { .t_us = fake_us += 137, .pin = (uint8_t)(i % NUM_PINS), .level = (uint8_t)(i & 1) };
+        edge_ring_push(&ring, &ev);
+    }
+    sink = edge_stats_drain(&edges, &ring, 256);
+}
+
+static void fanout(int clients) {
+    static const uint8_t payload[512];
+    for (int i = 0; i < clients; i++) bcast_add_client(&bc, 100 + i);
+
+    bcast_msg_t *msg = bcast_msg_new(&bc, payload, sizeof(payload), false, BCAST_KEY_NONE);
+    if (!msg) abort();
+    bcast_publish(&bc, msg, BCAST_ALL, fake_us);
+    bcast_msg_unref(msg);
+
+    uint32_t t;
+    for (int i = 0; i < clients; i++) {
+        bcast_msg_t *m = bcast_pop(&bc.clients[i], &t);
+        if (m) bcast_msg_unref(m);
+    }
+}
+
+static void bench_bcast_fanout_1(void) { fanout(1); }
+static void bench_bcast_fanout_4(void) { fanout(4); }
+static void bench_bcast_fanout_8(void) { fanout(8); }
+
+// The check every publisher makes before encoding, 8 subscribers
+static void bench_topic_due_8(void) {
+    sink = topic_due(&topics, TOPIC_ADC, 1ull << 35, fake_us += 25000);
+}
+
+static void bench_cmd_parse_16(void) {
+    memcpy(cmd_buf, cmd_frame, cmd_frame_len);
+    if (!cmd_parse_batch(&table, cmd_buf, cmd_frame_len, NULL, &batch)) abort();
+    sink = cmd_run_batch(&batch, NULL, NULL);
+}
+
+static void bench_i2c_txn_parse(void) {
+    static i2c_txn_t txn;
+    sink = i2c_txn_parse("0x68;W:0x6B,0;R:0x3B,14;D:0x00,128", &txn);
+}
+
+static void bench_adc_push_1024(void) {
+    sink = cap_engine_push(&cap, adc_samples, 1024, NULL, NULL);
+}
+
+// One DMA read's worth of interleaved samples into min/mean/max points
+static void bench_scan_push_4k(void) {
+    sink = scan_engine_push(&scan, scan_chans, scan_raw, 4096, NULL, NULL);
+}
+
+// The portable kernel; on target the `cycles` field of {"analysis"} is the
+// per-block cost with esp-dsp
+static void bench_fft_1024(void) {
+    memcpy(fft.buf, fft_input, sizeof(fft_input));
+    dsp_fft_run(&fft);
+}
+
+// One oscilloscope block: mV conversion, stats, window, FFT and spectrum
+static void bench_dsp_analyze_1024(void) {
+    dsp_analyze(&fft, adc_samples, scan_lut, 20000, &analysis);
+    sink = analysis.bins;
+}
+
+// What a recorder producer and the writer do per chunk: oscilloscope frames
+// copied in (the last one split), then the header and CRC
+static void bench_rec_chunk_8k(void) {
+    rec_chunk_t c;
+    size_t len = cap.cfg.block_len * 2 + CAP_HDR_LEN;
+    rec_chunk_init(&c, rec_buf, 0, 0);
+    for (uint64_t t = 0; rec_chunk_put(&c, REC_ADC_BLOCK, t, cap.frame, len, false) == len; t += 25000) {
+    }
+    sink = rec_chunk_seal(&c);
+}
+
+static void bench_uart_frame_1k(void) {
+    size_t space;
+    uint8_t *dst = uart_framer_tail(&framer, &space);
+    memset(dst, 'x', space);
+    uart_framer_commit(&framer, space);
+    sink = uart_framer_finish(&framer, 0);
+}
+
+static void bench_la_rle_4k(void) {
+    la_rle_t r;
+    la_rle_init(&r, la_runs, 4096);
+    sink = la_rle_from_samples(&r, la_samples, 4096);
+}
+
+static void bench_la_merge_rmt(void) {
+    la_rle_t r;
+    la_rle_init(&r, la_runs, 4096);
+    sink = la_merge_rmt(&r, la_chans, 4);
+}
+
+static void bench_seq_parse_64(void) {
+    sink = seq_parse(seq_text, 4, seq_steps, SEQ_MAX_STEPS);
+}
+
+// What the alarm ISR does per step, minus the register writes
+static void bench_seq_step_1k(void) {
+    seq_player_t p;
+    seq_stats_t st;
+    seq_player_init(&p, seq_steps, 64, 16, 10, 0);
+    seq_stats_init(&st, 20);
+    while (!p.done) {
+        seq_stats_record(&st, (int32_t)(p.due & 7));
+        seq_player_advance(&p);
+    }
+    sink = st.steps;
+}
+
+// Eight pins on four frequencies, then all released
+static void bench_pwm_assign_8(void) {
+    static pwm_alloc_t alloc;
+    pwm_plan_t plan;
+    uint8_t mode, ch;
+    pwm_alloc_init(&alloc, 80000000);
+    for (int i = 0; i < 8; i++) sink = pwm_assign(&alloc, gpio_nums[i], 1000u << (i & 3), &plan);
+    for (int i = 0; i < 8; i++) sink = pwm_release(&alloc, gpio_nums[i], &mode, &ch);
+}
+
+static void bench_lat_record_64(void) {
+    for (uint32_t i = 0; i < 64; i++) lat_hist_record(&hist, i * 37);
+}
+
+typedef struct {
+    const char *name;
+    void (*fn)(void);
+    int units;          // items per op, for the items/s column
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    { "pin_snapshot_bin",   bench_pin_snapshot_bin,   NUM_PINS },
+    { "pin_delta_bin",      bench_pin_delta_bin,      1 },
+    { "pin_store_read",     bench_pin_store_read,     NUM_PINS },
+    { "pin_store_write",    bench_pin_store_write,    NUM_PINS },
+    { "pin_snapshot_json",  bench_pin_snapshot_json,  NUM_PINS },
+    { "edge_stats_json",    bench_edge_stats_json,    NUM_PINS },
+    { "edge_drain_256",     bench_edge_drain_256,     256 },
+    { "bcast_fanout_1",     bench_bcast_fanout_1,     1 },
+    { "bcast_fanout_4",     bench_bcast_fanout_4,     4 },
+    { "bcast_fanout_8",     bench_bcast_fanout_8,     8 },
+    { "topic_due_8",        bench_topic_due_8,        BCAST_MAX_CLIENTS },
+    { "cmd_parse_16",       bench_cmd_parse_16,       16 },
+    { "i2c_txn_parse",      bench_i2c_txn_parse,      3 },
+    { "adc_push_1024",      bench_adc_push_1024,      1024 },
+    { "scan_push_4k",       bench_scan_push_4k,       4096 },
+    { "fft_1024",           bench_fft_1024,           1024 },
+    { "dsp_analyze_1024",   bench_dsp_analyze_1024,   1024 },
+    { "rec_chunk_8k",       bench_rec_chunk_8k,       REC_CHUNK_MAX },
+    { "uart_frame_1k",      bench_uart_frame_1k,      UART_MAX_BATCH },
+    { "la_rle_4k",          bench_la_rle_4k,          4096 },
+    { "la_merge_rmt",       bench_la_merge_rmt,       4 * 127 },
+    { "seq_parse_64",       bench_seq_parse_64,       64 },
+    { "seq_step_1k",        bench_seq_step_1k,        1024 },
+    { "pwm_assign_8",       bench_pwm_assign_8,       8 },
+    { "lat_record_64",      bench_lat_record_64,      64 },
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    const char *filter = NULL;
+    double budget = 0.2;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) json = true;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) budget = atof(argv[++i]) / 1000;
+        else {
+            fprintf(stderr, "usage: %s [--json] [--filter <substring>] [--time <ms>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    setup();
+    if (!json) {
+        printf("%-20s %12s %10s %14s %10s %10s\n", "case", "iterations", "ns/op", "items/s", "allocs/op", "bytes/op");
+    }
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const bench_case_t *bc_case = &cases[c];
+        if (filter && !strstr(bc_case->name, filter)) continue;
+
+        for (int i = 0; i < 1000; i++) bc_case->fn();    // warm up
+
+        // Grow the batch until one batch fills the time budget
+        long iters = 1000;
+        double dt;
+        size_t a0, b0;
+        for (;;) {
+            a0 = allocs;
+            b0 = alloc_bytes;
+            double t0 = now_s();
+            for (long i = 0; i < iters; i++) bc_case->fn();
+            dt = now_s() - t0;
+            if (dt >= budget || iters > (1L << 30)) break;
+            iters = dt > 0 ? (long)(iters * (budget * 1.2 / dt)) + 1 : iters * 10;
+        }
+
+        double ns = dt * 1e9 / iters;
+        double items = bc_case->units * iters / dt;
+        double allocs_op = (double)(allocs - a0) / iters;
+        double bytes_op = (double)(alloc_bytes - b0) / iters;
+        if (json) {
+            printf("{\"case\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.1f,\"items_per_s\":%.0f,"
+                   "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+                   bc_case->name, iters, ns, items, allocs_op, bytes_op);
+        } else {
+            printf("%-20s %12ld %10.1f %14.0f %10.2f %10.1f\n",
+                   bc_case->name, iters, ns, items, allocs_op, bytes_op);
+        }
+    }
+
+#ifndef CORE_BENCH_COUNT_ALLOCS
+    if (!json) printf("(allocation counting unavailable in this build)\n");
+#endif
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Correctness checks for dsp_core.
+//
+// dsp_check
+// Compares the FFT with a direct DFT at every supported length, then runs
+// synthetic ADC blocks (sine, square, DC, two tones) through dsp_analyze
+// and checks each measurement against the value it was generated with.
+// Exits non-zero if any check fails.
+#include "dsp_core.h"
+#include "scan_core.h"
+#include "check.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATE        100000
+#define FULL_MV     3300
+
+static dsp_fft_t fft;
+static uint16_t lut[SCAN_LUT_LEN];
+static uint16_t raw[DSP_MAX_N];
+
+static uint16_t code(double mv) {
+    double c = mv * (SCAN_LUT_LEN - 1) / FULL_MV;
+    return (uint16_t)(c < 0 ? 0 : c > SCAN_LUT_LEN - 1 ? SCAN_LUT_LEN - 1 : lround(c));
+}
+
+static void check_fft(uint16_t n) {
+    static double ref[2 * DSP_MAX_N];
+    srand(n);
+    for (uint16_t i = 0; i < n; i++) {
+        fft.buf[2 * i] = (float)(rand() % 2001 - 1000) / 1000;
+        fft.buf[2 * i + 1] = (float)(rand() % 2001 - 1000) / 1000;
+    }
+    for (uint16_t k = 0; k < n; k++) {
+        double re = 0, im = 0;
+        for (uint16_t t = 0; t < n; t++) {
+            double a = -2 * M_PI * ((uint32_t)k * t % n) / n;
+            re += fft.buf[2 * t] * cos(a) - fft.buf[2 * t + 1] * sin(a);
+            im += fft.buf[2 * t] * sin(a) + fft.buf[2 * t + 1] * cos(a);
+        }
+        ref[2 * k] = re;
+        ref[2 * k + 1] = im;
+    }
+    dsp_fft_run(&fft);
+    double err = 0;
+    for (uint32_t i = 0; i < 2u * n; i++) {
+        double d = fabs(fft.buf[i] - ref[i]);
+        if (d > err) err = d;
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "fft %u max error", n);
+    // float accumulates about log2(n) roundings of values up to sqrt(n)
+    near(err, 0, 1e-4 * n, what);
+}
+
+static double ref_mean, ref_rms;
+
+// Mean and RMS of the block as generated, in double precision; a block
+// rarely holds whole periods, so these differ from the ideal signal's
+static void analyze(const char *name, dsp_result_t *r) {
+    double sum = 0, sum_sq = 0;
+    for (uint16_t i = 0; i < fft.n; i++) {
+        sum += lut[raw[i]];
+        sum_sq += (double)lut[raw[i]] * lut[raw[i]];
+    }
+    ref_mean = sum / fft.n;
+    ref_rms = sqrt(sum_sq / fft.n);
+    dsp_analyze(&fft, raw, lut, RATE, r);
+    printf("%s\n", name);
+}
+
+int main(void) {
+    scan_lut_linear(lut, FULL_MV);
+    for (uint16_t n = DSP_MIN_N; n && n <= DSP_MAX_N; n <<= 1) {
+        if (!dsp_fft_init(&fft, n)) {
+            fprintf(stderr, "dsp_check: init %u failed\n", n);
+            return 1;
+        }
+        check_fft(n);
+    }
+    if (dsp_fft_init(&fft, 100) || dsp_fft_len(1000) != 512 || dsp_fft_len(10) != 0) {
+        fprintf(stderr, "dsp_check: length checks failed\n");
+        return 1;
+    }
+
+    dsp_result_t r;
+    uint16_t n = DSP_MAX_N;
+    dsp_fft_init(&fft, n);
+    double bin = (double)RATE / n;
+
+    // 1 V amplitude sine at 1.65 V, between bins
+    double f = 3170;
+    for (uint16_t i = 0; i < n; i++) raw[i] = code(1650 + 1000 * sin(2 * M_PI * f * i / RATE));
+    analyze("sine 3170 Hz, 2 Vpp", &r);
+    near(r.mean_mv, ref_mean, 0.05, "mean mV");
+    near(r.rms_mv, ref_rms, 0.05, "rms mV");
+    near(r.max_mv - r.min_mv, 2000, 3, "vpp mV");
+    near(r.freq_hz, f, bin / 10, "freq Hz");
+    int peak = 0;
+    for (int b = 1; b < r.bins; b++) if (r.db[b] > r.db[peak]) peak = b;
+    near((peak + 0.5) * r.bin_hz, f, r.bin_hz, "spectrum peak Hz");
+    // Scalloping between bins costs Hann up to 1.4 dB
+    near(r.db[peak], 60, 2, "peak dB re 1 mV");
+    check(r.duty > 0.45 && r.duty < 0.55, "duty", r.duty, 0.5);
+
+    // 30 % duty square wave, 0 to 3 V, 1 kHz
+    for (uint16_t i = 0; i < n; i++) raw[i] = code(fmod(i, 100) < 30 ? 3000 : 0);
+    analyze("square 1 kHz, 30 %", &r);
+    near(r.duty, 0.30, 0.01, "duty");
+    near(r.freq_hz, 1000, bin / 4, "freq Hz");
+    near(r.mean_mv, ref_mean, 0.05, "mean mV");
+    near(r.max_mv - r.min_mv, 3000, 2, "vpp mV");
+
+    // Flat line: no frequency, no duty
+    for (uint16_t i = 0; i < n; i++) raw[i] = code(1200);
+    analyze("DC 1.2 V", &r);
+    near(r.freq_hz, 0, 0, "freq Hz");
+    check(r.duty < 0, "duty (none)", r.duty, -1);
+    near(r.rms_mv, 1200, 1, "rms mV");
+
+    // Two tones 26 dB apart: the stronger one is the dominant frequency
+    for (uint16_t i = 0; i < n; i++) {
+        raw[i] = code(1650 + 50 * sin(2 * M_PI * 800 * i / RATE) + 1000 * sin(2 * M_PI * 12000 * i / RATE));
+    }
+    analyze("800 Hz + 12 kHz", &r);
+    near(r.freq_hz, 12000, bin / 10, "freq Hz");
+    int b800 = (int)(800 / r.bin_hz);
+    near(r.db[b800], 20 * log10(50), 3, "800 Hz dB re 1 mV");
+
+    char json[1024];
+    size_t len = dsp_result_to_json(&r, 34, json, sizeof(json));
+    check(len > 0 && len < sizeof(json), "json length", (double)len, 0);
+    if (len) printf("%.120s...\n", json);
+
+    return check_exit("dsp_check");
+}
@@ -0,0 +1,193 @@
+// Correctness checks for edge_core.
+//
+// edge_check [--events <n>]
+// Runs synthetic edge streams through the edge statistics and checks bounce
+// counts, pulse widths, edge rates, the settled-level mask and timestamp
+// wrap. Then fills the ring to check the overrun counter, walks it across
+// index wraparound, and runs an ISR-like producer thread against a consumer
+// thread that must see every event exactly once and in order.
+// Exits non-zero if any check fails.
+#include "edge_core.h"
+#include "check.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BOUNCE_US   10
+
+static edge_stats_t st;
+static edge_ring_t ring;
+
+static void edge(uint8_t pin, uint32_t t_us, uint8_t level) {
+    edge_stats_apply(&st, &(edge_event_t){ .t_us = t_us, .pin = pin, .level = level });
+}
+
+static void check_square(void) {
+    // Pin 0: low from 0, then ten 30 us high / 70 us low periods from 1000
+    edge_stats_init(&st, 4, BOUNCE_US, 0);
+    edge_stats_seed(&st, 0, 0, 0);
+    for (uint32_t k = 0; k < 10; k++) {
+        edge(0, 1000 + k * 100, 1);
+        edge(0, 1030 + k * 100, 0);
+    }
+    const edge_pin_stats_t *p = &st.pins[0];
+    printf("square wave, 30 us high / 70 us low\n");
+    eq(p->edges, 20, "edges");
+    eq(p->bounces, 0, "bounces");
+    eq(p->min_high_us, 30, "min high us");
+    eq(p->max_high_us, 30, "max high us");
+    eq(p->min_low_us, 70, "min low us");
+    eq(p->max_low_us, 1000, "max low us (from the seed)");
+    eq(p->last_high_us, 30, "last high us");
+    eq(p->last_low_us, 70, "last low us");
+    eq(edge_stats_rate(&st, 0, 2000), 10000, "rate over 2 ms, edges/s");
+    eq(st.active, 0x1, "active mask");
+    eq(st.level_changed, 0, "level changed (even edges)");
+
+    edge_stats_window_reset(&st, 2000);
+    eq(edge_stats_rate(&st, 0, 3000), 0, "rate after window reset");
+    eq(p->edges, 20, "edges kept across windows");
+}
+
+static void check_bounce(void) {
+    // Pin 1 rises, chatters 4 us apart, then settles; the last event reports
+    // the level it already had: a pulse too short for the ISR to see
+    edge_stats_init(&st, 4, BOUNCE_US, 0);
+    edge_stats_seed(&st, 1, 0, 0);
+    edge(1, 5000, 1);
+    edge(1, 5004, 0);
+    edge(1, 5008, 1);
+    edge(1, 6000, 1);
+    const edge_pin_stats_t *p = &st.pins[1];
+    printf("bounce\n");
+    eq(p->edges, 5, "edges (a missed pulse counts two)");
+    eq(p->bounces, 3, "bounces");
+    eq(p->min_high_us, 4, "min high us");
+    eq(p->min_low_us, 0, "min low us (missed pulse)");
+    eq(p->level, 1, "level");
+    eq(st.level_changed, 0x2, "level changed (odd edges)");
+
+    // Edges on pins past num_pins are ignored
+    edge(7, 6100, 1);
+    eq(st.active, 0x2, "active mask, out-of-range pin ignored");
+}
+
+static void check_time_wrap(void) {
+    edge_stats_init(&st, 4, BOUNCE_US, UINT32_MAX - 50);
+    edge_stats_seed(&st, 2, 0, UINT32_MAX - 50);
+    edge(2, UINT32_MAX - 20, 1);
+    edge(2, 25, 0);             // 46 us later, past the wrap
+    const edge_pin_stats_t *p = &st.pins[2];
+    printf("timestamp wrap\n");
+    eq(p->last_high_us, 46, "high us across the wrap");
+    eq(p->bounces, 0, "bounces");
+    eq(edge_stats_rate(&st, 2, 49), 20000, "rate across the wrap, edges/s");
+
+    char json[512];
+    static const int gpios[] = { 4, 5, 18, 19 };
+    size_t len = edge_stats_to_json(&st, gpios, 7, 49, json, sizeof(json));
+    check(len > 0 && strstr(json, "\"pin\":18") && strstr(json, "\"overruns\":7") && !strstr(json, "\"pin\":4"),
+          "json lists the active pin only", (long)len, (long)len);
+    eq(edge_stats_to_json(&st, gpios, 7, 49, json, 16), 0, "json into a short buffer");
+}
+
+static void check_overrun(void) {
+    edge_ring_init(&ring);
+    int pushed = 0;
+    for (uint32_t i = 0; i < EDGE_RING_LEN + 5; i++) {
+        pushed += edge_ring_push(&ring, &(edge_event_t){ .t_us = i, .pin = i % 8 });
+    }
+    printf("full ring\n");
+    eq(pushed, EDGE_RING_LEN, "accepted");
+    eq(atomic_load(&ring.overruns), 5, "overruns");
+
+    // The oldest events are kept, the newest dropped
+    edge_event_t ev;
+    uint32_t n = 0;
+    bool order = true;
+    while (edge_ring_pop(&ring, &ev)) order &= ev.t_us == n++;
+    eq(n, EDGE_RING_LEN, "popped");
+    check(order, "oldest kept, in order", order, 1);
+    check(edge_ring_push(&ring, &(edge_event_t){ 0 }), "push after drain", 1, 1);
+}
+
+static void check_wraparound(void) {
+    // Start the indices just short of 2^32 so both the buffer index and the
+    // counters wrap; batches of uneven size walk the buffer several times
+    edge_ring_init(&ring);
+    atomic_store(&ring.head, UINT32_MAX - 700);
+    atomic_store(&ring.tail, UINT32_MAX - 700);
+    uint32_t next_push = 0, next_pop = 0;
+    bool order = true;
+    for (int round = 0; round < 50; round++) {
+        uint32_t batch = 1 + (uint32_t)(round * 97) % EDGE_RING_LEN;
+        for (uint32_t i = 0; i < batch; i++) {
+            if (edge_ring_push(&ring, &(edge_event_t){ .t_us = next_push })) next_push++;
+        }
+        edge_event_t ev;
+        for (uint32_t i = 0; i < batch / 2 + 1 && edge_ring_pop(&ring, &ev); i++) order &= ev.t_us == next_pop++;
+    }
+    edge_event_t ev;
+    while (edge_ring_pop(&ring, &ev)) order &= ev.t_us == next_pop++;
+    printf("index wraparound\n");
+    check(order, "events in order", order, 1);
+    eq(next_pop, next_push, "popped all pushed");
+    uint32_t head = atomic_load(&ring.head);
+    check(head < 1000000, "head index after wrapping 2^32", head, head);
+}
+
+static uint32_t total_events = 1000000;
+static uint32_t producer_drops;
+
+// Plays the ISR: pushes never block, so a full ring is retried and counted
+static void *producer(void *arg) {
+    for (uint32_t i = 0; i < total_events; i++) {
+        edge_event_t ev = { .t_us = i, .pin = (uint8_t)(i % 24), .level = (uint8_t)(i & 1) };
+        while (!edge_ring_push(&ring, &ev)) {
+            producer_drops++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void check_threads(void) {
+    edge_ring_init(&ring);
+    atomic_store(&ring.head, UINT32_MAX - 5000);
+    atomic_store(&ring.tail, UINT32_MAX - 5000);
+    pthread_t t;
+    pthread_create(&t, NULL, producer, NULL);
+
+    uint32_t next = 0, bad = 0;
+    edge_event_t ev;
+    while (next < total_events) {
+        if (!edge_ring_pop(&ring, &ev)) {
+            sched_yield();
+            continue;
+        }
+        if (ev.t_us != next || ev.pin != next % 24 || ev.level != (next & 1)) bad++;
+        next = ev.t_us + 1;
+    }
+    pthread_join(t, NULL);
+    printf("producer and consumer threads, %u events\n", total_events);
+    eq(bad, 0, "events out of order or torn");
+    eq(atomic_load(&ring.overruns), producer_drops, "overruns = refused pushes");
+    check(!edge_ring_pop(&ring, &ev), "ring empty at the end", 1, 1);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) total_events = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+    check_square();
+    check_bounce();
+    check_time_wrap();
+    check_overrun();
+    check_wraparound();
+    check_threads();
+
+    return check_exit("edge_check");
+}
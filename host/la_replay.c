@@ -0,0 +1,445 @@
+// Replay harness for logic_core.
+//
+// la_replay [capture.bin] [--trigger PATTERN] [--pre PERCENT] [--window TICKS] [--idle TICKS]
+// Reads a recorded bitstream (one byte per sample, channel n = bit n, as
+// written by `sigrok-cli -O binary`) or synthesises an SPI transfer, then:
+//   - run-length codes it and expands it back (must be bit-exact),
+//   - rebuilds it from per-channel RMT symbols split at the idle threshold,
+//     merges them (must give the same runs),
+//   - frames the runs into wire blocks and decodes them again,
+//   - replays an armed capture of the trigger the way the firmware runs it:
+//     bursts arrive one idle period after they end, history older than the
+//     pre-trigger window is dropped, and the window sent must hold the
+//     recorded samples with the trigger at the pre-trigger depth,
+//   - reports where the trigger fires and the compression ratio.
+// On the synthetic streams it also checks a set of triggers against their
+// known sample positions, and that a trigger long after the first window is
+// still caught with bounded history. Exits non-zero on the first mismatch.
+#include "logic_core.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNTH_BYTES     64
+#define SYNTH_HALF_BIT  4       // samples per SCK half period
+#define SYNTH_GAP       3000    // idle samples between SPI frames
+#define GLITCH_BURSTS   100     // clock bursts ahead of and around the glitch
+#define GLITCH_AT       200003  // sample where the one pulse on ch1 rises
+#define BUSY_AT         100000  // ch2 toggles for 400 samples from here
+#define BUSY_PULSE      100205  // ch3 pulses once, with ch2 high
+#define ARM_STEP        250     // ticks between trigger searches while armed
+
+static void die(const char *what) {
+    fprintf(stderr, "la_replay: %s\n", what);
+    exit(1);
+}
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n ? n : 1);
+    if (!p) die("out of memory");
+    return p;
+}
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) die("cannot open capture");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0) die("empty capture");
+    uint8_t *buf = xmalloc((size_t)size);
+    *len = fread(buf, 1, (size_t)size, f);
+    fclose(f);
+    return buf;
+}
+
+// SPI mode 0, 4 frames of 16 bytes: ch0 SCK, ch1 MOSI, ch2 CS (active low), ch3 MISO
+static uint8_t *synth_spi(size_t *len) {
+    size_t frame = 16 * 8 * 2 * SYNTH_HALF_BIT;
+    size_t cap = (SYNTH_BYTES / 16) * (frame + SYNTH_GAP + 2 * SYNTH_HALF_BIT) + SYNTH_GAP;
+    uint8_t *s = xmalloc(cap);
+    size_t n = 0;
+
+    for (size_t i = 0; i < SYNTH_GAP; i++) s[n++] = 0x04;
+    for (int b = 0; b < SYNTH_BYTES; b++) {
+        uint8_t mosi = (uint8_t)(b * 37 + 5), miso = (uint8_t)~b;
+        if (b % 16 == 0) {
+            for (int i = 0; i < SYNTH_HALF_BIT; i++) s[n++] = 0x00;   // CS falls
+        }
+        for (int bit = 7; bit >= 0; bit--) {
+            uint8_t data = (uint8_t)((((mosi >> bit) & 1) << 1) | (((miso >> bit) & 1) << 3));
+            for (int i = 0; i < SYNTH_HALF_BIT; i++) s[n++] = data;          // SCK low, data set up
+            for (int i = 0; i < SYNTH_HALF_BIT; i++) s[n++] = data | 0x01;   // SCK high, sampled
+        }
+        if (b % 16 == 15) {
+            for (int i = 0; i < SYNTH_HALF_BIT; i++) s[n++] = 0x00;
+            for (int i = 0; i < SYNTH_GAP; i++) s[n++] = 0x04;              // CS high, bus idle
+        }
+    }
+    *len = n;
+    return s;
+}
+
+// ch0 clocks 16 pulses every SYNTH_GAP samples; ch1 pulses once, late.
+// ch3 pulses once in the middle of a long ch2 burst, while ch2 is high.
+static uint8_t *synth_glitch(size_t *len) {
+    size_t n = GLITCH_BURSTS * SYNTH_GAP;
+    uint8_t *s = xmalloc(n);
+    for (size_t i = 0; i < n; i++) {
+        size_t in_burst = i % SYNTH_GAP;
+        s[i] = in_burst < 32 * SYNTH_HALF_BIT && (in_burst / SYNTH_HALF_BIT) % 2;
+        if (i >= GLITCH_AT && i < GLITCH_AT + 10) s[i] |= 0x02;
+        if (i >= BUSY_AT && i < BUSY_AT + 400 && ((i - BUSY_AT) / SYNTH_HALF_BIT) % 2) s[i] |= 0x04;
+        if (i >= BUSY_PULSE && i < BUSY_PULSE + 10) s[i] |= 0x08;
+    }
+    *len = n;
+    return s;
+}
+
+static uint32_t rmt_word(const uint32_t half[2][2]) {
+    return (half[0][0] & 0x7FFF) | (half[0][1] << 15) | ((half[1][0] & 0x7FFF) << 16) | (half[1][1] << 31);
+}
+
+// What an RMT receive channel with the given idle threshold would have
+// recorded for channel ch; segment starts are exact here.
+static size_t to_rmt(const uint8_t *s, size_t n, int ch, uint32_t idle, uint32_t *syms, la_segment_t *segs,
+                     size_t *num_segs) {
+    size_t num_syms = 0, half_n = 0;
+    uint32_t half[2][2];
+    bool in_seg = false;
+    *num_segs = 0;
+
+    for (size_t i = 1; i <= n; i++) {
+        bool edge = i < n && ((s[i] ^ s[i - 1]) >> ch & 1);
+        if (!edge) continue;
+        uint32_t level = s[i] >> ch & 1;
+        size_t end = i + 1;
+        while (end < n && (s[end] >> ch & 1) == level) end++;
+        size_t run = end - i;
+
+        if (!in_seg) {
+            segs[*num_segs] = (la_segment_t){ .start = i, .first = (uint32_t)num_syms, .count = 0 };
+            in_seg = true;
+        }
+        bool last = run >= idle || run > 0x7FFF || end == n;
+        half[half_n][0] = last ? 0 : (uint32_t)run;
+        half[half_n][1] = level;
+        if (++half_n == 2 || last) {
+            if (half_n == 1) {
+                half[1][0] = 0;
+                half[1][1] = level;
+            }
+            syms[num_syms++] = rmt_word((const uint32_t (*)[2])half);
+            half_n = 0;
+        }
+        if (last) {
+            segs[*num_segs].count = (uint32_t)(num_syms - segs[*num_segs].first);
+            (*num_segs)++;
+            in_seg = false;
+        }
+        i = end - 1;
+    }
+    return num_syms;
+}
+
+// Sample position of the first match of pattern, or -1
+static long long find_sample(const char *pattern, const la_run_t *runs, size_t count) {
+    la_trigger_t trig;
+    if (!la_trigger_parse(pattern, &trig)) die("bad trigger");
+    size_t at = la_trigger_find(&trig, runs, count, 0);
+    return at == LA_NONE ? -1 : (long long)la_rle_tick(runs, at);
+}
+
+static uint64_t seg_end(const uint32_t *syms, const la_segment_t *seg) {
+    uint64_t end = seg->start;
+    for (size_t h = 0; h < (size_t)seg->count * 2; h++) {
+        uint32_t dur = syms[seg->first + h / 2] >> (h & 1 ? 16 : 0) & 0x7FFF;
+        if (!dur) break;
+        end += dur;
+    }
+    return end;
+}
+
+typedef struct {
+    uint64_t trigger;           // stream tick, UINT64_MAX if it never fired
+    size_t at;                  // trigger run in the window
+    size_t count;               // runs in the window
+    size_t peak_syms;           // most symbols one channel held
+} armed_t;
+
+// Armed capture as logic_capture.c runs it. A segment arrives once its line
+// has been idle for idle ticks; every ARM_STEP the arrived segments are
+// merged and searched up to the start of the first one still in progress
+// (its edge stamp has fired), and each channel drops what ends more than
+// pre ticks before that as its next segment arrives. After a match, the
+// capture runs on until every channel is in past the end of the window.
+static armed_t replay_armed(const la_trigger_t *t, const la_rmt_chan_t *rec, const size_t *rec_syms, size_t n,
+                            uint32_t idle, uint64_t window, uint64_t pre, la_run_t *runs, size_t run_cap) {
+    uint32_t *syms[LA_MAX_CHANNELS];
+    la_segment_t *segs[LA_MAX_CHANNELS];
+    size_t used[LA_MAX_CHANNELS] = { 0 }, num[LA_MAX_CHANNELS] = { 0 }, next[LA_MAX_CHANNELS] = { 0 };
+    uint8_t level[LA_MAX_CHANNELS];
+    for (int ch = 0; ch < LA_MAX_CHANNELS; ch++) {
+        syms[ch] = xmalloc(rec_syms[ch] * sizeof(uint32_t));
+        segs[ch] = xmalloc(rec[ch].num_segs * sizeof(la_segment_t));
+        level[ch] = rec[ch].level;
+    }
+
+    armed_t a = { .trigger = UINT64_MAX, .at = LA_NONE };
+    uint64_t cut = 0;
+    la_rle_t rle;
+    la_rmt_chan_t view[LA_MAX_CHANNELS];
+    for (uint64_t now = 0; now <= (uint64_t)n + idle + ARM_STEP; now += ARM_STEP) {
+        uint64_t settled = now;
+        for (int ch = 0; ch < LA_MAX_CHANNELS; ch++) {
+            for (; next[ch] < rec[ch].num_segs; next[ch]++) {
+                const la_segment_t *seg = &rec[ch].segs[next[ch]];
+                if (seg_end(rec[ch].symbols, seg) + idle > now) break;
+                memcpy(syms[ch] + used[ch], rec[ch].symbols + seg->first, seg->count * sizeof(uint32_t));
+                segs[ch][num[ch]++] = (la_segment_t){ .start = seg->start, .first = (uint32_t)used[ch], .count = seg->count };
+                used[ch] += seg->count;
+                if (used[ch] > a.peak_syms) a.peak_syms = used[ch];
+                if (cut) used[ch] -= la_rmt_drop(syms[ch], segs[ch], &num[ch], &level[ch], cut);
+            }
+            if (next[ch] < rec[ch].num_segs && rec[ch].segs[next[ch]].start < settled) {
+                settled = rec[ch].segs[next[ch]].start;
+            }
+            view[ch] = (la_rmt_chan_t){ .symbols = syms[ch], .segs = segs[ch], .num_segs = num[ch], .level = level[ch] };
+        }
+        if (a.trigger != UINT64_MAX) {
+            if (settled >= a.trigger + window - pre) break;
+            continue;
+        }
+        la_rle_init(&rle, runs, run_cap);
+        if (!la_merge_rmt(&rle, view, LA_MAX_CHANNELS)) die("armed merge overflowed");
+        size_t at = la_trigger_find(t, runs, rle.count, 0);
+        if (at != LA_NONE && la_rle_tick(runs, at) < settled) a.trigger = la_rle_tick(runs, at);
+        else if (settled > pre) cut = settled - pre;
+    }
+
+    la_rle_init(&rle, runs, run_cap);
+    if (!la_merge_rmt(&rle, view, LA_MAX_CHANNELS)) die("armed merge overflowed");
+    if (a.trigger != UINT64_MAX) {
+        uint64_t from = a.trigger > pre ? a.trigger - pre : 0;
+        a.count = la_rle_window(runs, rle.count, from, from + window);
+        uint64_t tick = 0;
+        for (a.at = 0; a.at < a.count && tick < a.trigger - from; a.at++) tick += runs[a.at].ticks;
+    }
+    for (int ch = 0; ch < LA_MAX_CHANNELS; ch++) {
+        free(syms[ch]);
+        free(segs[ch]);
+    }
+    return a;
+}
+
+// Arm on pattern, then check the trigger sits at the pre-trigger depth of
+// the window and the window holds exactly the recorded samples; returns
+// where it fired, -1 if never
+static long long check_armed(const char *pattern, uint32_t pre_percent, uint64_t window, const uint8_t *samples,
+                             size_t n, const la_rmt_chan_t *rec, const size_t *rec_syms, uint32_t idle,
+                             size_t *peak_syms) {
+    la_trigger_t trig;
+    if (!la_trigger_parse(pattern, &trig)) die("bad trigger");
+    uint64_t pre = window * pre_percent / 100;
+    la_run_t *runs = xmalloc((n + 2) * sizeof(*runs));
+    armed_t a = replay_armed(&trig, rec, rec_syms, n, idle, window, pre, runs, n + 2);
+    if (peak_syms) *peak_syms = a.peak_syms;
+    if (a.trigger == UINT64_MAX) {
+        free(runs);
+        return -1;
+    }
+
+    uint64_t depth = a.trigger < pre ? a.trigger : pre;
+    if (a.at == LA_NONE || la_rle_tick(runs, a.at) != depth) die("trigger is not at the pre-trigger depth of the window");
+    if (pre && la_trigger_find(&trig, runs, a.count, 0) != a.at) die("trigger does not match at its run in the window");
+
+    uint64_t from = a.trigger - depth;
+    uint64_t to = from + window < n ? from + window : n;
+    uint8_t *got = xmalloc(window);
+    // The merge ends one tick after the last edge; the recording runs on
+    size_t len = la_rle_to_samples(runs, a.count, got, to - from);
+    if (!len) die("armed window is empty");
+    if (len < to - from) memset(got + len, got[len - 1], to - from - len);
+    if (memcmp(got, samples + from, to - from) != 0) die("armed window differs from the recording");
+    free(got);
+    free(runs);
+    return (long long)a.trigger;
+}
+
+// Every channel of samples as its RMT receive channel would have recorded it;
+// returns the symbols over all channels
+static size_t record_rmt(const uint8_t *s, size_t n, uint32_t idle, la_rmt_chan_t *chans, size_t *syms_per_ch) {
+    size_t total = 0;
+    for (int ch = 0; ch < LA_MAX_CHANNELS; ch++) {
+        uint32_t *syms = xmalloc((n / 2 + 2) * sizeof(uint32_t));
+        la_segment_t *segs = xmalloc((n / 2 + 2) * sizeof(la_segment_t));
+        size_t num_segs;
+        syms_per_ch[ch] = to_rmt(s, n, ch, idle, syms, segs, &num_segs);
+        total += syms_per_ch[ch];
+        chans[ch] = (la_rmt_chan_t){ .symbols = syms, .segs = segs, .num_segs = num_segs, .level = s[0] >> ch & 1 };
+    }
+    return total;
+}
+
+static void free_rmt(la_rmt_chan_t *chans) {
+    for (int ch = 0; ch < LA_MAX_CHANNELS; ch++) {
+        free((void *)chans[ch].symbols);
+        free((void *)chans[ch].segs);
+    }
+}
+
+// The synthetic SPI stream idles with CS high for SYNTH_GAP samples, drops
+// CS, and raises SCK after the half bit that puts up the first data bit
+static const struct {
+    const char *pattern;
+    long long sample;
+} synth_matches[] = {
+    { "XXF",  SYNTH_GAP },                          // CS falls
+    { "RXXX", SYNTH_GAP + 2 * SYNTH_HALF_BIT },     // first SCK rise
+    { "RX0",  SYNTH_GAP + 2 * SYNTH_HALF_BIT },     // same, CS low
+    { "XXXR", SYNTH_GAP + SYNTH_HALF_BIT },         // MISO = ~0 shifts out a 1 first
+    { "1XR",  -1 },                                 // CS never rises with SCK high
+    { "",     0 },
+};
+
+static bool same_runs(const la_run_t *a, size_t na, const la_run_t *b, size_t nb, bool loose_tail) {
+    if (na != nb) return false;
+    for (size_t i = 0; i < na; i++) {
+        if (a[i].word != b[i].word) return false;
+        if (a[i].ticks != b[i].ticks && !(loose_tail && i == na - 1)) return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL, *pattern = "";
+    uint32_t idle = 1000, pre_percent = 25;
+    uint64_t window = 4000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trigger") == 0 && i + 1 < argc) pattern = argv[++i];
+        else if (strcmp(argv[i], "--pre") == 0 && i + 1 < argc) pre_percent = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) window = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--idle") == 0 && i + 1 < argc) idle = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else path = argv[i];
+    }
+    if (!idle) idle = 1;
+    if (pre_percent > 99 || !window) die("--pre is 0 to 99 percent of a non-empty --window");
+
+    la_trigger_t trig;
+    if (!la_trigger_parse(pattern, &trig)) die("bad trigger (use 0 1 X R F per channel)");
+
+    size_t n;
+    uint8_t *samples = path ? read_file(path, &n) : synth_spi(&n);
+
+    // 1. Samples -> runs -> samples
+    la_run_t *runs = xmalloc(n * sizeof(*runs));
+    la_rle_t rle;
+    la_rle_init(&rle, runs, n);
+    if (la_rle_from_samples(&rle, samples, n) != n || rle.ticks != n) die("RLE did not consume the capture");
+    uint8_t *back = xmalloc(n);
+    if (la_rle_to_samples(runs, rle.count, back, n) != n || memcmp(back, samples, n) != 0) die("RLE round trip differs");
+
+    // 2. Per-channel RMT symbols -> merged runs
+    la_rmt_chan_t chans[LA_MAX_CHANNELS];
+    size_t syms_per_ch[LA_MAX_CHANNELS];
+    size_t total_syms = record_rmt(samples, n, idle, chans, syms_per_ch);
+    la_run_t *merged = xmalloc((n + 1) * sizeof(*merged));
+    la_rle_t mrle;
+    la_rle_init(&mrle, merged, n + 1);
+    if (!la_merge_rmt(&mrle, chans, LA_MAX_CHANNELS)) die("RMT merge overflowed");
+    // The merge ends one tick after the last edge; the recording runs on
+    if (!same_runs(runs, rle.count, merged, mrle.count, true)) die("RMT merge differs from the sample RLE");
+
+    // 3. Runs -> wire blocks -> runs
+    size_t trig_at = la_trigger_find(&trig, runs, rle.count, 0);
+    la_framer_t fr;
+    la_framer_init(&fr, runs, rle.count, LA_MAX_CHANNELS, 1, trig_at != LA_NONE ? LA_FLAG_TRIGGERED : 0);
+    la_run_t *decoded = xmalloc(n * sizeof(*decoded));
+    size_t got = 0, wire = 0, blocks = 0;
+    uint8_t block[LA_BLOCK_MAX];
+    size_t len;
+    uint64_t tick = 0;
+    while ((len = la_framer_next(&fr, block, sizeof(block))) > 0) {
+        uint32_t first;
+        size_t k = la_block_decode(block, len, decoded + got, n - got, &first);
+        if (!k && (block[12] | block[13])) die("block failed to decode");
+        if (first != (uint32_t)tick) die("block start tick out of sequence");
+        for (size_t i = 0; i < k; i++) tick += decoded[got + i].ticks;
+        got += k;
+        wire += len;
+        blocks++;
+        if ((block[2] & LA_FLAG_LAST) != 0) break;
+    }
+    if (!same_runs(runs, rle.count, decoded, got, false)) die("wire round trip differs");
+
+    char json[256];
+    int gpios[LA_MAX_CHANNELS] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    la_summary_t sum = { .id = 1, .gpios = gpios, .channels = LA_MAX_CHANNELS, .tick_hz = 1,
+                         .runs = rle.count, .ticks = rle.ticks, .trigger = trig_at };
+    if (!la_summary_to_json(&sum, runs, json, sizeof(json))) die("summary JSON overflowed");
+
+    printf("%s: %zu samples, %zu runs, %zu RMT symbols, %zu blocks / %zu bytes on the wire (%.1fx)\n",
+           path ? path : "synthetic SPI", n, rle.count, total_syms, blocks, wire, (double)n / wire);
+
+    // 4. Armed capture of the trigger
+    if (trig.mask) {
+        size_t peak;
+        long long at = check_armed(pattern, pre_percent, window, samples, n, chans, syms_per_ch, idle, &peak);
+        if (at != find_sample(pattern, runs, rle.count)) die("armed trigger differs from a search of the whole capture");
+        if (at >= 0) {
+            printf("'%s' fires at sample %lld; %llu-tick window, %u%% pre-trigger, at most %zu symbols held per channel\n",
+                   pattern, at, (unsigned long long)window, (unsigned)pre_percent, peak);
+        } else {
+            printf("'%s' never fires\n", pattern);
+        }
+    }
+
+    // 5. Trigger positions and pre-trigger depths on the synthetic streams
+    for (size_t i = 0; !path && i < sizeof(synth_matches) / sizeof(synth_matches[0]); i++) {
+        long long at = find_sample(synth_matches[i].pattern, runs, rle.count);
+        if (at != synth_matches[i].sample) {
+            fprintf(stderr, "la_replay: '%s' matched at sample %lld, want %lld\n", synth_matches[i].pattern, at,
+                    synth_matches[i].sample);
+            exit(1);
+        }
+        if (find_sample(synth_matches[i].pattern, merged, mrle.count) != at) die("search differs on the merged runs");
+        if (!*synth_matches[i].pattern) continue;
+        for (uint32_t pre = 0; pre < 100; pre += 45) {
+            if (check_armed(synth_matches[i].pattern, pre, 2000, samples, n, chans, syms_per_ch, idle, NULL) != at) {
+                fprintf(stderr, "la_replay: '%s' armed with %u%% pre-trigger fired away from sample %lld\n",
+                        synth_matches[i].pattern, (unsigned)pre, at);
+                exit(1);
+            }
+        }
+    }
+    if (!path) {
+        // A pulse 50 windows in: caught, with only the pre-trigger history held meanwhile
+        size_t gn, peak, gsyms[LA_MAX_CHANNELS];
+        uint8_t *glitch = synth_glitch(&gn);
+        la_rmt_chan_t gchans[LA_MAX_CHANNELS];
+        record_rmt(glitch, gn, idle, gchans, gsyms);
+        long long at = check_armed("XR", 25, 4000, glitch, gn, gchans, gsyms, idle, &peak);
+        if (at != GLITCH_AT) die("glitch trigger missed");
+        if (peak * 10 > gsyms[0]) die("armed capture held more than its pre-trigger history");
+        // ch3's pulse arrives while ch2's burst is still being received; a
+        // search that ran ahead would still see ch2 low there
+        if (check_armed("XX0R", 25, 4000, glitch, gn, gchans, gsyms, idle, NULL) != -1) {
+            die("armed trigger fired on a burst still being received");
+        }
+        printf("glitch at sample %lld caught holding at most %zu symbols per channel (the clock recorded %zu)\n",
+               at, peak, gsyms[0]);
+        free_rmt(gchans);
+        free(glitch);
+    }
+    printf("%s\nok\n", json);
+
+    free_rmt(chans);
+    free(decoded);
+    free(merged);
+    free(back);
+    free(runs);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Concurrency check for pin_store.
+//
+// pin_store_stress [--ms <duration>] [--readers <n>]
+// Two writer threads, serialized by one mutex as the firmware's writers
+// are, store generation k into every pin with all fields derived from k.
+// Reader threads take snapshots and single-pin copies without the lock and
+// check that none is torn: every field of a pin and every pin of a
+// snapshot must come from one k, and versions must never go backwards.
+// Readers that run out of tries fall back to the writers' lock, like
+// pin_snapshot() in main.c. Exits non-zero on the first inconsistency.
+#include "pin_store.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_PINS    24
+#define READ_TRIES  4
+#define MAX_READERS 16
+
+static pin_store_t store;
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool stop;
+static atomic_uint failures;
+static uint32_t next_k = 1;         // guarded by write_lock
+
+typedef struct {
+    unsigned long reads;
+    unsigned long fallbacks;
+    unsigned long writes;
+} counters_t;
+
+static pin_state_t from_k(uint32_t k) {
+    return (pin_state_t){
+        .level = k & 1, .output = (k >> 1) & 1,
+        .pwm_hz = k * 3, .bounces = k, .last_change_ms = k * 7,
+    };
+}
+
+static bool consistent(const pin_state_t *p) {
+    pin_state_t want = from_k(p->bounces);
+    return p->level == want.level && p->output == want.output && p->pwm_hz == want.pwm_hz &&
+           p->last_change_ms == want.last_change_ms;
+}
+
+static void fail(const char *what, uint32_t a, uint32_t b) {
+    if (atomic_fetch_add(&failures, 1) < 10) fprintf(stderr, "pin_store_stress: %s (%u vs %u)\n", what, a, b);
+    atomic_store(&stop, true);
+}
+
+static void *writer(void *arg) {
+    counters_t *c = arg;
+    while (!atomic_load(&stop)) {
+        pthread_mutex_lock(&write_lock);
+        uint32_t k = next_k++;
+        pin_store_write_begin(&store);
+        for (size_t i = 0; i < NUM_PINS; i++) {
+            pin_state_t p = from_k(k);
+            pin_store_set(&store, i, &p);
+        }
+        pin_store_write_end(&store);
+        pthread_mutex_unlock(&write_lock);
+        c->writes++;
+    }
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    counters_t *c = arg;
+    static _Thread_local pin_snapshot_t snap;
+    uint32_t last_version = 0, last_pin_version[NUM_PINS] = { 0 };
+    size_t idx = 0;
+    while (!atomic_load(&stop)) {
+        if (!pin_store_read(&store, &snap, READ_TRIES)) {
+            pthread_mutex_lock(&write_lock);
+            if (!pin_store_read(&store, &snap, 1)) fail("read under the writers' lock failed", 0, 0);
+            pthread_mutex_unlock(&write_lock);
+            c->fallbacks++;
+        }
+        c->reads++;
+
+        if (snap.num_pins != NUM_PINS) fail("pin count", snap.num_pins, NUM_PINS);
+        if (snap.version < last_version) fail("store version went back", snap.version, last_version);
+        last_version = snap.version;
+        for (size_t i = 0; i < NUM_PINS; i++) {
+            const pin_state_t *p = &snap.pins[i];
+            if (!consistent(p)) fail("torn pin", p->bounces, p->pwm_hz);
+            if (p->bounces != snap.pins[0].bounces) fail("pins from different writes", p->bounces, snap.pins[0].bounces);
+            if (p->version > snap.version) fail("pin version above store version", p->version, snap.version);
+            if (p->version < last_pin_version[i]) fail("pin version went back", p->version, last_pin_version[i]);
+            last_pin_version[i] = p->version;
+        }
+
+        // And one pin on its own
+        pin_state_t pin;
+        idx = (idx + 7) % NUM_PINS;
+        if (pin_store_read_pin(&store, idx, &pin, READ_TRIES)) {
+            if (!consistent(&pin)) fail("torn single pin", pin.bounces, pin.pwm_hz);
+            if (pin.version < last_pin_version[idx]) fail("single pin version went back", pin.version, last_pin_version[idx]);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int ms = 1000, readers = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) readers = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: pin_store_stress [--ms <duration>] [--readers <n>]\n");
+            return 2;
+        }
+    }
+    if (readers < 1) readers = 1;
+    if (readers > MAX_READERS) readers = MAX_READERS;
+
+    pin_store_init(&store, NUM_PINS);
+    pthread_t threads[2 + MAX_READERS];
+    counters_t counts[2 + MAX_READERS];
+    memset(counts, 0, sizeof(counts));
+    int n = 0;
+    for (int i = 0; i < 2; i++, n++) pthread_create(&threads[n], NULL, writer, &counts[n]);
+    for (int i = 0; i < readers; i++, n++) pthread_create(&threads[n], NULL, reader, &counts[n]);
+
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, true);
+
+    counters_t total = { 0 };
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+        total.reads += counts[i].reads;
+        total.fallbacks += counts[i].fallbacks;
+        total.writes += counts[i].writes;
+    }
+    printf("%lu writes, %lu snapshots by %d readers, %lu retries, %lu lock fallbacks\n",
+           total.writes, total.reads, readers, (unsigned long)atomic_load(&store.retries), total.fallbacks);
+
+    if (atomic_load(&failures)) {
+        fprintf(stderr, "pin_store_stress: %u inconsistencies\n", atomic_load(&failures));
+        return 1;
+    }
+    if (!total.writes || !total.reads) {
+        fprintf(stderr, "pin_store_stress: threads made no progress\n");
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,391 @@
+// ADC capture — continuous (DMA) driver on ADC1 feeding capture_core for
+// one triggered channel, or scan_core for several interleaved channels.
+// Codes are converted through a lookup table filled once from adc_cali.
+#include "adc_capture.h"
+#include "dbg_wire.h"
+#include "metrics.h"
+
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <esp_cpu.h>
+#include <esp_adc/adc_continuous.h>
+#include <esp_adc/adc_cali.h>
+#include <esp_adc/adc_cali_scheme.h>
+#include <soc/soc_caps.h>
+
+#define TAG "AdcCapture"
+
+#define ADC_READ_LEN        (256 * SOC_ADC_DIGI_RESULT_BYTES)
+#define ADC_POOL_LEN        (8 * ADC_READ_LEN)
+#define ADC_READ_TIMEOUT_MS 100
+#define ADC_REFRESH_HZ      10      // max blocks/s shipped, the rest is holdoff
+#define ADC_SUMMARY_MS      200
+#define ADC_ANALYSIS_MS     500     // one block in this period gets the FFT and measurements
+#define ADC_DEFAULT_RATE    20000
+#define ADC_DEFAULT_BLOCK   512
+#define ADC_ATTEN           ADC_ATTEN_DB_12
+#define ADC_NOMINAL_MV      3300    // full scale assumed without eFuse calibration
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define ADC_OUTPUT_TYPE     ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ADC_GET_CHANNEL(p)  ((p)->type1.channel)
+#define ADC_GET_DATA(p)     ((p)->type1.data)
+#else
+#define ADC_OUTPUT_TYPE     ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ADC_GET_CHANNEL(p)  ((p)->type2.channel)
+#define ADC_GET_DATA(p)     ((p)->type2.data)
+#endif
+
+static adc_continuous_handle_t s_handle;
+static SemaphoreHandle_t s_lock;
+
+// Raw code -> mV, written once before the task starts
+static uint16_t s_lut[SCAN_LUT_LEN];
+static bool s_calibrated;
+
+// Owned by the capture task
+static cap_engine_t s_engine;
+static scan_engine_t s_scan;
+static bool s_scanning;
+static int s_pin;
+static uint8_t s_read_buf[ADC_READ_LEN];
+static uint16_t s_samples[ADC_READ_LEN / SOC_ADC_DIGI_RESULT_BYTES];
+static uint8_t s_chans[ADC_READ_LEN / SOC_ADC_DIGI_RESULT_BYTES];
+static dsp_fft_t s_fft;
+static dsp_result_t s_analysis;
+static uint16_t s_analysis_raw[DSP_MAX_N];
+static int64_t s_next_analysis;
+
+// Guarded by s_lock, applied by the capture task between reads
+static cap_config_t s_pending;
+static int s_pending_pin;
+static scan_config_t s_pending_scan;
+static bool s_pending_scanning;
+static bool s_reconfigure;
+static bool s_restart;          // channel or rate changed, driver must be stopped
+static bool s_rearm;
+
+static volatile uint32_t s_overruns;
+static adc_block_sink_t s_on_block;
+static adc_summary_sink_t s_on_summary;
+static adc_analysis_sink_t s_on_analysis;
+static adc_analysis_wanted_t s_analysis_wanted;
+
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data) {
+    s_overruns++;
+    return false;
+}
+
+static uint32_t holdoff_for(uint32_t rate, uint32_t window) {
+    uint32_t period = rate / ADC_REFRESH_HZ;
+    return period > window ? period - window : 0;
+}
+
+// Line or curve fitting from eFuse, whichever the chip supports
+static void fill_lut(void) {
+    adc_cali_handle_t cali = NULL;
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cfg = {
+        .unit_id = ADC_UNIT_1, .chan = ADC_CHANNEL_0, .atten = ADC_ATTEN, .bitwidth = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+    err = adc_cali_create_scheme_curve_fitting(&cfg, &cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cfg = {
+        .unit_id = ADC_UNIT_1, .atten = ADC_ATTEN, .bitwidth = SOC_ADC_DIGI_MAX_BITWIDTH,
+#if CONFIG_IDF_TARGET_ESP32
+        .default_vref = 1100,
+#endif
+    };
+    err = adc_cali_create_scheme_line_fitting(&cfg, &cali);
+#endif
+    s_calibrated = err == ESP_OK;
+#if CONFIG_IDF_TARGET_ESP32 && ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    // Without eFuse values the ESP32 scheme only assumes the nominal Vref
+    adc_cali_line_fitting_efuse_val_t efuse;
+    if (adc_cali_line_fitting_efuse_get_scheme(&efuse) != ESP_OK || efuse == ADC_CALI_LINE_FITTING_EFUSE_VAL_DEFAULT_VREF) {
+        s_calibrated = false;
+    }
+#endif
+
+    scan_lut_linear(s_lut, ADC_NOMINAL_MV);
+    if (err == ESP_OK) {
+        for (int raw = 0; raw < SCAN_LUT_LEN; raw++) {
+            int mv;
+            if (adc_cali_raw_to_voltage(cali, raw, &mv) == ESP_OK) s_lut[raw] = mv < 0 ? 0 : mv;
+        }
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        adc_cali_delete_scheme_curve_fitting(cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+        adc_cali_delete_scheme_line_fitting(cali);
+#endif
+    }
+    ESP_LOGI(TAG, "ADC1 full scale %u mV (%s)", s_lut[SCAN_LUT_LEN - 1], s_calibrated ? "eFuse" : "nominal");
+}
+
+static esp_err_t adc_driver_config(void) {
+    adc_digi_pattern_config_t patterns[SCAN_MAX_CHANNELS];
+    uint32_t n = s_scanning ? s_scan.cfg.channels : 1;
+    for (uint32_t i = 0; i < n; i++) {
+        patterns[i] = (adc_digi_pattern_config_t){
+            .atten = ADC_ATTEN,
+            .channel = (s_scanning ? s_scan.cfg.adc_channel[i] : s_engine.cfg.channel) & 0x7,
+            .unit = ADC_UNIT_1,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+        };
+    }
+    // The sample clock is shared: each scanned channel gets rate / n
+    adc_continuous_config_t cfg = {
+        .pattern_num = n,
+        .adc_pattern = patterns,
+        .sample_freq_hz = s_scanning ? s_scan.cfg.rate * n : s_engine.cfg.sample_rate,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_OUTPUT_TYPE,
+    };
+    return adc_continuous_config(s_handle, &cfg);
+}
+
+static void apply_pending(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool reconfigure = s_reconfigure, restart = s_restart, rearm = s_rearm;
+    cap_config_t cfg = s_pending;
+    int pin = s_pending_pin;
+    bool scanning = s_pending_scanning;
+    scan_config_t scan = s_pending_scan;
+    s_reconfigure = s_restart = s_rearm = false;
+    xSemaphoreGive(s_lock);
+
+    if (restart) adc_continuous_stop(s_handle);
+    if (reconfigure) {
+        cap_engine_configure(&s_engine, &cfg);
+        s_pin = pin;
+        s_scanning = scanning;
+        if (scanning) scan_engine_init(&s_scan, &scan, s_lut);
+    }
+    if (restart) {
+        // The ring holds samples of the previous pin or rate
+        cap_engine_reset(&s_engine);
+        esp_err_t err = adc_driver_config();
+        if (err != ESP_OK) ESP_LOGE(TAG, "ADC config failed: %s", esp_err_to_name(err));
+        err = adc_continuous_start(s_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "ADC start failed: %s", esp_err_to_name(err));
+        } else if (s_scanning) {
+            ESP_LOGI(TAG, "Scanning %u channels at %lu Hz each, %u points of %lu samples",
+                     scan.channels, (unsigned long)scan.rate, scan.points, (unsigned long)scan.per_point);
+        } else {
+            ESP_LOGI(TAG, "Capturing GPIO%d (ADC1_CH%d) at %lu Hz, %u samples/block",
+                     s_pin, cfg.channel, (unsigned long)cfg.sample_rate, cfg.block_len);
+        }
+    }
+    if (rearm) cap_engine_rearm(&s_engine);
+}
+
+// Measure the leading power-of-two samples of a block, after it has been sent
+static void analyze_block(const uint8_t *frame) {
+    int64_t now = esp_timer_get_time();
+    uint16_t n = dsp_fft_len(wire_get_u16(frame + 16));
+    if (!s_on_analysis || now < s_next_analysis || !n) return;
+    s_next_analysis = now + ADC_ANALYSIS_MS * 1000;
+    if (s_analysis_wanted && !s_analysis_wanted(s_pin)) return;
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    if (s_fft.n != n) dsp_fft_init(&s_fft, n);
+    for (uint16_t i = 0; i < n; i++) s_analysis_raw[i] = wire_get_u16(frame + CAP_HDR_LEN + 2 * i);
+    dsp_analyze(&s_fft, s_analysis_raw, s_lut, wire_get_u32(frame + 8), &s_analysis);
+    s_analysis.cycles = esp_cpu_get_cycle_count() - start;
+    s_on_analysis(s_pin, &s_analysis);
+}
+
+// ctx is the time the DMA read that completed the block returned
+static void on_block(const uint8_t *frame, size_t len, void *ctx) {
+    if (s_on_block) s_on_block(frame, len);
+    metrics_record(METRIC_ADC_BLOCK, (uint32_t)(esp_timer_get_time() - *(int64_t *)ctx));
+    if (!s_scanning) analyze_block(frame);
+}
+
+static void adc_capture_task(void* arg) {
+    uint32_t sum = 0, count = 0;
+    int64_t next_summary = esp_timer_get_time() + ADC_SUMMARY_MS * 1000;
+
+    while (1) {
+        if (s_reconfigure || s_rearm) apply_pending();
+
+        uint32_t got = 0;
+        if (adc_continuous_read(s_handle, s_read_buf, sizeof(s_read_buf), &got, ADC_READ_TIMEOUT_MS) != ESP_OK) {
+            continue;
+        }
+        int64_t read_t = esp_timer_get_time();
+
+        size_t n = 0;
+        if (s_scanning) {
+            for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES, n++) {
+                adc_digi_output_data_t *p = (adc_digi_output_data_t *)&s_read_buf[i];
+                s_chans[n] = ADC_GET_CHANNEL(p);
+                s_samples[n] = ADC_GET_DATA(p);
+            }
+            scan_engine_push(&s_scan, s_chans, s_samples, n, on_block, &read_t);
+            continue;
+        }
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            adc_digi_output_data_t *p = (adc_digi_output_data_t *)&s_read_buf[i];
+            if (ADC_GET_CHANNEL(p) != s_engine.cfg.channel) continue;
+            s_samples[n] = ADC_GET_DATA(p);
+            sum += s_lut[s_samples[n++] & (SCAN_LUT_LEN - 1)];
+        }
+        count += n;
+        cap_engine_push(&s_engine, s_samples, n, on_block, &read_t);
+
+        int64_t now = esp_timer_get_time();
+        if (now >= next_summary) {
+            if (count && s_on_summary) s_on_summary(s_pin, (float)sum / count / 1000.0f);
+            sum = count = 0;
+            next_summary = now + ADC_SUMMARY_MS * 1000;
+        }
+    }
+}
+
+esp_err_t adc_capture_start(int pin, adc_block_sink_t on_block_sink, adc_summary_sink_t on_summary_sink,
+                            adc_analysis_sink_t on_analysis_sink, adc_analysis_wanted_t analysis_wanted) {
+    adc_unit_t unit;
+    adc_channel_t channel;
+    if (adc_continuous_io_to_channel(pin, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    fill_lut();
+    s_lock = xSemaphoreCreateMutex();
+    s_on_block = on_block_sink;
+    s_on_summary = on_summary_sink;
+    s_on_analysis = on_analysis_sink;
+    s_analysis_wanted = analysis_wanted;
+    s_pin = s_pending_pin = pin;
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = ADC_POOL_LEN,
+        .conv_frame_size = ADC_READ_LEN,
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_cfg, &s_handle);
+    if (err != ESP_OK) return err;
+
+    adc_continuous_evt_cbs_t cbs = { .on_pool_ovf = on_pool_ovf };
+    adc_continuous_register_event_callbacks(s_handle, &cbs, NULL);
+
+    cap_config_t cfg = {
+        .sample_rate = ADC_DEFAULT_RATE,
+        .block_len = ADC_DEFAULT_BLOCK,
+        .pre_trigger = ADC_DEFAULT_BLOCK / 4,
+        .trig_mode = CAP_TRIG_NONE,
+        .trig_level = 2048,
+        .hysteresis = 40,
+        .holdoff = holdoff_for(ADC_DEFAULT_RATE, ADC_DEFAULT_BLOCK),
+        .channel = channel,
+    };
+    cap_engine_init(&s_engine, &cfg);
+    s_pending = s_engine.cfg;
+
+    err = adc_driver_config();
+    if (err == ESP_OK) err = adc_continuous_start(s_handle);
+    if (err != ESP_OK) return err;
+
+    xTaskCreatePinnedToCore(adc_capture_task, "adc_capture", 4096, NULL, 5, NULL, 0);
+    return ESP_OK;
+}
+
+esp_err_t adc_capture_set_pin(int pin) {
+    adc_unit_t unit;
+    adc_channel_t channel;
+    if (adc_continuous_io_to_channel(pin, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_pending.channel = channel;
+    s_pending_pin = pin;
+    s_pending_scanning = false;
+    s_reconfigure = s_restart = true;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t adc_capture_set_rate(uint32_t sample_rate, uint16_t block_len) {
+    if (sample_rate < SOC_ADC_SAMPLE_FREQ_THRES_LOW) sample_rate = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+    if (sample_rate > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) sample_rate = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (block_len) s_pending.block_len = block_len;
+    cap_config_sanitize(&s_pending);
+    s_pending.sample_rate = sample_rate;
+    s_pending.holdoff = holdoff_for(sample_rate, s_pending.block_len);
+    s_reconfigure = s_restart = true;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t adc_capture_set_trigger(cap_trig_mode_t mode, uint16_t level, uint16_t pre_trigger, bool single) {
+    if (mode > CAP_TRIG_BELOW || level > 4095) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_pending.trig_mode = mode;
+    s_pending.trig_level = level;
+    s_pending.pre_trigger = pre_trigger;
+    s_pending.single = single;
+    cap_config_sanitize(&s_pending);
+    s_reconfigure = true;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t adc_capture_scan(const int *pins, size_t n, uint32_t rate, uint32_t window_ms, uint16_t points) {
+    scan_config_t cfg = { .channels = n, .points = points, .calibrated = s_calibrated };
+    if (!n || n > SCAN_MAX_CHANNELS) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < n; i++) {
+        adc_unit_t unit;
+        adc_channel_t channel;
+        if (adc_continuous_io_to_channel(pins[i], &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        cfg.adc_channel[i] = channel;
+        cfg.gpio[i] = pins[i];
+    }
+
+    // The converter's limits apply to the sum over all channels
+    uint64_t total = (uint64_t)rate * n;
+    if (total < SOC_ADC_SAMPLE_FREQ_THRES_LOW) total = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+    if (total > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) total = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+    cfg.rate = (uint32_t)(total / n);
+    uint64_t window = (uint64_t)cfg.rate * window_ms / 1000;
+    cfg.per_point = points && window > points ? (uint32_t)(window / points) : 1;
+    cfg.holdoff = holdoff_for(cfg.rate, cfg.per_point * points);
+    if (!scan_config_valid(&cfg)) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_pending_scan = cfg;
+    s_pending_scanning = true;
+    s_reconfigure = s_restart = true;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+size_t adc_capture_cal_json(char *out, size_t out_len) {
+    return scan_lut_to_json(s_lut, s_calibrated, out, out_len);
+}
+
+void adc_capture_rearm(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_rearm = true;
+    xSemaphoreGive(s_lock);
+}
+
+int adc_capture_pin(void) {
+    return s_pin;
+}
+
+uint32_t adc_capture_overruns(void) {
+    return s_overruns;
+}
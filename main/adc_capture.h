@@ -0,0 +1,39 @@
+// Continuous (DMA) ADC capture: one channel into the triggered block
+// engine, or several interleaved channels into min/mean/max envelopes
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "capture_core.h"
+#include "dsp_core.h"
+#include "scan_core.h"
+
+// Framed block (WIRE_ADC_BLOCK or WIRE_ADC_SCAN) ready for the binary WebSocket channel
+typedef void (*adc_block_sink_t)(const uint8_t *frame, size_t len);
+// Mean voltage over the last summary period, for the {"oscilloscope":...} message
+typedef void (*adc_summary_sink_t)(int pin, float voltage);
+// Spectrum and measurements of one single-channel block every ADC_ANALYSIS_MS
+typedef void (*adc_analysis_sink_t)(int pin, const dsp_result_t *analysis);
+// Asked before each analysis; false skips the FFT, e.g. with nobody subscribed
+typedef bool (*adc_analysis_wanted_t)(int pin);
+
+esp_err_t adc_capture_start(int pin, adc_block_sink_t on_block, adc_summary_sink_t on_summary,
+                            adc_analysis_sink_t on_analysis, adc_analysis_wanted_t analysis_wanted);
+
+// All setters only queue the change; the capture task applies it between reads.
+// Back to single-channel triggered capture on pin
+esp_err_t adc_capture_set_pin(int pin);
+// Scan ADC1 pins at rate Hz each; every frame covers window_ms as points
+// min/mean/max values per pin. Rates beyond the converter are clamped.
+esp_err_t adc_capture_scan(const int *pins, size_t n, uint32_t rate, uint32_t window_ms, uint16_t points);
+esp_err_t adc_capture_set_rate(uint32_t sample_rate, uint16_t block_len);
+esp_err_t adc_capture_set_trigger(cap_trig_mode_t mode, uint16_t level, uint16_t pre_trigger, bool single);
+void adc_capture_rearm(void);
+
+int adc_capture_pin(void);
+uint32_t adc_capture_overruns(void);
+
+// {"adc_cal":...}: the code -> mV table, thinned, for converting raw blocks
+size_t adc_capture_cal_json(char *out, size_t out_len);
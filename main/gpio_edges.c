@@ -0,0 +1,190 @@
+// GPIO edges — ISR producer into edge_core's ring, stats task as consumer
+#include "gpio_edges.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <driver/gpio.h>
+
+#define TAG "GpioEdges"
+
+#define EDGE_BOUNCE_US      5000    // edges closer than this count as bounce
+#define EDGE_DRAIN_MS       10
+#define EDGE_PUBLISH_MS     100
+#define EDGE_TAP_BATCH      64
+
+static edge_ring_t s_ring;
+static edge_stats_t s_stats;
+static const int *s_pins;
+static size_t s_num_pins;
+static gpio_edges_sink_t s_sink;
+static gpio_edges_tap_t s_tap;
+static _Atomic uint32_t s_reseed;   // pins whose level must be re-read by the task
+static _Atomic uint32_t s_enabled;  // pins armed through gpio_edges_enable()
+static _Atomic uint32_t s_claimed;  // pins owned by a peripheral, no ISR attached
+static _Atomic uint32_t s_stamp;    // pins whose next edge is only timestamped
+static _Atomic uint32_t s_stamped;
+static uint32_t s_stamp_us[EDGE_MAX_PINS];
+
+static void IRAM_ATTR gpio_edge_isr(void* arg) {
+    uint32_t idx = (uint32_t)(uintptr_t)arg;
+    uint32_t t_us = (uint32_t)esp_timer_get_time();
+    if (atomic_load(&s_stamp) & (1u << idx)) {
+        s_stamp_us[idx] = t_us;
+        atomic_fetch_and(&s_stamp, ~(1u << idx));
+        atomic_fetch_or(&s_stamped, 1u << idx);
+        gpio_intr_disable(s_pins[idx]);
+        return;
+    }
+    edge_event_t ev = {
+        .t_us = t_us,
+        .pin = idx,
+        .level = gpio_get_level(s_pins[idx]),
+    };
+    edge_ring_push(&s_ring, &ev);
+}
+
+// Like edge_stats_drain(), handing the raw events to the tap in batches
+static void drain_tapped(void) {
+    edge_event_t batch[EDGE_TAP_BATCH];
+    size_t total = 0, n;
+    do {
+        for (n = 0; n < EDGE_TAP_BATCH && edge_ring_pop(&s_ring, &batch[n]); n++) {
+            edge_stats_apply(&s_stats, &batch[n]);
+        }
+        if (n) s_tap(batch, n);
+        total += n;
+    } while (n == EDGE_TAP_BATCH && total < EDGE_RING_LEN);
+}
+
+static void gpio_edges_task(void* arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    int64_t next_publish = esp_timer_get_time() + EDGE_PUBLISH_MS * 1000;
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(EDGE_DRAIN_MS));
+        if (s_tap) drain_tapped();
+        else edge_stats_drain(&s_stats, &s_ring, EDGE_RING_LEN);
+
+        // Re-seed after a mode change so the first edge is measured from now
+        uint32_t reseed = atomic_exchange(&s_reseed, 0);
+        for (size_t i = 0; reseed; i++, reseed >>= 1) {
+            if (reseed & 1) edge_stats_seed(&s_stats, i, gpio_get_level(s_pins[i]), (uint32_t)esp_timer_get_time());
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now < next_publish) continue;
+        next_publish = now + EDGE_PUBLISH_MS * 1000;
+
+        if (s_stats.active && s_sink) s_sink(&s_stats, gpio_edges_overruns());
+        edge_stats_window_reset(&s_stats, (uint32_t)now);
+    }
+}
+
+esp_err_t gpio_edges_start(const int *pins, size_t num_pins, uint64_t claimed, gpio_edges_sink_t sink) {
+    if (num_pins > EDGE_MAX_PINS) return ESP_ERR_INVALID_ARG;
+
+    s_pins = pins;
+    s_num_pins = num_pins;
+    s_sink = sink;
+    edge_ring_init(&s_ring);
+    edge_stats_init(&s_stats, num_pins, EDGE_BOUNCE_US, (uint32_t)esp_timer_get_time());
+
+    // The ISR service runs on the calling core, which keeps the ring single-producer
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;
+
+    unsigned armed = 0;
+    for (size_t i = 0; i < num_pins; i++) {
+        atomic_fetch_or(&s_enabled, 1u << i);
+        if ((claimed >> pins[i]) & 1) {
+            atomic_fetch_or(&s_claimed, 1u << i);
+            continue;
+        }
+        gpio_set_intr_type(pins[i], GPIO_INTR_ANYEDGE);
+        gpio_isr_handler_add(pins[i], gpio_edge_isr, (void*)(uintptr_t)i);
+        gpio_edges_enable(i, true);
+        armed++;
+    }
+
+    xTaskCreatePinnedToCore(gpio_edges_task, "gpio_edges", 4096, NULL, 5, NULL, 0);
+    ESP_LOGI(TAG, "Edge capture armed on %u pins", armed);
+    return ESP_OK;
+}
+
+void gpio_edges_set_tap(gpio_edges_tap_t tap) {
+    s_tap = tap;
+}
+
+void gpio_edges_enable(size_t idx, bool enable) {
+    if (idx >= s_num_pins) return;
+    if (enable) {
+        atomic_fetch_or(&s_enabled, 1u << idx);
+        if (atomic_load(&s_claimed) & (1u << idx)) return;
+        atomic_fetch_or(&s_reseed, 1u << idx);
+        gpio_intr_enable(s_pins[idx]);
+    } else {
+        atomic_fetch_and(&s_enabled, ~(1u << idx));
+        if (atomic_load(&s_claimed) & (1u << idx)) return;
+        gpio_intr_disable(s_pins[idx]);
+    }
+}
+
+static int pin_index(int gpio) {
+    for (size_t i = 0; i < s_num_pins; i++) {
+        if (s_pins[i] == gpio) return i;
+    }
+    return -1;
+}
+
+bool gpio_edges_claim(int gpio, bool claimed) {
+    int idx = pin_index(gpio);
+    if (idx < 0) return false;
+    bool was = atomic_load(&s_claimed) & (1u << idx);
+    if (claimed == was) return true;
+    if (claimed) {
+        atomic_fetch_or(&s_claimed, 1u << idx);
+        atomic_fetch_and(&s_stamp, ~(1u << idx));
+        gpio_intr_disable(gpio);
+        gpio_isr_handler_remove(gpio);
+    } else {
+        gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+        gpio_isr_handler_add(gpio, gpio_edge_isr, (void*)(uintptr_t)idx);
+        atomic_fetch_and(&s_claimed, ~(1u << idx));
+        gpio_edges_enable(idx, atomic_load(&s_enabled) & (1u << idx));
+    }
+    return true;
+}
+
+bool gpio_edges_stamp_arm(int gpio) {
+    int idx = pin_index(gpio);
+    if (idx < 0 || (atomic_load(&s_claimed) & (1u << idx))) return false;
+    atomic_fetch_and(&s_stamped, ~(1u << idx));
+    atomic_fetch_or(&s_stamp, 1u << idx);
+    gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+    gpio_intr_enable(gpio);
+    return true;
+}
+
+bool gpio_edges_stamp_read(int gpio, uint32_t *t_us) {
+    int idx = pin_index(gpio);
+    if (idx < 0 || !(atomic_load(&s_stamped) & (1u << idx))) return false;
+    *t_us = s_stamp_us[idx];
+    return true;
+}
+
+void gpio_edges_stamp_release(int gpio) {
+    int idx = pin_index(gpio);
+    if (idx < 0 || (atomic_load(&s_claimed) & (1u << idx))) return;
+    atomic_fetch_and(&s_stamp, ~(1u << idx));
+    atomic_fetch_and(&s_stamped, ~(1u << idx));
+    // Peripherals that reset the pad also reset its interrupt type
+    gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+    gpio_edges_enable(idx, atomic_load(&s_enabled) & (1u << idx));
+}
+
+uint32_t gpio_edges_overruns(void) {
+    return atomic_load(&s_ring.overruns);
+}
@@ -0,0 +1,39 @@
+// Interrupt-driven GPIO edge capture with esp_timer timestamps
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "edge_core.h"
+
+// Called from the edge task once per publish period with pending activity.
+// stats->active and stats->level_changed tell which pins moved.
+typedef void (*gpio_edges_sink_t)(const edge_stats_t *stats, uint32_t overruns);
+
+// claimed: bit mask of GPIOs a peripheral owns (UART, I2C...); they get no
+// edge interrupt until released with gpio_edges_claim()
+esp_err_t gpio_edges_start(const int *pins, size_t num_pins, uint64_t claimed, gpio_edges_sink_t sink);
+
+// Hand a pin to a peripheral (its interrupt is removed and stays off) or
+// take it back. False if gpio is not a monitored pin.
+bool gpio_edges_claim(int gpio, bool claimed);
+
+// Raw events as the edge task drains them, every EDGE_DRAIN_MS, e.g. for the recorder
+typedef void (*gpio_edges_tap_t)(const edge_event_t *ev, size_t n);
+void gpio_edges_set_tap(gpio_edges_tap_t tap);
+
+// Arm or disarm the edge interrupt of one pin (by index), e.g. on mode change.
+// A claimed pin only records the wish, applied when it is released.
+void gpio_edges_enable(size_t idx, bool enable);
+
+uint32_t gpio_edges_overruns(void);
+
+// One-shot timestamp for aligning logic analyzer channels: the next edge on
+// gpio is stamped and the pin's interrupt then stays off, so a MHz signal
+// can't flood the ISR. False if gpio is not a monitored pin or is claimed.
+bool gpio_edges_stamp_arm(int gpio);
+// Stamp of the armed edge (esp_timer us); false while it hasn't happened
+bool gpio_edges_stamp_read(int gpio, uint32_t *t_us);
+// Back to normal edge reporting, as set by gpio_edges_enable()
+void gpio_edges_stamp_release(int gpio);
@@ -0,0 +1,217 @@
+// I2C engine — a worker task owns the i2c_master bus and runs queued jobs,
+// streaming each result as soon as it completes.
+#include "i2c_engine.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <driver/i2c_master.h>
+
+#define TAG "I2cEngine"
+
+#define I2C_JOB_QUEUE       4
+#define I2C_TIMEOUT_MS      20
+#define I2C_SCAN_FIRST      0x08
+#define I2C_SCAN_LAST       0x77
+#define I2C_SCAN_PROGRESS   16      // addresses between progress messages
+#define I2C_STUCK_LIMIT     3       // consecutive timeouts before a scan gives up
+#define I2C_MIN_CLK         10000
+#define I2C_MAX_CLK         1000000
+
+typedef enum {
+    I2C_JOB_SCAN,
+    I2C_JOB_TXN,
+} i2c_job_type_t;
+
+typedef struct {
+    i2c_job_type_t type;
+    uint32_t id;
+    uint32_t targets;
+    i2c_txn_t txn;
+} i2c_job_t;
+
+static i2c_master_bus_handle_t s_bus;
+static QueueHandle_t s_jobs;
+static i2c_result_sink_t s_sink;
+static _Atomic uint32_t s_clk_hz;
+static _Atomic uint32_t s_next_id = 1;
+
+// Owned by the worker task
+static char s_json[1536];
+static uint8_t s_rx[I2C_MAX_READ];
+
+static uint32_t elapsed_us(int64_t start) {
+    return (uint32_t)(esp_timer_get_time() - start);
+}
+
+static void emit(uint32_t targets, size_t len) {
+    if (len && s_sink) s_sink(targets, s_json, len);
+}
+
+static void run_scan(const i2c_job_t* job) {
+    uint8_t found[I2C_SCAN_LAST - I2C_SCAN_FIRST + 1];
+    size_t n_found = 0;
+    int timeouts = 0;
+    esp_err_t fail = ESP_OK;
+    int64_t start = esp_timer_get_time();
+
+    for (int addr = I2C_SCAN_FIRST; addr <= I2C_SCAN_LAST; addr++) {
+        esp_err_t err = i2c_master_probe(s_bus, addr, I2C_TIMEOUT_MS);
+        if (err == ESP_OK) {
+            found[n_found++] = addr;
+            timeouts = 0;
+        } else if (err == ESP_ERR_TIMEOUT) {
+            // SDA held low or no pull-ups: every further probe would time out too
+            i2c_master_bus_reset(s_bus);
+            if (++timeouts >= I2C_STUCK_LIMIT) {
+                fail = err;
+                ESP_LOGW(TAG, "Scan aborted at 0x%02x, bus not responding", addr);
+                break;
+            }
+        } else {
+            timeouts = 0;
+        }
+
+        if ((addr - I2C_SCAN_FIRST + 1) % I2C_SCAN_PROGRESS == 0 && addr < I2C_SCAN_LAST) {
+            emit(job->targets, i2c_scan_to_json(job->id, found, n_found, addr + 1, false, 0, "",
+                                                s_json, sizeof(s_json)));
+        }
+    }
+    emit(job->targets, i2c_scan_to_json(job->id, found, n_found, 0, true, elapsed_us(start),
+                                        esp_err_to_name(fail), s_json, sizeof(s_json)));
+}
+
+static esp_err_t run_op(i2c_master_dev_handle_t dev, const i2c_op_t* op, size_t* n) {
+    uint8_t wbuf[1 + I2C_MAX_WRITE];
+    esp_err_t err = ESP_OK;
+    *n = 0;
+
+    switch (op->type) {
+    case I2C_OP_WRITE:
+        wbuf[0] = op->reg;
+        memcpy(wbuf + 1, op->data, op->len);
+        err = i2c_master_transmit(dev, wbuf, 1 + op->len, I2C_TIMEOUT_MS);
+        if (err == ESP_OK) *n = op->len;
+        break;
+    case I2C_OP_READ:
+        err = i2c_master_transmit_receive(dev, &op->reg, 1, s_rx, op->len, I2C_TIMEOUT_MS);
+        if (err == ESP_OK) *n = op->len;
+        break;
+    case I2C_OP_DUMP:
+        // Short transactions so devices without long auto-increment still answer
+        while (*n < op->len && err == ESP_OK) {
+            uint8_t reg = op->reg + *n;
+            size_t chunk = op->len - *n < I2C_DUMP_CHUNK ? op->len - *n : I2C_DUMP_CHUNK;
+            err = i2c_master_transmit_receive(dev, &reg, 1, s_rx + *n, chunk, I2C_TIMEOUT_MS);
+            if (err == ESP_OK) *n += chunk;
+        }
+        break;
+    }
+    return err;
+}
+
+static void run_txn(const i2c_job_t* job) {
+    const i2c_txn_t* txn = &job->txn;
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = txn->addr,
+        .scl_speed_hz = atomic_load(&s_clk_hz),
+    };
+    i2c_master_dev_handle_t dev;
+    esp_err_t err = i2c_master_bus_add_device(s_bus, &dev_cfg, &dev);
+    if (err != ESP_OK) {
+        int len = snprintf(s_json, sizeof(s_json), "{\"i2c_done\":{\"job\":%lu,\"err\":\"%s\"}}",
+                           (unsigned long)job->id, esp_err_to_name(err));
+        emit(job->targets, len);
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    int failed = 0;
+    for (int i = 0; i < txn->n_ops; i++) {
+        size_t n;
+        int64_t t = esp_timer_get_time();
+        err = run_op(dev, &txn->ops[i], &n);
+        uint32_t us = elapsed_us(t);
+        if (err != ESP_OK) failed++;
+        emit(job->targets, i2c_op_to_json(job->id, i, txn->addr, &txn->ops[i], s_rx, n, us,
+                                          esp_err_to_name(err), s_json, sizeof(s_json)));
+        if (err == ESP_ERR_TIMEOUT) {
+            i2c_master_bus_reset(s_bus);
+            break;  // the bus is wedged, the rest of the batch would only time out
+        }
+    }
+    i2c_master_bus_rm_device(dev);
+
+    int len = snprintf(s_json, sizeof(s_json),
+                       "{\"i2c_done\":{\"job\":%lu,\"addr\":%u,\"ops\":%u,\"failed\":%d,\"us\":%lu,\"clk\":%lu}}",
+                       (unsigned long)job->id, txn->addr, txn->n_ops, failed,
+                       (unsigned long)elapsed_us(start), (unsigned long)dev_cfg.scl_speed_hz);
+    emit(job->targets, len);
+}
+
+static void i2c_worker_task(void* arg) {
+    static i2c_job_t job;
+    while (1) {
+        if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+        if (job.type == I2C_JOB_SCAN) run_scan(&job);
+        else run_txn(&job);
+    }
+}
+
+esp_err_t i2c_engine_start(int port, int sda_pin, int scl_pin, uint32_t clk_hz, i2c_result_sink_t sink) {
+    s_sink = sink;
+    atomic_store(&s_clk_hz, clk_hz);
+
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = port,
+        .sda_io_num = sda_pin,
+        .scl_io_num = scl_pin,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &s_bus);
+    if (err != ESP_OK) return err;
+
+    s_jobs = xQueueCreate(I2C_JOB_QUEUE, sizeof(i2c_job_t));
+    if (!s_jobs) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(i2c_worker_task, "i2c_worker", 4096, NULL, 3, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static uint32_t queue_job(i2c_job_t* job) {
+    job->id = atomic_fetch_add(&s_next_id, 1);
+    if (xQueueSend(s_jobs, job, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Job queue full, job dropped");
+        return 0;
+    }
+    return job->id;
+}
+
+uint32_t i2c_engine_scan(uint32_t targets) {
+    i2c_job_t job = { .type = I2C_JOB_SCAN, .targets = targets };
+    return queue_job(&job);
+}
+
+uint32_t i2c_engine_txn(uint32_t targets, const i2c_txn_t *txn) {
+    i2c_job_t job = { .type = I2C_JOB_TXN, .targets = targets, .txn = *txn };
+    return queue_job(&job);
+}
+
+esp_err_t i2c_engine_set_clock(uint32_t clk_hz) {
+    if (clk_hz < I2C_MIN_CLK || clk_hz > I2C_MAX_CLK) return ESP_ERR_INVALID_ARG;
+    atomic_store(&s_clk_hz, clk_hz);
+    return ESP_OK;
+}
+
+uint32_t i2c_engine_clock(void) {
+    return atomic_load(&s_clk_hz);
+}
@@ -0,0 +1,20 @@
+// I2C bus worker — scans and register transactions run off the httpd task
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "i2c_core.h"
+
+// Results are streamed as JSON to the slot mask that queued the job
+typedef void (*i2c_result_sink_t)(uint32_t targets, const char *json, size_t len);
+
+esp_err_t i2c_engine_start(int port, int sda_pin, int scl_pin, uint32_t clk_hz, i2c_result_sink_t sink);
+
+// Queue a job; returns its id, or 0 when the queue is full
+uint32_t i2c_engine_scan(uint32_t targets);
+uint32_t i2c_engine_txn(uint32_t targets, const i2c_txn_t *txn);
+
+// SCL clock for the jobs that start after this call
+esp_err_t i2c_engine_set_clock(uint32_t clk_hz);
+uint32_t i2c_engine_clock(void);
@@ -0,0 +1,387 @@
+// Logic analyzer — each pin gets an RMT receive channel that records level
+// durations at up to 80 MHz. RMT ends a receive after LOGIC_IDLE_TICKS of
+// silence, so every channel is re-armed per burst and each burst is placed
+// on the common time base by a one-shot GPIO edge timestamp. Channels are
+// therefore aligned to within the GPIO interrupt latency (~2 us); timing
+// within one burst is exact. Edges in the few microseconds it takes to
+// re-arm a channel are lost.
+//
+// With a trigger the capture arms instead: every LOGIC_SEARCH_MS the bursts
+// recorded so far are merged and searched, up to the tick where some channel
+// may still be receiving (its edge stamp has fired but the burst is not in).
+// Until the trigger matches, history older than the pre-trigger window is
+// dropped as each channel's bursts complete; after it, the capture runs on
+// for the rest of the window and only the window around the match is sent.
+#include "logic_capture.h"
+#include "gpio_edges.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <driver/gpio.h>
+#include <driver/rmt_rx.h>
+#include <soc/soc_caps.h>
+
+#define TAG "Logic"
+
+#define LOGIC_APB_HZ        80000000
+#define LOGIC_IDLE_TICKS    30000           // RMT durations are 15 bit, the idle threshold stays below
+#define LOGIC_HEAP_RESERVE  (32 * 1024)     // left for WiFi and the web server
+#define LOGIC_MAX_BUFFER    (96 * 1024)
+#define LOGIC_MAX_SEGMENTS  128             // bursts per channel
+#define LOGIC_POLL_MS       10
+#define LOGIC_BURST_BLOCKS  8               // blocks queued before letting the sender drain
+#define LOGIC_BURST_MS      20
+#define LOGIC_SEARCH_MS     20              // trigger search period while armed
+#define LOGIC_ARM_MAX_MS    600000          // esp_timer stamps are 32-bit us, keep well inside
+#define LOGIC_SLACK_US      10              // edge stamps lag the edge by the interrupt latency
+#define LOGIC_SETTLE_MS     1000            // after the window, for the last bursts to come in
+
+typedef struct {
+    uint32_t targets;
+    uint32_t id;
+    logic_config_t cfg;
+} logic_job_t;
+
+typedef struct {
+    uint8_t ch;
+    uint16_t count;
+    uint32_t t_us;
+} logic_event_t;
+
+typedef struct {
+    rmt_channel_handle_t handle;
+    uint32_t *symbols;
+    size_t cap;
+    size_t used;
+    la_segment_t *segs;
+    size_t num_segs;
+    uint8_t level;                  // before the first burst
+    bool full;
+    bool stamped;                   // the current burst's first edge gets a timestamp
+} logic_chan_t;
+
+static QueueHandle_t s_jobs;
+static QueueHandle_t s_events;
+static logic_sink_t s_sink;
+static _Atomic bool s_busy;
+static _Atomic bool s_stop;
+static _Atomic uint32_t s_next_id = 1;
+
+// Owned by the capture task
+static logic_chan_t s_chans[LA_MAX_CHANNELS];
+static size_t s_hw_symbols;
+static uint32_t s_tick_hz;
+static uint32_t s_origin_us;
+static char s_json[384];
+static uint8_t s_block[LA_BLOCK_MAX];
+
+static bool IRAM_ATTR on_recv_done(rmt_channel_handle_t chan, const rmt_rx_done_event_data_t *edata, void *ctx) {
+    logic_event_t ev = {
+        .ch = (uint8_t)(uintptr_t)ctx,
+        .count = edata->num_symbols,
+        .t_us = (uint32_t)esp_timer_get_time(),
+    };
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(s_events, &ev, &woken);
+    return woken == pdTRUE;
+}
+
+static uint64_t us_to_ticks(uint32_t us) {
+    return (uint64_t)us * s_tick_hz / 1000000;
+}
+
+static void emit_error(uint32_t targets, const char *msg) {
+    int n = snprintf(s_json, sizeof(s_json), "{\"logic_error\":\"%s\"}", msg);
+    if (n > 0 && (size_t)n < sizeof(s_json) && s_sink) s_sink(targets, s_json, n, false);
+}
+
+static bool arm_burst(const logic_config_t *cfg, size_t i) {
+    logic_chan_t *c = &s_chans[i];
+    // A burst longer than the channel's RMT memory is cut there, so that much must fit
+    if (c->cap - c->used < s_hw_symbols || c->num_segs == LOGIC_MAX_SEGMENTS) {
+        c->full = true;
+        return false;
+    }
+    rmt_receive_config_t rx = {
+        .signal_range_min_ns = 0,
+        .signal_range_max_ns = (uint32_t)((uint64_t)LOGIC_IDLE_TICKS * 1000000000 / s_tick_hz),
+    };
+    if (rmt_receive(c->handle, c->symbols + c->used, (c->cap - c->used) * sizeof(uint32_t), &rx) != ESP_OK) {
+        c->full = true;
+        return false;
+    }
+    c->stamped = gpio_edges_stamp_arm(cfg->gpios[i]);
+    return true;
+}
+
+static void record_burst(const logic_config_t *cfg, const logic_event_t *ev) {
+    logic_chan_t *c = &s_chans[ev->ch];
+    if (!ev->count || c->used + ev->count > c->cap) return;
+
+    uint32_t stamp;
+    uint64_t start;
+    if (gpio_edges_stamp_read(cfg->gpios[ev->ch], &stamp)) {
+        start = us_to_ticks(stamp - s_origin_us);
+    } else {
+        // No stamp (pin not monitored): back-date from the end of the idle period
+        uint64_t len = LOGIC_IDLE_TICKS;
+        for (size_t k = 0; k < ev->count; k++) {
+            uint32_t sym = c->symbols[c->used + k];
+            len += (sym & 0x7FFF) + ((sym >> 16) & 0x7FFF);
+        }
+        uint64_t end = us_to_ticks(ev->t_us - s_origin_us);
+        start = end > len ? end - len : 0;
+    }
+    c->segs[c->num_segs++] = (la_segment_t){ .start = start, .first = c->used, .count = ev->count };
+    c->used += ev->count;
+}
+
+static bool merge_channels(const logic_config_t *cfg, la_rle_t *rle, la_run_t *runs, size_t run_cap) {
+    la_rmt_chan_t chans[LA_MAX_CHANNELS];
+    for (size_t i = 0; i < cfg->channels; i++) {
+        logic_chan_t *c = &s_chans[i];
+        chans[i] = (la_rmt_chan_t){ .symbols = c->symbols, .segs = c->segs, .num_segs = c->num_segs, .level = c->level };
+    }
+    la_rle_init(rle, runs, run_cap);
+    return la_merge_rmt(rle, chans, cfg->channels);
+}
+
+// Ticks up to which every channel's bursts are in. A fired edge stamp means
+// that channel is still receiving, or its burst is queued, from that edge on;
+// a channel without stamps can be a whole RMT burst behind.
+static uint64_t settled_ticks(const logic_config_t *cfg) {
+    uint64_t now = us_to_ticks((uint32_t)esp_timer_get_time() - s_origin_us);
+    uint64_t unstamped = (uint64_t)s_hw_symbols * 2 * 0x7FFF + LOGIC_IDLE_TICKS;
+    uint64_t settled = now;
+    for (size_t i = 0; i < cfg->channels; i++) {
+        uint32_t stamp;
+        uint64_t t = now;
+        if (!s_chans[i].stamped) {
+            t = now > unstamped ? now - unstamped : 0;
+        } else if (gpio_edges_stamp_read(cfg->gpios[i], &stamp)) {
+            uint32_t us = stamp - s_origin_us;
+            t = us_to_ticks(us > LOGIC_SLACK_US ? us - LOGIC_SLACK_US : 0);
+        }
+        if (t < settled) settled = t;
+    }
+    return settled;
+}
+
+// Tick of the first trigger match before settled, UINT64_MAX if none yet
+static uint64_t find_trigger(const logic_config_t *cfg, la_run_t *runs, size_t run_cap, uint64_t settled) {
+    la_rle_t rle;
+    merge_channels(cfg, &rle, runs, run_cap);
+    size_t at = la_trigger_find(&cfg->trigger, runs, rle.count, 0);
+    if (at == LA_NONE) return UINT64_MAX;
+    uint64_t tick = la_rle_tick(runs, at);
+    return tick < settled ? tick : UINT64_MAX;
+}
+
+// A triggered capture sends the window ticks around the trigger, pre of them
+// ahead of it; an armed one that never fired sends its last window, and a
+// capture without a trigger everything.
+static void send_capture(const logic_job_t *job, la_run_t *runs, size_t run_cap, bool truncated, uint64_t trigger,
+                         uint64_t window, uint64_t pre) {
+    const logic_config_t *cfg = &job->cfg;
+    la_rle_t rle;
+    truncated |= !merge_channels(cfg, &rle, runs, run_cap);
+
+    size_t at = LA_NONE;
+    if (trigger != UINT64_MAX) {
+        uint64_t from = trigger > pre ? trigger - pre : 0;
+        rle.count = la_rle_window(runs, rle.count, from, from + window);
+        // Clipping leaves a run starting at the trigger tick
+        uint64_t t = 0;
+        for (at = 0; at < rle.count && t < trigger - from; at++) t += runs[at].ticks;
+    } else if (cfg->trigger.mask) {
+        rle.count = la_rle_window(runs, rle.count, rle.ticks > window ? rle.ticks - window : 0, rle.ticks);
+    }
+    rle.ticks = la_rle_tick(runs, rle.count);
+
+    la_summary_t sum = {
+        .id = job->id, .gpios = cfg->gpios, .channels = cfg->channels, .tick_hz = s_tick_hz,
+        .runs = rle.count, .ticks = rle.ticks, .trigger = at, .truncated = truncated,
+    };
+    size_t len = la_summary_to_json(&sum, runs, s_json, sizeof(s_json));
+    if (len && s_sink) s_sink(job->targets, s_json, len, false);
+
+    la_framer_t fr;
+    uint8_t flags = (at != LA_NONE ? LA_FLAG_TRIGGERED : 0) | (truncated ? LA_FLAG_TRUNCATED : 0);
+    la_framer_init(&fr, runs, rle.count, cfg->channels, job->id, flags);
+    for (int blocks = 1; (len = la_framer_next(&fr, s_block, sizeof(s_block))) > 0; blocks++) {
+        if (s_sink) s_sink(job->targets, s_block, len, true);
+        // Stay inside the broadcast byte budget on big captures
+        if (blocks % LOGIC_BURST_BLOCKS == 0) vTaskDelay(pdMS_TO_TICKS(LOGIC_BURST_MS));
+    }
+    ESP_LOGI(TAG, "Capture %lu: %u runs over %llu ticks at %lu Hz%s%s", (unsigned long)job->id,
+             (unsigned)rle.count, (unsigned long long)rle.ticks, (unsigned long)s_tick_hz,
+             at != LA_NONE ? ", triggered" : cfg->trigger.mask ? ", no trigger" : "",
+             truncated ? " (truncated)" : "");
+}
+
+static void run_capture(const logic_job_t *job) {
+    const logic_config_t *cfg = &job->cfg;
+    size_t n = cfg->channels;
+
+    uint32_t div = LOGIC_APB_HZ / cfg->sample_hz;
+    div = div < 1 ? 1 : div > 255 ? 255 : div;
+    s_tick_hz = LOGIC_APB_HZ / div;
+    s_hw_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL * (SOC_RMT_RX_CANDIDATES_PER_GROUP / n);
+
+    // Depth is whatever the heap allows: per symbol, its word plus up to two merged runs
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    size_t budget = free_bytes > LOGIC_HEAP_RESERVE ? free_bytes - LOGIC_HEAP_RESERVE : 0;
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (budget > largest) budget = largest;
+    if (budget > LOGIC_MAX_BUFFER) budget = LOGIC_MAX_BUFFER;
+    size_t seg_bytes = n * LOGIC_MAX_SEGMENTS * sizeof(la_segment_t);
+    size_t cap = budget > seg_bytes ? (budget - seg_bytes) / n / (sizeof(uint32_t) + 2 * sizeof(la_run_t)) : 0;
+    if (cap < s_hw_symbols) {
+        emit_error(job->targets, "not enough memory");
+        return;
+    }
+    // Plus a run per 2^32 ticks of the idle stretch an armed wait can leave
+    size_t run_cap = 2 * n * cap + 2 + 16;
+    uint8_t *mem = heap_caps_malloc(seg_bytes + run_cap * sizeof(la_run_t) + n * cap * sizeof(uint32_t),
+                                    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!mem) {
+        emit_error(job->targets, "not enough memory");
+        return;
+    }
+    la_segment_t *segs = (la_segment_t *)mem;
+    la_run_t *runs = (la_run_t *)(mem + seg_bytes);
+    uint32_t *symbols = (uint32_t *)(runs + run_cap);
+
+    rmt_rx_event_callbacks_t cbs = { .on_recv_done = on_recv_done };
+    esp_err_t err = ESP_OK;
+    size_t opened = 0;
+    memset(s_chans, 0, sizeof(s_chans));
+    for (; opened < n; opened++) {
+        logic_chan_t *c = &s_chans[opened];
+        c->symbols = symbols + opened * cap;
+        c->cap = cap;
+        c->segs = segs + opened * LOGIC_MAX_SEGMENTS;
+        rmt_rx_channel_config_t rc = {
+            .gpio_num = cfg->gpios[opened],
+            .clk_src = RMT_CLK_SRC_DEFAULT,
+            .resolution_hz = s_tick_hz,
+            .mem_block_symbols = s_hw_symbols,
+        };
+        err = rmt_new_rx_channel(&rc, &c->handle);
+        if (err != ESP_OK) break;
+        rmt_rx_register_event_callbacks(c->handle, &cbs, (void *)(uintptr_t)opened);
+        err = rmt_enable(c->handle);
+        if (err != ESP_OK) break;
+        c->level = gpio_get_level(cfg->gpios[opened]);
+    }
+
+    bool truncated = false;
+    bool armed = cfg->trigger.mask != 0;
+    uint64_t window = (uint64_t)cfg->duration_ms * s_tick_hz / 1000;
+    uint64_t pre = armed ? window * cfg->pre_percent / 100 : 0;
+    uint64_t trigger = UINT64_MAX;
+    if (err == ESP_OK) {
+        xQueueReset(s_events);
+        int64_t origin = esp_timer_get_time();
+        s_origin_us = (uint32_t)origin;
+        for (size_t i = 0; i < n; i++) arm_burst(cfg, i);
+
+        int64_t deadline = origin + (int64_t)(armed ? LOGIC_ARM_MAX_MS : cfg->duration_ms) * 1000;
+        int64_t next_search = origin;
+        uint64_t cut = 0;
+        logic_event_t ev;
+        while (!atomic_load(&s_stop) && !truncated && esp_timer_get_time() < deadline) {
+            if (xQueueReceive(s_events, &ev, pdMS_TO_TICKS(LOGIC_POLL_MS)) == pdTRUE) {
+                record_burst(cfg, &ev);
+                // Between bursts nothing is receiving into the channel's buffer, so its history can move
+                logic_chan_t *c = &s_chans[ev.ch];
+                if (cut) c->used -= la_rmt_drop(c->symbols, c->segs, &c->num_segs, &c->level, cut);
+                // One full channel ends the capture; the others would run on unaligned
+                truncated = !arm_burst(cfg, ev.ch);
+            }
+            if (!armed || esp_timer_get_time() < next_search) continue;
+
+            next_search = esp_timer_get_time() + LOGIC_SEARCH_MS * 1000;
+            uint64_t settled = settled_ticks(cfg);
+            if (trigger != UINT64_MAX) {
+                // Run on until every channel's bursts are in past the end of the window
+                if (settled >= trigger + window - pre) break;
+                continue;
+            }
+            trigger = find_trigger(cfg, runs, run_cap, settled);
+            if (trigger != UINT64_MAX) {
+                deadline = esp_timer_get_time() + ((int64_t)cfg->duration_ms + LOGIC_SETTLE_MS) * 1000;
+            } else if (settled > pre) {
+                // No match up to settled, so only its last pre ticks can still lead one
+                cut = settled - pre;
+            }
+        }
+    } else {
+        ESP_LOGE(TAG, "RMT channel for GPIO%d: %s", cfg->gpios[opened], esp_err_to_name(err));
+    }
+
+    for (size_t i = 0; i <= opened && i < n; i++) {
+        if (!s_chans[i].handle) continue;
+        rmt_disable(s_chans[i].handle);
+        rmt_del_channel(s_chans[i].handle);
+        gpio_edges_stamp_release(cfg->gpios[i]);
+    }
+    if (err == ESP_OK) {
+        // Bursts that completed while the channels were being stopped
+        logic_event_t ev;
+        while (xQueueReceive(s_events, &ev, 0) == pdTRUE) record_burst(cfg, &ev);
+        send_capture(job, runs, run_cap, truncated, trigger, window, pre);
+    } else {
+        emit_error(job->targets, esp_err_to_name(err));
+    }
+    free(mem);
+}
+
+static void logic_task(void *arg) {
+    static logic_job_t job;
+    while (1) {
+        if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+        atomic_store(&s_stop, false);
+        run_capture(&job);
+        atomic_store(&s_busy, false);
+    }
+}
+
+esp_err_t logic_capture_start(logic_sink_t sink) {
+    s_sink = sink;
+    s_jobs = xQueueCreate(1, sizeof(logic_job_t));
+    s_events = xQueueCreate(4 * LA_MAX_CHANNELS, sizeof(logic_event_t));
+    if (!s_jobs || !s_events) return ESP_ERR_NO_MEM;
+    // Merging a deep capture takes a while; keep it off the core running WiFi
+    if (xTaskCreatePinnedToCore(logic_task, "logic", 4096, NULL, 3, NULL, 1) != pdPASS) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t logic_capture_arm(uint32_t targets, const logic_config_t *cfg) {
+    if (!cfg->channels || cfg->channels > LA_MAX_CHANNELS || cfg->channels > SOC_RMT_RX_CANDIDATES_PER_GROUP ||
+        !cfg->sample_hz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_busy, &idle, true)) return ESP_ERR_INVALID_STATE;
+
+    logic_job_t job = { .targets = targets, .id = atomic_fetch_add(&s_next_id, 1), .cfg = *cfg };
+    if (xQueueSend(s_jobs, &job, 0) != pdTRUE) {
+        atomic_store(&s_busy, false);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+void logic_capture_stop(void) {
+    atomic_store(&s_stop, true);
+}
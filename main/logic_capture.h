@@ -0,0 +1,30 @@
+// Logic analyzer — one RMT receive channel per pin, merged and run-length
+// coded by logic_core, streamed as binary blocks
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "logic_core.h"
+
+// JSON summary first, then the binary blocks, to the slot mask that armed the capture
+typedef void (*logic_sink_t)(uint32_t targets, const void *data, size_t len, bool binary);
+
+typedef struct {
+    int gpios[LA_MAX_CHANNELS];         // channel n = bit n of a run word
+    uint8_t channels;
+    uint32_t sample_hz;                 // rounded to an 80 MHz / n RMT tick
+    uint32_t duration_ms;               // the window sent, pre-trigger included
+    la_trigger_t trigger;               // an empty mask captures at once
+    uint8_t pre_percent;                // of the window ahead of the trigger
+} logic_config_t;
+
+esp_err_t logic_capture_start(logic_sink_t sink);
+
+// ESP_ERR_INVALID_STATE while a capture is running or armed
+esp_err_t logic_capture_arm(uint32_t targets, const logic_config_t *cfg);
+
+// End the running capture early, or give up waiting for the trigger; what
+// was captured is still sent
+void logic_capture_stop(void);
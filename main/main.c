@@ -5,24 +5,35 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <esp_log.h>
-#include <esp_event.h>
 #include <esp_system.h>
-#include <esp_wifi.h>
 #include <nvs_flash.h>
-#include <esp_netif.h>
 #include "esp_spiffs.h"
 #include <driver/gpio.h>
-#include <driver/ledc.h>
 #include <driver/uart.h>
-#include <driver/i2c.h>
 #include <esp_timer.h>
 #include <esp_rom_sys.h>
-#include <esp_adc/adc_oneshot.h>
+#include "adc_capture.h"
+#include "gpio_edges.h"
+#include "pin_proto.h"
+#include "pin_store.h"
+#include "topic_core.h"
+#include "dbg_wire.h"
+#include "ws_broadcast.h"
+#include "uart_bridge.h"
+#include "i2c_engine.h"
+#include "cmd_core.h"
+#include "metrics.h"
+#include "logic_capture.h"
+#include "sequencer.h"
+#include "pwm_engine.h"
+#include "recorder.h"
+#include "wifi_link.h"
+#include "static_assets.h"
+#include <freertos/semphr.h>
 
 #define TAG "WebDebug"
-#define WIFI_SSID "Nokia Repeater"
-#define WIFI_PASS "12345678"
 
 // AP Configuration
 #define AP_SSID "ESP32-Debugger"
@@ -33,17 +44,17 @@
 
 #define I2C_MASTER_SDA 21
 #define I2C_MASTER_SCL 22
-#define I2C_PORT I2C_NUM_0
+#define I2C_PORT 0
+#define I2C_DEFAULT_CLK 100000
 #define UART_PORT UART_NUM_1
 #define UART_TX 17
 #define UART_RX 16
+#define UART_DEFAULT_BAUD 115200
 
-#define OSCILLO_ADC_CHANNEL ADC_CHANNEL_6  // GPIO34 = ADC1_CH6
-#define MAX_WS_CLIENTS 8
+#define OSCILLO_DEFAULT_PIN 34  // GPIO34 = ADC1_CH6
+#define MAX_WS_CLIENTS BCAST_MAX_CLIENTS
 
 // Function prototypes
-static void network_init_task(void* parameter);
-
 static httpd_handle_t server = NULL;
 
 static const int usable_pins[] = {
@@ -52,18 +63,26 @@ static const int usable_pins[] = {
 };
 #define NUM_PINS (sizeof(usable_pins) / sizeof(usable_pins[0]))
 
-static bool pin_modes[NUM_PINS];
-static bool pin_states[NUM_PINS];
-static unsigned int bounce_counters[NUM_PINS];
-static unsigned long last_change_times[NUM_PINS];
-static int pwm_frequencies[NUM_PINS];
+// Routed to a peripheral at boot: never reset, re-moded or driven by commands
+#define PERIPHERAL_PINS ((1ull << UART_TX) | (1ull << UART_RX) | \
+                         (1ull << I2C_MASTER_SDA) | (1ull << I2C_MASTER_SCL))
+
+// Mode, level, PWM frequency and bounce count of every pin. Written from
+// the edge task (core 0), the httpd handler and the sequencer task, read
+// lock-free by all of them and by the ws sender.
+static pin_store_t pin_store;
+static SemaphoreHandle_t pin_write_lock;    // serializes pin_store writers
+#define PIN_READ_TRIES 4
 
-static adc_oneshot_unit_handle_t adc_handle;
-static int oscillo_pin = 34;
-static float last_voltage = 0.0f;
-static const float smoothing_factor = 0.3f;
+// Per-client protocol state, indexed by ws_broadcast slot
+typedef struct {
+    bool binary;        // negotiated PROTO:BIN, pin states go out as pin_proto deltas
+    uint32_t acked;     // last pin-state version the client acknowledged (0 = none)
+} ws_client_t;
 
-static int ws_clients[MAX_WS_CLIENTS];
+static ws_client_t ws_clients[MAX_WS_CLIENTS];
+static topic_table_t topics;                // what each slot subscribed to (SUB/UNSUB)
+static SemaphoreHandle_t clients_lock;      // ws_clients[], topics and the shared pin JSON buffer
 
 static int get_pin_index(int pin) {
     for (int i = 0; i < NUM_PINS; i++) {
@@ -72,121 +91,876 @@ static int get_pin_index(int pin) {
     return -1;
 }
 
+static bool peripheral_pin(int pin) {
+    return pin >= 0 && pin < 64 && ((PERIPHERAL_PINS >> pin) & 1);
+}
+
+// Lock-free, unless a writer was preempted mid-update by this task on the
+// same core: then wait behind the writers' lock, whose priority
+// inheritance lets the writer finish
+static void pin_snapshot(pin_snapshot_t* snap) {
+    if (pin_store_read(&pin_store, snap, PIN_READ_TRIES)) return;
+    xSemaphoreTake(pin_write_lock, portMAX_DELAY);
+    pin_store_read(&pin_store, snap, 1);
+    xSemaphoreGive(pin_write_lock);
+}
+
+static pin_state_t pin_get(int idx) {
+    pin_state_t pin;
+    if (!pin_store_read_pin(&pin_store, idx, &pin, PIN_READ_TRIES)) {
+        xSemaphoreTake(pin_write_lock, portMAX_DELAY);
+        pin_store_read_pin(&pin_store, idx, &pin, 1);
+        xSemaphoreGive(pin_write_lock);
+    }
+    return pin;
+}
+
+// Writers keep the bracket to plain stores; driver calls go outside it
+static void pins_write_begin(void) {
+    xSemaphoreTake(pin_write_lock, portMAX_DELAY);
+    pin_store_write_begin(&pin_store);
+}
+
+static void pins_write_end(void) {
+    pin_store_write_end(&pin_store);
+    xSemaphoreGive(pin_write_lock);
+}
+
 static void set_pin_mode(int pin, bool output) {
-    gpio_set_direction(pin, output ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT);
     int idx = get_pin_index(pin);
-    if (idx >= 0) {
-        pin_modes[idx] = output;
-        pwm_frequencies[idx] = 0;
-    }
+    bool was_pwm = idx >= 0 && pin_get(idx).pwm_hz;
+    if (was_pwm) pwm_engine_release(pin);
+    gpio_set_direction(pin, output ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT);
+    if (idx < 0) return;
+
+    pin_state_t st;
+    pins_write_begin();
+    pin_store_peek(&pin_store, idx, &st);
+    st.output = output;
+    st.pwm_hz = 0;
+    if (was_pwm) st.level = false;
+    pin_store_set(&pin_store, idx, &st);
+    pins_write_end();
+    gpio_edges_enable(idx, !output);
 }
 
 static void write_pin(int pin, bool value) {
     int idx = get_pin_index(pin);
-    if (idx >= 0 && pin_modes[idx]) {
-        gpio_set_level(pin, value);
-        pin_states[idx] = value;
-    }
+    if (idx < 0 || !pin_get(idx).output) return;
+    gpio_set_level(pin, value);
+
+    pin_state_t st;
+    pins_write_begin();
+    pin_store_peek(&pin_store, idx, &st);
+    st.level = value;
+    pin_store_set(&pin_store, idx, &st);
+    pins_write_end();
 }
 
-static void set_pwm(int pin, int freq) {
+// LEDC timer and channel come from the PWM engine's allocator; a PWM pin is an output
+static esp_err_t set_pwm(int pin, int freq) {
     int idx = get_pin_index(pin);
-    if (idx >= 0) pwm_frequencies[idx] = freq;
+    if (idx < 0) return ESP_ERR_INVALID_ARG;
+    if (!pin_get(idx).output) set_pin_mode(pin, true);
+    esp_err_t err = pwm_engine_set(pin, freq);
+
+    pin_state_t st;
+    pins_write_begin();
+    pin_store_peek(&pin_store, idx, &st);
+    st.pwm_hz = err == ESP_OK ? freq : 0;
+    pin_store_set(&pin_store, idx, &st);
+    pins_write_end();
+    return err;
+}
 
-    int channel = pin % 8;
+static void reply_client(int slot, const char* message) {
+    if (slot >= 0) ws_broadcast_send(1u << slot, message, strlen(message), false, WS_KEY_NONE);
+}
 
-    ledc_timer_config_t ledc_timer = {
-        .speed_mode = LEDC_HIGH_SPEED_MODE,
-        .duty_resolution = LEDC_TIMER_8_BIT,
-        .timer_num = LEDC_TIMER_0,
-        .freq_hz = freq,
-        .clk_cfg = LEDC_AUTO_CLK
-    };
-    ledc_timer_config(&ledc_timer);
-
-    ledc_channel_config_t ledc_channel = {
-        .gpio_num = pin,
-        .speed_mode = LEDC_HIGH_SPEED_MODE,
-        .channel = channel,
-        .timer_sel = LEDC_TIMER_0,
-        .duty = 127,
-        .hpoint = 0
-    };
-    ledc_channel_config(&ledc_channel);
+// Subscribers of a topic due an update about gpios (0 = not about
+// particular pins); publishers check this before encoding anything
+static uint32_t topic_targets(topic_id_t id, uint64_t gpios) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    uint32_t targets = topic_due(&topics, id, gpios, (uint32_t)esp_timer_get_time());
+    xSemaphoreGive(clients_lock);
+    return targets;
 }
 
-static void uart_send(const char* str) {
-    uart_write_bytes(UART_PORT, str, strlen(str));
+// Every subscriber, whatever its rate: for messages that must not be skipped
+static uint32_t topic_all(topic_id_t id, uint64_t gpios) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    uint32_t targets = topic_subscribers(&topics, id, gpios);
+    xSemaphoreGive(clients_lock);
+    return targets;
 }
 
-static void scan_i2c(char* out, size_t max_len) {
-    size_t pos = 0;
-    pos += snprintf(out + pos, max_len - pos, "{\"i2c\":[");
-    for (uint8_t addr = 1; addr < 127; addr++) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_stop(cmd);
-        esp_err_t ret = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(20));
-        i2c_cmd_link_delete(cmd);
-        if (ret == ESP_OK) {
-            pos += snprintf(out + pos, max_len - pos, "%d,", addr);
-        }
+// GPIOs an ADC frame carries, for subscribers that filter on pins
+static uint64_t adc_frame_gpios(const uint8_t* frame, size_t len) {
+    uint64_t gpios = 0;
+    if (len > 20 && frame[0] == WIRE_ADC_SCAN) {
+        for (size_t i = 0; i < frame[1] && 20 + i < len; i++) gpios |= 1ull << (frame[20 + i] & 63);
+        return gpios;
     }
-    if (pos > 7 && out[pos - 1] == ',') pos--;  // Remove trailing comma
-    snprintf(out + pos, max_len - pos, "]}");
+    int pin = adc_capture_pin();
+    return pin >= 0 ? 1ull << pin : 0;
 }
 
-static void notify_clients(const char* message) {
+static void send_adc_block(const uint8_t* frame, size_t len) {
+    recorder_put_frame(frame, len);
+    uint32_t targets = topic_targets(TOPIC_ADC, adc_frame_gpios(frame, len));
+    if (targets) ws_broadcast_send(targets, frame, len, true, WS_KEY_ADC_BLOCK);
+}
+
+// RX bytes only go to clients that asked for them, never thinned out
+static void send_uart_rx(const uint8_t* frame, size_t len) {
+    recorder_put_frame(frame, len);
+    uint32_t targets = topic_all(TOPIC_UART, 0);
+    if (targets) ws_broadcast_send(targets, frame, len, true, WS_KEY_NONE);
+}
+
+// To the requester and to whoever watches every client's I2C traffic
+static void send_i2c_result(uint32_t targets, const char* json, size_t len) {
+    ws_broadcast_send(targets | topic_all(TOPIC_I2C, 0), json, len, false, WS_KEY_NONE);
+}
+
+static void send_metrics(const char* json, size_t len) {
+    uint32_t targets = topic_targets(TOPIC_METRICS, 0);
+    if (targets) ws_broadcast_send(targets, json, len, false, WS_KEY_METRICS);
+}
+
+// One snapshot stream for everyone, at the fastest subscriber's rate (1 s
+// when none asked for one); it stops with its last subscriber
+static void update_metrics_stream(void) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    bool any = topic_subscribers(&topics, TOPIC_METRICS, 0) != 0;
+    uint32_t interval_us = topic_min_interval(&topics, TOPIC_METRICS);
+    xSemaphoreGive(clients_lock);
+    metrics_stream(!any ? 0 : interval_us ? interval_us / 1000 : 1000, send_metrics);
+}
+
+static void send_logic(uint32_t targets, const void* data, size_t len, bool binary) {
+    ws_broadcast_send(targets, data, len, binary, WS_KEY_NONE);
+}
+
+// Every PWM output with its timer, resolution and achieved frequency
+static void send_pwm_report(uint32_t targets) {
+    static char json[2048];
+    size_t len = pwm_engine_to_json(json, sizeof(json));
+    if (len) ws_broadcast_send(targets, json, len, false, WS_KEY_NONE);
+}
+
+// Raw code -> mV table so the UI converts oscilloscope blocks the way the device does
+static void send_adc_cal(int slot) {
+    char json[384];
+    size_t len = adc_capture_cal_json(json, sizeof(json));
+    if (slot >= 0 && len) ws_broadcast_send(1u << slot, json, len, false, WS_KEY_NONE);
+}
+
+// Every client sees a recording start and end, whoever started it
+static void send_rec_status(const char* json, size_t len) {
+    ws_broadcast_send(BCAST_ALL, json, len, false, WS_KEY_NONE);
+}
+
+static void send_uart_stats(int slot) {
+    char json[256];
+    size_t len = uart_bridge_stats_json(json, sizeof(json));
+    if (slot >= 0 && len) ws_broadcast_send(1u << slot, json, len, false, WS_KEY_NONE);
+}
+
+// Binary clients are flagged and get a delta from their last ACK when the
+// sender reaches them; JSON clients share one encoded array. targets is a
+// ws_broadcast slot mask.
+static void send_pin_states(uint32_t targets) {
+    static char json[2048];
+    static pin_snapshot_t snap;
+    static pin_proto_state_t model;
+    uint32_t binary_mask = 0;
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
     for (int i = 0; i < MAX_WS_CLIENTS; i++) {
-        if (ws_clients[i] >= 0) {
-            httpd_ws_frame_t frame = {
-                .type = HTTPD_WS_TYPE_TEXT,
-                .payload = (uint8_t *)message,
-                .len = strlen(message),
-                .final = true
-            };
-            httpd_ws_send_frame_async(server, ws_clients[i], &frame);
+        if (ws_clients[i].binary) binary_mask |= 1u << i;
+    }
+    uint32_t json_mask = targets & ~binary_mask & ws_broadcast_clients();
+    if (json_mask) {
+        if (!model.gpio_nums) pin_proto_init(&model, usable_pins, NUM_PINS);
+        pin_snapshot(&snap);
+        pin_proto_load(&model, &snap);
+        size_t len = pin_proto_to_json(&model, json, sizeof(json));
+        if (len) ws_broadcast_send(json_mask, json, len, false, WS_KEY_PINS_JSON);
+    }
+    xSemaphoreGive(clients_lock);
+
+    if (targets & binary_mask) ws_broadcast_defer(targets & binary_mask, WS_DEFER_PINS);
+}
+
+// Pin changes go to PINS subscribers watching one of gpios (0 = any pin
+// may have changed) at their own rate; flush_pin_states() catches up the
+// ones held back once their interval has passed
+static void publish_pin_states(uint64_t gpios) {
+    uint32_t targets = topic_targets(TOPIC_PINS, gpios);
+    if (targets) send_pin_states(targets);
+}
+
+// ws_broadcast tick, on the sender task
+static void flush_pin_states(uint32_t now_us) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    uint32_t targets = topic_due_pending(&topics, TOPIC_PINS, now_us);
+    xSemaphoreGive(clients_lock);
+    if (targets) send_pin_states(targets);
+}
+
+// Sequencer reports; once playback ends the driven levels go into the pin model
+static void send_seq_report(uint32_t targets, const char* json, size_t len, int levels) {
+    ws_broadcast_send(targets, json, len, false, WS_KEY_NONE);
+    if (levels < 0) return;
+    int gpios[SEQ_MAX_CHANNELS];
+    size_t n = sequencer_pins(gpios);
+    pins_write_begin();
+    for (size_t ch = 0; ch < n; ch++) {
+        int idx = get_pin_index(gpios[ch]);
+        pin_state_t st;
+        if (idx < 0) continue;
+        pin_store_peek(&pin_store, idx, &st);
+        st.level = (levels >> ch) & 1;
+        pin_store_set(&pin_store, idx, &st);
+    }
+    pins_write_end();
+    publish_pin_states(0);
+}
+
+// Runs on the sender task once the client is writable
+static size_t encode_deferred(int slot, uint32_t bits, uint8_t* buf, size_t len, bool* binary) {
+    static pin_snapshot_t snap;
+    static pin_proto_state_t model;
+    if (!(bits & WS_DEFER_PINS)) return 0;
+    if (!model.gpio_nums) pin_proto_init(&model, usable_pins, NUM_PINS);
+    pin_snapshot(&snap);
+    pin_proto_load(&model, &snap);
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    uint32_t acked = ws_clients[slot].acked;
+    xSemaphoreGive(clients_lock);
+    size_t n = pin_proto_encode(&model, acked, buf, len);
+    *binary = true;
+    return n;
+}
+
+// Command context for one received frame
+typedef struct {
+    httpd_req_t* req;
+    int slot;               // ws_broadcast slot of the sender, -1 if unknown
+    uint32_t rx_us;         // when the frame arrived, esp_timer µs
+    bool pins_changed;      // one pin-state broadcast after the whole batch
+} cmd_ctx_t;
+
+static cmd_table_t cmd_table;
+static cmd_pool_t rx_pool;
+
+static int check_pin(const cmd_t* cmd, void* arg, const char** err) {
+    if (peripheral_pin(cmd->ival[0])) {
+        *err = "pin is in use by a peripheral";
+        return -1;
+    }
+    if (get_pin_index(cmd->ival[0]) >= 0) return 0;
+    *err = "pin not available";
+    return -1;
+}
+
+static int check_mode(const cmd_t* cmd, void* arg, const char** err) {
+    if (check_pin(cmd, arg, err) != 0) return -1;
+    if (strcmp(cmd->sval[1], "INPUT") == 0 || strcmp(cmd->sval[1], "OUTPUT") == 0) return 0;
+    *err = "mode must be INPUT or OUTPUT";
+    return -1;
+}
+
+static int check_pwm_pin(const cmd_t* cmd, void* arg, const char** err) {
+    if (check_pin(cmd, arg, err) != 0) return -1;
+    if (cmd->ival[0] < 34) return 0;
+    *err = "pin is input-only";
+    return -1;
+}
+
+static int check_adc_trig(const cmd_t* cmd, void* arg, const char** err) {
+    cap_trig_mode_t mode;
+    if (!cap_trig_mode_parse(cmd->sval[0], &mode)) {
+        *err = "unknown trigger mode";
+        return -1;
+    }
+    if (cmd->argc > 3 && strcmp(cmd->sval[3], "SINGLE") != 0) {
+        *err = "expected SINGLE";
+        return -1;
+    }
+    return 0;
+}
+
+static int check_uart_cfg(const cmd_t* cmd, void* arg, const char** err) {
+    uart_line_t line;
+    uart_bridge_line(&line);
+    if (uart_line_parse(cmd->sval[0], &line)) return 0;
+    *err = "expected <baud>[,<bits><N|E|O><stop>]";
+    return -1;
+}
+
+static int check_i2c_txn(const cmd_t* cmd, void* arg, const char** err) {
+    i2c_txn_t txn;
+    if (i2c_txn_parse(cmd->sval[0], &txn)) return 0;
+    *err = "bad transaction";
+    return -1;
+}
+
+// "18+19+23": pins in the given direction, each once, at most max;
+// returns the channel count or -1
+static int parse_pin_list(const char* s, bool outputs, int max, int* gpios, const char** err) {
+    int n = 0;
+    while (*s) {
+        char* end;
+        long pin = strtol(s, &end, 10);
+        int idx = end != s ? get_pin_index(pin) : -1;
+        if (idx < 0 || (*end && *end != '+')) {
+            *err = "pins must be GPIO numbers joined with +";
+            return -1;
+        }
+        if (peripheral_pin(pin)) {
+            *err = "pin is in use by a peripheral";
+            return -1;
         }
+        pin_state_t st = pin_get(idx);
+        if (st.output != outputs) {
+            *err = outputs ? "sequencer pins must be outputs" : "pins must be inputs";
+            return -1;
+        }
+        if (outputs && st.pwm_hz) {
+            *err = "pin is driving PWM";
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (gpios[i] == pin) {
+                *err = "pin listed twice";
+                return -1;
+            }
+        }
+        if (n == max) {
+            *err = "too many pins";
+            return -1;
+        }
+        gpios[n++] = pin;
+        s = *end ? end + 1 : end;
     }
+    if (n == 0) *err = "no pins";
+    return n ? n : -1;
 }
 
-// 🔧 NEW: Broadcast all pin states as JSON
-static void send_all_pin_states() {
-    char buffer[2048];
-    int pos = 0;
-    pos += snprintf(buffer + pos, sizeof(buffer) - pos, "[");
+static int check_logic(const cmd_t* cmd, void* arg, const char** err) {
+    int gpios[LA_MAX_CHANNELS];
+    int n = parse_pin_list(cmd->sval[0], false, LA_MAX_CHANNELS, gpios, err);
+    if (n < 0) return -1;
+    la_trigger_t trigger;
+    if (cmd->argc > 3 && (!la_trigger_parse(cmd->sval[3], &trigger) || (int)strlen(cmd->sval[3]) > n)) {
+        *err = "trigger is one of 0 1 X R F per pin";
+        return -1;
+    }
+    return 0;
+}
 
-    for (int i = 0; i < NUM_PINS; i++) {
-        const char* mode_str = pin_modes[i] ? (pwm_frequencies[i] > 0 ? "PWM" : "OUTPUT") : "INPUT";
-        pos += snprintf(buffer + pos, sizeof(buffer) - pos,
-            "{\"pin\":%d,\"mode\":\"%s\",\"state\":%d,\"bounce\":%d}%s",
-            usable_pins[i], mode_str, pin_states[i], bounce_counters[i],
-            (i < NUM_PINS - 1) ? "," : ""
-        );
+static int check_adc_scan(const cmd_t* cmd, void* arg, const char** err) {
+    int gpios[SCAN_MAX_CHANNELS];
+    int n = parse_pin_list(cmd->sval[0], false, SCAN_MAX_CHANNELS, gpios, err);
+    if (n < 0) return -1;
+    if (n * cmd->ival[3] > SCAN_MAX_BINS) {
+        *err = "too many points for that many pins";
+        return -1;
+    }
+    return 0;
+}
+
+static int check_rec_start(const cmd_t* cmd, void* arg, const char** err) {
+    uint8_t sources;
+    if (rec_sources_parse(cmd->sval[0], &sources)) return 0;
+    *err = "sources are ADC, EDGES and UART joined with +";
+    return -1;
+}
+
+static sequencer_config_t seq_cfg;  // httpd runs one handler at a time
+
+static int check_seq(const cmd_t* cmd, void* arg, const char** err) {
+    int n = parse_pin_list(cmd->sval[0], true, SEQ_MAX_CHANNELS, seq_cfg.gpios, err);
+    if (n < 0) return -1;
+    if (seq_parse(cmd->sval[1], n, seq_cfg.steps, SEQ_MAX_STEPS)) return 0;
+    *err = "steps are <0|1 per pin>@<us>;..., 5 us or longer";
+    return -1;
+}
+
+static int cmd_ack(const cmd_t* cmd, void* arg, const char** err) {
+    cmd_ctx_t* ctx = arg;
+    uint32_t version = cmd->ival[0];
+    if (ctx->slot < 0) return 0;
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    ws_client_t* client = &ws_clients[ctx->slot];
+    if (version > client->acked && version <= pin_store_version(&pin_store)) client->acked = version;
+    xSemaphoreGive(clients_lock);
+    return 0;
+}
+
+static int cmd_proto(const cmd_t* cmd, void* arg, const char** err) {
+    // PROTO:BIN or PROTO:JSON, answered with a full snapshot in the new form
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot < 0) return 0;
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    ws_clients[ctx->slot].binary = strcmp(cmd->sval[0], "BIN") == 0;
+    ws_clients[ctx->slot].acked = 0;
+    xSemaphoreGive(clients_lock);
+    send_pin_states(1u << ctx->slot);
+    return 0;
+}
+
+static int check_ping(const cmd_t* cmd, void* arg, const char** err) {
+    if (cmd->argc < 2 || strcmp(cmd->sval[1], "ALL") == 0) return 0;
+    *err = "PING:<id>[,ALL]";
+    return -1;
+}
+
+static int cmd_ping(const cmd_t* cmd, void* arg, const char** err) {
+    // Echoes the frame's receive time, the time the commands before it in
+    // the frame were done, and (stamped by the sender) the time the reply
+    // went out. ALL sends it to every client to time the fan-out.
+    cmd_ctx_t* ctx = arg;
+    uint32_t targets = cmd->argc > 1 ? BCAST_ALL : ctx->slot >= 0 ? 1u << ctx->slot : 0;
+    char json[160];
+    int n = snprintf(json, sizeof(json), "{\"pong\":{\"id\":%ld,\"slot\":%d,\"rx_us\":%lu,\"apply_us\":%lu,\"send_us\":",
+                     (long)cmd->ival[0], ctx->slot, (unsigned long)ctx->rx_us,
+                     (unsigned long)esp_timer_get_time());
+    size_t stamp_at = n;
+    n += snprintf(json + n, sizeof(json) - n, "%*s}}", WS_STAMP_WIDTH, "0");
+    ws_broadcast_send_stamped(targets, json, n, stamp_at);
+    return 0;
+}
+
+static int cmd_clients(const cmd_t* cmd, void* arg, const char** err) {
+    // Per-client queue depth, drops and send latency
+    cmd_ctx_t* ctx = arg;
+    char buf[1024];
+    size_t len = ws_broadcast_stats_json(buf, sizeof(buf));
+    if (ctx->slot >= 0 && len) ws_broadcast_send(1u << ctx->slot, buf, len, false, WS_KEY_NONE);
+    return 0;
+}
+
+static int cmd_mode(const cmd_t* cmd, void* arg, const char** err) {
+    set_pin_mode(cmd->ival[0], strcmp(cmd->sval[1], "OUTPUT") == 0);
+    ((cmd_ctx_t*)arg)->pins_changed = true;
+    return 0;
+}
+
+static int cmd_write(const cmd_t* cmd, void* arg, const char** err) {
+    write_pin(cmd->ival[0], cmd->ival[1]);
+    ((cmd_ctx_t*)arg)->pins_changed = true;
+    return 0;
+}
+
+static int cmd_pwm(const cmd_t* cmd, void* arg, const char** err) {
+    // PWM:<pin>,<hz>[,<duty>], duty in 0.01 % (default: unchanged, 50 % for a new pin)
+    esp_err_t res = set_pwm(cmd->ival[0], cmd->ival[1]);
+    if (res == ESP_OK && cmd->argc > 2) res = pwm_engine_duty(cmd->ival[0], cmd->ival[2]);
+    ((cmd_ctx_t*)arg)->pins_changed = true;
+    if (res == ESP_OK) {
+        send_pwm_report(BCAST_ALL);
+        return 0;
     }
+    *err = res == ESP_ERR_NOT_FOUND ? "no free LEDC timer or channel" :
+           res == ESP_ERR_INVALID_ARG ? "frequency out of range" : esp_err_to_name(res);
+    return -1;
+}
+
+static int cmd_pwm_off(const cmd_t* cmd, void* arg, const char** err) {
+    // Back to a plain output, driven low
+    if (!pin_get(get_pin_index(cmd->ival[0])).pwm_hz) return 0;
+    set_pin_mode(cmd->ival[0], true);
+    ((cmd_ctx_t*)arg)->pins_changed = true;
+    send_pwm_report(BCAST_ALL);
+    return 0;
+}
+
+static int cmd_pwm_stats(const cmd_t* cmd, void* arg, const char** err) {
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot >= 0) send_pwm_report(1u << ctx->slot);
+    return 0;
+}
+
+static int cmd_duty(const cmd_t* cmd, void* arg, const char** err) {
+    // DUTY:<pin>,<duty>: the slider path, latched at the next period, no report
+    esp_err_t res = pwm_engine_duty(cmd->ival[0], cmd->ival[1]);
+    if (res == ESP_OK) return 0;
+    *err = res == ESP_ERR_INVALID_STATE ? "fade in progress" : "pin is not driving PWM";
+    return -1;
+}
 
-    snprintf(buffer + pos, sizeof(buffer) - pos, "]");
-    notify_clients(buffer);
+static int cmd_fade(const cmd_t* cmd, void* arg, const char** err) {
+    // FADE:<pin>,<duty>,<ms>: hardware fade from the current duty
+    if (pwm_engine_fade(cmd->ival[0], cmd->ival[1], cmd->ival[2]) == ESP_OK) return 0;
+    *err = "pin is not driving PWM";
+    return -1;
+}
+
+static int cmd_oscillo(const cmd_t* cmd, void* arg, const char** err) {
+    if (adc_capture_set_pin(cmd->ival[0]) == ESP_OK) return 0;
+    *err = "not an ADC1 pin";
+    return -1;
+}
+
+static int cmd_adc_rate(const cmd_t* cmd, void* arg, const char** err) {
+    // ADC_RATE:<hz>[,<block_len>]
+    adc_capture_set_rate(cmd->ival[0], cmd->argc > 1 ? cmd->ival[1] : 0);
+    return 0;
+}
+
+static int cmd_adc_trig(const cmd_t* cmd, void* arg, const char** err) {
+    // ADC_TRIG:<NONE|RISING|FALLING|EDGE|ABOVE|BELOW>,<level>,<pre>[,SINGLE]
+    cap_trig_mode_t mode;
+    cap_trig_mode_parse(cmd->sval[0], &mode);
+    adc_capture_set_trigger(mode, cmd->ival[1], cmd->ival[2], cmd->argc > 3);
+    return 0;
+}
+
+static int cmd_adc_arm(const cmd_t* cmd, void* arg, const char** err) {
+    adc_capture_rearm();
+    return 0;
+}
+
+static int cmd_adc_scan(const cmd_t* cmd, void* arg, const char** err) {
+    // ADC_SCAN:<gpio>[+<gpio>...],<hz per pin>,<window_ms>,<points>, e.g. ADC_SCAN:34+35,20000,50,400
+    int gpios[SCAN_MAX_CHANNELS];
+    int n = parse_pin_list(cmd->sval[0], false, SCAN_MAX_CHANNELS, gpios, err);
+    if (adc_capture_scan(gpios, n, cmd->ival[1], cmd->ival[2], cmd->ival[3]) == ESP_OK) return 0;
+    *err = "not an ADC1 pin";
+    return -1;
+}
+
+static int cmd_adc_cal(const cmd_t* cmd, void* arg, const char** err) {
+    send_adc_cal(((cmd_ctx_t*)arg)->slot);
+    return 0;
+}
+
+static int cmd_uart_send(const cmd_t* cmd, void* arg, const char** err) {
+    // Escapes (\r \n \xNN) let one line carry control bytes
+    char* text = (char*)cmd->sval[0];
+    size_t len = cmd_unescape(text);
+    if (uart_bridge_write(text, len) == len) return 0;
+    *err = "UART TX buffer full";
+    return -1;
+}
+
+static int cmd_uart_cfg(const cmd_t* cmd, void* arg, const char** err) {
+    // UART_CFG:<baud>[,<bits><N|E|O><stop>], e.g. UART_CFG:921600,8N1
+    uart_line_t line;
+    uart_bridge_line(&line);
+    uart_line_parse(cmd->sval[0], &line);
+    uart_bridge_configure(&line);
+    send_uart_stats(((cmd_ctx_t*)arg)->slot);
+    return 0;
+}
+
+static int cmd_uart_sub(const cmd_t* cmd, void* arg, const char** err) {
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot < 0) return 0;
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    if (cmd->ival[0]) topic_subscribe(&topics, ctx->slot, TOPIC_UART, 0, 0);
+    else topic_unsubscribe(&topics, ctx->slot, TOPIC_UART);
+    xSemaphoreGive(clients_lock);
+    send_uart_stats(ctx->slot);
+    return 0;
+}
+
+static int cmd_uart_stats(const cmd_t* cmd, void* arg, const char** err) {
+    send_uart_stats(((cmd_ctx_t*)arg)->slot);
+    return 0;
+}
+
+static int cmd_i2c_scan(const cmd_t* cmd, void* arg, const char** err) {
+    // Runs on the I2C worker; progress and the address list stream back
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot < 0 || i2c_engine_scan(1u << ctx->slot)) return 0;
+    *err = "I2C busy";
+    return -1;
+}
+
+static int cmd_i2c_txn(const cmd_t* cmd, void* arg, const char** err) {
+    // I2C_TXN:<addr>;R:<reg>,<n>;W:<reg>,<b>[,<b>...];D:<reg>,<n>
+    static i2c_txn_t txn;  // httpd runs one handler at a time
+    cmd_ctx_t* ctx = arg;
+    i2c_txn_parse(cmd->sval[0], &txn);
+    if (ctx->slot < 0 || i2c_engine_txn(1u << ctx->slot, &txn)) return 0;
+    *err = "I2C busy";
+    return -1;
+}
+
+static int cmd_logic(const cmd_t* cmd, void* arg, const char** err) {
+    // LOGIC:<gpio>[+<gpio>...],<sample_hz>,<ms>[,<trigger>[,<pre %>]], e.g. LOGIC:18+19+23,8000000,200,FXX,25
+    cmd_ctx_t* ctx = arg;
+    logic_config_t cfg = { .sample_hz = cmd->ival[1], .duration_ms = cmd->ival[2], .pre_percent = 25 };
+    cfg.channels = parse_pin_list(cmd->sval[0], false, LA_MAX_CHANNELS, cfg.gpios, err);
+    if (cmd->argc > 3) la_trigger_parse(cmd->sval[3], &cfg.trigger);
+    if (cmd->argc > 4) cfg.pre_percent = cmd->ival[4];
+    if (ctx->slot < 0 || logic_capture_arm(1u << ctx->slot, &cfg) == ESP_OK) return 0;
+    *err = "logic analyzer busy";
+    return -1;
+}
+
+static int cmd_logic_stop(const cmd_t* cmd, void* arg, const char** err) {
+    logic_capture_stop();
+    return 0;
+}
+
+static int cmd_rec_start(const cmd_t* cmd, void* arg, const char** err) {
+    // REC_START:<source>[+<source>...][,<max_kb>], e.g. REC_START:ADC+EDGES,2048
+    uint8_t sources;
+    rec_sources_parse(cmd->sval[0], &sources);
+
+    // What a decoder needs to make sense of the records, in the file header
+    char desc[REC_DESC_MAX + 1], line_str[16];
+    uart_line_t line;
+    uart_bridge_line(&line);
+    uart_line_format(&line, line_str, sizeof(line_str));
+    int n = snprintf(desc, sizeof(desc), "{\"sources\":\"%s\",\"uart\":\"%s\",\"pins\":[", cmd->sval[0], line_str);
+    for (int i = 0; i < NUM_PINS && n < (int)sizeof(desc); i++) {
+        n += snprintf(desc + n, sizeof(desc) - n, "%s%d", i ? "," : "", usable_pins[i]);
+    }
+    if (n < (int)sizeof(desc)) snprintf(desc + n, sizeof(desc) - n, "]}");
+
+    esp_err_t res = recorder_begin(sources, cmd->argc > 1 ? cmd->ival[1] : 0, desc);
+    if (res == ESP_OK) return 0;
+    *err = res == ESP_ERR_INVALID_STATE ? "recording in progress"
+         : res == ESP_ERR_NO_MEM ? "not enough flash or memory" : "cannot create file";
+    return -1;
+}
+
+static int cmd_rec_stop(const cmd_t* cmd, void* arg, const char** err) {
+    recorder_end();
+    return 0;
+}
+
+static int cmd_rec_status(const cmd_t* cmd, void* arg, const char** err) {
+    char json[256];
+    cmd_ctx_t* ctx = arg;
+    size_t len = recorder_status_json(json, sizeof(json));
+    if (ctx->slot >= 0 && len) ws_broadcast_send(1u << ctx->slot, json, len, false, WS_KEY_NONE);
+    return 0;
+}
+
+static int cmd_seq(const cmd_t* cmd, void* arg, const char** err) {
+    // SEQ:<gpio>[+<gpio>...],<vector>@<us>[;<vector>@<us>...], e.g. SEQ:25+26,10@100;01@100
+    seq_cfg.channels = parse_pin_list(cmd->sval[0], true, SEQ_MAX_CHANNELS, seq_cfg.gpios, err);
+    seq_cfg.count = seq_parse(cmd->sval[1], seq_cfg.channels, seq_cfg.steps, SEQ_MAX_STEPS);
+    if (sequencer_load(&seq_cfg) == ESP_OK) return 0;
+    *err = "sequencer busy";
+    return -1;
+}
+
+static int cmd_seq_start(const cmd_t* cmd, void* arg, const char** err) {
+    // SEQ_START[:<loops>], 0 repeats until SEQ_STOP
+    cmd_ctx_t* ctx = arg;
+    esp_err_t res = sequencer_play(ctx->slot >= 0 ? 1u << ctx->slot : 0, cmd->argc ? cmd->ival[0] : 1);
+    if (res == ESP_OK) return 0;
+    *err = res == ESP_ERR_INVALID_STATE ? "sequencer busy" : "no sequence loaded";
+    return -1;
+}
+
+static int cmd_seq_stop(const cmd_t* cmd, void* arg, const char** err) {
+    sequencer_stop();
+    return 0;
+}
+
+static int cmd_metrics(const cmd_t* cmd, void* arg, const char** err) {
+    // METRICS:<period_ms> subscribes this client, METRICS:0 unsubscribes
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot < 0) return 0;
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    if (cmd->ival[0]) topic_subscribe(&topics, ctx->slot, TOPIC_METRICS, cmd->ival[0] * 1000, 0);
+    else topic_unsubscribe(&topics, ctx->slot, TOPIC_METRICS);
+    xSemaphoreGive(clients_lock);
+    update_metrics_stream();
+    return 0;
+}
+
+static void send_subs(int slot) {
+    char json[512];
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    size_t len = topic_to_json(&topics, slot, json, sizeof(json));
+    xSemaphoreGive(clients_lock);
+    if (len) ws_broadcast_send(1u << slot, json, len, false, WS_KEY_NONE);
+}
+
+static int check_sub(const cmd_t* cmd, void* arg, const char** err) {
+    topic_id_t id;
+    uint64_t gpios;
+    if (!topic_parse(cmd->sval[0], &id)) {
+        *err = "topics are PINS, ADC, UART, I2C, WIFI and METRICS";
+        return -1;
+    }
+    if (cmd->argc > 2 && ((id != TOPIC_PINS && id != TOPIC_ADC) || !topic_parse_gpios(cmd->sval[2], &gpios))) {
+        *err = "PINS and ADC filter on GPIO numbers joined with +";
+        return -1;
+    }
+    return 0;
+}
+
+static int cmd_sub(const cmd_t* cmd, void* arg, const char** err) {
+    // SUB:<topic>[,<max_hz>[,<gpios>]]; max_hz 0 takes every update
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot < 0) return 0;
+    topic_id_t id;
+    uint64_t gpios = 0;
+    topic_parse(cmd->sval[0], &id);
+    if (cmd->argc > 2) topic_parse_gpios(cmd->sval[2], &gpios);
+    uint32_t interval_us = cmd->argc > 1 && cmd->ival[1] ? 1000000 / cmd->ival[1] : 0;
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    topic_subscribe(&topics, ctx->slot, id, interval_us, gpios);
+    xSemaphoreGive(clients_lock);
+
+    if (id == TOPIC_PINS) send_pin_states(1u << ctx->slot);  // start from the full picture
+    if (id == TOPIC_METRICS) update_metrics_stream();
+    send_subs(ctx->slot);
+    return 0;
+}
+
+static int check_unsub(const cmd_t* cmd, void* arg, const char** err) {
+    topic_id_t id;
+    if (strcmp(cmd->sval[0], "ALL") == 0 || topic_parse(cmd->sval[0], &id)) return 0;
+    *err = "topics are PINS, ADC, UART, I2C, WIFI, METRICS or ALL";
+    return -1;
+}
+
+static int cmd_unsub(const cmd_t* cmd, void* arg, const char** err) {
+    cmd_ctx_t* ctx = arg;
+    if (ctx->slot < 0) return 0;
+    topic_id_t id;
+    bool all = !topic_parse(cmd->sval[0], &id);
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    if (all) topic_drop_client(&topics, ctx->slot);
+    else topic_unsubscribe(&topics, ctx->slot, id);
+    xSemaphoreGive(clients_lock);
+    if (all || id == TOPIC_METRICS) update_metrics_stream();
+    send_subs(ctx->slot);
+    return 0;
+}
+
+// WIFI_STA:<ssid>[,<password>]: the SSID ends at the first comma, the password may hold any
+static bool split_wifi_sta(const char* arg, char* ssid, char* password) {
+    const char* comma = strchr(arg, ',');
+    size_t ssid_len = comma ? (size_t)(comma - arg) : strlen(arg);
+    const char* pass = comma ? comma + 1 : "";
+    size_t pass_len = strlen(pass);
+    if (ssid_len < 1 || ssid_len > 32 || (pass_len && (pass_len < 8 || pass_len > 64))) return false;
+    memcpy(ssid, arg, ssid_len);
+    ssid[ssid_len] = '\0';
+    memcpy(password, pass, pass_len + 1);
+    return true;
+}
+
+static int check_wifi_sta(const cmd_t* cmd, void* arg, const char** err) {
+    char ssid[33], password[65];
+    if (split_wifi_sta(cmd->sval[0], ssid, password)) return 0;
+    *err = "WIFI_STA:<ssid>[,<password>], SSID up to 32 bytes, password 8 to 64";
+    return -1;
+}
+
+static int cmd_wifi_sta(const cmd_t* cmd, void* arg, const char** err) {
+    char ssid[33], password[65];
+    split_wifi_sta(cmd->sval[0], ssid, password);
+    if (wifi_link_set_sta(ssid, password) == ESP_OK) return 0;
+    *err = "could not store Wi-Fi credentials";
+    return -1;
+}
+
+static int cmd_i2c_clk(const cmd_t* cmd, void* arg, const char** err) {
+    i2c_engine_set_clock(cmd->ival[0]);
+    return 0;
+}
+
+#define ARG_INT(lo, hi) { CMD_ARG_INT, (lo), (hi) }
+#define ARG_WORD        { CMD_ARG_WORD, 0, 0 }
+#define ARG_REST        { CMD_ARG_REST, 0, 0 }
+#define ARG_PIN         ARG_INT(0, 39)
+
+// Sorted by name; cmd_table_init() refuses an unsorted table
+static const cmd_def_t cmd_defs[] = {
+    { "ACK",        1, 1, { ARG_INT(0, INT32_MAX) },                            NULL,           cmd_ack },
+    { "ADC_ARM",    0, 0, { },                                                  NULL,           cmd_adc_arm },
+    { "ADC_CAL",    0, 0, { },                                                  NULL,           cmd_adc_cal },
+    { "ADC_RATE",   2, 1, { ARG_INT(1, 2000000), ARG_INT(0, CAP_MAX_BLOCK) }, NULL,          cmd_adc_rate },
+    { "ADC_SCAN",   4, 4, { ARG_WORD, ARG_INT(1, 2000000), ARG_INT(1, 60000), ARG_INT(1, SCAN_MAX_POINTS) }, check_adc_scan, cmd_adc_scan },
+    { "ADC_TRIG",   4, 3, { ARG_WORD, ARG_INT(0, 4095), ARG_INT(0, CAP_MAX_BLOCK), ARG_WORD }, check_adc_trig, cmd_adc_trig },
+    { "CLIENTS",    0, 0, { },                                                  NULL,           cmd_clients },
+    { "DUTY",       2, 2, { ARG_PIN, ARG_INT(0, PWM_DUTY_SCALE) },              check_pin,      cmd_duty },
+    { "FADE",       3, 3, { ARG_PIN, ARG_INT(0, PWM_DUTY_SCALE), ARG_INT(0, 60000) }, check_pin, cmd_fade },
+    { "I2C_CLK",    1, 1, { ARG_INT(10000, 1000000) },                          NULL,           cmd_i2c_clk },
+    { "I2C_SCAN",   0, 0, { },                                                  NULL,           cmd_i2c_scan },
+    { "I2C_TXN",    1, 1, { ARG_REST },                                         check_i2c_txn,  cmd_i2c_txn },
+    { "LOGIC",      5, 3, { ARG_WORD, ARG_INT(320000, 80000000), ARG_INT(1, 10000), ARG_WORD, ARG_INT(0, 99) }, check_logic, cmd_logic },
+    { "LOGIC_STOP", 0, 0, { },                                                  NULL,           cmd_logic_stop },
+    { "METRICS",    1, 1, { ARG_INT(0, 60000) },                                NULL,           cmd_metrics },
+    { "MODE",       2, 2, { ARG_PIN, ARG_WORD },                                check_mode,     cmd_mode },
+    { "OSCILLO",    1, 1, { ARG_PIN },                                          check_pin,      cmd_oscillo },
+    { "PING",       2, 1, { ARG_INT(0, INT32_MAX), ARG_WORD },                  check_ping,     cmd_ping },
+    { "PROTO",      1, 1, { ARG_WORD },                                         NULL,           cmd_proto },
+    { "PWM",        3, 2, { ARG_PIN, ARG_INT(1, 40000000), ARG_INT(0, PWM_DUTY_SCALE) }, check_pwm_pin, cmd_pwm },
+    { "PWM_OFF",    1, 1, { ARG_PIN },                                          check_pin,      cmd_pwm_off },
+    { "PWM_STATS",  0, 0, { },                                                  NULL,           cmd_pwm_stats },
+    { "REC_START",  2, 1, { ARG_WORD, ARG_INT(32, 1024) },                      check_rec_start, cmd_rec_start },
+    { "REC_STATUS", 0, 0, { },                                                  NULL,           cmd_rec_status },
+    { "REC_STOP",   0, 0, { },                                                  NULL,           cmd_rec_stop },
+    { "SEQ",        2, 2, { ARG_WORD, ARG_REST },                               check_seq,      cmd_seq },
+    { "SEQ_START",  1, 0, { ARG_INT(0, 1000000) },                              NULL,           cmd_seq_start },
+    { "SEQ_STOP",   0, 0, { },                                                  NULL,           cmd_seq_stop },
+    { "SUB",        3, 1, { ARG_WORD, ARG_INT(0, TOPIC_MAX_HZ), ARG_WORD },    check_sub,      cmd_sub },
+    { "UART_CFG",   1, 1, { ARG_REST },                                         check_uart_cfg, cmd_uart_cfg },
+    { "UART_SEND",  1, 1, { ARG_REST },                                         NULL,           cmd_uart_send },
+    { "UART_STATS", 0, 0, { },                                                  NULL,           cmd_uart_stats },
+    { "UART_SUB",   1, 1, { ARG_INT(0, 1) },                                    NULL,           cmd_uart_sub },
+    { "UNSUB",      1, 1, { ARG_WORD },                                         check_unsub,    cmd_unsub },
+    { "WIFI_STA",   1, 1, { ARG_REST },                                         check_wifi_sta, cmd_wifi_sta },
+    { "WRITE",      2, 2, { ARG_PIN, ARG_INT(0, 1) },                           check_pin,      cmd_write },
+};
+
+static void reply_error(int slot, int line, const char* msg) {
+    char json[128];
+    snprintf(json, sizeof(json), "{\"error\":{\"line\":%d,\"msg\":\"%s\"}}", line, msg);
+    reply_client(slot, json);
+}
+
+// ws_broadcast close hook: the session on slot is gone, reset what it subscribed to
+static void release_client(int slot) {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    bool metrics_sub = topic_subscribers(&topics, TOPIC_METRICS, 0) & (1u << slot);
+    ws_clients[slot] = (ws_client_t){ 0 };
+    topic_drop_client(&topics, slot);
+    xSemaphoreGive(clients_lock);
+    if (metrics_sub) update_metrics_stream();
 }
 
 static esp_err_t ws_handler(httpd_req_t *req) {
     if (req->method == HTTP_GET) {
         int sockfd = httpd_req_to_sockfd(req);
 
-        // Register client in ws_clients[]
-        for (int i = 0; i < MAX_WS_CLIENTS; i++) {
-            if (ws_clients[i] < 0) {
-                ws_clients[i] = sockfd;
-                break;
-            }
+        // Register the client; it starts on JSON until it sends PROTO:BIN
+        int slot = ws_broadcast_add_client(sockfd);
+        if (slot < 0) {
+            ESP_LOGW(TAG, "WebSocket client rejected, all %d slots busy: sockfd=%d", MAX_WS_CLIENTS, sockfd);
+            return ESP_OK;
         }
-
-        ESP_LOGI(TAG, "WebSocket client connected: sockfd=%d", sockfd);
-        send_all_pin_states();  
+        // Until it says otherwise it gets what clients always got: pins, ADC and Wi-Fi, unthrottled
+        xSemaphoreTake(clients_lock, portMAX_DELAY);
+        ws_clients[slot] = (ws_client_t){ .binary = false, .acked = 0 };
+        topic_drop_client(&topics, slot);
+        topic_subscribe(&topics, slot, TOPIC_PINS, 0, 0);
+        topic_subscribe(&topics, slot, TOPIC_ADC, 0, 0);
+        topic_subscribe(&topics, slot, TOPIC_WIFI, 0, 0);
+        xSemaphoreGive(clients_lock);
+
+        ESP_LOGI(TAG, "WebSocket client connected: sockfd=%d slot=%d", sockfd, slot);
+        metrics_boot_mark(BOOT_FIRST_WS);
+        send_pin_states(1u << slot);
         return ESP_OK;
     }
 
+    uint32_t rx_us = (uint32_t)esp_timer_get_time();
     httpd_ws_frame_t frame = {
         .type = HTTPD_WS_TYPE_TEXT,
         .payload = NULL,
@@ -195,58 +969,37 @@ static esp_err_t ws_handler(httpd_req_t *req) {
     esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
     if (ret != ESP_OK || frame.len == 0) return ret;
 
-    frame.payload = malloc(frame.len + 1);
-    if (!frame.payload) return ESP_ERR_NO_MEM;
-
-    ret = httpd_ws_recv_frame(req, &frame, frame.len);
-    if (ret != ESP_OK) {
-        free(frame.payload);
-        return ret;
+    cmd_ctx_t ctx = { .req = req, .slot = ws_broadcast_slot(httpd_req_to_sockfd(req)), .rx_us = rx_us };
+    if (frame.len >= CMD_BUF_LEN) {
+        // The unread payload would desync the stream, so the session has to go
+        reply_error(ctx.slot, 0, "frame too large");
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    frame.payload[frame.len] = '\0';
-    char* msg = (char*)frame.payload;
-
-    if (strncmp(msg, "MODE:", 5) == 0) {
-        int pin = atoi(msg + 5);
-        char* mode = strchr(msg + 5, ',');
-        if (mode) set_pin_mode(pin, strstr(mode, "OUTPUT") != NULL);
-        send_all_pin_states();
-    } else if (strncmp(msg, "WRITE:", 6) == 0) {
-        int pin = atoi(msg + 6);
-        int val = atoi(strchr(msg + 6, ',') + 1);
-        write_pin(pin, val);
-        send_all_pin_states();
-    } else if (strncmp(msg, "PWM:", 4) == 0) {
-        int pin = atoi(msg + 4);
-        int freq = atoi(strchr(msg + 4, ',') + 1);
-        set_pwm(pin, freq);
-        send_all_pin_states();
-    } else if (strncmp(msg, "OSCILLO:", 8) == 0) {
-        oscillo_pin = atoi(msg + 8);
-    } else if (strncmp(msg, "UART_SEND:", 10) == 0) {
-        uart_send(msg + 10);
-    } else if (strcmp(msg, "I2C_SCAN") == 0) {
-        char buf[128];
-        scan_i2c(buf, sizeof(buf));
-        notify_clients(buf);
-    } else if (strcmp(msg, "UART_READ") == 0) {
-        char out[128] = "{\"uart\":\"";
-        int len = strlen(out);
-        uint8_t byte;
-        while (uart_read_bytes(UART_PORT, &byte, 1, 10 / portTICK_PERIOD_MS) > 0 && len < 120) {
-            out[len++] = byte;
+    char* buf = cmd_pool_claim(&rx_pool);
+    if (!buf) return ESP_ERR_NO_MEM;
+    frame.payload = (uint8_t*)buf;
+
+    ret = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (ret == ESP_OK) {
+        int64_t start = esp_timer_get_time();
+        // Newline-separated batch: validated as a whole, then applied with
+        // at most one pin-state broadcast
+        static cmd_batch_t batch;  // httpd runs one handler at a time
+        if (!cmd_parse_batch(&cmd_table, buf, frame.len, &ctx, &batch)) {
+            reply_error(ctx.slot, batch.error_line, batch.error);
+        } else {
+            const char* err = NULL;
+            if (cmd_run_batch(&batch, &ctx, &err) && err) reply_error(ctx.slot, 0, err);
+            if (ctx.pins_changed) publish_pin_states(0);
         }
-        out[len++] = '\"'; out[len++] = '}'; out[len] = 0;
-        notify_clients(out);
+        metrics_record(METRIC_CMD, (uint32_t)(esp_timer_get_time() - start));
     }
 
-    free(frame.payload);
-    return ESP_OK;
+    cmd_pool_release(&rx_pool, buf);
+    return ret;
 }
 
-
-
 static httpd_uri_t ws_uri = {
     .uri = "/ws",
     .method = HTTP_GET,
@@ -257,79 +1010,117 @@ static httpd_uri_t ws_uri = {
     .supported_subprotocol = NULL
 };
 
-static void debounce_task(void* arg) {
-    while (1) {
-        bool changed = false;
-        uint32_t now = esp_log_timestamp();
-        for (int i = 0; i < NUM_PINS; i++) {
-            if (!pin_modes[i]) {
-                int level = gpio_get_level(usable_pins[i]);
-                if (level != pin_states[i] && (now - last_change_times[i]) > 20) {
-                    pin_states[i] = level;
-                    bounce_counters[i]++;
-                    last_change_times[i] = now;
-                    changed = true;
-                }
-            }
-        }
-        if (changed) {
-            send_all_pin_states();  // notify frontend of new pin states
-        }
-        vTaskDelay(pdMS_TO_TICKS(50));
+// Called by the edge task every publish period in which input pins moved
+static void on_edge_batch(const edge_stats_t* stats, uint32_t overruns) {
+    static char json[3072];
+
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    uint64_t gpios = 0;
+    // The mode is checked inside the bracket, so a pin switched to output
+    // meanwhile keeps the level it was given
+    uint32_t updated = 0;
+    pins_write_begin();
+    for (int i = 0; i < NUM_PINS; i++) {
+        pin_state_t st;
+        if (!(stats->active & (1u << i))) continue;
+        gpios |= 1ull << usable_pins[i];
+        pin_store_peek(&pin_store, i, &st);
+        if (st.output) continue;
+        updated |= 1u << i;
+        st.level = stats->pins[i].level;
+        st.bounces = stats->pins[i].bounces;
+        st.last_change_ms = stats->pins[i].last_t_us / 1000;
+        pin_store_set(&pin_store, i, &st);
+    }
+    pins_write_end();
+    for (int i = 0; i < NUM_PINS; i++) {
+        if (updated & (1u << i)) metrics_record(METRIC_GPIO_EDGE, now_us - stats->pins[i].last_t_us);
     }
+
+    // Edge statistics ride with the pin states they explain
+    uint32_t targets = topic_targets(TOPIC_PINS, gpios);
+    if (!targets) return;
+    size_t len = edge_stats_to_json(stats, usable_pins, overruns, now_us, json, sizeof(json));
+    if (len) ws_broadcast_send(targets, json, len, false, WS_KEY_NONE);
+    send_pin_states(targets);
 }
 
-static void oscilloscope_task(void* arg) {
-    while (1) {
-        int raw = 0;
-        adc_oneshot_read(adc_handle, OSCILLO_ADC_CHANNEL, &raw);
-        float voltage = raw * 3.3f / 4095.0f;
-        last_voltage = last_voltage * (1.0f - smoothing_factor) + voltage * smoothing_factor;
-
-        char json[64];
-        snprintf(json, sizeof(json), "{\"oscilloscope\":{\"pin\":%d,\"voltage\":%.2f}}", oscillo_pin, last_voltage);
-        notify_clients(json);
-        vTaskDelay(pdMS_TO_TICKS(200));
+// Summary and analysis are slow already (5 Hz, 2 Hz): every ADC subscriber
+// of the pin gets them, only blocks and scan frames are rate limited
+static void send_oscillo_summary(int pin, float voltage) {
+    char json[64];
+    uint32_t targets = topic_all(TOPIC_ADC, 1ull << pin);
+    if (!targets) return;
+    snprintf(json, sizeof(json), "{\"oscilloscope\":{\"pin\":%d,\"voltage\":%.2f}}", pin, voltage);
+    ws_broadcast_send(targets, json, strlen(json), false, WS_KEY_OSCILLO);
+}
+
+// Checked before the FFT runs, so an unwatched pin costs nothing
+static bool adc_analysis_wanted(int pin) {
+    return topic_all(TOPIC_ADC, 1ull << pin) != 0;
+}
+
+static void send_adc_analysis(int pin, const dsp_result_t* analysis) {
+    static char json[1024];  // only the ADC task sends these
+    uint32_t targets = topic_all(TOPIC_ADC, 1ull << pin);
+    if (!targets) return;
+    size_t len = dsp_result_to_json(analysis, pin, json, sizeof(json));
+    if (len) ws_broadcast_send(targets, json, len, false, WS_KEY_ANALYSIS);
+}
+
+// Debugger counters appended to /metrics
+static void write_app_metrics(prom_writer_t* w) {
+    prom_header(w, "dbg_ws_clients", "gauge", "Connected WebSocket clients");
+    prom_printf(w, "dbg_ws_clients %d\n", __builtin_popcount(ws_broadcast_clients()));
+    prom_header(w, "dbg_adc_overruns_total", "counter", "ADC DMA pool overflows");
+    prom_printf(w, "dbg_adc_overruns_total %lu\n", (unsigned long)adc_capture_overruns());
+    prom_header(w, "dbg_gpio_edge_overruns_total", "counter", "GPIO edges lost to a full ring");
+    prom_printf(w, "dbg_gpio_edge_overruns_total %lu\n", (unsigned long)gpio_edges_overruns());
+    prom_header(w, "dbg_cmd_pool_exhausted_total", "counter", "Frames refused for lack of a receive buffer");
+    prom_printf(w, "dbg_cmd_pool_exhausted_total %lu\n", (unsigned long)rx_pool.exhausted);
+    prom_header(w, "dbg_pin_store_retries_total", "counter", "Pin snapshot passes redone because a writer was active");
+    prom_printf(w, "dbg_pin_store_retries_total %lu\n", (unsigned long)atomic_load(&pin_store.retries));
+
+    uint32_t published[TOPIC_COUNT], held[TOPIC_COUNT];
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    memcpy(published, topics.published, sizeof(published));
+    memcpy(held, topics.held, sizeof(held));
+    xSemaphoreGive(clients_lock);
+    prom_header(w, "dbg_topic_published_total", "counter", "Rate-limited topic updates sent to at least one subscriber");
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        prom_printf(w, "dbg_topic_published_total{topic=\"%s\"} %lu\n", topic_name(i), (unsigned long)published[i]);
     }
+    prom_header(w, "dbg_topic_held_total", "counter", "Topic deliveries skipped by a subscriber's rate limit");
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        prom_printf(w, "dbg_topic_held_total{topic=\"%s\"} %lu\n", topic_name(i), (unsigned long)held[i]);
+    }
+}
+
+static void send_wifi_status(uint32_t targets) {
+    char json[384];
+    size_t len = wifi_link_status_json(json, sizeof(json));
+    if (len) ws_broadcast_send(targets, json, len, false, WS_KEY_WIFI);
 }
 
+// Link changes reach every WIFI subscriber at once, whatever its rate
+static void on_wifi_change(void) {
+    uint32_t targets = topic_all(TOPIC_WIFI, 0);
+    if (targets) send_wifi_status(targets);
+}
+
+// Periodic refresh for the RSSI; state changes come from on_wifi_change()
 static void wifi_status_task(void* arg) {
     while (1) {
-        wifi_ap_record_t ap_info;
-        wifi_sta_list_t sta_list;
-        char json[256];
-        wifi_mode_t mode;
-
-        esp_wifi_get_mode(&mode);
-        esp_wifi_ap_get_sta_list(&sta_list);
-        esp_wifi_sta_get_ap_info(&ap_info);
-
-        snprintf(json, sizeof(json), 
-            "{\"wifi\":{"
-            "\"mode\":\"APSTA\","
-            "\"ap\":{"
-            "\"ssid\":\"%s\","
-            "\"connected_stations\":%d"
-            "},"
-            "\"sta\":{"
-            "\"connected\":%s,"
-            "\"rssi\":%d"
-            "}"
-            "}}",
-            AP_SSID,
-            sta_list.num,
-            ap_info.rssi != 0 ? "true" : "false",
-            ap_info.rssi
-        );
-        
-        notify_clients(json);
+        // Nothing is queried or encoded while no WIFI subscriber is due
+        uint32_t targets = topic_targets(TOPIC_WIFI, 0);
+        if (targets) send_wifi_status(targets);
         vTaskDelay(pdMS_TO_TICKS(5000)); // Update every 5 seconds
     }
 }
 
 static void mount_spiffs() {
     esp_vfs_spiffs_conf_t conf = {
-        .base_path = "/spiffs",
+        .base_path = STATIC_ASSETS_BASE,
         .partition_label = NULL,
         .max_files = 8,
         .format_if_mount_failed = true
@@ -337,37 +1128,39 @@ static void mount_spiffs() {
     ESP_ERROR_CHECK(esp_vfs_spiffs_register(&conf));
 }
 
-static esp_err_t static_file_handler(httpd_req_t *req) {
-    char filepath[600];
-    snprintf(filepath, sizeof(filepath), "/spiffs%s", req->uri);
-
-    FILE* f = fopen(filepath, "r");
-    if (!f) return httpd_resp_send_404(req);
-
-    char line[128];
-    while (fgets(line, sizeof(line), f)) {
-        httpd_resp_sendstr_chunk(req, line);
-    }
-    fclose(f);
-    return httpd_resp_sendstr_chunk(req, NULL);
-}
-
-static esp_err_t index_handler(httpd_req_t *req) {
-    FILE* f = fopen("/spiffs/index.html", "r");
-    if (!f) return httpd_resp_send_404(req);
-
-    char line[128];
-    httpd_resp_set_type(req, "text/html");
-    while (fgets(line, sizeof(line), f)) {
-        httpd_resp_sendstr_chunk(req, line);
-    }
-    fclose(f);
-    return httpd_resp_sendstr_chunk(req, NULL);
+static esp_err_t index_handler(httpd_req_t* req) {
+    metrics_boot_mark(BOOT_FIRST_PAGE);
+    return static_assets_handler(req);
 }
 
 static void start_web_server() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.send_wait_timeout = 2;  // bounds a stall if a socket fills mid-frame
+    config.max_uri_handlers = 16;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.close_fn = ws_broadcast_session_closed;  // reclaims the client's slot
     ESP_ERROR_CHECK(httpd_start(&server, &config));
+    ws_broadcast_set_server(server);
+
+    // First match wins, so the catch-all static handler goes last
+    httpd_register_uri_handler(server, &ws_uri);
+
+    httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_http_handler
+    };
+    httpd_register_uri_handler(server, &metrics_uri);
+
+    // Recordings: list, download with Range, delete
+    httpd_uri_t rec_uris[] = {
+        { .uri = "/rec", .method = HTTP_GET, .handler = recorder_http_handler },
+        { .uri = "/rec/*", .method = HTTP_GET, .handler = recorder_http_handler },
+        { .uri = "/rec/*", .method = HTTP_DELETE, .handler = recorder_http_handler },
+    };
+    for (size_t i = 0; i < sizeof(rec_uris) / sizeof(rec_uris[0]); i++) {
+        httpd_register_uri_handler(server, &rec_uris[i]);
+    }
 
     httpd_uri_t index_uri = {
         .uri = "/",
@@ -379,141 +1172,88 @@ static void start_web_server() {
     httpd_uri_t static_handler = {
         .uri = "/*",
         .method = HTTP_GET,
-        .handler = static_file_handler
+        .handler = static_assets_handler
     };
     httpd_register_uri_handler(server, &static_handler);
-
-    httpd_register_uri_handler(server, &ws_uri);
-}
-
-static void wifi_init() {
-    esp_netif_init();
-    esp_event_loop_create_default();
-    
-    // Create both AP and STA interfaces
-    esp_netif_create_default_wifi_ap();
-    esp_netif_create_default_wifi_sta();
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    // Configure AP
-    wifi_config_t ap_config = {
-        .ap = {
-            .ssid = AP_SSID,
-            .ssid_len = strlen(AP_SSID),
-            .channel = AP_CHANNEL,
-            .password = AP_PASS,
-            .max_connection = AP_MAX_CONNECTIONS,
-            .authmode = WIFI_AUTH_WPA2_PSK,
-            .ssid_hidden = AP_SSID_HIDDEN
-        }
-    };
-
-    // Configure STA
-    wifi_config_t sta_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASS
-        }
-    };
-
-    // Set mode to APSTA (both AP and STA)
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
-    
-    // Set configurations
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
-    
-    // Start WiFi
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_ERROR_CHECK(esp_wifi_connect());
-}
-
-static void network_init_task(void* parameter) {
-    // Initialize WiFi first
-    wifi_init();
-    vTaskDelay(pdMS_TO_TICKS(2000));  // Wait for IP
-    
-    // Then start the web server
-    start_web_server();
-    
-    // Create WiFi status monitoring task
-    xTaskCreatePinnedToCore(
-        wifi_status_task,
-        "wifi_status",
-        4096,
-        NULL,
-        1,
-        NULL,
-        1  // Run on Core 1
-    );
-    
-    // Keep the network task running
-    while(1) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
 }
 
 void app_main(void) {
-    ESP_ERROR_CHECK(nvs_flash_init());
-    memset(ws_clients, -1, sizeof(ws_clients));
+    metrics_boot_mark(BOOT_APP_MAIN);
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+    metrics_init(write_app_metrics);
+    clients_lock = xSemaphoreCreateMutex();
+    topic_init(&topics);
+    pin_write_lock = xSemaphoreCreateMutex();
+    pin_store_init(&pin_store, NUM_PINS);
+    if (!cmd_table_init(&cmd_table, cmd_defs, sizeof(cmd_defs) / sizeof(cmd_defs[0]))) {
+        ESP_LOGE(TAG, "Command table is not sorted");
+        abort();
+    }
+    ws_broadcast_on_tick(flush_pin_states);
+    ESP_ERROR_CHECK(ws_broadcast_start(encode_deferred));
+    ESP_ERROR_CHECK(ws_broadcast_on_close(release_client));
     mount_spiffs();
+    metrics_boot_mark(BOOT_SPIFFS);
 
-    // UART Setup
-    uart_config_t uart_config = {
-        .baud_rate = 9600,
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
+    // Non-blocking: the AP comes up and the station connects from Wi-Fi events,
+    // while the rest of the hardware is set up
+    wifi_link_ap_t ap = {
+        .ssid = AP_SSID, .password = AP_PASS, .channel = AP_CHANNEL,
+        .max_connections = AP_MAX_CONNECTIONS, .hidden = AP_SSID_HIDDEN,
     };
-    uart_driver_install(UART_PORT, 1024, 0, 0, NULL, 0);
-    uart_param_config(UART_PORT, &uart_config);
-    uart_set_pin(UART_PORT, UART_TX, UART_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-
-    // I2C Setup
-    i2c_config_t i2c_cfg = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA,
-        .scl_io_num = I2C_MASTER_SCL,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000
-    };
-    i2c_param_config(I2C_PORT, &i2c_cfg);
-    i2c_driver_install(I2C_PORT, I2C_MODE_MASTER, 0, 0, 0);
+    ESP_ERROR_CHECK(wifi_link_start(&ap, on_wifi_change));
+
+    // UART bridge: RX streams to UART_SUB clients, line settable with UART_CFG
+    uart_line_t uart_line = { .baud = UART_DEFAULT_BAUD, .data_bits = 8, .parity = 'N', .stop_bits = 1 };
+    ESP_ERROR_CHECK(uart_bridge_start(UART_PORT, UART_TX, UART_RX, &uart_line, send_uart_rx));
 
-    // ADC Setup
-    adc_oneshot_unit_init_cfg_t adc_cfg = { .unit_id = ADC_UNIT_1 };
-    adc_oneshot_new_unit(&adc_cfg, &adc_handle);
-    adc_oneshot_config_channel(adc_handle, OSCILLO_ADC_CHANNEL, &(adc_oneshot_chan_cfg_t){
-        .bitwidth = ADC_BITWIDTH_12,
-        .atten = ADC_ATTEN_DB_12
-    });
+    // I2C bus worker: scans and transactions never run on the httpd task
+    ESP_ERROR_CHECK(i2c_engine_start(I2C_PORT, I2C_MASTER_SDA, I2C_MASTER_SCL, I2C_DEFAULT_CLK, send_i2c_result));
 
+    // Every other pin starts as a plain input; a reset would detach the
+    // peripherals started above from theirs
     for (int i = 0; i < NUM_PINS; i++) {
+        if (peripheral_pin(usable_pins[i])) continue;
         gpio_reset_pin(usable_pins[i]);
         gpio_set_direction(usable_pins[i], GPIO_MODE_INPUT);
-        pin_modes[i] = false;
-        pin_states[i] = gpio_get_level(usable_pins[i]);
-        bounce_counters[i] = 0;
-        last_change_times[i] = 0;
-        pwm_frequencies[i] = 0;
     }
+    pins_write_begin();
+    for (int i = 0; i < NUM_PINS; i++) {
+        pin_state_t st = { .level = gpio_get_level(usable_pins[i]) };
+        pin_store_set(&pin_store, i, &st);
+    }
+    pins_write_end();
+
+    // LEDC timers/channels are allocated per pin; fades need the LEDC ISR service
+    ESP_ERROR_CHECK(pwm_engine_start());
+
+    // GPIO edge ISRs and their stats task live on Core 0 (default core)
+    ESP_ERROR_CHECK(gpio_edges_start(usable_pins, NUM_PINS, PERIPHERAL_PINS, on_edge_batch));
+
+    // Capture-to-flash recorder; edges, ADC blocks and UART RX feed it when selected
+    ESP_ERROR_CHECK(recorder_start(usable_pins, send_rec_status));
+    gpio_edges_set_tap(recorder_put_edges);
+
+    // Logic analyzer captures run on their own task, aligned through the edge ISRs
+    ESP_ERROR_CHECK(logic_capture_start(send_logic));
+
+    // Waveform sequencer: gptimer alarms on its own task, Core 1
+    ESP_ERROR_CHECK(sequencer_start(send_seq_report));
+
+    // ADC capture (continuous DMA) runs its own task on Core 0
+    ESP_ERROR_CHECK(adc_capture_start(OSCILLO_DEFAULT_PIN, send_adc_block, send_oscillo_summary, send_adc_analysis,
+                                      adc_analysis_wanted));
+
+    // Serve as soon as every handler's module is up; there is no waiting for
+    // an IP, the server answers on the AP now and on the station once it joins
+    start_web_server();
+    metrics_boot_mark(BOOT_HTTPD);
 
-    // Create a task for network and web server operations on Core 1
-    xTaskCreatePinnedToCore(
-        network_init_task,
-        "network_init",
-        8192,
-        NULL,
-        1,
-        NULL,
-        1  // Run on Core 1
-    );
-
-    // Create other tasks on Core 0 (default core)
-    xTaskCreatePinnedToCore(debounce_task, "debounce_task", 4096, NULL, 5, NULL, 0);
-    xTaskCreatePinnedToCore(oscilloscope_task, "oscilloscope_task", 4096, NULL, 5, NULL, 0);
+    // Wi-Fi status refresh for WIFI subscribers, Core 1
+    xTaskCreatePinnedToCore(wifi_status_task, "wifi_status", 4096, NULL, 1, NULL, 1);
 }
@@ -0,0 +1,256 @@
+// Metrics — latency histograms fed from the hot paths plus FreeRTOS task,
+// heap and stack state, read on demand. Per-task CPU needs
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (on in sdkconfig.defaults).
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#define TAG "Metrics"
+
+#define METRICS_MAX_TASKS       32
+#define METRICS_MIN_PERIOD_MS   250
+#define METRICS_JSON_LEN        3072
+#define METRICS_CHUNK           1024
+
+static lat_hist_t s_hist[METRIC_LAT_COUNT];
+
+// esp_timer ms when each boot phase was reached, 0 = not yet. esp_timer
+// starts with the app, so ROM and bootloader time are not included.
+static volatile uint32_t s_boot_ms[BOOT_PHASE_COUNT];
+static const char* const s_boot_names[BOOT_PHASE_COUNT] = {
+    [BOOT_APP_MAIN] = "app_main", [BOOT_SPIFFS] = "spiffs", [BOOT_WIFI_START] = "wifi_start",
+    [BOOT_AP_START] = "ap_start", [BOOT_HTTPD] = "httpd", [BOOT_STA_CONNECTED] = "sta_connected",
+    [BOOT_STA_GOT_IP] = "sta_got_ip", [BOOT_FIRST_PAGE] = "first_page", [BOOT_FIRST_WS] = "first_ws",
+};
+static metrics_extra_fn_t s_extra;
+
+static SemaphoreHandle_t s_lock;        // guards the snapshot buffers below
+static TaskStatus_t s_tasks[METRICS_MAX_TASKS];
+
+// Streaming state, owned by the metrics task
+static TaskHandle_t s_stream_task;
+static volatile uint32_t s_period_ms;
+static metrics_sink_t s_sink;
+static struct {
+    TaskHandle_t handle;
+    uint64_t runtime;
+} s_prev[METRICS_MAX_TASKS];
+static size_t s_prev_n;
+static int64_t s_prev_t;
+
+void metrics_init(metrics_extra_fn_t extra) {
+    s_extra = extra;
+    s_lock = xSemaphoreCreateMutex();
+    lat_hist_init(&s_hist[METRIC_CMD], "dbg_cmd_latency_seconds", "cmd",
+                  "WebSocket command frame parse and apply time");
+    lat_hist_init(&s_hist[METRIC_BCAST_PUBLISH], "dbg_broadcast_publish_seconds", "publish",
+                  "Time to copy a message and queue it for every client");
+    lat_hist_init(&s_hist[METRIC_BCAST_SEND], "dbg_broadcast_send_latency_seconds", "send",
+                  "Queue to socket latency per client message");
+    lat_hist_init(&s_hist[METRIC_ADC_BLOCK], "dbg_adc_block_latency_seconds", "adc",
+                  "ADC DMA read to block queued for clients");
+    lat_hist_init(&s_hist[METRIC_GPIO_EDGE], "dbg_gpio_edge_latency_seconds", "edge",
+                  "GPIO edge timestamp to pin state queued for clients");
+}
+
+void metrics_record(metric_lat_t id, uint32_t us) {
+    if (id < METRIC_LAT_COUNT) lat_hist_record(&s_hist[id], us);
+}
+
+void metrics_boot_mark(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_COUNT || s_boot_ms[phase]) return;
+    uint32_t ms = (uint32_t)(esp_timer_get_time() / 1000);
+    s_boot_ms[phase] = ms ? ms : 1;
+    ESP_LOGI(TAG, "Boot: %s at %lu ms", s_boot_names[phase], (unsigned long)ms);
+}
+
+// Caller holds s_lock
+static size_t snapshot_tasks(uint64_t* total_runtime) {
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    size_t n = uxTaskGetSystemState(s_tasks, METRICS_MAX_TASKS, &total);
+    *total_runtime = total;
+    return n;
+#else
+    *total_runtime = 0;
+    return 0;
+#endif
+}
+
+static void write_prom(prom_writer_t* w) {
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    prom_header(w, "esp_uptime_seconds", "counter", "Time since boot");
+    prom_printf(w, "esp_uptime_seconds %lld\n", (long long)(esp_timer_get_time() / 1000000));
+    prom_header(w, "esp_heap_free_bytes", "gauge", "Free 8-bit capable heap");
+    prom_printf(w, "esp_heap_free_bytes %u\n", (unsigned)free_bytes);
+    prom_header(w, "esp_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+    prom_printf(w, "esp_heap_min_free_bytes %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    prom_header(w, "esp_heap_largest_free_block_bytes", "gauge", "Largest allocatable block");
+    prom_printf(w, "esp_heap_largest_free_block_bytes %u\n", (unsigned)largest);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint64_t total;
+    size_t n = snapshot_tasks(&total);
+    if (n) {
+        prom_header(w, "esp_task_stack_high_water_bytes", "gauge", "Least free stack seen per task");
+        for (size_t i = 0; i < n; i++) {
+            prom_printf(w, "esp_task_stack_high_water_bytes{task=\"%s\"} %lu\n",
+                        s_tasks[i].pcTaskName, (unsigned long)s_tasks[i].usStackHighWaterMark);
+        }
+        prom_header(w, "esp_task_priority", "gauge", "Current task priority");
+        for (size_t i = 0; i < n; i++) {
+            prom_printf(w, "esp_task_priority{task=\"%s\"} %u\n",
+                        s_tasks[i].pcTaskName, (unsigned)s_tasks[i].uxCurrentPriority);
+        }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        prom_header(w, "esp_task_runtime_seconds_total", "counter", "CPU time per task");
+        for (size_t i = 0; i < n; i++) {
+            uint64_t rt = s_tasks[i].ulRunTimeCounter;
+            prom_printf(w, "esp_task_runtime_seconds_total{task=\"%s\"} %lu.%06lu\n", s_tasks[i].pcTaskName,
+                        (unsigned long)(rt / 1000000), (unsigned long)(rt % 1000000));
+        }
+#endif
+    }
+    xSemaphoreGive(s_lock);
+
+    prom_header(w, "esp_boot_phase_seconds", "gauge", "Uptime when each boot phase was first reached");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        uint32_t ms = s_boot_ms[i];
+        if (ms) prom_printf(w, "esp_boot_phase_seconds{phase=\"%s\"} %lu.%03lu\n", s_boot_names[i],
+                            (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+    }
+
+    for (int i = 0; i < METRIC_LAT_COUNT; i++) prom_hist(w, &s_hist[i]);
+    if (s_extra) s_extra(w);
+}
+
+static bool send_chunk(const char* buf, size_t len, void* ctx) {
+    return httpd_resp_send_chunk((httpd_req_t*)ctx, buf, len) == ESP_OK;
+}
+
+esp_err_t metrics_http_handler(httpd_req_t *req) {
+    char chunk[METRICS_CHUNK];
+    prom_writer_t w;
+    prom_init(&w, chunk, sizeof(chunk), send_chunk, req);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    write_prom(&w);
+    if (!prom_finish(&w)) ESP_LOGW(TAG, "Scrape truncated");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// CPU time since the previous call in tenths of a percent of one core
+static uint32_t cpu_permille(TaskHandle_t handle, uint64_t runtime, int64_t dt_us) {
+    for (size_t i = 0; i < s_prev_n; i++) {
+        if (s_prev[i].handle == handle) {
+            return dt_us > 0 ? (uint32_t)((runtime - s_prev[i].runtime) * 1000 / dt_us) : 0;
+        }
+    }
+    return 0;
+}
+
+static size_t encode_json(char* out, size_t out_len) {
+    size_t pos = 0;
+    int n = snprintf(out, out_len,
+        "{\"metrics\":{\"uptime_ms\":%lld,\"heap\":{\"free\":%u,\"min_free\":%u,\"largest\":%u},\"tasks\":[",
+        (long long)(esp_timer_get_time() / 1000), (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+        (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    if (n < 0 || (size_t)n >= out_len) return 0;
+    pos = n;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint64_t total;
+    int64_t now = esp_timer_get_time();
+    size_t count = snapshot_tasks(&total);
+    for (size_t i = 0; i < count && pos < out_len; i++) {
+        const TaskStatus_t* t = &s_tasks[i];
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        uint64_t runtime = t->ulRunTimeCounter;
+#else
+        uint64_t runtime = 0;
+#endif
+        uint32_t cpu = cpu_permille(t->xHandle, runtime, now - s_prev_t);
+        n = snprintf(out + pos, out_len - pos, "%s{\"name\":\"%s\",\"prio\":%u,\"stack_free\":%lu,\"cpu\":%lu.%lu}",
+                     i ? "," : "", t->pcTaskName, (unsigned)t->uxCurrentPriority,
+                     (unsigned long)t->usStackHighWaterMark, (unsigned long)(cpu / 10), (unsigned long)(cpu % 10));
+        pos = (n < 0 || (size_t)n >= out_len - pos) ? out_len : pos + n;
+    }
+    for (size_t i = 0; i < count; i++) {
+        s_prev[i].handle = s_tasks[i].xHandle;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        s_prev[i].runtime = s_tasks[i].ulRunTimeCounter;
+#endif
+    }
+    s_prev_n = count;
+    s_prev_t = now;
+    xSemaphoreGive(s_lock);
+    if (pos >= out_len) return 0;
+
+    n = snprintf(out + pos, out_len - pos, "],\"boot_ms\":{");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    pos += n;
+    bool first = true;
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        uint32_t ms = s_boot_ms[i];
+        if (!ms) continue;
+        n = snprintf(out + pos, out_len - pos, "%s\"%s\":%lu", first ? "" : ",", s_boot_names[i], (unsigned long)ms);
+        if (n < 0 || (size_t)n >= out_len - pos) return 0;
+        pos += n;
+        first = false;
+    }
+
+    n = snprintf(out + pos, out_len - pos, "},\"latency_us\":{");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    pos += n;
+    for (int i = 0; i < METRIC_LAT_COUNT; i++) {
+        if (i) {
+            if (pos + 1 >= out_len) return 0;
+            out[pos++] = ',';
+        }
+        size_t len = lat_hist_to_json(&s_hist[i], out + pos, out_len - pos);
+        if (!len) return 0;
+        pos += len;
+    }
+    n = snprintf(out + pos, out_len - pos, "}}}");
+    if (n < 0 || (size_t)n >= out_len - pos) return 0;
+    return pos + n;
+}
+
+static void metrics_task(void* arg) {
+    static char json[METRICS_JSON_LEN];
+    while (1) {
+        uint32_t period = s_period_ms;
+        if (!period) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        size_t len = encode_json(json, sizeof(json));
+        if (len && s_sink) s_sink(json, len);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(period));
+    }
+}
+
+esp_err_t metrics_stream(uint32_t period_ms, metrics_sink_t sink) {
+    if (period_ms && period_ms < METRICS_MIN_PERIOD_MS) period_ms = METRICS_MIN_PERIOD_MS;
+    s_sink = sink;
+    s_period_ms = period_ms;
+    if (!s_stream_task) {
+        if (xTaskCreatePinnedToCore(metrics_task, "metrics", 3072, NULL, 1, &s_stream_task, 1) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    } else {
+        xTaskNotifyGive(s_stream_task);
+    }
+    return ESP_OK;
+}
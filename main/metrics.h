@@ -0,0 +1,47 @@
+// Runtime telemetry — /metrics (Prometheus text) and a periodic JSON snapshot
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include "metrics_core.h"
+
+typedef enum {
+    METRIC_CMD,             // ws frame parse + apply
+    METRIC_BCAST_PUBLISH,   // ws_broadcast_send: encode-once copy and fan-out
+    METRIC_BCAST_SEND,      // enqueue to socket write, per client
+    METRIC_ADC_BLOCK,       // DMA read returned to block queued for clients
+    METRIC_GPIO_EDGE,       // edge timestamp to pin state queued for clients
+    METRIC_LAT_COUNT,
+} metric_lat_t;
+
+// Boot milestones, each stamped the first time it is reached, for
+// tracking time to first page across firmware changes
+typedef enum {
+    BOOT_APP_MAIN,          // app_main entered
+    BOOT_SPIFFS,            // web assets mounted
+    BOOT_WIFI_START,        // esp_wifi_start() returned
+    BOOT_AP_START,          // AP interface up
+    BOOT_HTTPD,             // web server listening
+    BOOT_STA_CONNECTED,     // station associated
+    BOOT_STA_GOT_IP,
+    BOOT_FIRST_PAGE,        // first GET /
+    BOOT_FIRST_WS,          // first WebSocket client
+    BOOT_PHASE_COUNT,
+} boot_phase_t;
+
+// Application gauges/counters appended to /metrics
+typedef void (*metrics_extra_fn_t)(prom_writer_t *w);
+// Periodic JSON snapshot for WebSocket subscribers
+typedef void (*metrics_sink_t)(const char *json, size_t len);
+
+void metrics_init(metrics_extra_fn_t extra);
+void metrics_record(metric_lat_t id, uint32_t us);
+void metrics_boot_mark(boot_phase_t phase);     // callable before metrics_init()
+
+// Start streaming {"metrics":...} every period_ms (0 stops)
+esp_err_t metrics_stream(uint32_t period_ms, metrics_sink_t sink);
+
+// GET /metrics
+esp_err_t metrics_http_handler(httpd_req_t *req);
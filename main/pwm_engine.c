@@ -0,0 +1,133 @@
+// PWM engine — pwm_core decides which LEDC timer and channel a pin uses;
+// this file applies its plans. Duty goes through ledc_set_duty and
+// ledc_update_duty, which latch at the end of the current period, and a
+// frequency change on a timer with one user only rewrites its divider, so
+// neither restarts the output. Called from the httpd handler only.
+#include "pwm_engine.h"
+
+#include <stdatomic.h>
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_rom_gpio.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <soc/gpio_sig_map.h>
+
+#define TAG "PWM"
+
+#define PWM_APB_HZ          80000000    // LEDC_USE_APB_CLK, which pwm_core's divider maths assume
+
+static pwm_alloc_t s_alloc;
+static _Atomic uint32_t s_fading;       // bit mode * PWM_CHANNELS + channel
+
+static bool IRAM_ATTR on_fade_end(const ledc_cb_param_t *param, void *arg) {
+    if (param->event == LEDC_FADE_END_EVT) atomic_fetch_and(&s_fading, ~(1u << (uintptr_t)arg));
+    return false;
+}
+
+static uint32_t fade_bit(uint8_t mode, uint8_t channel) {
+    return 1u << (mode * PWM_CHANNELS + channel);
+}
+
+static esp_err_t config_timer(uint8_t mode, uint8_t timer) {
+    const pwm_timer_t *t = &s_alloc.timers[mode][timer];
+    ledc_timer_config_t cfg = {
+        .speed_mode = mode,
+        .duty_resolution = t->bits,
+        .timer_num = timer,
+        .freq_hz = t->freq_hz,
+        .clk_cfg = LEDC_USE_APB_CLK,
+    };
+    return ledc_timer_config(&cfg);
+}
+
+static esp_err_t apply_duty(uint8_t mode, uint8_t channel) {
+    const pwm_channel_t *c = &s_alloc.channels[mode][channel];
+    uint32_t ticks = pwm_duty_ticks(c->duty, s_alloc.timers[mode][c->timer].bits);
+    esp_err_t err = ledc_set_duty(mode, channel, ticks);
+    return err == ESP_OK ? ledc_update_duty(mode, channel) : err;
+}
+
+esp_err_t pwm_engine_start(void) {
+    pwm_alloc_init(&s_alloc, PWM_APB_HZ);
+    return ledc_fade_func_install(0);
+}
+
+esp_err_t pwm_engine_set(int gpio, uint32_t freq_hz) {
+    uint8_t bits;
+    uint32_t div;
+    if (!pwm_timing(PWM_APB_HZ, freq_hz, &bits, &div)) return ESP_ERR_INVALID_ARG;
+    pwm_plan_t plan;
+    if (!pwm_assign(&s_alloc, gpio, freq_hz, &plan)) return ESP_ERR_NOT_FOUND;
+
+    if (plan.freed_mode >= 0) {
+        ledc_stop(plan.freed_mode, plan.freed_channel, 0);
+        atomic_fetch_and(&s_fading, ~fade_bit(plan.freed_mode, plan.freed_channel));
+    }
+
+    esp_err_t err = ESP_OK;
+    if (plan.timer_config) err = config_timer(plan.mode, plan.timer);
+    else if (plan.timer_freq) err = ledc_set_freq(plan.mode, plan.timer, freq_hz);
+
+    if (err == ESP_OK && plan.channel_config) {
+        const pwm_channel_t *c = &s_alloc.channels[plan.mode][plan.channel];
+        ledc_channel_config_t cfg = {
+            .gpio_num = gpio,
+            .speed_mode = plan.mode,
+            .channel = plan.channel,
+            .timer_sel = plan.timer,
+            .duty = pwm_duty_ticks(c->duty, s_alloc.timers[plan.mode][plan.timer].bits),
+            .hpoint = 0,
+        };
+        ledc_cbs_t cbs = { .fade_cb = on_fade_end };
+        err = ledc_channel_config(&cfg);
+        if (err == ESP_OK) {
+            err = ledc_cb_register(plan.mode, plan.channel, &cbs,
+                                   (void *)(uintptr_t)(plan.mode * PWM_CHANNELS + plan.channel));
+        }
+    } else if (err == ESP_OK && (plan.rebind || plan.timer_config)) {
+        // Same channel, new timer or resolution: rebind and rescale the duty
+        if (plan.rebind) err = ledc_bind_channel_timer(plan.mode, plan.channel, plan.timer);
+        if (err == ESP_OK) err = apply_duty(plan.mode, plan.channel);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "GPIO%d at %lu Hz: %s", gpio, (unsigned long)freq_hz, esp_err_to_name(err));
+        pwm_engine_release(gpio);
+    }
+    return err;
+}
+
+esp_err_t pwm_engine_duty(int gpio, uint32_t duty) {
+    uint8_t mode, channel;
+    if (!pwm_find(&s_alloc, gpio, &mode, &channel)) return ESP_ERR_NOT_FOUND;
+    if (atomic_load(&s_fading) & fade_bit(mode, channel)) return ESP_ERR_INVALID_STATE;
+    s_alloc.channels[mode][channel].duty = duty > PWM_DUTY_SCALE ? PWM_DUTY_SCALE : duty;
+    return apply_duty(mode, channel);
+}
+
+esp_err_t pwm_engine_fade(int gpio, uint32_t duty, uint32_t ms) {
+    uint8_t mode, channel;
+    if (!pwm_find(&s_alloc, gpio, &mode, &channel)) return ESP_ERR_NOT_FOUND;
+    pwm_channel_t *c = &s_alloc.channels[mode][channel];
+    c->duty = duty > PWM_DUTY_SCALE ? PWM_DUTY_SCALE : duty;
+    atomic_fetch_or(&s_fading, fade_bit(mode, channel));
+    esp_err_t err = ledc_set_fade_time_and_start(mode, channel, pwm_duty_ticks(c->duty, s_alloc.timers[mode][c->timer].bits),
+                                                 ms, LEDC_FADE_NO_WAIT);
+    if (err != ESP_OK) atomic_fetch_and(&s_fading, ~fade_bit(mode, channel));
+    return err;
+}
+
+void pwm_engine_release(int gpio) {
+    uint8_t mode, channel;
+    if (!pwm_release(&s_alloc, gpio, &mode, &channel)) return;
+    ledc_stop(mode, channel, 0);
+    atomic_fetch_and(&s_fading, ~fade_bit(mode, channel));
+    // The pad still carries the LEDC signal until it is routed back to the GPIO output register
+    gpio_set_level(gpio, 0);
+    esp_rom_gpio_connect_out_signal(gpio, SIG_GPIO_OUT_IDX, false, false);
+}
+
+size_t pwm_engine_to_json(char *out, size_t out_len) {
+    return pwm_to_json(&s_alloc, out, out_len);
+}
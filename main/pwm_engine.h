@@ -0,0 +1,26 @@
+// PWM engine — LEDC timers and channels allocated per pin by pwm_core,
+// live duty and frequency updates and hardware fades
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "pwm_core.h"
+
+esp_err_t pwm_engine_start(void);
+
+// Start or retune a pin. ESP_ERR_INVALID_ARG for an impossible frequency,
+// ESP_ERR_NOT_FOUND when every timer or channel is taken.
+esp_err_t pwm_engine_set(int gpio, uint32_t freq_hz);
+
+// duty in 0.01 % (0..PWM_DUTY_SCALE), latched at the next PWM period.
+// ESP_ERR_INVALID_STATE while a fade runs on the pin.
+esp_err_t pwm_engine_duty(int gpio, uint32_t duty);
+
+// Hardware fade from the current duty to duty over ms
+esp_err_t pwm_engine_fade(int gpio, uint32_t duty, uint32_t ms);
+
+// Stop the pin's PWM and hand it back to plain GPIO output, driven low
+void pwm_engine_release(int gpio);
+
+size_t pwm_engine_to_json(char *out, size_t out_len);
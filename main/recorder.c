@@ -0,0 +1,455 @@
+// Recorder — producers append records to the active chunk buffer under a
+// short lock; full chunks go to the writer task, which owns the file. With
+// two buffers, sampling only ever waits for a memcpy, never for flash: if
+// both buffers are in flight the record is dropped and counted instead.
+#include "recorder.h"
+#include "static_assets.h"
+#include "dbg_wire.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_spiffs.h>
+
+#define TAG "Recorder"
+
+#define REC_PREFIX          "rec_"
+#define REC_NAME_MAX        16
+#define REC_FLUSH_MS        2000    // a quiet chunk is written after this, bounding loss on reset
+#define REC_RESERVE         (32 * 1024)     // left free on the partition for the UI and SPIFFS
+#define REC_SEND_CHUNK      4096
+
+typedef enum {
+    REC_IDLE = 0,
+    REC_RECORDING,
+    REC_FINISHING,              // writer is flushing and writing the index
+} rec_state_t;
+
+typedef struct {
+    uint8_t buf;
+    rec_chunk_t meta;
+} rec_job_t;
+
+static _Atomic int s_state;
+static recorder_sink_t s_sink;
+static const int *s_gpio_nums;
+static QueueHandle_t s_jobs;
+
+// Guarded by s_lock
+static SemaphoreHandle_t s_lock;
+static uint8_t *s_bufs[2];
+static bool s_in_flight[2];
+static int s_active;
+static rec_chunk_t s_chunk;
+static uint8_t s_sources;
+static uint32_t s_dropped;
+static uint32_t s_dropped_logged;
+
+// Owned by the writer task once recording; read for status only
+static int s_fd = -1;
+static char s_name[REC_NAME_MAX];
+static rec_index_t *s_index;
+static uint32_t s_max_bytes;
+static _Atomic uint32_t s_bytes;
+static _Atomic uint32_t s_chunks;
+static _Atomic uint32_t s_records;
+
+// Hand the active chunk to the writer and switch buffers; false if the
+// other buffer is still being written
+static bool rotate_locked(uint64_t now) {
+    if (rec_chunk_empty(&s_chunk)) {
+        rec_chunk_init(&s_chunk, s_chunk.buf, s_chunk.seq, now);
+        return true;
+    }
+    int other = s_active ^ 1;
+    if (s_in_flight[other]) return false;
+
+    // Sealed by the writer: the CRC pass stays off the producers' path
+    rec_job_t job = { .buf = s_active, .meta = s_chunk };
+    s_in_flight[s_active] = true;
+    xQueueSend(s_jobs, &job, 0);    // never full: one slot per buffer
+    s_active = other;
+    rec_chunk_init(&s_chunk, s_bufs[other], s_chunk.seq + 1, now);
+    return true;
+}
+
+static bool put_locked(uint8_t type, uint64_t now, const uint8_t *data, size_t len) {
+    bool cont = false;
+    if (rec_chunk_empty(&s_chunk)) rec_chunk_init(&s_chunk, s_chunk.buf, s_chunk.seq, now);
+    while (1) {
+        size_t n = rec_chunk_put(&s_chunk, type, now, data, len, cont);
+        data += n;
+        len -= n;
+        if (n && !len) return true;
+        if (!n && rec_chunk_empty(&s_chunk)) return false;
+        cont = cont || n;
+        // A record cut off here ends in REC_FRAG_MORE with nothing after; readers drop it
+        if (!rotate_locked(now)) return false;
+    }
+}
+
+static void put(uint8_t source, uint8_t type, const void *data, size_t len) {
+    if (atomic_load(&s_state) != REC_RECORDING || !(s_sources & source) || !len) return;
+    uint64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (atomic_load(&s_state) == REC_RECORDING) {
+        if (s_dropped != s_dropped_logged) {
+            uint8_t count[4];
+            wire_put_u32(count, s_dropped);
+            if (put_locked(REC_DROPPED, now, count, sizeof(count))) s_dropped_logged = s_dropped;
+        }
+        if (!put_locked(type, now, data, len)) s_dropped++;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void recorder_put_frame(const uint8_t *frame, size_t len) {
+    put(frame[0] == WIRE_UART_RX ? REC_SRC_UART : REC_SRC_ADC, frame[0], frame, len);
+}
+
+void recorder_put_edges(const edge_event_t *ev, size_t n) {
+    uint8_t payload[64 * 6];
+    if (atomic_load(&s_state) != REC_RECORDING || !(s_sources & REC_SRC_EDGES)) return;
+    while (n) {
+        size_t k = n < 64 ? n : 64;
+        put(REC_SRC_EDGES, REC_EDGES, payload, rec_edges_encode(ev, k, s_gpio_nums, payload, sizeof(payload)));
+        ev += k;
+        n -= k;
+    }
+}
+
+size_t recorder_status_json(char *out, size_t out_len) {
+    static const char *states[] = { "idle", "recording", "finishing" };
+    size_t total = 0, used = 0;
+    esp_spiffs_info(NULL, &total, &used);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t dropped = s_dropped;
+    xSemaphoreGive(s_lock);
+    int n = snprintf(out, out_len,
+                     "{\"rec\":{\"state\":\"%s\",\"name\":\"%s\",\"bytes\":%lu,\"chunks\":%lu,\"records\":%lu,"
+                     "\"dropped\":%lu,\"free\":%lu}}",
+                     states[atomic_load(&s_state)], s_name, (unsigned long)atomic_load(&s_bytes),
+                     (unsigned long)atomic_load(&s_chunks), (unsigned long)atomic_load(&s_records),
+                     (unsigned long)dropped, (unsigned long)(total - used));
+    return n > 0 && (size_t)n < out_len ? n : 0;
+}
+
+static void notify(void) {
+    char json[256];
+    size_t len = recorder_status_json(json, sizeof(json));
+    if (len && s_sink) s_sink(json, len);
+}
+
+static bool is_rec_name(const char *name) {
+    size_t len = strlen(name);
+    if (len >= REC_NAME_MAX || strncmp(name, REC_PREFIX, strlen(REC_PREFIX)) != 0) return false;
+    if (len <= strlen(REC_PREFIX) + 4 || strcmp(name + len - 4, ".bin") != 0) return false;
+    for (size_t i = strlen(REC_PREFIX); i < len - 4; i++) {
+        if (name[i] < '0' || name[i] > '9') return false;
+    }
+    return true;
+}
+
+static void next_name(char *out) {
+    unsigned max = 0;
+    DIR *dir = opendir(STATIC_ASSETS_BASE);
+    struct dirent *de;
+    while (dir && (de = readdir(dir))) {
+        if (is_rec_name(de->d_name)) {
+            unsigned n = strtoul(de->d_name + strlen(REC_PREFIX), NULL, 10);
+            if (n > max) max = n;
+        }
+    }
+    if (dir) closedir(dir);
+    snprintf(out, REC_NAME_MAX, REC_PREFIX "%04u.bin", max + 1);
+}
+
+static bool space_left(void) {
+    size_t total = 0, used = 0;
+    if (esp_spiffs_info(NULL, &total, &used) != ESP_OK || total - used < REC_RESERVE) return false;
+    size_t trailer = 8 + REC_INDEX_MAX * REC_INDEX_ENTRY_LEN + REC_FOOTER_LEN;
+    return !s_max_bytes || atomic_load(&s_bytes) + REC_CHUNK_MAX + trailer <= s_max_bytes;
+}
+
+static void release_buffers(void) {
+    free(s_bufs[0]);
+    free(s_bufs[1]);
+    free(s_index);
+    s_bufs[0] = s_bufs[1] = NULL;
+    s_index = NULL;
+}
+
+esp_err_t recorder_begin(uint8_t sources, uint32_t max_kb, const char *desc) {
+    if (atomic_load(&s_state) != REC_IDLE) return ESP_ERR_INVALID_STATE;
+    s_max_bytes = max_kb * 1024;
+    atomic_store(&s_bytes, 0);
+    if (!space_left()) return ESP_ERR_NO_MEM;
+
+    s_bufs[0] = malloc(REC_CHUNK_MAX);
+    s_bufs[1] = malloc(REC_CHUNK_MAX);
+    s_index = malloc(sizeof(*s_index));
+    if (!s_bufs[0] || !s_bufs[1] || !s_index) {
+        release_buffers();
+        return ESP_ERR_NO_MEM;
+    }
+
+    char path[sizeof(STATIC_ASSETS_BASE) + REC_NAME_MAX + 1];
+    next_name(s_name);
+    snprintf(path, sizeof(path), STATIC_ASSETS_BASE "/%s", s_name);
+    s_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    uint64_t now = esp_timer_get_time();
+    size_t hdr = rec_file_header(s_bufs[0], now, sources, desc);
+    if (s_fd < 0 || write(s_fd, s_bufs[0], hdr) != (ssize_t)hdr) {
+        ESP_LOGE(TAG, "Cannot create %s", path);
+        if (s_fd >= 0) close(s_fd);
+        s_fd = -1;
+        release_buffers();
+        return ESP_FAIL;
+    }
+
+    rec_index_init(s_index);
+    atomic_store(&s_bytes, hdr);
+    atomic_store(&s_chunks, 0);
+    atomic_store(&s_records, 0);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_in_flight[0] = s_in_flight[1] = false;
+    s_active = 0;
+    rec_chunk_init(&s_chunk, s_bufs[0], 0, now);
+    s_sources = sources;
+    s_dropped = s_dropped_logged = 0;
+    atomic_store(&s_state, REC_RECORDING);
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "Recording to %s (sources 0x%02x)", s_name, sources);
+    notify();
+    return ESP_OK;
+}
+
+// The writer notices within REC_FLUSH_MS / 4
+void recorder_end(void) {
+    int expected = REC_RECORDING;
+    atomic_compare_exchange_strong(&s_state, &expected, REC_FINISHING);
+}
+
+static void write_job(rec_job_t *job) {
+    if (s_fd >= 0) {
+        size_t len = rec_chunk_seal(&job->meta);
+        if (write(s_fd, s_bufs[job->buf], len) == (ssize_t)len) {
+            fsync(s_fd);
+            rec_index_add(s_index, &job->meta, atomic_load(&s_bytes));
+            atomic_fetch_add(&s_bytes, len);
+            atomic_fetch_add(&s_chunks, 1);
+            atomic_fetch_add(&s_records, job->meta.records);
+        } else {
+            ESP_LOGE(TAG, "Write failed, stopping");
+            recorder_end();
+        }
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_in_flight[job->buf] = false;
+    xSemaphoreGive(s_lock);
+    if (!space_left()) recorder_end();
+}
+
+// Flush what is left, append the index and close the file
+static void finish(void) {
+    rec_job_t job;
+    while (1) {
+        while (xQueueReceive(s_jobs, &job, 0)) write_job(&job);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool empty = rec_chunk_empty(&s_chunk);
+        if (!empty) rotate_locked(esp_timer_get_time());
+        xSemaphoreGive(s_lock);
+        if (empty) break;
+    }
+
+    // Both buffers are idle now; either holds the trailer
+    size_t len = rec_index_encode(s_index, atomic_load(&s_bytes), s_bufs[0], REC_CHUNK_MAX);
+    if (s_fd >= 0 && len && write(s_fd, s_bufs[0], len) == (ssize_t)len) atomic_fetch_add(&s_bytes, len);
+    if (s_fd >= 0) close(s_fd);
+    s_fd = -1;
+    release_buffers();
+    ESP_LOGI(TAG, "%s closed: %lu bytes, %lu records, %lu dropped", s_name, (unsigned long)atomic_load(&s_bytes),
+             (unsigned long)atomic_load(&s_records), (unsigned long)s_dropped);
+    atomic_store(&s_state, REC_IDLE);
+    notify();
+}
+
+static void recorder_task(void *arg) {
+    while (1) {
+        rec_job_t job;
+        if (xQueueReceive(s_jobs, &job, pdMS_TO_TICKS(REC_FLUSH_MS / 4))) {
+            write_job(&job);
+            continue;
+        }
+        if (atomic_load(&s_state) == REC_FINISHING) finish();
+        if (atomic_load(&s_state) != REC_RECORDING) continue;
+
+        uint64_t now = esp_timer_get_time();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (!rec_chunk_empty(&s_chunk) && now - s_chunk.base_us >= REC_FLUSH_MS * 1000ull) rotate_locked(now);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+esp_err_t recorder_start(const int *gpio_nums, recorder_sink_t sink) {
+    s_gpio_nums = gpio_nums;
+    s_sink = sink;
+    s_lock = xSemaphoreCreateMutex();
+    s_jobs = xQueueCreate(2, sizeof(rec_job_t));
+    if (!s_lock || !s_jobs) return ESP_ERR_NO_MEM;
+    // Below the capture tasks: flash writes may wait, sampling may not
+    if (xTaskCreatePinnedToCore(recorder_task, "recorder", 4096, NULL, 3, NULL, 0) != pdPASS) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+// --- HTTP ---
+
+typedef enum {
+    RANGE_IGNORE,           // malformed or unsupported: answer 200 with the whole file
+    RANGE_OK,
+    RANGE_UNSATISFIABLE,    // well formed but past the end: 416
+} range_result_t;
+
+// "bytes=a-b", "bytes=a-" or "bytes=-n"; a single range only. Anything
+// else is ignored, as RFC 9110 asks of a Range header the server can't parse.
+static range_result_t parse_range(const char *h, uint32_t size, uint32_t *first, uint32_t *last) {
+    if (strncasecmp(h, "bytes=", 6) != 0) return RANGE_IGNORE;
+    h += 6;
+    char *end;
+    if (*h == '-') {
+        if (!isdigit((unsigned char)h[1])) return RANGE_IGNORE;
+        unsigned long n = strtoul(h + 1, &end, 10);
+        if (*end) return RANGE_IGNORE;
+        if (!n || !size) return RANGE_UNSATISFIABLE;
+        *first = n >= size ? 0 : size - n;
+        *last = size - 1;
+        return RANGE_OK;
+    }
+    if (!isdigit((unsigned char)*h)) return RANGE_IGNORE;
+    unsigned long a = strtoul(h, &end, 10);
+    if (*end != '-') return RANGE_IGNORE;
+    h = end + 1;
+    unsigned long b = ULONG_MAX;
+    if (*h) {
+        if (!isdigit((unsigned char)*h)) return RANGE_IGNORE;
+        b = strtoul(h, &end, 10);
+        if (*end || b < a) return RANGE_IGNORE;
+    }
+    if (a >= size) return RANGE_UNSATISFIABLE;
+    *first = a;
+    *last = b >= size ? size - 1 : b;
+    return RANGE_OK;
+}
+
+static esp_err_t send_list(httpd_req_t *req) {
+    char line[96];
+    size_t total = 0, used = 0;
+    esp_spiffs_info(NULL, &total, &used);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"recordings\":[");
+
+    DIR *dir = opendir(STATIC_ASSETS_BASE);
+    struct dirent *de;
+    bool first = true;
+    while (dir && (de = readdir(dir))) {
+        if (!is_rec_name(de->d_name)) continue;
+        char path[sizeof(STATIC_ASSETS_BASE) + REC_NAME_MAX + 1];
+        struct stat st;
+        snprintf(path, sizeof(path), STATIC_ASSETS_BASE "/%s", de->d_name);
+        if (stat(path, &st) != 0) continue;
+        bool active = atomic_load(&s_state) != REC_IDLE && strcmp(de->d_name, s_name) == 0;
+        snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"size\":%ld,\"active\":%s}", first ? "" : ",",
+                 de->d_name, (long)st.st_size, active ? "true" : "false");
+        httpd_resp_sendstr_chunk(req, line);
+        first = false;
+    }
+    if (dir) closedir(dir);
+    snprintf(line, sizeof(line), "],\"free\":%lu,\"total\":%lu}", (unsigned long)(total - used), (unsigned long)total);
+    httpd_resp_sendstr_chunk(req, line);
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+static esp_err_t send_file(httpd_req_t *req, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return httpd_resp_send_404(req);
+    uint32_t size = st.st_size, first = 0, last = size ? size - 1 : 0;
+
+    char range[48], content_range[64];
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+        range_result_t res = parse_range(range, size, &first, &last);
+        if (res == RANGE_UNSATISFIABLE) {
+            snprintf(content_range, sizeof(content_range), "bytes */%lu", (unsigned long)size);
+            httpd_resp_set_hdr(req, "Content-Range", content_range);
+            httpd_resp_set_status(req, "416 Range Not Satisfiable");
+            return httpd_resp_send(req, NULL, 0);
+        }
+        if (res == RANGE_OK) {
+            snprintf(content_range, sizeof(content_range), "bytes %lu-%lu/%lu", (unsigned long)first,
+                     (unsigned long)last, (unsigned long)size);
+            httpd_resp_set_hdr(req, "Content-Range", content_range);
+            httpd_resp_set_status(req, "206 Partial Content");
+        }
+    }
+    if (!size) return httpd_resp_send(req, NULL, 0);
+
+    FILE *f = fopen(path, "rb");
+    char *buf = malloc(REC_SEND_CHUNK);
+    if (!f || !buf || fseek(f, first, SEEK_SET) != 0) {
+        if (f) fclose(f);
+        free(buf);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    esp_err_t err = ESP_OK;
+    uint32_t left = last - first + 1;
+    while (err == ESP_OK && left) {
+        size_t got = fread(buf, 1, left < REC_SEND_CHUNK ? left : REC_SEND_CHUNK, f);
+        if (!got) break;
+        err = httpd_resp_send_chunk(req, buf, got);
+        left -= got;
+    }
+    free(buf);
+    fclose(f);
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+
+esp_err_t recorder_http_handler(httpd_req_t *req) {
+    char name[REC_NAME_MAX + 1];
+    const char *p = req->uri + strlen("/rec");
+    if (*p == '/') p++;
+    size_t len = strcspn(p, "?#");
+    if (len == 0 && req->method == HTTP_GET) return send_list(req);
+    if (len > REC_NAME_MAX) return httpd_resp_send_404(req);
+    memcpy(name, p, len);
+    name[len] = '\0';
+    if (!is_rec_name(name)) return httpd_resp_send_404(req);
+
+    char path[sizeof(STATIC_ASSETS_BASE) + REC_NAME_MAX + 1];
+    snprintf(path, sizeof(path), STATIC_ASSETS_BASE "/%s", name);
+    if (req->method == HTTP_DELETE) {
+        if (atomic_load(&s_state) != REC_IDLE && strcmp(name, s_name) == 0) {
+            httpd_resp_set_status(req, "409 Conflict");
+            return httpd_resp_sendstr(req, "Recording in progress");
+        }
+        if (unlink(path) != 0) return httpd_resp_send_404(req);
+        httpd_resp_set_status(req, "204 No Content");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    return send_file(req, path);
+}
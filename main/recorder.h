@@ -0,0 +1,31 @@
+// Capture-to-flash recorder — ADC blocks, GPIO edges and UART RX written to
+// SPIFFS in rec_core's format by a double-buffered writer task, listed,
+// downloaded (with Range) and deleted over HTTP under /rec
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include "rec_core.h"
+
+// Called from the writer task whenever a recording starts or ends
+typedef void (*recorder_sink_t)(const char *json, size_t len);
+
+esp_err_t recorder_start(const int *gpio_nums, recorder_sink_t sink);
+
+// New file rec_NNNN.bin; max_kb 0 records until the partition is nearly full.
+// ESP_ERR_INVALID_STATE while a recording is running.
+esp_err_t recorder_begin(uint8_t sources, uint32_t max_kb, const char *desc);
+void recorder_end(void);
+
+// Producers; never block on flash. Dropped records are counted in the file.
+void recorder_put_frame(const uint8_t *frame, size_t len);    // WIRE_* typed frames
+void recorder_put_edges(const edge_event_t *ev, size_t n);
+
+// {"rec":{"state":..,"name":..,"bytes":..,"chunks":..,"records":..,"dropped":..}}
+size_t recorder_status_json(char *out, size_t out_len);
+
+// GET /rec lists recordings, GET /rec/<name> downloads (Range), DELETE /rec/<name>
+esp_err_t recorder_http_handler(httpd_req_t *req);
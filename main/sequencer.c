@@ -0,0 +1,222 @@
+// Sequencer — a 10 MHz gptimer raises one alarm per step and the ISR drives
+// every channel at once through GPIO_OUT_W1TS/W1TC. Due times are absolute
+// timer counts, so a late interrupt delays one step without shifting the
+// rest. Steps that fall due within SEQ_SPIN_TICKS of the previous one are
+// played from the same interrupt by spinning on the counter.
+#include "sequencer.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <driver/gptimer.h>
+#include <soc/gpio_reg.h>
+#include <soc/soc.h>
+
+#define TAG "Sequencer"
+
+#define SEQ_TIMER_HZ        10000000
+#define SEQ_TICKS_PER_US    (SEQ_TIMER_HZ / 1000000)
+#define SEQ_LEAD_TICKS      (100 * SEQ_TICKS_PER_US)   // first step, leaves time to start the timer
+#define SEQ_SPIN_TICKS      (4 * SEQ_TICKS_PER_US)     // closer steps are spun for, not alarmed
+#define SEQ_LATE_TICKS      (2 * SEQ_TICKS_PER_US)     // counted as late in the report
+#define SEQ_BURST_STEPS     32                         // steps per interrupt at most
+#define SEQ_POLL_MS         20
+
+typedef struct {
+    uint32_t targets;
+    uint32_t id;
+    uint32_t loops;
+} seq_job_t;
+
+static sequencer_sink_t s_sink;
+static QueueHandle_t s_jobs;
+static SemaphoreHandle_t s_finished;
+static gptimer_handle_t s_timer;
+static _Atomic bool s_busy;
+static _Atomic bool s_stop;
+static _Atomic uint32_t s_next_id = 1;
+
+static sequencer_config_t s_cfg;
+static uint32_t s_lo[SEQ_MAX_CHANNELS];     // GPIO0-31 mask per channel
+static uint32_t s_hi[SEQ_MAX_CHANNELS];     // GPIO32-39
+static uint32_t s_all_lo, s_all_hi;
+
+// Shared with the alarm ISR while the timer runs
+static seq_player_t s_player;
+static seq_stats_t s_stats;
+static uint8_t s_word;
+static uint64_t s_end;
+
+static inline void IRAM_ATTR drive(uint8_t word) {
+    uint32_t lo = 0, hi = 0;
+    for (size_t ch = 0; ch < s_cfg.channels; ch++) {
+        if (word & (1u << ch)) {
+            lo |= s_lo[ch];
+            hi |= s_hi[ch];
+        }
+    }
+    REG_WRITE(GPIO_OUT_W1TS_REG, lo);
+    REG_WRITE(GPIO_OUT_W1TC_REG, s_all_lo & ~lo);
+    REG_WRITE(GPIO_OUT1_W1TS_REG, hi);
+    REG_WRITE(GPIO_OUT1_W1TC_REG, s_all_hi & ~hi);
+    s_word = word;
+}
+
+static bool IRAM_ATTR on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *ctx) {
+    uint64_t now = edata->count_value;
+    for (int n = 0; ; n++) {
+        while (now < s_player.due) gptimer_get_raw_count(timer, &now);
+        if (s_player.done || atomic_load(&s_stop)) {
+            BaseType_t woken = pdFALSE;
+            s_end = now;
+            gptimer_stop(timer);
+            xSemaphoreGiveFromISR(s_finished, &woken);
+            return woken == pdTRUE;
+        }
+
+        drive(s_player.steps[s_player.index].word);
+        gptimer_get_raw_count(timer, &now);
+        seq_stats_record(&s_stats, (int32_t)(now - s_player.due));
+        seq_player_advance(&s_player);
+
+        if (s_player.due > now + SEQ_SPIN_TICKS || n == SEQ_BURST_STEPS) break;
+    }
+    // Behind schedule after a full burst: catch up from the next interrupt
+    uint64_t alarm = s_player.due > now + SEQ_SPIN_TICKS ? s_player.due : now + SEQ_SPIN_TICKS;
+    gptimer_set_alarm_action(timer, &(gptimer_alarm_config_t){ .alarm_count = alarm });
+    return false;
+}
+
+static void report(const seq_job_t *job, const char *state, uint64_t requested, uint64_t actual, int levels) {
+    char json[320];
+    seq_report_t r = {
+        .id = job->id,
+        .state = state,
+        .loops = s_player.loop,
+        .requested_us = requested / SEQ_TICKS_PER_US,
+        .actual_us = actual / SEQ_TICKS_PER_US,
+        .tick_hz = SEQ_TIMER_HZ,
+        .stats = &s_stats,
+    };
+    size_t len = seq_report_to_json(&r, json, sizeof(json));
+    if (len && s_sink) s_sink(job->targets, json, len, levels);
+}
+
+static void play(const seq_job_t *job) {
+    seq_player_init(&s_player, s_cfg.steps, s_cfg.count, job->loops, SEQ_TICKS_PER_US, SEQ_LEAD_TICKS);
+    seq_stats_init(&s_stats, SEQ_LATE_TICKS);
+    xSemaphoreTake(s_finished, 0);
+
+    gptimer_set_raw_count(s_timer, 0);
+    gptimer_set_alarm_action(s_timer, &(gptimer_alarm_config_t){ .alarm_count = SEQ_LEAD_TICKS });
+    esp_err_t err = gptimer_enable(s_timer);
+    if (err == ESP_OK) err = gptimer_start(s_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Timer start failed: %s", esp_err_to_name(err));
+        gptimer_disable(s_timer);
+        report(job, "stopped", 0, 0, -1);
+        return;
+    }
+    report(job, "running", 0, 0, -1);
+
+    bool finished = false;
+    while (!(finished = xSemaphoreTake(s_finished, pdMS_TO_TICKS(SEQ_POLL_MS)) == pdTRUE)) {
+        if (atomic_load(&s_stop)) break;
+    }
+    if (!finished) {
+        // A long hold would keep the ISR from seeing s_stop until its alarm
+        gptimer_stop(s_timer);
+        finished = xSemaphoreTake(s_finished, 0) == pdTRUE;
+        if (!finished) gptimer_get_raw_count(s_timer, &s_end);
+    }
+    gptimer_disable(s_timer);
+
+    // The schedule up to the last applied step's hold, against the clock
+    if (s_end < SEQ_LEAD_TICKS) s_end = SEQ_LEAD_TICKS;
+    uint64_t requested = s_player.due > s_end && !s_player.done ? s_end : s_player.due;
+    report(job, s_player.done ? "done" : "stopped", requested - SEQ_LEAD_TICKS, s_end - SEQ_LEAD_TICKS,
+           s_stats.steps ? s_word : -1);
+    ESP_LOGI(TAG, "Sequence %lu %s after %lu steps, worst error %ld ticks", (unsigned long)job->id,
+             s_player.done ? "done" : "stopped", (unsigned long)s_stats.steps, (long)s_stats.max);
+}
+
+static void sequencer_task(void *arg) {
+    // The alarm interrupt is allocated on this core, away from WiFi
+    gptimer_config_t tcfg = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = SEQ_TIMER_HZ,
+        .intr_priority = 3,
+    };
+    gptimer_event_callbacks_t cbs = { .on_alarm = on_alarm };
+    esp_err_t err = gptimer_new_timer(&tcfg, &s_timer);
+    if (err == ESP_OK) err = gptimer_register_event_callbacks(s_timer, &cbs, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "gptimer: %s", esp_err_to_name(err));
+        vTaskDelete(NULL);
+    }
+
+    seq_job_t job;
+    while (1) {
+        if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+        atomic_store(&s_stop, false);
+        play(&job);
+        atomic_store(&s_busy, false);
+    }
+}
+
+esp_err_t sequencer_start(sequencer_sink_t sink) {
+    s_sink = sink;
+    s_jobs = xQueueCreate(1, sizeof(seq_job_t));
+    s_finished = xSemaphoreCreateBinary();
+    if (!s_jobs || !s_finished) return ESP_ERR_NO_MEM;
+    if (xTaskCreatePinnedToCore(sequencer_task, "sequencer", 3072, NULL, 6, NULL, 1) != pdPASS) return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t sequencer_load(const sequencer_config_t *cfg) {
+    if (!cfg->channels || cfg->channels > SEQ_MAX_CHANNELS || !cfg->count || cfg->count > SEQ_MAX_STEPS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_busy, &idle, true)) return ESP_ERR_INVALID_STATE;
+
+    memcpy(&s_cfg, cfg, sizeof(s_cfg));
+    s_all_lo = s_all_hi = 0;
+    for (size_t ch = 0; ch < cfg->channels; ch++) {
+        int gpio = cfg->gpios[ch];
+        s_lo[ch] = gpio < 32 ? 1u << gpio : 0;
+        s_hi[ch] = gpio < 32 ? 0 : 1u << (gpio - 32);
+        s_all_lo |= s_lo[ch];
+        s_all_hi |= s_hi[ch];
+    }
+    atomic_store(&s_busy, false);
+    return ESP_OK;
+}
+
+esp_err_t sequencer_play(uint32_t targets, uint32_t loops) {
+    if (!s_cfg.count) return ESP_ERR_INVALID_ARG;
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_busy, &idle, true)) return ESP_ERR_INVALID_STATE;
+
+    seq_job_t job = { .targets = targets, .id = atomic_fetch_add(&s_next_id, 1), .loops = loops };
+    if (xQueueSend(s_jobs, &job, 0) != pdTRUE) {
+        atomic_store(&s_busy, false);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+void sequencer_stop(void) {
+    atomic_store(&s_stop, true);
+}
+
+size_t sequencer_pins(int *gpios) {
+    memcpy(gpios, s_cfg.gpios, sizeof(s_cfg.gpios));
+    return s_cfg.channels;
+}
@@ -0,0 +1,35 @@
+// Sequencer — plays timed output vectors on up to 8 pins from a gptimer
+// alarm, with per-step timing error against the requested schedule
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "seq_core.h"
+
+// Report JSON to the slot mask that started playback. levels is the word
+// left on the pins once playback has ended, -1 for the "running" report.
+typedef void (*sequencer_sink_t)(uint32_t targets, const char *json, size_t len, int levels);
+
+typedef struct {
+    int gpios[SEQ_MAX_CHANNELS];        // channel n = bit n of a step word
+    uint8_t channels;
+    size_t count;
+    seq_step_t steps[SEQ_MAX_STEPS];
+} sequencer_config_t;
+
+esp_err_t sequencer_start(sequencer_sink_t sink);
+
+// Replace the loaded sequence; ESP_ERR_INVALID_STATE while one is playing
+esp_err_t sequencer_load(const sequencer_config_t *cfg);
+
+// Play the loaded sequence loops times (0 = until stopped). The pins must
+// already be outputs; they are driven through the GPIO set/clear registers.
+esp_err_t sequencer_play(uint32_t targets, uint32_t loops);
+
+// End playback early; the pins keep their current levels
+void sequencer_stop(void);
+
+// GPIOs of the loaded sequence, so callers can track their levels
+size_t sequencer_pins(int *gpios);
@@ -0,0 +1,207 @@
+// Static assets — files are served whole from RAM after the first request
+// (or in large blocks when too big to cache), with the build-time .gz
+// variant when the browser accepts gzip.
+#include "static_assets.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+
+#define TAG "Assets"
+
+#define ASSET_PATH_MAX      64
+#define ASSET_CACHE_SLOTS   8
+#define ASSET_CACHE_FILE    (16 * 1024)   // larger files are streamed
+#define ASSET_CACHE_TOTAL   (48 * 1024)
+#define ASSET_CHUNK         4096
+
+typedef struct {
+    char path[ASSET_PATH_MAX + 4];  // file actually opened, ".gz" included
+    char etag[12];
+    bool gzip;
+    size_t size;
+    uint8_t* data;                  // NULL when streamed
+} asset_entry_t;
+
+// Only touched from the httpd task
+static asset_entry_t s_cache[ASSET_CACHE_SLOTS];
+static size_t s_cache_bytes;
+
+static const struct {
+    const char* ext;
+    const char* type;
+} mime_types[] = {
+    { ".html", "text/html" },
+    { ".htm",  "text/html" },
+    { ".css",  "text/css" },
+    { ".js",   "application/javascript" },
+    { ".json", "application/json" },
+    { ".svg",  "image/svg+xml" },
+    { ".png",  "image/png" },
+    { ".jpg",  "image/jpeg" },
+    { ".ico",  "image/x-icon" },
+    { ".txt",  "text/plain" },
+    { ".csv",  "text/csv" },
+};
+
+static const char* mime_type(const char* path) {
+    const char* ext = strrchr(path, '.');
+    if (ext) {
+        for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+            if (strcasecmp(ext, mime_types[i].ext) == 0) return mime_types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+// Copy the URI path (query dropped) into out; rejects anything that could
+// escape the SPIFFS root or that SPIFFS can't name.
+static bool sanitize_path(const char* uri, char* out, size_t out_len) {
+    size_t len = strcspn(uri, "?#");
+    if (len == 1 && uri[0] == '/') {
+        uri = "/index.html";
+        len = strlen(uri);
+    }
+    if (len == 0 || len >= out_len || uri[0] != '/') return false;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = uri[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '/' || c == '.' || c == '-' || c == '_';
+        if (!ok) return false;
+        if (c == '.' && i > 0 && uri[i - 1] == '.') return false;
+    }
+    memcpy(out, uri, len);
+    out[len] = '\0';
+    return true;
+}
+
+static bool accepts_gzip(httpd_req_t* req) {
+    char buf[64];
+    if (httpd_req_get_hdr_value_str(req, "Accept-Encoding", buf, sizeof(buf)) != ESP_OK) return false;
+    return strstr(buf, "gzip") != NULL;
+}
+
+static uint32_t fnv1a(uint32_t h, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static asset_entry_t* cache_lookup(const char* path) {
+    for (int i = 0; i < ASSET_CACHE_SLOTS; i++) {
+        if (s_cache[i].path[0] && strcmp(s_cache[i].path, path) == 0) return &s_cache[i];
+    }
+    return NULL;
+}
+
+// Open the file once to learn its size and ETag, keeping the bytes if they fit
+static asset_entry_t* cache_load(const char* path, bool gzip) {
+    char fs_path[sizeof(STATIC_ASSETS_BASE) + ASSET_PATH_MAX + 4];
+    snprintf(fs_path, sizeof(fs_path), STATIC_ASSETS_BASE "%s", path);
+
+    struct stat st;
+    if (stat(fs_path, &st) != 0) return NULL;
+    FILE* f = fopen(fs_path, "rb");
+    if (!f) return NULL;
+
+    asset_entry_t* e = NULL;
+    for (int i = 0; i < ASSET_CACHE_SLOTS && !e; i++) {
+        if (!s_cache[i].path[0]) e = &s_cache[i];
+    }
+    if (!e) {
+        // Full: recycle slot 0; cached pages are few and this is rare
+        e = &s_cache[0];
+        s_cache_bytes -= e->data ? e->size : 0;
+        free(e->data);
+    }
+    memset(e, 0, sizeof(*e));
+
+    size_t size = st.st_size;
+    uint8_t* data = NULL;
+    if (size <= ASSET_CACHE_FILE && s_cache_bytes + size <= ASSET_CACHE_TOTAL) data = malloc(size ? size : 1);
+
+    uint32_t h = 2166136261u;
+    if (data) {
+        size_t got = fread(data, 1, size, f);
+        h = fnv1a(h, data, got);
+        size = got;
+        s_cache_bytes += size;
+    } else {
+        uint8_t buf[256];
+        size_t got;
+        while ((got = fread(buf, 1, sizeof(buf), f)) > 0) h = fnv1a(h, buf, got);
+    }
+    fclose(f);
+
+    strlcpy(e->path, path, sizeof(e->path));
+    snprintf(e->etag, sizeof(e->etag), "\"%08lx\"", (unsigned long)(h ^ size));
+    e->gzip = gzip;
+    e->size = size;
+    e->data = data;
+    return e;
+}
+
+static asset_entry_t* find_asset(const char* path, bool gzip) {
+    char variant[ASSET_PATH_MAX + 4];
+    if (gzip) {
+        snprintf(variant, sizeof(variant), "%s.gz", path);
+        asset_entry_t* e = cache_lookup(variant);
+        if (e || (e = cache_load(variant, true))) return e;
+    }
+    asset_entry_t* e = cache_lookup(path);
+    return e ? e : cache_load(path, false);
+}
+
+static esp_err_t stream_file(httpd_req_t* req, const asset_entry_t* e) {
+    char fs_path[sizeof(STATIC_ASSETS_BASE) + ASSET_PATH_MAX + 4];
+    snprintf(fs_path, sizeof(fs_path), STATIC_ASSETS_BASE "%s", e->path);
+    FILE* f = fopen(fs_path, "rb");
+    if (!f) return httpd_resp_send_404(req);
+
+    char* buf = malloc(ASSET_CHUNK);
+    if (!buf) {
+        fclose(f);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    esp_err_t err = ESP_OK;
+    size_t got;
+    while (err == ESP_OK && (got = fread(buf, 1, ASSET_CHUNK, f)) > 0) {
+        err = httpd_resp_send_chunk(req, buf, got);
+    }
+    free(buf);
+    fclose(f);
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+
+esp_err_t static_assets_handler(httpd_req_t* req) {
+    char path[ASSET_PATH_MAX];
+    if (!sanitize_path(req->uri, path, sizeof(path))) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad path");
+    }
+
+    asset_entry_t* e = find_asset(path, accepts_gzip(req));
+    if (!e) return httpd_resp_send_404(req);
+
+    httpd_resp_set_hdr(req, "ETag", e->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");   // always revalidate, 304 is cheap
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    char inm[sizeof(e->etag) + 4];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strcmp(inm, e->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, mime_type(path));
+    if (e->gzip) httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+
+    if (e->data) return httpd_resp_send(req, (const char*)e->data, e->size);
+    return stream_file(req, e);
+}
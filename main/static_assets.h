@@ -0,0 +1,9 @@
+// Static web assets from SPIFFS — gzip variants, ETag revalidation and a RAM cache
+#pragma once
+
+#include <esp_http_server.h>
+
+#define STATIC_ASSETS_BASE "/spiffs"
+
+// GET handler for "/" and "/*" (needs httpd_uri_match_wildcard)
+esp_err_t static_assets_handler(httpd_req_t *req);
@@ -0,0 +1,191 @@
+// UART bridge — the driver's event queue wakes the bridge task, which reads
+// whatever is buffered straight into the frame under construction and ships
+// it when the batch is full or the line goes idle.
+#include "uart_bridge.h"
+
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <driver/uart.h>
+
+#define TAG "UartBridge"
+
+#define UART_RX_BUF         8192    // ~90 ms at 921600 baud
+#define UART_TX_BUF         2048
+#define UART_EVENT_QUEUE    32
+#define UART_BATCH_BYTES    512     // ship once this much is collected
+#define UART_IDLE_MS        20      // ... or the line has been quiet this long
+#define UART_RX_TOUT        10      // hardware idle timeout, in symbol times
+
+static uart_port_t s_port;
+static QueueHandle_t s_events;
+static SemaphoreHandle_t s_lock;
+static uart_rx_sink_t s_sink;
+static uart_line_t s_line;          // guarded by s_lock
+
+// Owned by the bridge task
+static uart_framer_t s_framer;
+
+static volatile uint32_t s_rx_bytes;
+static volatile uint32_t s_tx_bytes;
+static volatile uint32_t s_tx_dropped;
+static volatile uint32_t s_frames;
+static volatile uint32_t s_overflows;
+static volatile uint32_t s_frame_errors;
+static volatile uint32_t s_parity_errors;
+static volatile uint32_t s_breaks;
+
+static esp_err_t apply_line(const uart_line_t *line) {
+    static const uart_word_length_t bits[] = { UART_DATA_5_BITS, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS };
+    uart_parity_t parity = line->parity == 'E' ? UART_PARITY_EVEN :
+                           line->parity == 'O' ? UART_PARITY_ODD : UART_PARITY_DISABLE;
+
+    esp_err_t err = uart_set_baudrate(s_port, line->baud);
+    if (err == ESP_OK) err = uart_set_word_length(s_port, bits[line->data_bits - 5]);
+    if (err == ESP_OK) err = uart_set_parity(s_port, parity);
+    if (err == ESP_OK) err = uart_set_stop_bits(s_port, line->stop_bits == 2 ? UART_STOP_BITS_2 : UART_STOP_BITS_1);
+    return err;
+}
+
+static void flush_batch(void) {
+    if (!uart_framer_pending(&s_framer)) return;
+    size_t len = uart_framer_finish(&s_framer, (uint32_t)(esp_timer_get_time() / 1000));
+    s_frames++;
+    if (s_sink) s_sink(s_framer.frame, len);
+}
+
+// Pull everything the driver has buffered, shipping each full batch
+static void drain_rx(void) {
+    size_t avail = 0;
+    uart_get_buffered_data_len(s_port, &avail);
+    while (avail > 0) {
+        size_t space;
+        uint8_t* dst = uart_framer_tail(&s_framer, &space);
+        size_t want = avail < space ? avail : space;
+        int got = uart_read_bytes(s_port, dst, want, 0);
+        if (got <= 0) break;
+        uart_framer_commit(&s_framer, got);
+        s_rx_bytes += got;
+        avail -= got;
+        if (s_framer.len >= UART_BATCH_BYTES) flush_batch();
+    }
+}
+
+static void uart_bridge_task(void* arg) {
+    uart_event_t event;
+    while (1) {
+        if (xQueueReceive(s_events, &event, pdMS_TO_TICKS(UART_IDLE_MS)) != pdTRUE) {
+            flush_batch();  // idle: ship the partial batch
+            continue;
+        }
+
+        switch (event.type) {
+        case UART_DATA:
+            drain_rx();
+            if (event.timeout_flag) flush_batch();
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // Bytes are already lost; keep what is buffered but flag the gap
+            s_overflows++;
+            drain_rx();
+            uart_framer_flag(&s_framer, UART_FLAG_OVERFLOW);
+            flush_batch();
+            if (event.type == UART_FIFO_OVF) xQueueReset(s_events);
+            break;
+        case UART_FRAME_ERR:
+            s_frame_errors++;
+            uart_framer_flag(&s_framer, UART_FLAG_FRAME_ERR);
+            break;
+        case UART_PARITY_ERR:
+            s_parity_errors++;
+            uart_framer_flag(&s_framer, UART_FLAG_PARITY);
+            break;
+        case UART_BREAK:
+            s_breaks++;
+            uart_framer_flag(&s_framer, UART_FLAG_BREAK);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+esp_err_t uart_bridge_start(int port, int tx_pin, int rx_pin, const uart_line_t *line, uart_rx_sink_t sink) {
+    s_port = port;
+    s_sink = sink;
+    s_line = *line;
+    uart_framer_init(&s_framer, port);
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    uart_config_t cfg = {
+        .baud_rate = line->baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    esp_err_t err = uart_driver_install(s_port, UART_RX_BUF, UART_TX_BUF, UART_EVENT_QUEUE, &s_events, 0);
+    if (err != ESP_OK) return err;
+    ESP_ERROR_CHECK(uart_param_config(s_port, &cfg));
+    ESP_ERROR_CHECK(uart_set_pin(s_port, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(apply_line(line));
+    uart_set_rx_timeout(s_port, UART_RX_TOUT);
+
+    if (xTaskCreate(uart_bridge_task, "uart_bridge", 3072, NULL, 6, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_bridge_configure(const uart_line_t *line) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = apply_line(line);
+    if (err == ESP_OK) s_line = *line;
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "Line set to %lu baud %u%c%u (%s)", (unsigned long)line->baud,
+             line->data_bits, line->parity, line->stop_bits, esp_err_to_name(err));
+    return err;
+}
+
+void uart_bridge_line(uart_line_t *line) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *line = s_line;
+    xSemaphoreGive(s_lock);
+}
+
+size_t uart_bridge_write(const void *data, size_t len) {
+    // The driver copies into its TX ring; only queue what fits so callers never block
+    size_t space = 0;
+    uart_get_tx_buffer_free_size(s_port, &space);
+    size_t n = len < space ? len : space;
+    if (n) {
+        int written = uart_write_bytes(s_port, data, n);
+        n = written > 0 ? written : 0;
+    }
+    s_tx_bytes += n;
+    s_tx_dropped += len - n;
+    return n;
+}
+
+size_t uart_bridge_stats_json(char *out, size_t out_len) {
+    uart_line_t line;
+    char line_str[24];
+    uart_bridge_line(&line);
+    uart_line_format(&line, line_str, sizeof(line_str));
+
+    int n = snprintf(out, out_len,
+        "{\"uart\":{\"line\":\"%s\",\"rx_bytes\":%lu,\"tx_bytes\":%lu,\"tx_dropped\":%lu,"
+        "\"frames\":%lu,\"overflows\":%lu,\"frame_errors\":%lu,\"parity_errors\":%lu,\"breaks\":%lu}}",
+        line_str, (unsigned long)s_rx_bytes, (unsigned long)s_tx_bytes, (unsigned long)s_tx_dropped,
+        (unsigned long)s_frames, (unsigned long)s_overflows, (unsigned long)s_frame_errors,
+        (unsigned long)s_parity_errors, (unsigned long)s_breaks);
+    return (n < 0 || (size_t)n >= out_len) ? 0 : n;
+}
@@ -0,0 +1,22 @@
+// UART bridge — event-driven RX streamed as binary frames, buffered TX
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "uart_core.h"
+
+// Called from the bridge task with one framed RX batch; the buffer is reused after return
+typedef void (*uart_rx_sink_t)(const uint8_t *frame, size_t len);
+
+esp_err_t uart_bridge_start(int port, int tx_pin, int rx_pin, const uart_line_t *line, uart_rx_sink_t sink);
+
+// Change baud rate / framing without reinstalling the driver
+esp_err_t uart_bridge_configure(const uart_line_t *line);
+void uart_bridge_line(uart_line_t *line);
+
+// Queue bytes for transmission; never blocks, returns the number accepted
+size_t uart_bridge_write(const void *data, size_t len);
+
+size_t uart_bridge_stats_json(char *out, size_t out_len);
@@ -0,0 +1,316 @@
+// Wi-Fi link — nothing here blocks: esp_wifi_start() returns with the AP
+// coming up, and the station is driven entirely from driver events. A lost
+// or failed connection retries after a jittered, doubling delay. The last
+// AP's BSSID and channel are kept in NVS, so after a power cycle the
+// station skips the all-channel scan and associates directly.
+#include "wifi_link.h"
+#include "sdkconfig.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <esp_netif.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <nvs.h>
+
+#define TAG "WifiLink"
+
+#define NVS_NAMESPACE       "wifi"
+#define BACKOFF_MIN_MS      250
+#define BACKOFF_MAX_MS      30000
+#define DIRECT_TRIES        2       // failed attempts on the remembered AP before a full scan
+
+typedef enum {
+    STA_IDLE,           // no credentials
+    STA_CONNECTING,
+    STA_CONNECTED,      // associated, waiting for DHCP
+    STA_GOT_IP,
+    STA_WAITING,        // backing off before the next attempt
+} sta_state_t;
+
+static const char* const state_names[] = { "idle", "connecting", "connected", "got_ip", "waiting" };
+
+static SemaphoreHandle_t s_lock;    // everything below
+static wifi_link_ap_t s_ap;
+static wifi_link_cb_t s_on_change;
+static esp_timer_handle_t s_retry_timer;
+
+static char s_ssid[33];
+static char s_password[65];
+static uint8_t s_bssid[6];          // remembered AP, valid if s_direct
+static uint8_t s_channel;
+static bool s_direct;
+
+static sta_state_t s_state;
+static uint32_t s_attempt;          // failures since the last IP
+static uint32_t s_direct_fails;
+static uint32_t s_retry_ms;
+static uint32_t s_reconnects;       // connections lost after getting an IP
+static uint8_t s_last_reason;
+static esp_ip4_addr_t s_ip;
+
+// --- NVS ---
+
+static void load_config(void) {
+    nvs_handle_t nvs;
+    strlcpy(s_ssid, CONFIG_ESP_WIFI_SSID, sizeof(s_ssid));
+    strlcpy(s_password, CONFIG_ESP_WIFI_PASSWORD, sizeof(s_password));
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return;   // first boot
+
+    size_t len = sizeof(s_ssid);
+    if (nvs_get_str(nvs, "ssid", s_ssid, &len) == ESP_OK) {
+        len = sizeof(s_password);
+        if (nvs_get_str(nvs, "pass", s_password, &len) != ESP_OK) s_password[0] = '\0';
+    }
+    len = sizeof(s_bssid);
+    s_direct = nvs_get_blob(nvs, "bssid", s_bssid, &len) == ESP_OK && len == sizeof(s_bssid) &&
+               nvs_get_u8(nvs, "chan", &s_channel) == ESP_OK;
+    nvs_close(nvs);
+}
+
+// Only written when something changed, to spare the flash
+static void save_ap(const uint8_t* bssid, uint8_t channel) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+    nvs_set_blob(nvs, "bssid", bssid, 6);
+    nvs_set_u8(nvs, "chan", channel);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static esp_err_t save_credentials(const char* ssid, const char* password) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) return err;
+    err = nvs_set_str(nvs, "ssid", ssid);
+    if (err == ESP_OK) err = nvs_set_str(nvs, "pass", password);
+    nvs_erase_key(nvs, "bssid");
+    nvs_erase_key(nvs, "chan");
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    nvs_close(nvs);
+    return err;
+}
+
+// --- station ---
+
+// Caller holds s_lock
+static void apply_sta_config(void) {
+    wifi_config_t cfg = { 0 };
+    strlcpy((char*)cfg.sta.ssid, s_ssid, sizeof(cfg.sta.ssid));
+    strlcpy((char*)cfg.sta.password, s_password, sizeof(cfg.sta.password));
+    cfg.sta.scan_method = WIFI_FAST_SCAN;
+    if (s_direct) {
+        // One channel, one BSSID: no scan of the whole band
+        cfg.sta.bssid_set = true;
+        memcpy(cfg.sta.bssid, s_bssid, sizeof(s_bssid));
+        cfg.sta.channel = s_channel;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &cfg);
+}
+
+// Caller holds s_lock
+static void connect_locked(void) {
+    if (!s_ssid[0]) {
+        s_state = STA_IDLE;
+        return;
+    }
+    s_state = STA_CONNECTING;
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) ESP_LOGW(TAG, "esp_wifi_connect: %s", esp_err_to_name(err));
+}
+
+// 250 ms doubling to 30 s, +-25 % so boards powered up together don't retry in step
+static uint32_t backoff_ms(uint32_t attempt) {
+    uint32_t ms = attempt >= 7 ? BACKOFF_MAX_MS : BACKOFF_MIN_MS << attempt;
+    if (ms > BACKOFF_MAX_MS) ms = BACKOFF_MAX_MS;
+    return ms - ms / 4 + esp_random() % (ms / 2 + 1);
+}
+
+static void retry_cb(void* arg) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_state == STA_WAITING) connect_locked();
+    xSemaphoreGive(s_lock);
+}
+
+// Caller holds s_lock
+static void on_disconnected(const wifi_event_sta_disconnected_t* ev) {
+    if (s_state == STA_GOT_IP) s_reconnects++;
+    s_last_reason = ev->reason;
+    s_ip.addr = 0;
+    if (!s_ssid[0]) {
+        s_state = STA_IDLE;
+        return;
+    }
+    // The remembered AP may be gone or have moved channel: back to scanning
+    if (s_direct && (ev->reason == WIFI_REASON_NO_AP_FOUND || ++s_direct_fails >= DIRECT_TRIES)) {
+        s_direct = false;
+        apply_sta_config();
+    }
+    s_retry_ms = backoff_ms(s_attempt++);
+    s_state = STA_WAITING;
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)s_retry_ms * 1000);
+    ESP_LOGI(TAG, "Station disconnected (reason %u), retry in %lu ms", ev->reason, (unsigned long)s_retry_ms);
+}
+
+// Caller holds s_lock
+static void on_connected(const wifi_event_sta_connected_t* ev) {
+    s_state = STA_CONNECTED;
+    s_direct_fails = 0;
+    if (!s_direct || s_channel != ev->channel || memcmp(s_bssid, ev->bssid, sizeof(s_bssid)) != 0) {
+        memcpy(s_bssid, ev->bssid, sizeof(s_bssid));
+        s_channel = ev->channel;
+        s_direct = true;
+        save_ap(s_bssid, s_channel);
+    }
+}
+
+static void event_handler(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    bool changed = true;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (base == WIFI_EVENT) {
+        switch (id) {
+        case WIFI_EVENT_AP_START:
+            metrics_boot_mark(BOOT_AP_START);
+            break;
+        case WIFI_EVENT_STA_START:
+            connect_locked();
+            break;
+        case WIFI_EVENT_STA_CONNECTED:
+            metrics_boot_mark(BOOT_STA_CONNECTED);
+            on_connected(data);
+            break;
+        case WIFI_EVENT_STA_DISCONNECTED:
+            on_disconnected(data);
+            break;
+        case WIFI_EVENT_AP_STACONNECTED:
+        case WIFI_EVENT_AP_STADISCONNECTED:
+            break;
+        default:
+            changed = false;
+        }
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        const ip_event_got_ip_t* ev = data;
+        metrics_boot_mark(BOOT_STA_GOT_IP);
+        s_state = STA_GOT_IP;
+        s_ip = ev->ip_info.ip;
+        s_attempt = 0;
+        ESP_LOGI(TAG, "Station got " IPSTR, IP2STR(&s_ip));
+    } else {
+        changed = false;
+    }
+    xSemaphoreGive(s_lock);
+    if (changed && s_on_change) s_on_change();
+}
+
+esp_err_t wifi_link_start(const wifi_link_ap_t* ap, wifi_link_cb_t on_change) {
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    s_ap = *ap;
+    s_on_change = on_change;
+    load_config();
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_create_default_wifi_ap();
+    esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // This module keeps the configuration; the driver's own NVS copy only costs boot time
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, event_handler, NULL, NULL));
+
+    const esp_timer_create_args_t timer_args = { .callback = retry_cb, .name = "wifi_retry" };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_retry_timer));
+
+    wifi_config_t ap_config = {
+        .ap = {
+            .ssid_len = strlen(ap->ssid),
+            .channel = ap->channel,
+            .max_connection = ap->max_connections,
+            .authmode = WIFI_AUTH_WPA2_PSK,
+            .ssid_hidden = ap->hidden
+        }
+    };
+    strlcpy((char*)ap_config.ap.ssid, ap->ssid, sizeof(ap_config.ap.ssid));
+    strlcpy((char*)ap_config.ap.password, ap->password, sizeof(ap_config.ap.password));
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    apply_sta_config();
+    xSemaphoreGive(s_lock);
+
+    // The station connects from WIFI_EVENT_STA_START
+    ESP_ERROR_CHECK(esp_wifi_start());
+    metrics_boot_mark(BOOT_WIFI_START);
+    ESP_LOGI(TAG, "Wi-Fi started, station %s%s", s_ssid[0] ? s_ssid : "(not configured)",
+             s_direct ? " via remembered AP" : "");
+    return ESP_OK;
+}
+
+esp_err_t wifi_link_set_sta(const char* ssid, const char* password) {
+    esp_err_t err = save_credentials(ssid, password);
+    if (err != ESP_OK) return err;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    strlcpy(s_ssid, ssid, sizeof(s_ssid));
+    strlcpy(s_password, password, sizeof(s_password));
+    s_direct = false;
+    s_attempt = 0;
+    esp_timer_stop(s_retry_timer);
+    bool linked = s_state == STA_CONNECTING || s_state == STA_CONNECTED || s_state == STA_GOT_IP;
+    apply_sta_config();
+    // A live link is dropped first; its disconnect event starts the new attempt
+    if (linked) esp_wifi_disconnect();
+    else connect_locked();
+    xSemaphoreGive(s_lock);
+    if (s_on_change) s_on_change();
+    return ESP_OK;
+}
+
+// --- status ---
+
+// SSIDs are arbitrary bytes: escape quotes and backslashes, drop control characters
+static size_t json_str(char* out, size_t out_len, const char* s) {
+    size_t pos = 0;
+    for (; *s && pos + 2 < out_len; s++) {
+        if ((unsigned char)*s < 0x20) continue;
+        if (*s == '"' || *s == '\\') out[pos++] = '\\';
+        out[pos++] = *s;
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+size_t wifi_link_status_json(char* out, size_t out_len) {
+    wifi_sta_list_t sta_list = { 0 };
+    wifi_ap_record_t ap_info = { 0 };
+    char ap_ssid[70], ssid[70], ip[16] = "";
+    esp_wifi_ap_get_sta_list(&sta_list);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sta_state_t state = s_state;
+    bool linked = state == STA_CONNECTED || state == STA_GOT_IP;
+    if (linked) esp_wifi_sta_get_ap_info(&ap_info);
+    if (state == STA_GOT_IP) snprintf(ip, sizeof(ip), IPSTR, IP2STR(&s_ip));
+    json_str(ap_ssid, sizeof(ap_ssid), s_ap.ssid);
+    json_str(ssid, sizeof(ssid), s_ssid);
+    int n = snprintf(out, out_len,
+        "{\"wifi\":{\"mode\":\"APSTA\",\"ap\":{\"ssid\":\"%s\",\"connected_stations\":%d},"
+        "\"sta\":{\"ssid\":\"%s\",\"state\":\"%s\",\"connected\":%s,\"rssi\":%d,\"ip\":\"%s\","
+        "\"channel\":%u,\"remembered\":%s,\"reconnects\":%lu,\"retry_ms\":%lu,\"last_reason\":%u}}}",
+        ap_ssid, sta_list.num, ssid, state_names[state], state == STA_GOT_IP ? "true" : "false",
+        linked ? ap_info.rssi : 0, ip, s_direct ? s_channel : 0, s_direct ? "true" : "false",
+        (unsigned long)s_reconnects, (unsigned long)(state == STA_WAITING ? s_retry_ms : 0), s_last_reason);
+    xSemaphoreGive(s_lock);
+    return n < 0 || (size_t)n >= out_len ? 0 : (size_t)n;
+}
@@ -0,0 +1,31 @@
+// Wi-Fi bring-up driven by WIFI_EVENT/IP_EVENT: the AP is up as soon as the
+// driver starts, the station connects and reconnects with backoff, and its
+// credentials and last AP (BSSID, channel) live in NVS for fast reconnects
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+typedef struct {
+    const char *ssid;
+    const char *password;
+    uint8_t channel;
+    uint8_t max_connections;
+    bool hidden;
+} wifi_link_ap_t;
+
+// Station or AP clients changed; runs on the event loop task
+typedef void (*wifi_link_cb_t)(void);
+
+// Starts AP+STA and returns without waiting for anything. Station
+// credentials come from NVS, or from CONFIG_ESP_WIFI_SSID/PASSWORD until
+// WIFI_STA stores some; an empty SSID leaves the station idle.
+esp_err_t wifi_link_start(const wifi_link_ap_t *ap, wifi_link_cb_t on_change);
+
+// Store new station credentials, forget the remembered AP and reconnect
+esp_err_t wifi_link_set_sta(const char *ssid, const char *password);
+
+// {"wifi":{"mode":"APSTA","ap":{...},"sta":{...}}}
+size_t wifi_link_status_json(char *out, size_t out_len);
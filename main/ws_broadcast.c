@@ -0,0 +1,281 @@
+// WebSocket broadcast — producers enqueue refcounted messages, a single sender
+// task writes them out so no producer ever blocks on a slow socket.
+#include "ws_broadcast.h"
+#include "metrics.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TAG "WsBroadcast"
+
+#define WS_EVICT_STRIKES    32          // consecutive drops before a client is dropped
+#define WS_MAX_LAG_US       3000000     // oldest queued message age before a client is dropped
+#define WS_BYTE_BUDGET      (48 * 1024) // payload bytes alive across all queues
+#define WS_SENDER_IDLE_MS   50
+#define WS_DEFERRED_MAX     512
+#define WS_CLOSE_HOOKS_MAX  4
+
+static bcast_t s_bcast;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_sender;
+static httpd_handle_t s_server;
+static ws_deferred_encoder_t s_encoder;
+static ws_close_hook_t s_close_hooks[WS_CLOSE_HOOKS_MAX];
+static size_t s_num_close_hooks;
+static ws_tick_hook_t s_tick_hook;
+static uint32_t s_closing;          // slots being torn down, under s_lock
+
+static uint32_t now_us(void) {
+    return (uint32_t)esp_timer_get_time();
+}
+
+static bool socket_writable(int fd) {
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(fd, &wfds);
+    struct timeval tv = { 0 };
+    return select(fd + 1, NULL, &wfds, NULL, &tv) > 0;
+}
+
+static esp_err_t send_frame(int fd, bool binary, const uint8_t* data, size_t len) {
+    if (httpd_ws_get_fd_info(s_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET) return ESP_ERR_INVALID_STATE;
+    httpd_ws_frame_t frame = {
+        .type = binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)data,
+        .len = len,
+        .final = true
+    };
+    return httpd_ws_send_frame_async(s_server, fd, &frame);
+}
+
+// Hooks run while the slot is still taken, so a new client can't get it
+// and have its fresh state cleared
+static void run_close_hooks(int slot) {
+    for (size_t i = 0; i < s_num_close_hooks; i++) s_close_hooks[i](slot);
+}
+
+// The sender's eviction and httpd's close_fn can race for a slot: whichever
+// marks it closing first runs the hooks and frees it, the other backs off.
+// False if the slot no longer holds fd or is already closing.
+static bool begin_close(int slot, int fd) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool mine = fd >= 0 && s_bcast.clients[slot].fd == fd && !(s_closing & (1u << slot));
+    if (mine) s_closing |= 1u << slot;
+    xSemaphoreGive(s_lock);
+    return mine;
+}
+
+static bcast_client_t end_close(int slot, int fd) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_client_t stats = s_bcast.clients[slot];
+    if (stats.fd == fd) bcast_remove_client(&s_bcast, slot);
+    s_closing &= ~(1u << slot);
+    xSemaphoreGive(s_lock);
+    return stats;
+}
+
+static void evict_client(int slot) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int fd = s_bcast.clients[slot].fd;
+    xSemaphoreGive(s_lock);
+    if (!begin_close(slot, fd)) return;
+    run_close_hooks(slot);
+    bcast_client_t stats = end_close(slot, fd);
+
+    ESP_LOGW(TAG, "Dropping client fd=%d (depth=%u, dropped=%lu)", fd, stats.count, (unsigned long)stats.dropped);
+    httpd_sess_trigger_close(s_server, fd);
+}
+
+// Send at most one message to a slot; returns true if something went out
+static bool service_client(int slot) {
+    static uint8_t deferred_buf[WS_DEFERRED_MAX];
+    bcast_client_t* c = &s_bcast.clients[slot];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool work = bcast_has_work(c);
+    bool evict = c->evict;
+    int fd = c->fd;
+    xSemaphoreGive(s_lock);
+
+    if (!work) return false;
+    if (evict) {
+        evict_client(slot);
+        return false;
+    }
+    // A full send buffer means a slow client: leave its queue to coalesce
+    if (!socket_writable(fd)) return false;
+
+    uint32_t since = 0, bits = 0;
+    bcast_msg_t* msg = NULL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (c->fd == fd) {
+        if (c->deferred) bits = bcast_take_deferred(c, &since);
+        else msg = bcast_pop(c, &since);
+    }
+    xSemaphoreGive(s_lock);
+
+    esp_err_t err = ESP_OK;
+    if (bits) {
+        bool binary = false;
+        size_t len = s_encoder ? s_encoder(slot, bits, deferred_buf, sizeof(deferred_buf), &binary) : 0;
+        if (len) err = send_frame(fd, binary, deferred_buf, len);
+    } else if (msg) {
+        const uint8_t* data = msg->data;
+        if (msg->stamp_at && msg->len <= sizeof(deferred_buf)) {
+            // Every client gets its own copy, stamped as it goes out
+            char stamp[WS_STAMP_WIDTH + 1];
+            snprintf(stamp, sizeof(stamp), "%*lu", WS_STAMP_WIDTH, (unsigned long)now_us());
+            memcpy(deferred_buf, msg->data, msg->len);
+            memcpy(deferred_buf + msg->stamp_at, stamp, WS_STAMP_WIDTH);
+            data = deferred_buf;
+        }
+        err = send_frame(fd, msg->binary, data, msg->len);
+        bcast_msg_unref(msg);
+    } else {
+        return false;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (c->fd == fd) {
+        if (err == ESP_OK) bcast_record_sent(c, now_us() - since);
+        else c->evict = true;
+    }
+    xSemaphoreGive(s_lock);
+    if (err == ESP_OK) metrics_record(METRIC_BCAST_SEND, now_us() - since);
+    return true;
+}
+
+static void ws_sender_task(void* arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WS_SENDER_IDLE_MS));
+        if (s_tick_hook) s_tick_hook(now_us());
+
+        // Round-robin, one message per client per pass, so nobody starves
+        bool progress;
+        do {
+            progress = false;
+            for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+                progress |= service_client(i);
+            }
+        } while (progress);
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        uint32_t evict = bcast_check_lag(&s_bcast, now_us());
+        xSemaphoreGive(s_lock);
+        for (int i = 0; evict; i++, evict >>= 1) {
+            if (evict & 1) evict_client(i);
+        }
+    }
+}
+
+esp_err_t ws_broadcast_start(ws_deferred_encoder_t encoder) {
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    s_encoder = encoder;
+    bcast_init(&s_bcast, WS_EVICT_STRIKES, WS_MAX_LAG_US, WS_BYTE_BUDGET);
+
+    if (xTaskCreatePinnedToCore(ws_sender_task, "ws_sender", 4096, NULL, 4, &s_sender, 1) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ws_broadcast_set_server(httpd_handle_t server) {
+    s_server = server;
+}
+
+int ws_broadcast_add_client(int fd) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = bcast_add_client(&s_bcast, fd);
+    xSemaphoreGive(s_lock);
+    return slot;
+}
+
+void ws_broadcast_remove_client(int fd) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_remove_client(&s_bcast, bcast_find_client(&s_bcast, fd));
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t ws_broadcast_on_close(ws_close_hook_t hook) {
+    if (s_num_close_hooks == WS_CLOSE_HOOKS_MAX) return ESP_ERR_NO_MEM;
+    s_close_hooks[s_num_close_hooks++] = hook;
+    return ESP_OK;
+}
+
+void ws_broadcast_on_tick(ws_tick_hook_t hook) {
+    s_tick_hook = hook;
+}
+
+void ws_broadcast_session_closed(httpd_handle_t hd, int fd) {
+    // Evicted clients are released by the sender; plain HTTP sessions have no slot
+    int slot = ws_broadcast_slot(fd);
+    if (slot >= 0 && begin_close(slot, fd)) {
+        run_close_hooks(slot);
+        end_close(slot, fd);
+    }
+    close(fd);
+}
+
+int ws_broadcast_slot(int fd) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int slot = bcast_find_client(&s_bcast, fd);
+    xSemaphoreGive(s_lock);
+    return slot;
+}
+
+uint32_t ws_broadcast_clients(void) {
+    uint32_t mask = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < BCAST_MAX_CLIENTS; i++) {
+        if (s_bcast.clients[i].fd >= 0) mask |= 1u << i;
+    }
+    xSemaphoreGive(s_lock);
+    return mask;
+}
+
+static void publish(uint32_t targets, const void* data, size_t len, bool binary, uint8_t key, size_t stamp_at) {
+    if (!(ws_broadcast_clients() & targets)) return;   // don't encode for nobody
+
+    uint32_t start = now_us();
+    bcast_msg_t* msg = bcast_msg_new(&s_bcast, data, len, binary, key);
+    if (!msg) return;
+    msg->stamp_at = stamp_at;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_publish(&s_bcast, msg, targets, now_us());
+    xSemaphoreGive(s_lock);
+    bcast_msg_unref(msg);
+    xTaskNotifyGive(s_sender);
+    metrics_record(METRIC_BCAST_PUBLISH, now_us() - start);
+}
+
+void ws_broadcast_send(uint32_t targets, const void* data, size_t len, bool binary, uint8_t key) {
+    publish(targets, data, len, binary, key, 0);
+}
+
+void ws_broadcast_send_stamped(uint32_t targets, const void* data, size_t len, size_t stamp_at) {
+    // Stamped copies are made in the sender's frame buffer
+    if (stamp_at == 0 || stamp_at + WS_STAMP_WIDTH > len || len > WS_DEFERRED_MAX) return;
+    publish(targets, data, len, false, WS_KEY_NONE, stamp_at);
+}
+
+void ws_broadcast_defer(uint32_t targets, uint32_t bits) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_defer(&s_bcast, targets, bits, now_us());
+    xSemaphoreGive(s_lock);
+    xTaskNotifyGive(s_sender);
+}
+
+size_t ws_broadcast_stats_json(char* out, size_t out_len) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t len = bcast_stats_json(&s_bcast, out, out_len);
+    xSemaphoreGive(s_lock);
+    return len;
+}
@@ -0,0 +1,61 @@
+// WebSocket broadcast layer — per-client bounded queues drained by one sender task
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_http_server.h>
+#include "bcast_core.h"
+
+// Coalescing keys: a newer message with the same key replaces a queued one
+enum {
+    WS_KEY_NONE = BCAST_KEY_NONE,
+    WS_KEY_PINS_JSON,
+    WS_KEY_OSCILLO,
+    WS_KEY_WIFI,
+    WS_KEY_ADC_BLOCK,
+    WS_KEY_METRICS,
+    WS_KEY_ANALYSIS,
+};
+
+// Deferred per-client messages, encoded by the sender task when the client is writable
+#define WS_DEFER_PINS   0x01
+
+// Encode the deferred messages in bits for one client slot; returns 0 for nothing to send
+typedef size_t (*ws_deferred_encoder_t)(int slot, uint32_t bits, uint8_t *buf, size_t len, bool *binary);
+
+esp_err_t ws_broadcast_start(ws_deferred_encoder_t encoder);
+void ws_broadcast_set_server(httpd_handle_t server);
+
+int ws_broadcast_add_client(int fd);    // slot index, or -1 when full
+void ws_broadcast_remove_client(int fd);
+
+// Called with the slot of a client that is going away, before the slot can
+// be reused, so modules can drop their per-client state. Register before
+// the server starts.
+typedef void (*ws_close_hook_t)(int slot);
+esp_err_t ws_broadcast_on_close(ws_close_hook_t hook);
+
+// Called by the sender task at the start of every pass, at least every
+// 50 ms, e.g. to publish state that a rate limit held back.
+// May call ws_broadcast_send(); set before ws_broadcast_start().
+typedef void (*ws_tick_hook_t)(uint32_t now_us);
+void ws_broadcast_on_tick(ws_tick_hook_t hook);
+
+// httpd close_fn: releases the session's slot, then closes the socket
+void ws_broadcast_session_closed(httpd_handle_t hd, int fd);
+int ws_broadcast_slot(int fd);
+uint32_t ws_broadcast_clients(void);    // mask of occupied slots
+
+// Encode-once fan-out to the slots in targets (BCAST_ALL for everyone)
+void ws_broadcast_send(uint32_t targets, const void *data, size_t len, bool binary, uint8_t key);
+
+// Text message with a WS_STAMP_WIDTH-character field at stamp_at, which the
+// sender overwrites with its clock (µs, space padded) for each client as the
+// frame goes out; for latency probes
+#define WS_STAMP_WIDTH  10
+void ws_broadcast_send_stamped(uint32_t targets, const void *data, size_t len, size_t stamp_at);
+void ws_broadcast_defer(uint32_t targets, uint32_t bits);
+
+size_t ws_broadcast_stats_json(char *out, size_t out_len);
@@ -0,0 +1,73 @@
+"""Compare core_bench --json output with a committed baseline.
+
+  core_bench --json | bench_compare.py BASELINE          check, exit 1 on a regression
+  bench_compare.py BASELINE CURRENT                      same, from a saved run
+  core_bench --json > host/bench_baseline.jsonl          refresh the baseline
+
+Heap calls and bytes per op are deterministic and must not grow at all: the
+hot paths are meant to stay allocation-free. ns/op depends on the machine,
+so it only fails past --ns-factor times the baseline, which catches an
+accidental O(n^2) or a lost fast path, not a few percent. A baseline case
+missing from the run fails; new cases are listed and pass.
+Standard library only.
+"""
+import argparse
+import json
+import sys
+
+
+def load(f):
+    cases = {}
+    for line in f:
+        line = line.strip()
+        if line:
+            row = json.loads(line)
+            cases[row['case']] = row
+    return cases
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('baseline')
+    ap.add_argument('current', nargs='?', help='core_bench --json output (default: stdin)')
+    ap.add_argument('--ns-factor', type=float, default=3.0,
+                    help='fail when ns/op exceeds this multiple of the baseline (default 3)')
+    args = ap.parse_args()
+
+    with open(args.baseline) as f:
+        base = load(f)
+    if args.current:
+        with open(args.current) as f:
+            cur = load(f)
+    else:
+        cur = load(sys.stdin)
+
+    failures = 0
+    for name, b in base.items():
+        c = cur.get(name)
+        if c is None:
+            print(f'{name:20} missing from this run  FAIL')
+            failures += 1
+            continue
+        problems = []
+        for key in ('allocs_per_op', 'bytes_per_op'):
+            if c[key] > b[key]:
+                problems.append(f'{key} {b[key]} -> {c[key]}')
+        ratio = c['ns_per_op'] / b['ns_per_op'] if b['ns_per_op'] else 1.0
+        if ratio > args.ns_factor:
+            problems.append(f'ns/op x{ratio:.1f} (limit x{args.ns_factor:g})')
+        status = 'FAIL  ' + ', '.join(problems) if problems else 'ok'
+        print(f'{name:20} {b["ns_per_op"]:>10.1f} -> {c["ns_per_op"]:>10.1f} ns/op  {status}')
+        failures += bool(problems)
+    for name in sorted(set(cur) - set(base)):
+        print(f'{name:20} new, not in the baseline')
+
+    if failures:
+        print(f'bench_compare: {failures} cases regressed', file=sys.stderr)
+        return 1
+    print('ok')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,42 @@
+"""Stage the web UI for the SPIFFS image.
+
+Copies every file from the source directory and writes a gzip variant next
+to each compressible one (index.html -> index.html.gz). The firmware serves
+the .gz file with Content-Encoding: gzip when the browser accepts it.
+"""
+import gzip
+import os
+import shutil
+import sys
+
+COMPRESSIBLE = ('.html', '.htm', '.css', '.js', '.json', '.svg', '.txt', '.csv')
+
+
+def stage(src_dir, out_dir):
+    if os.path.isdir(out_dir):
+        shutil.rmtree(out_dir)
+    os.makedirs(out_dir)
+
+    for root, _, files in os.walk(src_dir):
+        rel_root = os.path.relpath(root, src_dir)
+        dst_root = os.path.normpath(os.path.join(out_dir, rel_root))
+        os.makedirs(dst_root, exist_ok=True)
+        for name in files:
+            src = os.path.join(root, name)
+            dst = os.path.join(dst_root, name)
+            shutil.copyfile(src, dst)
+            if not name.lower().endswith(COMPRESSIBLE):
+                continue
+            with open(src, 'rb') as f:
+                data = f.read()
+            # mtime=0 keeps the image reproducible
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            with open(dst + '.gz', 'wb') as f:
+                f.write(packed)
+            print(f'{os.path.relpath(src, src_dir)}: {len(data)} -> {len(packed)} bytes gzipped')
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit(f'usage: {sys.argv[0]} <data dir> <staging dir>')
+    stage(sys.argv[1], sys.argv[2])
@@ -0,0 +1,222 @@
+"""Decode a recording made with REC_START (see rec_core.h for the format).
+
+  rec_decode.py FILE                  summary: header, chunks, records per type
+  rec_decode.py FILE --csv DIR        adc.csv, scan.csv, edges.csv, uart.bin in DIR
+  rec_decode.py --get URL [FILE]      download http://<device>/rec/<name>, resuming
+                                      a partial FILE with a Range request
+
+Chunks are checked against their CRC and walked from the start of the file,
+so a recording cut short by a reset or a full partition decodes up to its
+last complete chunk; the index at the end is only used for the summary.
+Standard library only.
+"""
+import argparse
+import json
+import os
+import struct
+import sys
+import urllib.request
+import zlib
+
+MAGIC = b'DBGREC01'
+CHUNK_HDR_LEN = 24
+REC_HDR_LEN = 8
+FOOTER_LEN = 16
+
+ADC_BLOCK = 0x01
+UART_RX = 0x03
+ADC_SCAN = 0x05
+EDGES = 0x08
+DROPPED = 0x09
+TYPE_NAMES = {ADC_BLOCK: 'adc', UART_RX: 'uart', ADC_SCAN: 'scan', EDGES: 'edges', DROPPED: 'dropped'}
+
+FRAG_MORE = 0x01
+FRAG_CONT = 0x02
+
+
+class Recording:
+    def __init__(self, data):
+        if data[:8] != MAGIC:
+            raise ValueError('not a recording')
+        self.version, hdr_len, self.max_chunk, self.start_us = struct.unpack_from('<HHIQ', data, 8)
+        self.sources = data[24]
+        desc_len, = struct.unpack_from('<H', data, 26)
+        self.desc = json.loads(data[32:32 + desc_len] or b'{}')
+        self.data = data
+        self.hdr_len = hdr_len
+        self.index = self._read_index()
+
+    def _read_index(self):
+        d = self.data
+        if len(d) < self.hdr_len + FOOTER_LEN or d[-FOOTER_LEN:-FOOTER_LEN + 4] != b'REND':
+            return None
+        offset, chunks, records = struct.unpack_from('<III', d, len(d) - 12)
+        if d[offset:offset + 4] != b'RIDX':
+            return None
+        count, = struct.unpack_from('<I', d, offset + 4)
+        entries = [struct.unpack_from('<IHHIQI', d, offset + 8 + i * 24) for i in range(count)]
+        return {'offset': offset, 'chunks': chunks, 'records': records, 'entries': entries}
+
+    def chunks(self):
+        """(offset, seq, base_us, payload) for each valid chunk, in file order."""
+        d, pos = self.data, self.hdr_len
+        end = self.index['offset'] if self.index else len(d)
+        while pos + CHUNK_HDR_LEN <= end:
+            if d[pos:pos + 4] != b'RCHK':
+                break
+            seq, base_us, length, _, crc = struct.unpack_from('<IQHHI', d, pos + 4)
+            payload = d[pos + CHUNK_HDR_LEN:pos + CHUNK_HDR_LEN + length]
+            if len(payload) != length or zlib.crc32(payload) != crc:
+                break
+            yield pos, seq, base_us, payload
+            pos += (CHUNK_HDR_LEN + length + 3) & ~3
+
+    def records(self):
+        """(type, t_us, payload) with fragments joined; t_us is esp_timer time
+        of the first fragment. A record whose tail was lost is skipped."""
+        pending = None
+        for _, _, base_us, payload in self.chunks():
+            pos = 0
+            while pos + REC_HDR_LEN <= len(payload):
+                rtype, flags, length, dt = struct.unpack_from('<BBHI', payload, pos)
+                body = payload[pos + REC_HDR_LEN:pos + REC_HDR_LEN + length]
+                pos += REC_HDR_LEN + length
+                if flags & FRAG_CONT:
+                    if pending is None or pending[0] != rtype:
+                        pending = None
+                        continue
+                    pending[2].extend(body)
+                else:
+                    pending = (rtype, base_us + dt, bytearray(body))
+                if not flags & FRAG_MORE:
+                    yield pending[0], pending[1], bytes(pending[2])
+                    pending = None
+
+
+def edges(payload):
+    for i in range(0, len(payload) - 5, 6):
+        yield struct.unpack_from('<IBB', payload, i)
+
+
+def adc_block(frame):
+    """(channel, seq, rate, pre_trigger or None, raw codes)"""
+    channel, _, _, seq, rate, _, n, pre = struct.unpack_from('<xBBBIIIHH', frame)
+    codes = struct.unpack_from(f'<{n}H', frame, 20)
+    return channel, seq, rate, None if pre == 0xFFFF else pre, codes
+
+
+def scan_frame(frame):
+    """(seq, rate, per_point, {gpio: [(min, mean, max), ...]})"""
+    channels, flags, seq, rate, per_point, points = struct.unpack_from('<BBxIIIH', frame, 1)
+    gpios = frame[20:20 + channels]
+    base = 20 + ((channels + 1) & ~1)
+    out = {}
+    for c, gpio in enumerate(gpios):
+        vals = struct.unpack_from(f'<{points * 3}H', frame, base + c * points * 6)
+        out[gpio] = [vals[i:i + 3] for i in range(0, len(vals), 3)]
+    return seq, rate, per_point, out
+
+
+def summary(rec):
+    print(f'version {rec.version}, started at {rec.start_us / 1e6:.3f} s (device uptime)')
+    print(f'description: {json.dumps(rec.desc)}')
+    counts, first, last, dropped, chunks = {}, None, None, 0, 0
+    for _ in rec.chunks():
+        chunks += 1
+    for rtype, t_us, payload in rec.records():
+        name = TYPE_NAMES.get(rtype, f'0x{rtype:02x}')
+        counts[name] = counts.get(name, 0) + 1
+        first = t_us if first is None else first
+        last = t_us
+        if rtype == DROPPED:
+            dropped = struct.unpack_from('<I', payload)[0]
+    print(f'{chunks} valid chunks, {len(rec.data)} bytes')
+    if rec.index:
+        ix = rec.index
+        print(f'index: {len(ix["entries"])} entries over {ix["chunks"]} chunks, {ix["records"]} records')
+    else:
+        print('no index: recording did not end cleanly, decoded up to the last valid chunk')
+    if first is not None:
+        print(f'span {(last - first) / 1e6:.3f} s')
+    for name, n in sorted(counts.items()):
+        print(f'  {name:8} {n}')
+    if dropped:
+        print(f'{dropped} records dropped while flash was busy')
+
+
+def export_csv(rec, out_dir):
+    os.makedirs(out_dir, exist_ok=True)
+    with open(os.path.join(out_dir, 'adc.csv'), 'w') as adc, \
+            open(os.path.join(out_dir, 'scan.csv'), 'w') as scan, \
+            open(os.path.join(out_dir, 'edges.csv'), 'w') as edg, \
+            open(os.path.join(out_dir, 'uart.bin'), 'wb') as uart:
+        adc.write('t_us,block,channel,rate,index,raw\n')
+        scan.write('t_us,frame,gpio,point,min,mean,max\n')
+        edg.write('t_us,gpio,level\n')
+        for rtype, t_us, payload in rec.records():
+            if rtype == ADC_BLOCK:
+                channel, seq, rate, _, codes = adc_block(payload)
+                adc.writelines(f'{t_us},{seq},{channel},{rate},{i},{c}\n' for i, c in enumerate(codes))
+            elif rtype == ADC_SCAN:
+                seq, _, _, by_gpio = scan_frame(payload)
+                for gpio, points in by_gpio.items():
+                    scan.writelines(f'{t_us},{seq},{gpio},{i},{p[0]},{p[1]},{p[2]}\n' for i, p in enumerate(points))
+            elif rtype == EDGES:
+                # Edge times are the low 32 bits of esp_timer; rebuild the top from the record time
+                for t, gpio, level in edges(payload):
+                    full = (t_us & ~0xFFFFFFFF) | t
+                    if full > t_us + (1 << 31):
+                        full -= 1 << 32
+                    edg.write(f'{full},{gpio},{level}\n')
+            elif rtype == UART_RX:
+                n, = struct.unpack_from('<H', payload, 16)
+                uart.write(payload[18:18 + n])
+    print(f'wrote adc.csv, scan.csv, edges.csv and uart.bin to {out_dir}')
+
+
+def download(url, path):
+    have = os.path.getsize(path) if os.path.exists(path) else 0
+    req = urllib.request.Request(url)
+    if have:
+        req.add_header('Range', f'bytes={have}-')
+    try:
+        resp = urllib.request.urlopen(req, timeout=30)
+    except urllib.error.HTTPError as e:
+        if e.code == 416:
+            print(f'{path} is already complete ({have} bytes)')
+            return
+        raise
+    mode = 'ab' if have and resp.status == 206 else 'wb'
+    with resp, open(path, mode) as f:
+        while True:
+            block = resp.read(65536)
+            if not block:
+                break
+            f.write(block)
+    print(f'{path}: {os.path.getsize(path)} bytes')
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('file', nargs='?')
+    ap.add_argument('--csv', metavar='DIR', help='export records as CSV')
+    ap.add_argument('--get', metavar='URL', help='download a recording, resuming a partial file')
+    args = ap.parse_args()
+
+    if args.get:
+        args.file = args.file or args.get.rstrip('/').rsplit('/', 1)[-1]
+        download(args.get, args.file)
+        if not args.csv:
+            return
+    if not args.file:
+        ap.error('no recording given')
+    with open(args.file, 'rb') as f:
+        rec = Recording(f.read())
+    if args.csv:
+        export_csv(rec, args.csv)
+    else:
+        summary(rec)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
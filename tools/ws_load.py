@@ -0,0 +1,406 @@
+"""Load generator and latency probe for the debugger's WebSocket.
+
+  ws_load.py DEVICE [--clients N] [--rate HZ] [--duration S] [--mix CMD]...
+                    [--fanout-hz HZ] [--subs TOPICS] [--json]
+
+DEVICE is an address or a ws:// URL (default path /ws). Every client sends
+--rate frames a second for --duration seconds: one command from the mix,
+then PING:<id>. The device answers with {"pong":...} carrying the frame's
+receive time, the time the commands before the PING were done and the time
+the reply went out, so the round trip splits into time spent applying,
+time queued for the sender, and the network. Client 0 also sends
+PING:<id>,ALL --fanout-hz times a second; the delay until each client has
+that pong is the broadcast fan-out delay. Pongs still missing --grace
+seconds after the run count as dropped, and the device's queue counters
+(CLIENTS) and /metrics counters are compared before and after.
+
+Mix entries are [<weight>*]<command>, where {n} is the frame number, {bit}
+is n % 2 and {client} the client number:
+
+  ws_load.py 192.168.4.1 --clients 4 --rate 50 --mix '4*WRITE:2,{bit}' --mix PWM_STATS
+
+Without --mix the frames are bare PINGs. Clients subscribe to --subs only
+(default PINS), so the oscilloscope stream doesn't load the link unless
+asked for. The device takes at most 8 clients. Standard library only.
+"""
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import os
+import random
+import re
+import struct
+import sys
+import time
+import urllib.request
+from urllib.parse import urlsplit
+
+WS_GUID = b'258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+OP_TEXT, OP_BINARY, OP_CLOSE, OP_PING, OP_PONG = 0x1, 0x2, 0x8, 0x9, 0xA
+MAX_CLIENTS = 8     # BCAST_MAX_CLIENTS
+
+
+class WsClient:
+    """Minimal RFC 6455 client: masked text frames out, whole messages in."""
+
+    def __init__(self, reader, writer):
+        self.reader = reader
+        self.writer = writer
+
+    @classmethod
+    async def connect(cls, host, port, path):
+        reader, writer = await asyncio.open_connection(host, port)
+        key = base64.b64encode(os.urandom(16))
+        writer.write(b'GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+                     b'Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n'
+                     % (path.encode(), host.encode(), port, key))
+        head = await reader.readuntil(b'\r\n\r\n')
+        accept = base64.b64encode(hashlib.sha1(key + WS_GUID).digest())
+        if b' 101 ' not in head.split(b'\r\n', 1)[0] + b' ' or accept not in head:
+            writer.close()
+            raise ConnectionError('no WebSocket upgrade: %r' % head.split(b'\r\n', 1)[0])
+        return cls(reader, writer)
+
+    def _send(self, op, payload):
+        n = len(payload)
+        if n < 126:
+            hdr = struct.pack('>BB', 0x80 | op, 0x80 | n)
+        elif n < 65536:
+            hdr = struct.pack('>BBH', 0x80 | op, 0x80 | 126, n)
+        else:
+            hdr = struct.pack('>BBQ', 0x80 | op, 0x80 | 127, n)
+        mask = os.urandom(4)
+        self.writer.write(hdr + mask + mask_bytes(payload, mask))
+
+    def send_text(self, text):
+        self._send(OP_TEXT, text.encode())
+
+    async def recv(self):
+        """Next text or binary message as (opcode, payload); EOFError on close."""
+        parts, op = [], None
+        while True:
+            b0, b1 = await self.reader.readexactly(2)
+            n = b1 & 0x7F
+            if n == 126:
+                n, = struct.unpack('>H', await self.reader.readexactly(2))
+            elif n == 127:
+                n, = struct.unpack('>Q', await self.reader.readexactly(8))
+            mask = await self.reader.readexactly(4) if b1 & 0x80 else None
+            data = await self.reader.readexactly(n)
+            if mask:
+                data = mask_bytes(data, mask)
+            frame_op = b0 & 0x0F
+            if frame_op == OP_CLOSE:
+                raise EOFError('closed by the device')
+            if frame_op == OP_PING:
+                self._send(OP_PONG, data)
+                continue
+            if frame_op == OP_PONG:
+                continue
+            if frame_op:
+                op = frame_op
+            parts.append(data)
+            if b0 & 0x80:
+                return op, b''.join(parts)
+
+    def close(self):
+        self.writer.close()
+
+
+def mask_bytes(data, mask):
+    key = int.from_bytes((mask * (len(data) // 4 + 1))[:len(data)], 'big')
+    return (int.from_bytes(data, 'big') ^ key).to_bytes(len(data), 'big')
+
+
+def parse_target(target):
+    url = urlsplit(target if '://' in target else 'ws://' + target)
+    return url.hostname, url.port or 80, url.path or '/ws'
+
+
+def parse_mix(entries):
+    mix = []
+    for entry in entries:
+        m = re.match(r'(\d+)\*(.+)$', entry)
+        weight, cmd = (int(m.group(1)), m.group(2)) if m else (1, entry)
+        if weight < 1 or not cmd:
+            raise ValueError('bad mix entry: %s' % entry)
+        mix.append((weight, cmd))
+    return mix
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    s = sorted(values)
+    return s[min(len(s) - 1, max(0, int(round(p / 100 * len(s))) - 1))]
+
+
+def summary(values):
+    r = lambda v: None if v is None else round(v, 3)
+    return {'count': len(values), 'p50': r(percentile(values, 50)), 'p99': r(percentile(values, 99)),
+            'max': r(max(values) if values else None)}
+
+
+def us_delta(a, b):
+    # Device timestamps are 32-bit esp_timer microseconds
+    return (a - b) & 0xFFFFFFFF
+
+
+def fetch_counters(host, port):
+    """dbg_*_total counters from /metrics, or None if it can't be read."""
+    try:
+        with urllib.request.urlopen('http://%s:%d/metrics' % (host, port), timeout=5) as r:
+            text = r.read().decode()
+    except OSError:
+        return None
+    counters = {}
+    for line in text.splitlines():
+        m = re.match(r'(dbg_\w+_total(?:\{[^}]*\})?) (\d+)$', line)
+        if m:
+            counters[m.group(1)] = int(m.group(2))
+    return counters
+
+
+class Run:
+    def __init__(self, args, mix):
+        self.args = args
+        self.mix = mix
+        self.rng = random.Random(args.seed)
+        self.next_id = 1
+        self.pings = {}             # id -> (client, sent)
+        self.fanouts = {}           # id -> sent
+        self.fanout_rx = {}         # id -> {client: delay ms}
+        self.rtt_ms = []
+        self.apply_us = []
+        self.queue_us = []
+        self.fanout_queue_us = []
+        self.cmd_errors = []
+        self.received = [0] * args.clients
+        self.received_bytes = [0] * args.clients
+        self.clients_reply = None
+
+    def new_id(self):
+        i = self.next_id
+        self.next_id += 1
+        return i
+
+    def command(self, client, n):
+        if not self.mix:
+            return ''
+        cmd = self.rng.choices([c for _, c in self.mix], [w for w, _ in self.mix])[0]
+        return cmd.replace('{n}', str(n)).replace('{bit}', str(n % 2)).replace('{client}', str(client))
+
+    def on_message(self, client, op, payload):
+        now = time.perf_counter()
+        self.received[client] += 1
+        self.received_bytes[client] += len(payload)
+        if op != OP_TEXT:
+            return
+        try:
+            msg = json.loads(payload)
+        except ValueError:
+            return
+        if not isinstance(msg, dict):
+            return
+        if 'pong' in msg:
+            p = msg['pong']
+            if p['id'] in self.fanouts:
+                self.fanout_rx.setdefault(p['id'], {})[client] = (now - self.fanouts[p['id']]) * 1000
+                self.fanout_queue_us.append(us_delta(p['send_us'], p['apply_us']))
+            elif p['id'] in self.pings and self.pings[p['id']][0] == client:
+                _, sent = self.pings.pop(p['id'])
+                self.rtt_ms.append((now - sent) * 1000)
+                self.apply_us.append(us_delta(p['apply_us'], p['rx_us']))
+                self.queue_us.append(us_delta(p['send_us'], p['apply_us']))
+        elif 'error' in msg:
+            self.cmd_errors.append(msg['error'])
+        elif 'clients' in msg and self.clients_reply and not self.clients_reply.done():
+            self.clients_reply.set_result(msg)
+
+    async def reader(self, client, ws):
+        try:
+            while True:
+                op, payload = await ws.recv()
+                self.on_message(client, op, payload)
+        except (EOFError, asyncio.IncompleteReadError, ConnectionError):
+            pass
+
+    async def sender(self, client, ws, end):
+        period = 1 / self.args.rate
+        # Clients start spread over one period rather than all at once
+        next_t = time.perf_counter() + period * client / self.args.clients
+        n = 0
+        while next_t < end:
+            await asyncio.sleep(max(0, next_t - time.perf_counter()))
+            cmd = self.command(client, n)
+            ping_id = self.new_id()
+            self.pings[ping_id] = (client, time.perf_counter())
+            ws.send_text('%s\nPING:%d' % (cmd, ping_id) if cmd else 'PING:%d' % ping_id)
+            await ws.writer.drain()
+            n += 1
+            next_t += period
+
+    async def fanout(self, ws, end):
+        period = 1 / self.args.fanout_hz
+        next_t = time.perf_counter() + period / 2
+        while next_t < end:
+            await asyncio.sleep(max(0, next_t - time.perf_counter()))
+            ping_id = self.new_id()
+            self.fanouts[ping_id] = time.perf_counter()
+            ws.send_text('PING:%d,ALL' % ping_id)
+            await ws.writer.drain()
+            next_t += period
+
+    async def device_queues(self, ws):
+        """The CLIENTS reply: per-slot queue counters of every client."""
+        self.clients_reply = asyncio.get_running_loop().create_future()
+        ws.send_text('CLIENTS')
+        try:
+            return await asyncio.wait_for(self.clients_reply, 3)
+        except asyncio.TimeoutError:
+            return None
+
+    def fanout_missing(self):
+        n = self.args.clients
+        return sum(n - len(self.fanout_rx.get(i, {})) for i in self.fanouts)
+
+    async def run(self, host, port, path):
+        args = self.args
+        wss = []
+        for i in range(args.clients):
+            ws = await WsClient.connect(host, port, path)
+            # A registered client gets the pin states at once; the device
+            # upgrades but ignores clients beyond its slots
+            try:
+                await asyncio.wait_for(ws.recv(), 3)
+            except asyncio.TimeoutError:
+                raise ConnectionError('client %d got no pin states; are all slots taken?' % i)
+            subs = ['UNSUB:ALL'] + ['SUB:' + t for t in args.subs.split(',') if t]
+            ws.send_text('\n'.join(subs))
+            wss.append(ws)
+        readers = [asyncio.ensure_future(self.reader(i, ws)) for i, ws in enumerate(wss)]
+        await asyncio.sleep(0.5)    # subscription replies and initial state
+
+        counters_before = fetch_counters(host, port) if args.http else None
+        queues_before = await self.device_queues(wss[0])
+
+        self.received = [0] * args.clients
+        self.received_bytes = [0] * args.clients
+        start = time.perf_counter()
+        end = start + args.duration
+        tasks = [self.sender(i, ws, end) for i, ws in enumerate(wss)]
+        if args.fanout_hz > 0:
+            tasks.append(self.fanout(wss[0], end))
+        await asyncio.gather(*tasks)
+
+        grace_end = time.perf_counter() + args.grace
+        while (self.pings or self.fanout_missing()) and time.perf_counter() < grace_end:
+            await asyncio.sleep(0.05)
+        elapsed = time.perf_counter() - start
+
+        queues_after = await self.device_queues(wss[0])
+        counters_after = fetch_counters(host, port) if args.http else None
+        for r in readers:
+            r.cancel()
+        for ws in wss:
+            ws.close()
+        return self.report(elapsed, queues_before, queues_after, counters_before, counters_after)
+
+    def report(self, elapsed, queues_before, queues_after, counters_before, counters_after):
+        args = self.args
+        sent = self.next_id - 1 - len(self.fanouts)
+        fanout_delays = [d for rx in self.fanout_rx.values() for d in rx.values()]
+        spreads = [max(rx.values()) - min(rx.values()) for rx in self.fanout_rx.values() if len(rx) > 1]
+        result = {
+            'clients': args.clients, 'rate': args.rate, 'duration_s': args.duration,
+            'mix': [{'weight': w, 'cmd': c} for w, c in self.mix],
+            'rtt_ms': summary(self.rtt_ms),
+            'device_apply_us': summary(self.apply_us),
+            'device_queue_us': summary(self.queue_us),
+            'fanout_ms': summary(fanout_delays),
+            'fanout_spread_ms': summary(spreads),
+            'fanout_queue_us': summary(self.fanout_queue_us),
+            'pings': sent, 'pongs_dropped': len(self.pings),
+            'fanouts': len(self.fanouts), 'fanout_dropped': self.fanout_missing(),
+            'cmd_errors': len(self.cmd_errors),
+            'rx_msgs_per_s': round(sum(self.received) / elapsed, 1),
+            'rx_bytes_per_s': round(sum(self.received_bytes) / elapsed),
+        }
+        if queues_before and queues_after:
+            def total(q, key):
+                return sum(c[key] for c in q['clients'])
+            result['device_queues'] = {
+                'dropped': total(queues_after, 'dropped') - total(queues_before, 'dropped'),
+                'coalesced': total(queues_after, 'coalesced') - total(queues_before, 'coalesced'),
+                'max_depth': max(c['max_depth'] for c in queues_after['clients']),
+                'evictions': queues_after['evictions'] - queues_before['evictions'],
+                'alloc_failures': queues_after['alloc_failures'] - queues_before['alloc_failures'],
+            }
+        if counters_before is not None and counters_after is not None:
+            result['device_counters'] = {k: v - counters_before.get(k, 0) for k, v in counters_after.items()
+                                         if v != counters_before.get(k, 0)}
+        return result
+
+
+def fmt(s, unit, scale=1, digits=1):
+    if not s['count']:
+        return 'none'
+    f = lambda v: '%.*f' % (digits, v * scale)
+    return 'p50 %s  p99 %s  max %s %s  (%d)' % (f(s['p50']), f(s['p99']), f(s['max']), unit, s['count'])
+
+
+def print_report(r):
+    mix = ', '.join('%s x%d' % (m['cmd'], m['weight']) for m in r['mix']) or 'PING only'
+    print('%d clients x %g frames/s for %g s, mix: %s' % (r['clients'], r['rate'], r['duration_s'], mix))
+    print('round trip       %s' % fmt(r['rtt_ms'], 'ms'))
+    print('  applying       %s' % fmt(r['device_apply_us'], 'us', digits=0))
+    print('  sender queue   %s' % fmt(r['device_queue_us'], 'us', digits=0))
+    print('fan-out          %s' % fmt(r['fanout_ms'], 'ms'))
+    print('  spread         %s' % fmt(r['fanout_spread_ms'], 'ms'))
+    print('  sender queue   %s' % fmt(r['fanout_queue_us'], 'us', digits=0))
+    print('dropped          %d of %d pongs, %d of %d fan-out deliveries'
+          % (r['pongs_dropped'], r['pings'], r['fanout_dropped'], r['fanouts'] * r['clients']))
+    print('received         %.1f msgs/s, %d B/s' % (r['rx_msgs_per_s'], r['rx_bytes_per_s']))
+    if r['cmd_errors']:
+        print('command errors   %d' % r['cmd_errors'])
+    if 'device_queues' in r:
+        q = r['device_queues']
+        print('device queues    %d dropped, %d coalesced, max depth %d, %d evictions, %d alloc failures'
+              % (q['dropped'], q['coalesced'], q['max_depth'], q['evictions'], q['alloc_failures']))
+    for k, v in sorted(r.get('device_counters', {}).items()):
+        print('  %-40s +%d' % (k, v))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('device', help='address or ws://host[:port]/path')
+    ap.add_argument('--clients', type=int, default=4)
+    ap.add_argument('--rate', type=float, default=20, help='frames per second per client')
+    ap.add_argument('--duration', type=float, default=10, help='seconds')
+    ap.add_argument('--mix', action='append', default=[], help='[<weight>*]<command>, repeatable')
+    ap.add_argument('--fanout-hz', type=float, default=5, help='PING:<id>,ALL rate, 0 = none')
+    ap.add_argument('--subs', default='PINS', help='topics each client subscribes to, comma separated')
+    ap.add_argument('--grace', type=float, default=2, help='seconds to wait for late pongs')
+    ap.add_argument('--seed', type=int, default=1, help='for the command mix')
+    ap.add_argument('--no-http', dest='http', action='store_false', help="don't read /metrics")
+    ap.add_argument('--json', action='store_true')
+    args = ap.parse_args()
+    if not 1 <= args.clients <= MAX_CLIENTS or args.rate <= 0 or args.duration <= 0:
+        ap.error('--clients must be 1 to %d, --rate and --duration positive' % MAX_CLIENTS)
+
+    host, port, path = parse_target(args.device)
+    try:
+        result = asyncio.run(Run(args, parse_mix(args.mix)).run(host, port, path))
+    except (OSError, ValueError, asyncio.IncompleteReadError) as e:
+        sys.exit('ws_load: %s' % e)
+    if args.json:
+        json.dump(result, sys.stdout, indent=2)
+        print()
+    else:
+        print_report(result)
+
+
+if __name__ == '__main__':
+    main()